@@ -1,8 +1,32 @@
 #include <GL/glut.h>
+#include <GL/freeglut_ext.h> // glutGetProcAddress (funções GL além da 1.1)
 #include <GL/glu.h>
+#include <GL/glext.h>
+#if defined(__linux__) || defined(__FreeBSD__)
+#define RENDER_THREAD_GLX 1 // Thread de renderização separada (requer GLX/Xlib)
+#include <GL/glx.h>
+#include <X11/Xlib.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h> // readlink("/proc/self/exe"): diretório do cache de shaders
+#endif
 #include <math.h>
 #include <stdio.h>
-#include <stdbool.h> 
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USAR_SSE 1  // Estêncil da ola e testes de raio da BVH em SSE
+#endif
 
 // --- Integração com stb_image.h ---
 // Define esta macro em *um* arquivo .c ou .cpp antes de incluir stb_image.h
@@ -15,6 +39,28 @@
 #define PI 3.14159265359
 #define GRAUS_PARA_RAD(graus) ((graus) * PI / 180.0f)
 
+// --- Vetor 3D ---
+struct Vetor3 {
+    float x, y, z;
+};
+
+inline Vetor3 vetor3(float x, float y, float z) { Vetor3 v = {x, y, z}; return v; }
+inline Vetor3 operator+(Vetor3 a, Vetor3 b) { return vetor3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vetor3 operator-(Vetor3 a, Vetor3 b) { return vetor3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vetor3 operator*(Vetor3 a, float k) { return vetor3(a.x * k, a.y * k, a.z * k); }
+inline Vetor3 operator*(float k, Vetor3 a) { return a * k; }
+inline float produtoEscalar(Vetor3 a, Vetor3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vetor3 produtoVetorial(Vetor3 a, Vetor3 b) {
+    return vetor3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float comprimento(Vetor3 a) { return sqrtf(produtoEscalar(a, a)); }
+inline Vetor3 normalizar(Vetor3 a) {
+    float c = comprimento(a);
+    return (c > 0.0f) ? a * (1.0f / c) : a;
+}
+inline Vetor3 interpolar(Vetor3 a, Vetor3 b, float t) { return a + (b - a) * t; }
+inline Vetor3 produtoComponentes(Vetor3 a, Vetor3 b) { return vetor3(a.x * b.x, a.y * b.y, a.z * b.z); }
+
 // --- Constantes e Variáveis Globais ---
 
 // IDs das Texturas OpenGL
@@ -28,6 +74,9 @@ float anguloRotacaoZ = 0.0f;    // Rotação em torno do eixo Z (vista de cima)
 float anguloRotacaoY = 0.0f;   // Rotação em torno do eixo Y (inclinação vertical inicial)
 float anguloRotacaoX = 280.0f;    // Rotação em torno do eixo X
 float cameraDistanciaZ = 5.0f;  // Distância da câmera ao centro (zoom)
+const float CAMPO_VISAO_GRAUS = 60.0f; // Abertura vertical da perspectiva
+const float PLANO_PROXIMO = 0.1f, PLANO_DISTANTE = 100.0f;  // Planos de corte da perspectiva
+const float COR_CEU[3] = {0.529f, 0.808f, 0.922f};          // Fundo (azul céu claro)
 
 // Constantes da Geometria da Arquibancada/Estádio
 const int NUM_DEGRAUS = 15;                 // Número de degraus na arquibancada
@@ -39,7 +88,132 @@ const float ALTURA_MIN_ESC = ALTURA_MIN_REAL / ESCALA_OPENGL; // Altura inicial/
 const float ALTURA_MAX_ESC = ALTURA_MAX_REAL / ESCALA_OPENGL; // Altura máxima em unidades OpenGL
 const float Z_BASE_INICIAL = 0.0f;          // Coordenada Z da base dos degraus/paredes
 const float Z_CHAO = -0.01f;                // Coordenada Z do plano do chão (ligeiramente abaixo da base)
+// Gramado: elipse no centro, ligeiramente acima do chão para evitar Z-fighting
+const float RAIO_X_GRAMADO = 0.4f;
+const float RAIO_Y_GRAMADO = 0.6f;
+const float Z_GRAMADO = Z_CHAO + 0.001f;
 const float INCLINACAO_PAREDE_OFFSET = 0.05f; // Deslocamento radial no topo da parede para criar inclinação
+// Raios da elipse das arquibancadas (borda interna e base da parede externa)
+const float RAIO_X_ARQUIBANCADA_INT = 0.5f;
+const float RAIO_Y_ARQUIBANCADA_INT = 0.7f;
+const float RAIO_X_ARQUIBANCADA_EXT = 0.8f;
+const float RAIO_Y_ARQUIBANCADA_EXT = 0.95f;
+
+// Arcos (graus) das arquibancadas principais e das paredes de conexão
+const float ARCOS_PRINCIPAIS[][2] = {
+    {  0.0f,  60.0f}, {120.0f, 140.0f}, {140.0f, 220.0f}, {220.0f, 240.0f}, {300.0f, 360.0f}
+};
+const int NUM_ARCOS_PRINCIPAIS = sizeof(ARCOS_PRINCIPAIS) / sizeof(ARCOS_PRINCIPAIS[0]);
+const float ARCOS_CONEXAO[][2] = {
+    { 60.0f, 120.0f}, {240.0f, 300.0f}
+};
+const int NUM_ARCOS_CONEXAO = sizeof(ARCOS_CONEXAO) / sizeof(ARCOS_CONEXAO[0]);
+const int SEGMENTOS_CURVA_DEGRAU = 40;  // Segmentos por arco (detalhe 1)
+const int SEGMENTOS_CURVA_PAREDE = 60;
+
+// Seção especial (arquibancada 140-220): mais degraus, mais alta e mais funda
+const int DEGRAUS_ADICIONAIS_SECAO_ESPECIAL = 8;
+const float FATOR_ALTURA_SECAO_ESPECIAL = 1.35f;
+const float FATOR_RAIO_EXTERNO_SECAO_ESPECIAL = 1.15f;
+// Parede superior sobre a seção especial e marquise apoiada nela
+const float INCLINACAO_PAREDE_SUPERIOR_EXTRA = 0.15f;
+const float FATOR_ALTURA_PAREDE_SUPERIOR = 1.6f;
+const float MARQUISE_ESPESSURA = 0.03f;
+const float MARQUISE_PROJECAO_RADIAL = -0.3f;
+const float MARQUISE_INCLINACAO_Z_OFFSET = 0.08f;
+const float MARQUISE_ANGULO_INICIAL = 180.0f;
+const float MARQUISE_ANGULO_FINAL = 220.0f;
+const int NUM_REFLETORES_MARQUISE = 105;    // Ao longo da borda frontal da marquise
+
+// Medidas derivadas, antes calculadas a cada quadro dentro do desenho
+struct ParametrosEstadio {
+    float centro_x, centro_y;
+    float raio_x_geral_int, raio_y_geral_int;
+    float raio_x_geral_ext, raio_y_geral_ext;
+    float largura_radial_x_padrao, largura_radial_y_padrao;
+    float altura_max_parede_padrao;
+    float rx_topo_parede_padrao, ry_topo_parede_padrao;
+    float altura_arco_conexao;
+    int num_degraus_secao_especial;
+    float altura_max_secao_especial;
+    float largura_radial_x_especial, largura_radial_y_especial;
+    float rx_base_parede_superior, ry_base_parede_superior, z_base_parede_superior;
+    float rx_topo_parede_superior, ry_topo_parede_superior, z_topo_parede_superior;
+    float rx_base_marquise, ry_base_marquise, z_base_marquise;
+    float rx_frente_marquise, ry_frente_marquise, z_frente_marquise;
+};
+
+ParametrosEstadio calcularParametrosEstadio() {
+    ParametrosEstadio p;
+    p.centro_x = 0.0f;
+    p.centro_y = 0.0f;
+    p.raio_x_geral_int = RAIO_X_ARQUIBANCADA_INT;
+    p.raio_y_geral_int = RAIO_Y_ARQUIBANCADA_INT;
+    p.raio_x_geral_ext = RAIO_X_ARQUIBANCADA_EXT;
+    p.raio_y_geral_ext = RAIO_Y_ARQUIBANCADA_EXT;
+    p.largura_radial_x_padrao = p.raio_x_geral_ext - p.raio_x_geral_int;
+    p.largura_radial_y_padrao = p.raio_y_geral_ext - p.raio_y_geral_int;
+    p.altura_max_parede_padrao = ALTURA_MAX_ESC;
+    p.rx_topo_parede_padrao = p.raio_x_geral_ext + INCLINACAO_PAREDE_OFFSET;
+    p.ry_topo_parede_padrao = p.raio_y_geral_ext + INCLINACAO_PAREDE_OFFSET;
+    p.altura_arco_conexao = ALTURA_MIN_ESC * 7;
+
+    p.num_degraus_secao_especial = NUM_DEGRAUS + DEGRAUS_ADICIONAIS_SECAO_ESPECIAL;
+    p.altura_max_secao_especial = p.altura_max_parede_padrao * FATOR_ALTURA_SECAO_ESPECIAL;
+    p.largura_radial_x_especial = p.raio_x_geral_ext * FATOR_RAIO_EXTERNO_SECAO_ESPECIAL - p.raio_x_geral_int;
+    p.largura_radial_y_especial = p.raio_y_geral_ext * FATOR_RAIO_EXTERNO_SECAO_ESPECIAL - p.raio_y_geral_int;
+
+    p.rx_base_parede_superior = p.rx_topo_parede_padrao;
+    p.ry_base_parede_superior = p.ry_topo_parede_padrao;
+    p.z_base_parede_superior = p.altura_max_parede_padrao;
+    p.rx_topo_parede_superior = p.rx_base_parede_superior + INCLINACAO_PAREDE_SUPERIOR_EXTRA;
+    p.ry_topo_parede_superior = p.ry_base_parede_superior + INCLINACAO_PAREDE_SUPERIOR_EXTRA;
+    p.z_topo_parede_superior = p.altura_max_parede_padrao * FATOR_ALTURA_PAREDE_SUPERIOR;
+
+    p.rx_base_marquise = p.rx_topo_parede_superior; // Base (atrás) no topo da parede superior
+    p.ry_base_marquise = p.ry_topo_parede_superior;
+    p.z_base_marquise = p.z_topo_parede_superior + 0.03f;
+    p.rx_frente_marquise = p.rx_base_marquise + MARQUISE_PROJECAO_RADIAL; // Frente (projetada) com raio menor
+    p.ry_frente_marquise = p.ry_base_marquise + MARQUISE_PROJECAO_RADIAL;
+    p.z_frente_marquise = p.z_base_marquise + MARQUISE_INCLINACAO_Z_OFFSET;
+    return p;
+}
+
+const ParametrosEstadio estadio = calcularParametrosEstadio();
+
+bool arcoSecaoEspecial(int arco) {
+    return fabs(ARCOS_PRINCIPAIS[arco][0] - 140.0f) < FLOAT_COMPARISON_TOLERANCE;
+}
+
+int numDegrausArco(int arco) {
+    return arcoSecaoEspecial(arco) ? estadio.num_degraus_secao_especial : NUM_DEGRAUS;
+}
+
+// Raios e alturas do degrau 'k' (0 = mais baixo) de um arco principal
+struct GeometriaDegrau {
+    float rx_int, ry_int, rx_ext, ry_ext;
+    float z_base, z_topo;
+};
+
+GeometriaDegrau geometriaDegrau(int arco, int k) {
+    bool secao_especial = arcoSecaoEspecial(arco);
+    int num_degraus = numDegrausArco(arco);
+    // A altura máxima aqui refere-se à arquibancada
+    float altura_max = secao_especial ? estadio.altura_max_secao_especial : estadio.altura_max_parede_padrao;
+    float largura_x = secao_especial ? estadio.largura_radial_x_especial : estadio.largura_radial_x_padrao;
+    float largura_y = secao_especial ? estadio.largura_radial_y_especial : estadio.largura_radial_y_padrao;
+
+    GeometriaDegrau g;
+    g.z_topo = Z_BASE_INICIAL + (altura_max - Z_BASE_INICIAL) * ((float)(k + 1) / num_degraus);
+    g.z_base = Z_BASE_INICIAL + (altura_max - Z_BASE_INICIAL) * ((float)k / num_degraus);
+    float fracao_raio_int = (float)k / num_degraus;
+    float fracao_raio_ext = (float)(k + 1) / num_degraus;
+    g.rx_int = estadio.raio_x_geral_int + largura_x * fracao_raio_int;
+    g.ry_int = estadio.raio_y_geral_int + largura_y * fracao_raio_int;
+    g.rx_ext = estadio.raio_x_geral_int + largura_x * fracao_raio_ext;
+    g.ry_ext = estadio.raio_y_geral_int + largura_y * fracao_raio_ext;
+    return g;
+}
 
 bool leftMousePressed = false;
 int lastMouseX = 0;
@@ -48,334 +222,7518 @@ float camera_position[3] = {0.0f, 5.0f, 20.0f}; // Posição inicial
 float camera_target[3] = {0.0f, 0.0f, 0.0f};    // Ponto onde a câmera olha
 float zoomSpeed = 0.5f;
 
-// Parâmetro de controle da curva (de 0.0 a 1.0)
-float t = 0.0f;
-
-// Pontos de controle da curva de Bézier
-float p0[3] = {0.0f, 5.0f, 10.0f};
-float p1[3] = {5.0f, 8.0f, 5.0f};
-float p2[3] = {10.0f, 2.0f, 5.0f};
-float p3[3] = {15.0f, 5.0f, 10.0f};
-
 bool mouseEsquerdoPressionado = false;
 int ultimoXMouse = 0;
+int xCliqueMouse = 0, yCliqueMouse = 0;     // Onde o botão esquerdo foi pressionado
+const int TOLERANCIA_CLIQUE_PIXELS = 3;     // Acima disso, o gesto é arrasto
 
 int modoNoite = 0;            // 0 = dia, 1 = noite
 float alphaFiltro = 0.0f;     // 0.0 = dia, 1.0 = noite
-float passoTransicao = 1.0f / 300.0f; // Transição de 30 segundos
+float velocidadeTransicao = 1.0f / 30.0f; // Alpha por segundo (transição de 30 segundos)
+const float DURACAO_MODO_DIA_NOITE_S = 60.0f; // Tempo em cada modo antes de alternar
+
+// Tempo monotônico em milissegundos (resolução de sub-microssegundo)
+double tempoAtualMs() {
+    static const std::chrono::steady_clock::time_point origem = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> decorrido = std::chrono::steady_clock::now() - origem;
+    return decorrido.count();
+}
+
+// --- Rastreamento de Linha do Tempo (Chrome Trace / Perfetto) ---
+// Escopos marcados com RASTREAR_ESCOPO registram início/fim num buffer circular
+// próprio de cada thread (só a dona escreve, sem travas). Com --trace <arquivo>,
+// os eventos são gravados no formato JSON do Chrome ao sair do programa, para
+// abrir em chrome://tracing ou ui.perfetto.dev.
+struct EventoRastreio {
+    const char *nome;       // Deve ser uma string estática (literal)
+    double inicioMs;
+    double fimMs;
+};
+
+const int CAPACIDADE_RASTREIO = 1 << 16; // Eventos por thread; os mais antigos são sobrescritos
+
+struct BufferRastreio {
+    EventoRastreio eventos[CAPACIDADE_RASTREIO];
+    std::atomic<unsigned int> totalEscrito;  // Escrito apenas pela thread dona
+    int idThread;
+    const char *nomeThread;
+    BufferRastreio *proximo;
+};
 
-void atualizarTransicao(int valor) {
-    if (modoNoite && alphaFiltro < 1.5f) {
-        alphaFiltro += passoTransicao;
-        if (alphaFiltro > 1.5f) alphaFiltro = 1.5f;
-    } else if (!modoNoite && alphaFiltro > 0.0f) {
-        alphaFiltro -= passoTransicao;
-        if (alphaFiltro < 0.0f) alphaFiltro = 0.0f;
+std::atomic<BufferRastreio*> listaBuffersRastreio(NULL); // Lista encadeada, inserção por CAS
+std::atomic<int> proximoIdThreadRastreio(1);
+std::atomic<bool> rastreioAtivo(false);
+const char *arquivoRastreio = NULL;
+
+BufferRastreio *bufferRastreioDaThread() {
+    static thread_local BufferRastreio *buffer = NULL;
+    if (!buffer) {
+        buffer = new BufferRastreio();
+        buffer->totalEscrito.store(0);
+        buffer->idThread = proximoIdThreadRastreio.fetch_add(1);
+        buffer->nomeThread = "trabalhador"; // A thread principal se nomeia em main()
+        buffer->proximo = listaBuffersRastreio.load();
+        while (!listaBuffersRastreio.compare_exchange_weak(buffer->proximo, buffer)) {
+            // 'proximo' foi atualizado com a cabeça atual; tenta de novo
+        }
     }
+    return buffer;
+}
+
+// Dá um nome à thread atual na linha do tempo (string estática)
+void nomearThreadRastreio(const char *nome) {
+    if (!rastreioAtivo) return;
+    bufferRastreioDaThread()->nomeThread = nome;
+}
 
-    glutPostRedisplay();  // Atualiza a tela
-    glutTimerFunc(100, atualizarTransicao, 0);  // Chama a função novamente após 100ms
+void registrarEventoRastreio(const char *nome, double inicioMs, double fimMs) {
+    if (!rastreioAtivo) return;
+    BufferRastreio *buffer = bufferRastreioDaThread();
+    unsigned int indice = buffer->totalEscrito.load(std::memory_order_relaxed);
+    EventoRastreio &evento = buffer->eventos[indice % CAPACIDADE_RASTREIO];
+    evento.nome = nome;
+    evento.inicioMs = inicioMs;
+    evento.fimMs = fimMs;
+    buffer->totalEscrito.store(indice + 1, std::memory_order_release);
 }
 
+struct EscopoRastreio {
+    const char *nome;
+    double inicioMs;
+    EscopoRastreio(const char *nomeEscopo) : nome(nomeEscopo), inicioMs(rastreioAtivo ? tempoAtualMs() : 0.0) {}
+    ~EscopoRastreio() {
+        if (rastreioAtivo) registrarEventoRastreio(nome, inicioMs, tempoAtualMs());
+    }
+};
 
-//  Função para capturar o clique do mouse
-void mouse(int botao, int estado, int x, int y) {
-    if (botao == GLUT_LEFT_BUTTON) {
-        if (estado == GLUT_DOWN) {
-            mouseEsquerdoPressionado = true;
-            ultimoXMouse = x;
-        } else if (estado == GLUT_UP) {
-            mouseEsquerdoPressionado = false;
+#define RASTREIO_CONCATENAR_(a, b) a##b
+#define RASTREIO_CONCATENAR(a, b) RASTREIO_CONCATENAR_(a, b)
+#define RASTREAR_ESCOPO(nome) EscopoRastreio RASTREIO_CONCATENAR(escopoRastreio_, __LINE__)(nome)
+#define RASTREAR_FUNCAO() RASTREAR_ESCOPO(__func__)
+
+// Registrada com atexit(): grava todos os buffers como Chrome Trace JSON
+void gravarRastreioChrome() {
+    if (!rastreioAtivo || !arquivoRastreio) return;
+    rastreioAtivo = false; // Congela os buffers durante a gravação
+
+    FILE *arquivo = fopen(arquivoRastreio, "w");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao criar '%s'\n", arquivoRastreio);
+        return;
+    }
+    fprintf(arquivo, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(arquivo, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"almeidao\"}}");
+    int totalEventos = 0;
+    for (BufferRastreio *buffer = listaBuffersRastreio.load(); buffer; buffer = buffer->proximo) {
+        fprintf(arquivo, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                buffer->idThread, buffer->nomeThread);
+        unsigned int total = buffer->totalEscrito.load(std::memory_order_acquire);
+        unsigned int inicio = (total > (unsigned int)CAPACIDADE_RASTREIO) ? total - CAPACIDADE_RASTREIO : 0;
+        for (unsigned int i = inicio; i < total; i++) {
+            const EventoRastreio &evento = buffer->eventos[i % CAPACIDADE_RASTREIO];
+            fprintf(arquivo, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    evento.nome, buffer->idThread, evento.inicioMs * 1000.0, (evento.fimMs - evento.inicioMs) * 1000.0);
+            totalEventos++;
         }
     }
+    fprintf(arquivo, "\n]}\n");
+    fclose(arquivo);
+    printf("Rastreamento gravado em '%s' (%d eventos)\n", arquivoRastreio, totalEventos);
 }
 
+// --- Sistema de Tarefas (roubo de trabalho) ---
+// Cada thread trabalhadora tem sua própria fila de tarefas. A dona empilha e
+// retira pelo fim (LIFO, dados ainda no cache); as outras, quando ficam sem
+// trabalho, roubam pelo início (os trechos maiores e mais antigos). Threads
+// que não são trabalhadoras (GLUT, renderização) usam uma fila compartilhada
+// extra. Quem chama executarEmParalelo() também executa tarefas enquanto
+// espera, então chamadas aninhadas não travam.
+struct Tarefa {
+    void (*executar)(const void *contexto, int inicio, int fim);
+    const void *contexto;
+    int inicio, fim;
+    std::atomic<int> *pendentes;
+};
 
-// Mouse - Pressionar ou soltar botão
-void motion(int x, int y) {
-    if (mouseEsquerdoPressionado) {
-        int deltaX = x - ultimoXMouse;
-        cameraAngle += deltaX * 0.5f; // Sensibilidade da rotação
-        if (cameraAngle > 360.0f) cameraAngle -= 360.0f;
-        if (cameraAngle < 0.0f) cameraAngle += 360.0f;
-        ultimoXMouse = x;
-        glutPostRedisplay(); // Pede novo desenho da cena
+struct FilaTarefas {
+    std::mutex trava;
+    std::deque<Tarefa> tarefas;
+};
+
+int numTrabalhadores = 0;                   // Threads auxiliares (a thread chamadora também trabalha)
+FilaTarefas *filasTarefas = NULL;           // [0, numTrabalhadores): trabalhadores; [numTrabalhadores]: compartilhada
+std::vector<std::thread> threadsTrabalhadoras;
+std::atomic<bool> encerrarTrabalhadores(false);
+std::atomic<int> tarefasNaoIniciadas(0);
+std::mutex travaSonoTrabalhadores;
+std::condition_variable sinalTrabalhadores;
+thread_local int indiceFilaDaThread = -1;   // -1: thread externa (usa a fila compartilhada)
+
+bool retirarTarefa(int indiceFila, Tarefa &tarefa, bool doFim) {
+    FilaTarefas &fila = filasTarefas[indiceFila];
+    std::lock_guard<std::mutex> guarda(fila.trava);
+    if (fila.tarefas.empty()) return false;
+    if (doFim) {
+        tarefa = fila.tarefas.back();
+        fila.tarefas.pop_back();
+    } else {
+        tarefa = fila.tarefas.front();
+        fila.tarefas.pop_front();
     }
+    tarefasNaoIniciadas.fetch_sub(1);
+    return true;
 }
 
+// Própria fila primeiro, depois a compartilhada, depois roubo das demais
+bool obterTarefa(Tarefa &tarefa) {
+    int propria = indiceFilaDaThread >= 0 ? indiceFilaDaThread : numTrabalhadores;
+    if (retirarTarefa(propria, tarefa, true)) return true;
+    if (propria != numTrabalhadores && retirarTarefa(numTrabalhadores, tarefa, false)) return true;
+    for (int k = 1; k <= numTrabalhadores; k++) {
+        int vitima = (propria + k) % (numTrabalhadores + 1);
+        if (vitima != numTrabalhadores && retirarTarefa(vitima, tarefa, false)) return true;
+    }
+    return false;
+}
 
-// Função para calcular o ponto na curva de Bézier
-void bezier_curve(float t, float *p0, float *p1, float *p2, float *p3, float *point) {
-    float u = 1 - t;
-    float tt = t * t;
-    float uu = u * u;
-    float ttt = tt * t;
-    float uuu = uu * u;
-
-    point[0] = uuu * p0[0] + 3 * uu * t * p1[0] + 3 * u * tt * p2[0] + ttt * p3[0];
-    point[1] = uuu * p0[1] + 3 * uu * t * p1[1] + 3 * u * tt * p2[1] + ttt * p3[1];
-    point[2] = uuu * p0[2] + 3 * uu * t * p1[2] + 3 * u * tt * p2[2] + ttt * p3[2];
+void executarTarefa(const Tarefa &tarefa) {
+    tarefa.executar(tarefa.contexto, tarefa.inicio, tarefa.fim);
+    tarefa.pendentes->fetch_sub(1, std::memory_order_release);
 }
 
-// Atualiza a posição da câmera na curva
-void update_camera(float t, float *camera_position, float *p0, float *p1, float *p2, float *p3) {
-    float point[3];
-    bezier_curve(t, p0, p1, p2, p3, point);
+void lacoTrabalhador(int indice) {
+    indiceFilaDaThread = indice;
+    nomearThreadRastreio("trabalhador");
+    while (!encerrarTrabalhadores.load()) {
+        Tarefa tarefa;
+        if (obterTarefa(tarefa)) {
+            executarTarefa(tarefa);
+            continue;
+        }
+        std::unique_lock<std::mutex> trava(travaSonoTrabalhadores);
+        sinalTrabalhadores.wait_for(trava, std::chrono::milliseconds(2), [] {
+            return tarefasNaoIniciadas.load() > 0 || encerrarTrabalhadores.load();
+        });
+    }
+}
 
-    camera_position[0] = point[0];
-    camera_position[1] = point[1];
-    camera_position[2] = point[2];
+// Registrada com atexit()
+void encerrarSistemaTarefas() {
+    encerrarTrabalhadores.store(true);
+    sinalTrabalhadores.notify_all();
+    for (size_t i = 0; i < threadsTrabalhadoras.size(); i++) threadsTrabalhadoras[i].join();
+    threadsTrabalhadoras.clear();
 }
 
-// --- Funções Utilitárias ---
-GLuint carregarTextura(const char *nomeArquivo) {
-    GLuint idTextura;
-    int largura, altura, numCanais;
+// 'numThreads' <= 0 usa todos os núcleos. Pode ser chamada de novo (fora de
+// qualquer tarefa) para trocar o número de threads, como nos benchmarks.
+void iniciarSistemaTarefas(int numThreads) {
+    static bool encerramentoRegistrado = false;
+    if (numThreads <= 0) numThreads = (int)std::thread::hardware_concurrency();
+    if (numThreads < 1) numThreads = 1;
+    if (filasTarefas) {
+        encerrarSistemaTarefas();
+        delete[] filasTarefas;
+        encerrarTrabalhadores.store(false);
+    }
+    numTrabalhadores = numThreads - 1;
+    filasTarefas = new FilaTarefas[numTrabalhadores + 1];
+    for (int i = 0; i < numTrabalhadores; i++) {
+        threadsTrabalhadoras.push_back(std::thread(lacoTrabalhador, i));
+    }
+    if (!encerramentoRegistrado) {
+        atexit(encerrarSistemaTarefas);
+        encerramentoRegistrado = true;
+    }
+}
 
-    // Configura stb_image para inverter a imagem verticalmente no carregamento
-    // (necessário pois OpenGL espera origem no canto inferior esquerdo)
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *dados = stbi_load(nomeArquivo, &largura, &altura, &numCanais, 0);
+template <typename Corpo>
+void executarTrechoTarefa(const void *contexto, int inicio, int fim) {
+    (*(const Corpo *)contexto)(inicio, fim);
+}
 
-    if (dados) {
-        GLenum formato = GL_RGB; // Formato padrão (3 canais)
-        if (numCanais == 1) {
-            formato = GL_RED; // Formato para imagens em escala de cinza (1 canal)
-        } else if (numCanais == 4) {
-            formato = GL_RGBA; // Formato para imagens com canal alfa (4 canais)
+// Divide [inicio, fim) em trechos de até 'grao' itens e chama corpo(inicioTrecho, fimTrecho)
+// em paralelo; retorna quando todos terminarem
+template <typename Corpo>
+void executarTrechosEmParalelo(int inicio, int fim, int grao, const Corpo &corpo) {
+    int total = fim - inicio;
+    if (total <= 0) return;
+    if (grao < 1) grao = 1;
+    if (numTrabalhadores == 0 || total <= grao) {
+        corpo(inicio, fim);
+        return;
+    }
+    int numTrechos = (total + grao - 1) / grao;
+    std::atomic<int> pendentes(numTrechos);
+    int indiceFila = indiceFilaDaThread >= 0 ? indiceFilaDaThread : numTrabalhadores;
+    {
+        FilaTarefas &fila = filasTarefas[indiceFila];
+        std::lock_guard<std::mutex> guarda(fila.trava);
+        for (int t = 0; t < numTrechos; t++) {
+            Tarefa tarefa;
+            tarefa.executar = executarTrechoTarefa<Corpo>;
+            tarefa.contexto = &corpo;
+            tarefa.inicio = inicio + t * grao;
+            tarefa.fim = (tarefa.inicio + grao < fim) ? tarefa.inicio + grao : fim;
+            tarefa.pendentes = &pendentes;
+            fila.tarefas.push_back(tarefa);
         }
+        tarefasNaoIniciadas.fetch_add(numTrechos);
+    }
+    sinalTrabalhadores.notify_all();
 
-        glGenTextures(1, &idTextura);               // Gera um ID de textura
-        glBindTexture(GL_TEXTURE_2D, idTextura);    // Vincula a textura para configuração
+    while (pendentes.load(std::memory_order_acquire) > 0) {
+        Tarefa tarefa;
+        if (obterTarefa(tarefa)) executarTarefa(tarefa);
+        else std::this_thread::yield();
+    }
+}
 
-        // Envia os dados da imagem para a GPU
-        glTexImage2D(GL_TEXTURE_2D, 0, formato, largura, altura, 0, formato, GL_UNSIGNED_BYTE, dados);
+// Versão por item: corpo(i) para cada i em [inicio, fim)
+template <typename Corpo>
+void executarEmParalelo(int inicio, int fim, int grao, const Corpo &corpo) {
+    executarTrechosEmParalelo(inicio, fim, grao, [&corpo](int a, int b) {
+        for (int i = a; i < b; i++) corpo(i);
+    });
+}
 
-        // Define parâmetros de repetição e filtragem da textura
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // Repete a textura na coordenada S (horizontal)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // Repete a textura na coordenada T (vertical)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Filtragem linear para minificação (quando objeto está longe)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Filtragem linear para magnificação (quando objeto está perto)
+// --- Perfilamento dos Passos de Renderização (GPU + CPU) ---
+// Cada passo do display() é medido por uma consulta GL_TIME_ELAPSED e por um
+// temporizador de CPU. As consultas usam dois conjuntos alternados: o quadro N
+// só lê os resultados do quadro N-2, que a GPU já terminou, evitando travar.
+enum PassoRender {
+    PASSO_CHAO = 0,
+    PASSO_GRAMA,
+    PASSO_ARQUIBANCADA,
+    PASSO_PAREDES,
+    PASSO_MARQUISE,
+    PASSO_TAMPAS,
+    PASSO_SOMBRAS,
+    PASSO_ANALISE,
+    PASSO_ASSENTOS,
+    PASSO_TORCIDA,
+    PASSO_SELECAO,
+    PASSO_FILTRO_NOITE,
+    PASSO_CEU,
+    NUM_PASSOS_RENDER
+};
 
-        // Libera a memória da imagem carregada na CPU, pois já está na GPU
-        stbi_image_free(dados);
+const char *NOMES_PASSOS[NUM_PASSOS_RENDER] = {
+    "chao", "grama", "arquibancada", "paredes", "marquise", "tampas", "sombras", "analise", "assentos", "torcida", "selecao", "filtro_noite", "ceu"
+};
 
-        // Desvincula a textura (boa prática)
-        glBindTexture(GL_TEXTURE_2D, 0);
+const int NUM_CONJUNTOS_CONSULTA = 2;   // Conjuntos de consultas alternados (double buffering)
+const int HISTORICO_PERFIL = 600;       // Quadros guardados para exportação em CSV
+const double SUAVIZACAO_PERFIL = 0.1;   // Peso da média móvel exibida no painel
 
-        printf("Textura '%s' carregada (Largura: %d, Altura: %d, Canais: %d, ID: %u)\n",
-               nomeArquivo, largura, altura, numCanais, idTextura);
-        return idTextura;
+// Funções de consulta de tempo (GL 3.3 / ARB_timer_query), carregadas em tempo de execução
+PFNGLGENQUERIESPROC pglGenQueries = NULL;
+PFNGLBEGINQUERYPROC pglBeginQuery = NULL;
+PFNGLENDQUERYPROC pglEndQuery = NULL;
+PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v = NULL;
+bool temporizadorGpuDisponivel = false;
+
+GLuint consultasGpu[NUM_CONJUNTOS_CONSULTA][NUM_PASSOS_RENDER];
+bool consultaEmUso[NUM_CONJUNTOS_CONSULTA][NUM_PASSOS_RENDER];
+int conjuntoConsultaAtual = 0;
+
+double inicioCpuPasso[NUM_PASSOS_RENDER];
+double tempoCpuPassoMs[NUM_PASSOS_RENDER];   // Medição do quadro atual
+double tempoGpuPassoMs[NUM_PASSOS_RENDER];   // Último resultado de GPU disponível
+double mediaCpuPassoMs[NUM_PASSOS_RENDER];
+double mediaGpuPassoMs[NUM_PASSOS_RENDER];
+double inicioCpuQuadro = 0.0;
+double mediaCpuQuadroMs = 0.0;
+double ultimoTempoCpuQuadroMs = 0.0;
+
+// Histórico circular (um registro por quadro) para o CSV
+double historicoInstanteMs[HISTORICO_PERFIL];
+double historicoCpuMs[HISTORICO_PERFIL][NUM_PASSOS_RENDER];
+double historicoGpuMs[HISTORICO_PERFIL][NUM_PASSOS_RENDER];
+int indiceHistoricoPerfil = 0;
+int totalHistoricoPerfil = 0;
+
+bool painelPerfilVisivel = false;       // Alternado pela tecla 'p'
+
+void inicializarPerfil() {
+    pglGenQueries = (PFNGLGENQUERIESPROC)glutGetProcAddress("glGenQueries");
+    pglBeginQuery = (PFNGLBEGINQUERYPROC)glutGetProcAddress("glBeginQuery");
+    pglEndQuery = (PFNGLENDQUERYPROC)glutGetProcAddress("glEndQuery");
+    pglGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)glutGetProcAddress("glGetQueryObjectiv");
+    pglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)glutGetProcAddress("glGetQueryObjectui64v");
+
+    // O GLX devolve ponteiros para qualquer nome, então os ponteiros sozinhos
+    // não provam nada: GL_TIME_ELAPSED é do núcleo 3.3 ou do GL_ARB_timer_query
+    const char *versao = (const char *)glGetString(GL_VERSION);
+    const char *extensoes = (const char *)glGetString(GL_EXTENSIONS);
+    int maior = 0, menor = 0;
+    if (versao) sscanf(versao, "%d.%d", &maior, &menor);
+    bool temporizadorSuportado = maior > 3 || (maior == 3 && menor >= 3)
+                              || (extensoes && strstr(extensoes, "GL_ARB_timer_query"));
+    temporizadorGpuDisponivel = temporizadorSuportado && pglGenQueries && pglBeginQuery && pglEndQuery
+                             && pglGetQueryObjectiv && pglGetQueryObjectui64v;
+    if (temporizadorGpuDisponivel) {
+        for (int c = 0; c < NUM_CONJUNTOS_CONSULTA; c++) {
+            pglGenQueries(NUM_PASSOS_RENDER, consultasGpu[c]);
+            for (int p = 0; p < NUM_PASSOS_RENDER; p++) consultaEmUso[c][p] = false;
+        }
     } else {
-        // Exibe erro se o carregamento falhar
-        fprintf(stderr, "Erro ao carregar textura '%s': %s\n", nomeArquivo, stbi_failure_reason());
-        return 0; // Retorna 0 para indicar falha
+        fprintf(stderr, "Aviso: GL_TIME_ELAPSED indisponível, perfil apenas com tempos de CPU.\n");
+    }
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        tempoCpuPassoMs[p] = tempoGpuPassoMs[p] = 0.0;
+        mediaCpuPassoMs[p] = mediaGpuPassoMs[p] = 0.0;
     }
 }
 
-void desenharDegrauArquibancada(float cx, float cy,
-                                float rx_int, float ry_int, float rx_ext, float ry_ext,
-                                float z_base, float z_topo,
-                                float angulo_inicial_graus, float angulo_final_graus,
-                                int num_segmentos_curva) {
-    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
-    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
-    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
-    float intervalo_rad = rad_final - rad_inicial;
+// Chamada no início do display(): recolhe os resultados do conjunto que será reutilizado
+void iniciarQuadroPerfil() {
+    inicioCpuQuadro = tempoAtualMs();
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) tempoCpuPassoMs[p] = 0.0;
 
-    // --- Face Superior (Topo) ---
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad);
-        float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao * 5.0f; // Repetição de textura ao longo do arco
-        glTexCoord2f(s_coord, 1.0f); // Coord T = 1 (borda externa da textura?)
-        glVertex3f(cx + rx_ext * cos_a, cy + ry_ext * sin_a, z_topo);
-        glTexCoord2f(s_coord, 0.0f); // Coord T = 0 (borda interna da textura?)
-        glVertex3f(cx + rx_int * cos_a, cy + ry_int * sin_a, z_topo);
+    if (!temporizadorGpuDisponivel) return;
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        if (!consultaEmUso[conjuntoConsultaAtual][p]) continue;
+        GLuint consulta = consultasGpu[conjuntoConsultaAtual][p];
+        GLint disponivel = 0;
+        pglGetQueryObjectiv(consulta, GL_QUERY_RESULT_AVAILABLE, &disponivel);
+        if (disponivel) { // Se ainda não estiver pronto, descarta em vez de esperar
+            GLuint64 nanossegundos = 0;
+            pglGetQueryObjectui64v(consulta, GL_QUERY_RESULT, &nanossegundos);
+            tempoGpuPassoMs[p] = nanossegundos / 1.0e6;
+            mediaGpuPassoMs[p] += (tempoGpuPassoMs[p] - mediaGpuPassoMs[p]) * SUAVIZACAO_PERFIL;
+        }
+        consultaEmUso[conjuntoConsultaAtual][p] = false;
+    }
+}
+
+void iniciarPasso(PassoRender passo) {
+    if (temporizadorGpuDisponivel) {
+        pglBeginQuery(GL_TIME_ELAPSED, consultasGpu[conjuntoConsultaAtual][passo]);
+    }
+    inicioCpuPasso[passo] = tempoAtualMs();
+}
+
+void finalizarPasso(PassoRender passo) {
+    double fimMs = tempoAtualMs();
+    tempoCpuPassoMs[passo] += fimMs - inicioCpuPasso[passo];
+    registrarEventoRastreio(NOMES_PASSOS[passo], inicioCpuPasso[passo], fimMs);
+    if (temporizadorGpuDisponivel) {
+        pglEndQuery(GL_TIME_ELAPSED);
+        consultaEmUso[conjuntoConsultaAtual][passo] = true;
+    }
+}
+
+// Chamada no fim do display(): atualiza médias, histórico e alterna o conjunto de consultas
+void finalizarQuadroPerfil() {
+    double tempoQuadroMs = tempoAtualMs() - inicioCpuQuadro;
+    ultimoTempoCpuQuadroMs = tempoQuadroMs;
+    mediaCpuQuadroMs += (tempoQuadroMs - mediaCpuQuadroMs) * SUAVIZACAO_PERFIL;
+
+    historicoInstanteMs[indiceHistoricoPerfil] = inicioCpuQuadro;
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        mediaCpuPassoMs[p] += (tempoCpuPassoMs[p] - mediaCpuPassoMs[p]) * SUAVIZACAO_PERFIL;
+        historicoCpuMs[indiceHistoricoPerfil][p] = tempoCpuPassoMs[p];
+        historicoGpuMs[indiceHistoricoPerfil][p] = tempoGpuPassoMs[p];
+    }
+    indiceHistoricoPerfil = (indiceHistoricoPerfil + 1) % HISTORICO_PERFIL;
+    if (totalHistoricoPerfil < HISTORICO_PERFIL) totalHistoricoPerfil++;
+
+    conjuntoConsultaAtual = (conjuntoConsultaAtual + 1) % NUM_CONJUNTOS_CONSULTA;
+}
+
+// Grava o histórico de tempos por passo (mais antigo primeiro)
+void exportarPerfilCsv(const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "w");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao criar '%s'\n", nomeArquivo);
+        return;
+    }
+    fprintf(arquivo, "instante_ms");
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) fprintf(arquivo, ",cpu_%s_ms", NOMES_PASSOS[p]);
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) fprintf(arquivo, ",gpu_%s_ms", NOMES_PASSOS[p]);
+    fprintf(arquivo, "\n");
+
+    int inicio = (indiceHistoricoPerfil - totalHistoricoPerfil + HISTORICO_PERFIL) % HISTORICO_PERFIL;
+    for (int n = 0; n < totalHistoricoPerfil; n++) {
+        int i = (inicio + n) % HISTORICO_PERFIL;
+        fprintf(arquivo, "%.3f", historicoInstanteMs[i]);
+        for (int p = 0; p < NUM_PASSOS_RENDER; p++) fprintf(arquivo, ",%.4f", historicoCpuMs[i][p]);
+        for (int p = 0; p < NUM_PASSOS_RENDER; p++) fprintf(arquivo, ",%.4f", historicoGpuMs[i][p]);
+        fprintf(arquivo, "\n");
     }
+    fclose(arquivo);
+    printf("Perfil exportado para '%s' (%d quadros)\n", nomeArquivo, totalHistoricoPerfil);
+}
+
+// Escreve texto em coordenadas de pixel (requer projeção ortográfica em pixels ativa)
+void desenharTexto(float x, float y, const char *texto) {
+    glRasterPos2f(x, y);
+    for (const char *c = texto; *c; c++) {
+        glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+}
+
+// Painel sobreposto com os tempos médios de cada passo
+void desenharPainelPerfil(int largura, int altura) {
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, largura, 0, altura);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    const float margem = 10.0f;
+    const float alturaLinha = 15.0f;
+    float larguraPainel = 330.0f;
+    float alturaPainel = alturaLinha * (NUM_PASSOS_RENDER + 3) + margem;
+
+    // Fundo semi-transparente
+    glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+    glBegin(GL_QUADS);
+        glVertex2f(0.0f, altura - alturaPainel);
+        glVertex2f(larguraPainel, altura - alturaPainel);
+        glVertex2f(larguraPainel, altura);
+        glVertex2f(0.0f, altura);
     glEnd();
 
-    // --- Face Frontal (Vertical) ---
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad);
-        float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao * 5.0f; // Repetição de textura ao longo do arco
-        glTexCoord2f(s_coord, 1.0f); // Coord T = 1 (topo da face vertical)
-        glVertex3f(cx + rx_int * cos_a, cy + ry_int * sin_a, z_topo);
-        glTexCoord2f(s_coord, 0.0f); // Coord T = 0 (base da face vertical)
-        glVertex3f(cx + rx_int * cos_a, cy + ry_int * sin_a, z_base);
+    char linha[128];
+    float y = altura - margem - alturaLinha * 0.5f;
+    glColor3f(1.0f, 1.0f, 0.3f);
+    snprintf(linha, sizeof(linha), "Passo            CPU(ms)   GPU(ms)");
+    desenharTexto(margem, y, linha);
+    y -= alturaLinha;
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    double totalGpu = 0.0;
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        if (temporizadorGpuDisponivel) {
+            snprintf(linha, sizeof(linha), "%-16s %7.3f   %7.3f", NOMES_PASSOS[p], mediaCpuPassoMs[p], mediaGpuPassoMs[p]);
+        } else {
+            snprintf(linha, sizeof(linha), "%-16s %7.3f       n/d", NOMES_PASSOS[p], mediaCpuPassoMs[p]);
+        }
+        desenharTexto(margem, y, linha);
+        totalGpu += mediaGpuPassoMs[p];
+        y -= alturaLinha;
+    }
+
+    glColor3f(0.6f, 1.0f, 0.6f);
+    snprintf(linha, sizeof(linha), "%-16s %7.3f   %7.3f", "quadro (CPU)", mediaCpuQuadroMs, totalGpu);
+    desenharTexto(margem, y, linha);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// --- Estatísticas de Renderização ---
+// Contadores atualizados pelas funções de envio abaixo, que substituem as
+// chamadas diretas de glBegin/glVertex/glBindTexture no desenho da cena.
+// São zerados a cada quadro; o último quadro completo fica disponível em
+// obterEstatisticasRender() e é impresso no console pela tecla 'e'.
+struct EstatisticasRender {
+    unsigned long chamadasDesenho;      // Pares glBegin/glEnd (ou glDraw*)
+    unsigned long primitivas;           // Triângulos/quads/linhas resultantes
+    unsigned long vertices;             // Vértices enviados
+    unsigned long bindsTextura;         // glBindTexture
+    unsigned long bindsRedundantes;     // ... com a mesma textura já vinculada
+    unsigned long mudancasEstado;       // Ativações/desativações de blend, profundidade e textura
+    unsigned long objetosDescartados;   // Objetos rejeitados por culling
+    unsigned long bytesEnviados;        // Dados de vértices e texturas enviados ao driver
+    unsigned long cascatasSombra;       // Mapas de sombra redesenhados (os demais foram reaproveitados)
+    unsigned long tabelasCeu;           // Tabelas da vista do céu recalculadas
+};
+
+EstatisticasRender estatisticasQuadro;          // Quadro em andamento
+EstatisticasRender estatisticasUltimoQuadro;    // Último quadro completo
+GLenum modoPrimitivaAtual = GL_POINTS;
+unsigned long verticesPrimitivaAtual = 0;
+GLuint texturaVinculadaAtual = 0;
+
+const EstatisticasRender &obterEstatisticasRender() {
+    return estatisticasUltimoQuadro;
+}
+
+void finalizarQuadroEstatisticas() {
+    estatisticasUltimoQuadro = estatisticasQuadro;
+    memset(&estatisticasQuadro, 0, sizeof(estatisticasQuadro));
+}
+
+void imprimirEstatisticasRender() {
+    const EstatisticasRender &e = obterEstatisticasRender();
+    printf("--- Estatísticas do último quadro ---\n");
+    printf("  Chamadas de desenho: %lu\n", e.chamadasDesenho);
+    printf("  Primitivas:          %lu\n", e.primitivas);
+    printf("  Vértices:            %lu\n", e.vertices);
+    printf("  Binds de textura:    %lu (%lu redundantes)\n", e.bindsTextura, e.bindsRedundantes);
+    printf("  Mudanças de estado:  %lu\n", e.mudancasEstado);
+    printf("  Objetos descartados: %lu\n", e.objetosDescartados);
+    printf("  Bytes enviados:      %lu\n", e.bytesEnviados);
+    printf("  Cascatas de sombra:  %lu redesenhadas\n", e.cascatasSombra);
+    printf("  Tabelas do céu:      %lu recalculadas\n", e.tabelasCeu);
+}
+
+// Número de primitivas formadas por 'n' vértices no modo dado
+unsigned long contarPrimitivas(GLenum modo, unsigned long n) {
+    switch (modo) {
+        case GL_POINTS:         return n;
+        case GL_LINES:          return n / 2;
+        case GL_LINE_STRIP:     return n > 1 ? n - 1 : 0;
+        case GL_LINE_LOOP:      return n > 1 ? n : 0;
+        case GL_TRIANGLES:      return n / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:        return n > 2 ? n - 2 : 0;
+        case GL_QUADS:          return n / 4;
+        case GL_QUAD_STRIP:     return n > 2 ? (n - 2) / 2 : 0;
+        default:                return 0;
     }
+}
+
+void iniciarPrimitiva(GLenum modo) {
+    modoPrimitivaAtual = modo;
+    verticesPrimitivaAtual = 0;
+    glBegin(modo);
+}
+
+void finalizarPrimitiva() {
     glEnd();
+    estatisticasQuadro.chamadasDesenho++;
+    estatisticasQuadro.vertices += verticesPrimitivaAtual;
+    estatisticasQuadro.primitivas += contarPrimitivas(modoPrimitivaAtual, verticesPrimitivaAtual);
+}
+
+// Desenho a partir de arrays de vértices já habilitados
+void desenharArrays(GLenum modo, GLint primeiro, GLsizei quantidade) {
+    glDrawArrays(modo, primeiro, quantidade);
+    estatisticasQuadro.chamadasDesenho++;
+    estatisticasQuadro.vertices += quantidade;
+    estatisticasQuadro.primitivas += contarPrimitivas(modo, quantidade);
+}
+
+void enviarVertice3f(float x, float y, float z) {
+    verticesPrimitivaAtual++;
+    estatisticasQuadro.bytesEnviados += 3 * sizeof(float);
+    glVertex3f(x, y, z);
+}
+
+void enviarVertice3fv(const float *v) {
+    verticesPrimitivaAtual++;
+    estatisticasQuadro.bytesEnviados += 3 * sizeof(float);
+    glVertex3fv(v);
+}
+
+void enviarVertice2f(float x, float y) {
+    verticesPrimitivaAtual++;
+    estatisticasQuadro.bytesEnviados += 2 * sizeof(float);
+    glVertex2f(x, y);
+}
+
+void enviarCoordTextura2f(float s, float t) {
+    estatisticasQuadro.bytesEnviados += 2 * sizeof(float);
+    glTexCoord2f(s, t);
+}
+
+void vincularTextura(GLuint idTextura) {
+    estatisticasQuadro.bindsTextura++;
+    if (idTextura == texturaVinculadaAtual) estatisticasQuadro.bindsRedundantes++;
+    texturaVinculadaAtual = idTextura;
+    glBindTexture(GL_TEXTURE_2D, idTextura);
+}
+
+void alterarEstadoGL(GLenum capacidade, bool ativo) {
+    estatisticasQuadro.mudancasEstado++;
+    if (ativo) glEnable(capacidade);
+    else glDisable(capacidade);
+}
+
+// --- Coleta de Tempos de Quadro (benchmarks) ---
+// Usada pela reprodução de sessões e pelo voo em trilho: guarda, por quadro,
+// o intervalo desde o quadro anterior, o tempo de CPU do display() e os
+// contadores de renderização, e resume tudo em percentis ao final.
+double inicioQuadroAnteriorMs = -1.0;
+std::vector<double> intervalosColetaMs;     // Tempo entre quadros consecutivos
+std::vector<double> cpuColetaMs;            // Tempo de CPU do display()
+std::vector<EstatisticasRender> estatisticasColeta;
+
+void iniciarColetaQuadros() {
+    inicioQuadroAnteriorMs = -1.0;
+    intervalosColetaMs.clear();
+    cpuColetaMs.clear();
+    estatisticasColeta.clear();
+}
+
+void registrarInicioQuadroColeta() {
+    double agora = tempoAtualMs();
+    if (inicioQuadroAnteriorMs >= 0.0) intervalosColetaMs.push_back(agora - inicioQuadroAnteriorMs);
+    inicioQuadroAnteriorMs = agora;
+}
+
+void registrarFimQuadroColeta() {
+    cpuColetaMs.push_back(ultimoTempoCpuQuadroMs);
+    estatisticasColeta.push_back(obterEstatisticasRender());
+}
+
+double percentil(std::vector<double> valores, double fracao) {
+    if (valores.empty()) return 0.0;
+    std::sort(valores.begin(), valores.end());
+    size_t indice = (size_t)(fracao * (valores.size() - 1) + 0.5);
+    return valores[indice];
+}
+
+void relatarColetaQuadros(const char *titulo, const char *arquivoCsv) {
+    double soma = 0.0;
+    for (size_t i = 0; i < intervalosColetaMs.size(); i++) soma += intervalosColetaMs[i];
+    double media = intervalosColetaMs.empty() ? 0.0 : soma / intervalosColetaMs.size();
+    printf("--- %s: %zu quadros ---\n", titulo, cpuColetaMs.size());
+    printf("  Intervalo entre quadros (ms): média %.3f | p50 %.3f | p95 %.3f | p99 %.3f | máx %.3f\n",
+           media, percentil(intervalosColetaMs, 0.50), percentil(intervalosColetaMs, 0.95),
+           percentil(intervalosColetaMs, 0.99), percentil(intervalosColetaMs, 1.0));
+    printf("  CPU do display() (ms):        p50 %.3f | p95 %.3f | máx %.3f\n",
+           percentil(cpuColetaMs, 0.50), percentil(cpuColetaMs, 0.95), percentil(cpuColetaMs, 1.0));
+
+    FILE *arquivo = fopen(arquivoCsv, "w");
+    if (arquivo) {
+        fprintf(arquivo, "quadro,intervalo_ms,cpu_display_ms,chamadas_desenho,vertices,binds_textura\n");
+        for (size_t i = 0; i < cpuColetaMs.size(); i++) {
+            double intervalo = (i > 0 && i - 1 < intervalosColetaMs.size()) ? intervalosColetaMs[i - 1] : 0.0;
+            fprintf(arquivo, "%zu,%.4f,%.4f,%lu,%lu,%lu\n", i, intervalo, cpuColetaMs[i],
+                    estatisticasColeta[i].chamadasDesenho, estatisticasColeta[i].vertices,
+                    estatisticasColeta[i].bindsTextura);
+        }
+        fclose(arquivo);
+        printf("  Quadros detalhados em '%s'\n", arquivoCsv);
+    }
+}
+
+// --- Gravação e Reprodução de Sessões de Câmera ---
+// A gravação amostra o estado da câmera e do ciclo dia/noite a uma taxa fixa
+// (PERIODO_AMOSTRA_MS), independente da taxa de quadros de quem gravou. A
+// reprodução aplica uma amostra por quadro (passo fixo) e coleta o tempo de
+// cada quadro, para comparar versões do programa sobre a mesma sessão.
+struct AmostraCamera {
+    float posicao[3];
+    float angulo;
+    float alphaFiltro;
+    unsigned char modoNoite;
+};
+
+const char MAGICO_SESSAO[4] = {'A', 'L', 'M', 'C'};
+const unsigned int VERSAO_SESSAO = 1;
+const float PERIODO_AMOSTRA_MS = 1000.0f / 60.0f;
+const char *ARQUIVO_SESSAO_PADRAO = "sessao_camera.bin";
+
+std::vector<AmostraCamera> amostrasSessao;
+bool gravacaoAtiva = false;
+double proximaAmostraMs = 0.0;
+
+bool reproducaoAtiva = false;
+bool sairAoFimDaReproducao = false;     // Modo de benchmark (--replay)
+size_t indiceReproducao = 0;
+
+AmostraCamera capturarAmostraCamera() {
+    AmostraCamera amostra;
+    for (int i = 0; i < 3; i++) amostra.posicao[i] = camera_position[i];
+    amostra.angulo = cameraAngle;
+    amostra.alphaFiltro = alphaFiltro;
+    amostra.modoNoite = (unsigned char)modoNoite;
+    return amostra;
+}
+
+bool salvarSessaoCamera(const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao criar '%s'\n", nomeArquivo);
+        return false;
+    }
+    unsigned int numAmostras = (unsigned int)amostrasSessao.size();
+    fwrite(MAGICO_SESSAO, 1, 4, arquivo);
+    fwrite(&VERSAO_SESSAO, sizeof(VERSAO_SESSAO), 1, arquivo);
+    fwrite(&numAmostras, sizeof(numAmostras), 1, arquivo);
+    fwrite(&PERIODO_AMOSTRA_MS, sizeof(PERIODO_AMOSTRA_MS), 1, arquivo);
+    // Campos gravados um a um (21 bytes por amostra, sem preenchimento da struct)
+    for (size_t i = 0; i < amostrasSessao.size(); i++) {
+        const AmostraCamera &a = amostrasSessao[i];
+        fwrite(a.posicao, sizeof(float), 3, arquivo);
+        fwrite(&a.angulo, sizeof(float), 1, arquivo);
+        fwrite(&a.alphaFiltro, sizeof(float), 1, arquivo);
+        fwrite(&a.modoNoite, 1, 1, arquivo);
+    }
+    fclose(arquivo);
+    printf("Sessão gravada em '%s' (%u amostras, %.1f s)\n",
+           nomeArquivo, numAmostras, numAmostras * PERIODO_AMOSTRA_MS / 1000.0f);
+    return true;
+}
+
+bool carregarSessaoCamera(const char *nomeArquivo) {
+    FILE *arquivo = fopen(nomeArquivo, "rb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao abrir sessão '%s'\n", nomeArquivo);
+        return false;
+    }
+    char magico[4];
+    unsigned int versao = 0, numAmostras = 0;
+    float periodo = 0.0f;
+    bool valido = fread(magico, 1, 4, arquivo) == 4 && memcmp(magico, MAGICO_SESSAO, 4) == 0
+               && fread(&versao, sizeof(versao), 1, arquivo) == 1 && versao == VERSAO_SESSAO
+               && fread(&numAmostras, sizeof(numAmostras), 1, arquivo) == 1
+               && fread(&periodo, sizeof(periodo), 1, arquivo) == 1;
+    if (!valido) {
+        fprintf(stderr, "Sessão '%s' inválida ou de versão incompatível\n", nomeArquivo);
+        fclose(arquivo);
+        return false;
+    }
+    amostrasSessao.clear();
+    amostrasSessao.reserve(numAmostras);
+    for (unsigned int i = 0; i < numAmostras; i++) {
+        AmostraCamera a;
+        if (fread(a.posicao, sizeof(float), 3, arquivo) != 3
+            || fread(&a.angulo, sizeof(float), 1, arquivo) != 1
+            || fread(&a.alphaFiltro, sizeof(float), 1, arquivo) != 1
+            || fread(&a.modoNoite, 1, 1, arquivo) != 1) {
+            fprintf(stderr, "Sessão '%s' truncada na amostra %u\n", nomeArquivo, i);
+            break;
+        }
+        amostrasSessao.push_back(a);
+    }
+    fclose(arquivo);
+    printf("Sessão '%s' carregada (%zu amostras)\n", nomeArquivo, amostrasSessao.size());
+    return !amostrasSessao.empty();
+}
+
+void iniciarGravacaoCamera() {
+    amostrasSessao.clear();
+    proximaAmostraMs = tempoAtualMs();
+    gravacaoAtiva = true;
+    printf("Gravação de câmera iniciada\n");
+}
+
+void pararGravacaoCamera() {
+    gravacaoAtiva = false;
+    salvarSessaoCamera(ARQUIVO_SESSAO_PADRAO);
+}
+
+// Chamada pelo idle(): registra quantas amostras couberem no tempo decorrido
+void amostrarGravacaoCamera() {
+    if (!gravacaoAtiva) return;
+    double agora = tempoAtualMs();
+    if (agora - proximaAmostraMs > 1000.0) proximaAmostraMs = agora; // Não compensa pausas longas
+    while (agora >= proximaAmostraMs) {
+        amostrasSessao.push_back(capturarAmostraCamera());
+        proximaAmostraMs += PERIODO_AMOSTRA_MS;
+    }
+}
+
+void iniciarReproducaoCamera() {
+    if (amostrasSessao.empty()) {
+        fprintf(stderr, "Nenhuma sessão para reproduzir\n");
+        return;
+    }
+    if (gravacaoAtiva) pararGravacaoCamera();
+    indiceReproducao = 0;
+    iniciarColetaQuadros();
+    reproducaoAtiva = true;
+    printf("Reprodução iniciada (%zu quadros)\n", amostrasSessao.size());
+}
+
+void finalizarReproducaoCamera() {
+    reproducaoAtiva = false;
+    relatarColetaQuadros("Reprodução concluída", "reproducao_quadros.csv");
+    if (sairAoFimDaReproducao) exit(0);
+}
+
+// Início do display(): aplica a amostra do quadro atual
+void aplicarAmostraReproducao() {
+    if (!reproducaoAtiva) return;
+    registrarInicioQuadroColeta();
+
+    const AmostraCamera &a = amostrasSessao[indiceReproducao];
+    for (int i = 0; i < 3; i++) camera_position[i] = a.posicao[i];
+    cameraAngle = a.angulo;
+    alphaFiltro = a.alphaFiltro;
+    modoNoite = a.modoNoite;
+}
+
+// Fim do display(): guarda as medições do quadro e avança um passo
+void registrarQuadroReproducao() {
+    if (!reproducaoAtiva) return;
+    registrarFimQuadroColeta();
+    indiceReproducao++;
+    if (indiceReproducao >= amostrasSessao.size()) finalizarReproducaoCamera();
+}
+
+// --- Trilhos de Câmera (Bézier cúbica por partes) ---
+// Um trilho guarda 3n+1 pontos de controle: P0 C C P1 C C P2 ... Cada trecho
+// é uma Bézier cúbica. Na construção, cada trecho é amostrado por diferenças
+// finitas (três somas por ponto) e a tabela resultante de pontos e
+// comprimento acumulado permite percorrer o trilho com velocidade constante,
+// avançando um cursor pela tabela em vez de reavaliar os polinômios.
+const int AMOSTRAS_POR_TRECHO = 64;
+
+struct TrilhoCamera {
+    std::vector<Vetor3> controles;
+    bool fechado;
+    std::vector<Vetor3> pontosTabela;       // Amostras uniformes no parâmetro
+    std::vector<float> distanciasTabela;    // Comprimento de arco acumulado até cada amostra
+    float comprimentoTotal;
+};
+
+struct CursorTrilho {
+    size_t indice;      // Amostra da tabela imediatamente antes da posição
+    float distancia;    // Comprimento de arco percorrido na volta atual
+    int voltas;
+};
+
+// Avaliação direta de uma Bézier cúbica (referência)
+Vetor3 avaliarBezier(Vetor3 b0, Vetor3 b1, Vetor3 b2, Vetor3 b3, float t) {
+    float u = 1.0f - t;
+    return b0 * (u * u * u) + b1 * (3.0f * u * u * t) + b2 * (3.0f * u * t * t) + b3 * (t * t * t);
+}
+
+// Diferenças finitas: avalia a cúbica em 'passos' intervalos uniformes com somas
+struct DiferencasFinitas {
+    Vetor3 ponto, d1, d2, d3;
+};
+
+void iniciarDiferencasFinitas(DiferencasFinitas &df, Vetor3 b0, Vetor3 b1, Vetor3 b2, Vetor3 b3, int passos) {
+    // Forma polinomial: a t^3 + b t^2 + c t + d
+    Vetor3 a = (b3 - b0) + (b1 - b2) * 3.0f;
+    Vetor3 b = (b0 - b1 * 2.0f + b2) * 3.0f;
+    Vetor3 c = (b1 - b0) * 3.0f;
+    float h = 1.0f / passos;
+    float h2 = h * h, h3 = h2 * h;
+    df.ponto = b0;
+    df.d1 = a * h3 + b * h2 + c * h;
+    df.d2 = a * (6.0f * h3) + b * (2.0f * h2);
+    df.d3 = a * (6.0f * h3);
+}
+
+Vetor3 avancarDiferencasFinitas(DiferencasFinitas &df) {
+    df.ponto = df.ponto + df.d1;
+    df.d1 = df.d1 + df.d2;
+    df.d2 = df.d2 + df.d3;
+    return df.ponto;
+}
+
+int numTrechosTrilho(const TrilhoCamera &trilho) {
+    return trilho.controles.size() >= 4 ? (int)(trilho.controles.size() - 1) / 3 : 0;
+}
+
+void construirTabelaTrilho(TrilhoCamera &trilho) {
+    RASTREAR_FUNCAO();
+    int numTrechos = numTrechosTrilho(trilho);
+    trilho.pontosTabela.clear();
+    trilho.distanciasTabela.clear();
+    trilho.comprimentoTotal = 0.0f;
+    if (numTrechos == 0) return;
+
+    trilho.pontosTabela.reserve(numTrechos * AMOSTRAS_POR_TRECHO + 1);
+    trilho.distanciasTabela.reserve(numTrechos * AMOSTRAS_POR_TRECHO + 1);
+    trilho.pontosTabela.push_back(trilho.controles[0]);
+    trilho.distanciasTabela.push_back(0.0f);
+
+    for (int k = 0; k < numTrechos; k++) {
+        const Vetor3 *b = &trilho.controles[3 * k];
+        DiferencasFinitas df;
+        iniciarDiferencasFinitas(df, b[0], b[1], b[2], b[3], AMOSTRAS_POR_TRECHO);
+        for (int i = 1; i <= AMOSTRAS_POR_TRECHO; i++) {
+            // O último ponto é o de controle exato, sem o erro acumulado das somas
+            Vetor3 ponto = (i == AMOSTRAS_POR_TRECHO) ? b[3] : avancarDiferencasFinitas(df);
+            trilho.comprimentoTotal += comprimento(ponto - trilho.pontosTabela.back());
+            trilho.pontosTabela.push_back(ponto);
+            trilho.distanciasTabela.push_back(trilho.comprimentoTotal);
+        }
+    }
+}
+
+// Monta um trilho suave (C1) que passa por todos os pontos dados, convertendo
+// o spline de Catmull-Rom equivalente em trechos de Bézier
+void construirTrilhoPorPontos(TrilhoCamera &trilho, const std::vector<Vetor3> &pontos, bool fechado) {
+    trilho.controles.clear();
+    trilho.fechado = fechado;
+    int n = (int)pontos.size();
+    if (n < 2) {
+        construirTabelaTrilho(trilho);
+        return;
+    }
+    int numTrechos = fechado ? n : n - 1;
+    for (int k = 0; k < numTrechos; k++) {
+        Vetor3 anterior = fechado ? pontos[(k - 1 + n) % n] : pontos[k > 0 ? k - 1 : 0];
+        Vetor3 atual = pontos[k];
+        Vetor3 proximo = pontos[(k + 1) % n];
+        Vetor3 seguinte = fechado ? pontos[(k + 2) % n] : pontos[k + 2 < n ? k + 2 : n - 1];
+        if (k == 0) trilho.controles.push_back(atual);
+        trilho.controles.push_back(atual + (proximo - anterior) * (1.0f / 6.0f));
+        trilho.controles.push_back(proximo - (seguinte - atual) * (1.0f / 6.0f));
+        trilho.controles.push_back(proximo);
+    }
+    construirTabelaTrilho(trilho);
+}
+
+// Volta ao redor do estádio: pontos sobre uma elipse 'fatorRaio' vezes maior
+// que a borda externa das arquibancadas, subindo e descendo entre as alturas dadas
+void gerarTrilhoVoltaEstadio(TrilhoCamera &trilho, int numPontos, float fatorRaio,
+                             float alturaMin, float alturaMax) {
+    std::vector<Vetor3> pontos;
+    float alturaMedia = 0.5f * (alturaMin + alturaMax);
+    float amplitude = 0.5f * (alturaMax - alturaMin);
+    for (int k = 0; k < numPontos; k++) {
+        float angulo = 2.0f * PI * k / numPontos;
+        pontos.push_back(vetor3(RAIO_X_ARQUIBANCADA_EXT * fatorRaio * cosf(angulo),
+                                RAIO_Y_ARQUIBANCADA_EXT * fatorRaio * sinf(angulo),
+                                alturaMedia + amplitude * sinf(2.0f * angulo)));
+    }
+    construirTrilhoPorPontos(trilho, pontos, true);
+}
+
+// Posição por comprimento de arco com busca binária (acesso aleatório)
+Vetor3 posicaoTrilhoPorDistancia(const TrilhoCamera &trilho, float distancia) {
+    if (trilho.pontosTabela.empty()) return vetor3(0.0f, 0.0f, 0.0f);
+    if (trilho.fechado && trilho.comprimentoTotal > 0.0f) {
+        distancia = fmodf(distancia, trilho.comprimentoTotal);
+        if (distancia < 0.0f) distancia += trilho.comprimentoTotal;
+    }
+    size_t i = std::upper_bound(trilho.distanciasTabela.begin(), trilho.distanciasTabela.end(), distancia)
+             - trilho.distanciasTabela.begin();
+    if (i == 0) return trilho.pontosTabela.front();
+    if (i >= trilho.pontosTabela.size()) return trilho.pontosTabela.back();
+    float d0 = trilho.distanciasTabela[i - 1], d1 = trilho.distanciasTabela[i];
+    float fracao = (d1 > d0) ? (distancia - d0) / (d1 - d0) : 0.0f;
+    return interpolar(trilho.pontosTabela[i - 1], trilho.pontosTabela[i], fracao);
+}
+
+void reiniciarCursorTrilho(CursorTrilho &cursor) {
+    cursor.indice = 0;
+    cursor.distancia = 0.0f;
+    cursor.voltas = 0;
+}
+
+// Avanço sequencial (reprodução contínua): caminha pela tabela a partir da posição anterior
+void avancarCursorTrilho(const TrilhoCamera &trilho, CursorTrilho &cursor, float delta) {
+    size_t ultimo = trilho.pontosTabela.size();
+    if (ultimo < 2) return;
+    cursor.distancia += delta;
+    if (cursor.distancia >= trilho.comprimentoTotal) {
+        if (trilho.fechado) {
+            cursor.distancia = fmodf(cursor.distancia, trilho.comprimentoTotal);
+            cursor.indice = 0;
+            cursor.voltas++;
+        } else {
+            cursor.distancia = trilho.comprimentoTotal;
+        }
+    }
+    while (cursor.indice + 2 < ultimo && trilho.distanciasTabela[cursor.indice + 1] <= cursor.distancia) {
+        cursor.indice++;
+    }
+}
+
+Vetor3 posicaoCursorTrilho(const TrilhoCamera &trilho, const CursorTrilho &cursor) {
+    if (trilho.pontosTabela.size() < 2) return trilho.pontosTabela.empty() ? vetor3(0.0f, 0.0f, 0.0f) : trilho.pontosTabela[0];
+    float d0 = trilho.distanciasTabela[cursor.indice], d1 = trilho.distanciasTabela[cursor.indice + 1];
+    float fracao = (d1 > d0) ? (cursor.distancia - d0) / (d1 - d0) : 0.0f;
+    if (fracao > 1.0f) fracao = 1.0f;
+    return interpolar(trilho.pontosTabela[cursor.indice], trilho.pontosTabela[cursor.indice + 1], fracao);
+}
+
+// --- Voo de Câmera (quiosque e benchmark) ---
+// Com o voo ativo, o display() posiciona a câmera diretamente nas coordenadas
+// do estádio (Z para cima), olhando para o centro do gramado.
+const float VELOCIDADE_VOO = 0.35f;              // Unidades OpenGL por segundo
+const float PASSO_FIXO_VOO_S = 1.0f / 60.0f;     // Passo por quadro no modo benchmark
+TrilhoCamera trilhoVoo;
+CursorTrilho cursorVoo;
+bool vooAtivo = false;
+int voltasBenchmarkVoo = 0;                      // > 0: benchmark com esse número de voltas (--voo)
+Vetor3 olhoVoo = {0.0f, 0.0f, 0.0f};
+const Vetor3 ALVO_VOO = {0.0f, 0.0f, 0.1f};
+
+void iniciarVooCamera() {
+    if (trilhoVoo.pontosTabela.empty()) {
+        gerarTrilhoVoltaEstadio(trilhoVoo, 12, 1.9f, 0.5f, 1.1f);
+    }
+    reiniciarCursorTrilho(cursorVoo);
+    olhoVoo = posicaoCursorTrilho(trilhoVoo, cursorVoo);
+    if (voltasBenchmarkVoo > 0) iniciarColetaQuadros();
+    vooAtivo = true;
+    printf("Voo de câmera iniciado (trilho de %.2f unidades)\n", trilhoVoo.comprimentoTotal);
+}
+
+void pararVooCamera() {
+    vooAtivo = false;
+}
+
+// Modo quiosque: avançado pelo passo fixo da simulação
+void avancarVooQuiosque(float dt) {
+    if (!vooAtivo || voltasBenchmarkVoo > 0) return;
+    avancarCursorTrilho(trilhoVoo, cursorVoo, VELOCIDADE_VOO * dt);
+}
+
+// Benchmark, início do display(): posição do quadro atual
+void aplicarVooCamera() {
+    if (!vooAtivo || voltasBenchmarkVoo == 0) return;
+    registrarInicioQuadroColeta();
+    olhoVoo = posicaoCursorTrilho(trilhoVoo, cursorVoo);
+}
+
+// Benchmark, fim do display(): um passo fixo por quadro desenhado
+void avancarVooCamera() {
+    if (!vooAtivo || voltasBenchmarkVoo == 0) return;
+    avancarCursorTrilho(trilhoVoo, cursorVoo, VELOCIDADE_VOO * PASSO_FIXO_VOO_S);
+    registrarFimQuadroColeta();
+    if (cursorVoo.voltas >= voltasBenchmarkVoo) {
+        pararVooCamera();
+        relatarColetaQuadros("Voo concluído", "voo_quadros.csv");
+        exit(0);
+    }
+}
+
+// --- Estado da Cena (buffer triplo entre simulação e renderização) ---
+// Entrada, ciclo dia/noite e voo escrevem nas variáveis globais; a cada
+// atualização, publicarEstadoCena() copia um instantâneo para um dos três
+// buffers e o troca, sem travas, com o buffer intermediário. O desenho lê
+// apenas o instantâneo mais recente obtido por consumirEstadoCena(), de modo
+// que simulação e renderização podem rodar em threads diferentes.
+struct EstadoCena {
+    float posicaoCamera[3];
+    float anguloCamera;
+    bool vooAtivo;
+    Vetor3 olhoVoo;
+    float alphaFiltro;
+    int modoNoite;
+    bool luzesRefletoresLigadas;
+    bool painelPerfilVisivel;
+    int larguraJanela, alturaJanela;
+    double tempoCena;           // Tempo de simulação (s), para animações
+    std::vector<unsigned char> alturasOla; // Vazio sem ola em andamento
+    unsigned long sequencia;
+};
+
+const int CENA_NOVA = 4;    // Bit no índice intermediário: instantâneo ainda não consumido
+EstadoCena buffersEstadoCena[3];
+int indiceEscritaCena = 0;                      // Usado só pelo lado da simulação
+int indiceLeituraCena = 1;                      // Usado só pelo lado da renderização
+std::atomic<int> indiceIntermediarioCena(2);
+unsigned long sequenciaEstadoCena = 0;
+int larguraJanela = 1200, alturaJanela = 800;
+bool renderEmThreadSeparada = false;            // --thread-render ativo
+double tempoCenaS = 0.0;                        // Tempo de simulação interpolado (s)
+// Ola: alturas (0-255) da grade, escritas pelo sistema da simulação
+std::vector<unsigned char> alturasOlaAtuais;
+bool olaAtiva = false;
+bool pedidoIniciarOla = false;
+
+void publicarEstadoCena() {
+    EstadoCena &estado = buffersEstadoCena[indiceEscritaCena];
+    for (int i = 0; i < 3; i++) estado.posicaoCamera[i] = camera_position[i];
+    estado.anguloCamera = cameraAngle;
+    estado.vooAtivo = vooAtivo;
+    estado.olhoVoo = olhoVoo;
+    estado.alphaFiltro = alphaFiltro;
+    estado.modoNoite = modoNoite;
+    estado.luzesRefletoresLigadas = modoNoite != 0;
+    estado.painelPerfilVisivel = painelPerfilVisivel;
+    estado.larguraJanela = larguraJanela;
+    estado.alturaJanela = alturaJanela;
+    estado.tempoCena = tempoCenaS;
+    if (olaAtiva) estado.alturasOla = alturasOlaAtuais;
+    else estado.alturasOla.clear();
+    estado.sequencia = ++sequenciaEstadoCena;
+    indiceEscritaCena = indiceIntermediarioCena.exchange(indiceEscritaCena | CENA_NOVA, std::memory_order_acq_rel) & ~CENA_NOVA;
+}
+
+const EstadoCena &consumirEstadoCena() {
+    if (indiceIntermediarioCena.load(std::memory_order_acquire) & CENA_NOVA) {
+        indiceLeituraCena = indiceIntermediarioCena.exchange(indiceLeituraCena, std::memory_order_acq_rel) & ~CENA_NOVA;
+    }
+    return buffersEstadoCena[indiceLeituraCena];
+}
+
+// Pedidos do teclado atendidos pelo lado que possui os dados de perfil
+std::atomic<bool> pedidoExportarPerfil(false);
+std::atomic<bool> pedidoImprimirEstatisticas(false);
+std::atomic<int> passosSimulacaoUltimoQuadro(0); // Escrito pela simulação, impresso com as estatísticas
+// Detalhe da malha (multiplica os segmentos de cada arco); a malha é
+// reconstruída pela thread que desenha, no início do próximo quadro
+const int FATOR_DETALHE_MAXIMO = 64;
+std::atomic<int> fatorDetalheMalha(1);
+std::atomic<bool> pedidoReconstruirMalha(false);
+// Layout de cores dos assentos; recolorido pela thread que desenha
+enum LayoutAssentos {
+    LAYOUT_SETORES = 0,     // Uma cor por arco
+    LAYOUT_RESERVAS,        // Visitantes, imprensa e acessibilidade destacados
+    LAYOUT_OCULTO,
+    NUM_LAYOUTS_ASSENTOS
+};
+
+std::atomic<int> layoutAssentosAtual(LAYOUT_SETORES);
+std::atomic<bool> pedidoAtualizarAssentos(false);
+std::atomic<bool> torcidaVisivel(false);        // Dia de jogo
+std::atomic<bool> mapaLuzLigado(true);          // Mapa de luz pré-calculado, se carregado
+std::atomic<bool> sombrasLigadas(true);         // Sombras da marquise e da parede superior
+std::atomic<bool> iluminacaoLigada(false);      // Sol e refletores com as normais da malha
+std::atomic<bool> shadersLigados(true);         // Sem shaders (ou com --pipeline-fixo), pipeline fixo
+std::atomic<bool> shadersDisponiveis(false);    // Programas prontos; sem eles a tecla 'f' não alterna
+std::atomic<bool> ceuAtmosfericoLigado(true);   // Céu físico no lugar do azul fixo e do filtro preto
+std::atomic<float> horaSolCena(15.0f);          // Hora solar das sombras (--hora, teclas ',' e '.')
+const float PASSO_HORA_SOL = 0.25f;
+// Mapa de análise estendido sobre os degraus; calculado na primeira exibição
+enum ModoAnalise {
+    ANALISE_DESLIGADA = 0,
+    ANALISE_VISIBILIDADE,   // Qualidade da linha de visão de cada assento
+    ANALISE_SOMBRA,         // Fração do dia à sombra
+    NUM_MODOS_ANALISE
+};
+
+std::atomic<int> modoAnaliseAtual(ANALISE_DESLIGADA);
+// Início do vão da marquise (o fim fica em MARQUISE_ANGULO_FINAL); mudar
+// regera a malha e atualiza as análises que dependem da marquise
+const float PASSO_VAO_MARQUISE_GRAUS = 5.0f;
+const float ANGULO_INICIAL_MINIMO_MARQUISE = 140.0f;    // Início da parede superior
+std::atomic<float> anguloInicialMarquisePedido(MARQUISE_ANGULO_INICIAL);
+// Posição do último clique sem arrasto ((x << 16) | y; -1: nenhum), atendida
+// pela thread que desenha, que tem as matrizes do quadro
+std::atomic<int> pedidoSelecao(-1);
+
+void atenderPedidosRender() {
+    if (pedidoExportarPerfil.exchange(false)) exportarPerfilCsv("perfil_passos.csv");
+    if (pedidoImprimirEstatisticas.exchange(false)) {
+        imprimirEstatisticasRender();
+        printf("  Passos de simulação: %d no último avanço\n", passosSimulacaoUltimoQuadro.load());
+    }
+}
+
+
+
+// --- Fila de Eventos de Entrada ---
+// Os callbacks do GLUT só empilham eventos num buffer circular de produtor e
+// consumidor únicos. Uma vez por quadro, processarEventosEntrada() esvazia a
+// fila: soma os deslocamentos do mouse, executa as ações de tecla e converte
+// as teclas mantidas em intenção de movimento, aplicada pela simulação com
+// passo fixo, de modo que a velocidade não depende da taxa de eventos.
+// Cliques viram pedidos de seleção, atendidos pela thread que desenha.
+enum TipoEventoEntrada {
+    EVENTO_TECLA_PRESSIONADA,
+    EVENTO_TECLA_SOLTA,
+    EVENTO_ARRASTO_MOUSE,
+    EVENTO_CLIQUE_MOUSE
+};
+
+struct EventoEntrada {
+    TipoEventoEntrada tipo;
+    unsigned char tecla;
+    int x, y;                           // Arrasto: deslocamento em x; clique: posição na janela
+};
+
+const unsigned int CAPACIDADE_FILA_ENTRADA = 256;  // Potência de 2
+const float VELOCIDADE_CAMERA = 5.0f;               // Unidades por segundo (W/S/J/K)
+const float VELOCIDADE_GIRO_CAMERA = 60.0f;         // Graus por segundo (A/D)
+const float SENSIBILIDADE_MOUSE = 0.5f;             // Graus por pixel arrastado
+
+EventoEntrada filaEntrada[CAPACIDADE_FILA_ENTRADA];
+std::atomic<unsigned int> inicioFilaEntrada(0);     // Próximo a ler (consumidor)
+std::atomic<unsigned int> fimFilaEntrada(0);        // Próximo a escrever (produtor)
+unsigned long eventosEntradaDescartados = 0;
+
+bool teclaMantida[256];                 // Estado de cada tecla (lado do consumidor)
+
+// Resultado do processamento da fila, consumido pelos passos de simulação
+struct IntencaoCamera {
+    float frente, vertical, giro;   // -1, 0 ou 1 conforme as teclas ativas no quadro
+    float giroMouseGraus;           // Arrasto acumulado, aplicado de uma vez
+};
+IntencaoCamera intencaoCamera = {0.0f, 0.0f, 0.0f, 0.0f};
+
+void empilharEventoEntrada(TipoEventoEntrada tipo, unsigned char tecla, int x, int y) {
+    unsigned int fim = fimFilaEntrada.load(std::memory_order_relaxed);
+    if (fim - inicioFilaEntrada.load(std::memory_order_acquire) >= CAPACIDADE_FILA_ENTRADA) {
+        eventosEntradaDescartados++; // Fila cheia: o consumidor está muito atrasado
+        return;
+    }
+    EventoEntrada &evento = filaEntrada[fim & (CAPACIDADE_FILA_ENTRADA - 1)];
+    evento.tipo = tipo;
+    evento.tecla = tecla;
+    evento.x = x;
+    evento.y = y;
+    fimFilaEntrada.store(fim + 1, std::memory_order_release);
+}
+
+bool retirarEventoEntrada(EventoEntrada &evento) {
+    unsigned int inicio = inicioFilaEntrada.load(std::memory_order_relaxed);
+    if (inicio == fimFilaEntrada.load(std::memory_order_acquire)) return false;
+    evento = filaEntrada[inicio & (CAPACIDADE_FILA_ENTRADA - 1)];
+    inicioFilaEntrada.store(inicio + 1, std::memory_order_release);
+    return true;
+}
+
+// Ações disparadas uma vez quando a tecla é pressionada
+void executarAcaoTecla(unsigned char key) {
+    printf("Tecla: %c\n", key);
+
+    // Durante a reprodução só 'r' (interromper) e ESC são aceitos
+    if (reproducaoAtiva && key != 'r' && key != 27) return;
+    // A reprodução mede quadro a quadro e precisa do desenho na thread principal
+    if (renderEmThreadSeparada && key == 'r') return;
+
+    switch (key) {
+        case 'p': // Painel de perfil (tempo por passo)
+            painelPerfilVisivel = !painelPerfilVisivel;
+            break;
+        case 'c': // Exporta os tempos por passo em CSV
+            pedidoExportarPerfil.store(true);
+            break;
+        case 'g': // Inicia/encerra a gravação da sessão de câmera
+            if (gravacaoAtiva) pararGravacaoCamera();
+            else iniciarGravacaoCamera();
+            break;
+        case 'r': // Reproduz a última sessão gravada (ou interrompe a reprodução)
+            if (reproducaoAtiva) finalizarReproducaoCamera();
+            else if (!amostrasSessao.empty() || carregarSessaoCamera(ARQUIVO_SESSAO_PADRAO)) iniciarReproducaoCamera();
+            break;
+        case 'v': // Voo automático ao redor do estádio (modo quiosque)
+            if (vooAtivo) pararVooCamera();
+            else iniciarVooCamera();
+            break;
+        case 'e': // Estatísticas de renderização do último quadro
+            pedidoImprimirEstatisticas.store(true);
+            break;
+        case '+': case '=': // Mais/menos detalhe na malha (reconstruída em paralelo)
+        case '-': {
+            int detalhe = fatorDetalheMalha.load();
+            if (key == '-') detalhe = detalhe > 1 ? detalhe / 2 : 1;
+            else detalhe = detalhe < FATOR_DETALHE_MAXIMO ? detalhe * 2 : FATOR_DETALHE_MAXIMO;
+            fatorDetalheMalha.store(detalhe);
+            pedidoReconstruirMalha.store(true);
+            break;
+        }
+        case 'o': // Ola a partir do começo de cada lance de arquibancada
+            pedidoIniciarOla = true;
+            break;
+        case 't': // Torcida nas arquibancadas
+            torcidaVisivel.store(!torcidaVisivel.load());
+            break;
+        case 'm': // Mapa de luz pré-calculado (--mapa-luz)
+            mapaLuzLigado.store(!mapaLuzLigado.load());
+            printf("Mapa de luz %s\n", mapaLuzLigado.load() ? "ligado" : "desligado");
+            break;
+        case 'i': // Modo iluminado (sol e refletores)
+            iluminacaoLigada.store(!iluminacaoLigada.load());
+            printf("Iluminação %s\n", iluminacaoLigada.load() ? "ligada" : "desligada");
+            break;
+        case 'u': // Céu atmosférico (desligado: azul fixo e filtro preto)
+            ceuAtmosfericoLigado.store(!ceuAtmosfericoLigado.load());
+            printf("Céu atmosférico %s\n", ceuAtmosfericoLigado.load() ? "ligado" : "desligado");
+            break;
+        case 'f': // Shaders / pipeline fixo
+            if (!shadersDisponiveis.load()) {
+                printf("Shaders indisponíveis (sem GLSL 3.30 ou com --pipeline-fixo); pipeline fixo\n");
+                break;
+            }
+            shadersLigados.store(!shadersLigados.load());
+            printf("Pipeline %s\n", shadersLigados.load() ? "de shaders" : "fixo");
+            break;
+        case 'b': // Sombras da marquise e da parede superior
+            sombrasLigadas.store(!sombrasLigadas.load());
+            printf("Sombras %s\n", sombrasLigadas.load() ? "ligadas" : "desligadas");
+            break;
+        case ',': // Atrasa / adianta o sol das sombras
+        case '.': {
+            float hora = horaSolCena.load() + (key == ',' ? -PASSO_HORA_SOL : PASSO_HORA_SOL);
+            hora = std::max(0.0f, std::min(hora, 24.0f));
+            horaSolCena.store(hora);
+            printf("Sol das sombras às %.2f h\n", hora);
+            break;
+        }
+        case 'h': // Próximo mapa de análise sobre as arquibancadas
+            modoAnaliseAtual.store((modoAnaliseAtual.load() + 1) % NUM_MODOS_ANALISE);
+            break;
+        case '[': // Encurta / estende a marquise
+        case ']': {
+            float angulo = anguloInicialMarquisePedido.load()
+                         + (key == '[' ? PASSO_VAO_MARQUISE_GRAUS : -PASSO_VAO_MARQUISE_GRAUS);
+            angulo = std::max(ANGULO_INICIAL_MINIMO_MARQUISE,
+                              std::min(angulo, MARQUISE_ANGULO_FINAL - PASSO_VAO_MARQUISE_GRAUS));
+            anguloInicialMarquisePedido.store(angulo);
+            pedidoReconstruirMalha.store(true);
+            break;
+        }
+        case 'l': // Próximo layout de cores dos assentos (setores, reservas, oculto)
+            layoutAssentosAtual.store((layoutAssentosAtual.load() + 1) % NUM_LAYOUTS_ASSENTOS);
+            pedidoAtualizarAssentos.store(true);
+            break;
+        case 27: // ESC
+            exit(0);
+            break;
+    }
+}
+
+// Chamada uma vez por quadro, antes dos passos de simulação
+void processarEventosEntrada() {
+    // Teclas pressionadas e soltas dentro do mesmo quadro ainda contam por um quadro
+    bool ativaNoQuadro[256];
+    for (int i = 0; i < 256; i++) ativaNoQuadro[i] = teclaMantida[i];
+
+    int somaDeltaX = 0;
+    EventoEntrada evento;
+    while (retirarEventoEntrada(evento)) {
+        switch (evento.tipo) {
+            case EVENTO_TECLA_PRESSIONADA:
+                teclaMantida[evento.tecla] = true;
+                ativaNoQuadro[evento.tecla] = true;
+                executarAcaoTecla(evento.tecla);
+                break;
+            case EVENTO_TECLA_SOLTA:
+                teclaMantida[evento.tecla] = false;
+                break;
+            case EVENTO_ARRASTO_MOUSE:
+                somaDeltaX += evento.x;
+                break;
+            case EVENTO_CLIQUE_MOUSE:
+                pedidoSelecao.store((evento.x << 16) | evento.y);
+                break;
+        }
+    }
+
+    // Intenção de movimento para os passos de simulação deste quadro
+    intencaoCamera.giroMouseGraus += somaDeltaX * SENSIBILIDADE_MOUSE;
+    intencaoCamera.giro = (ativaNoQuadro['d'] ? 1.0f : 0.0f) - (ativaNoQuadro['a'] ? 1.0f : 0.0f);
+    intencaoCamera.vertical = (ativaNoQuadro['w'] ? 1.0f : 0.0f) - (ativaNoQuadro['s'] ? 1.0f : 0.0f);
+    intencaoCamera.frente = (ativaNoQuadro['j'] ? 1.0f : 0.0f) - (ativaNoQuadro['k'] ? 1.0f : 0.0f);
+}
+
+// --- Simulação com Passo Fixo ---
+// A simulação (câmera com velocidade e aceleração, ciclo dia/noite, voo e os
+// sistemas registrados) avança sempre em passos de PASSO_SIMULACAO_S. O
+// tempo real de cada quadro se acumula e é consumido em passos inteiros (no
+// máximo MAX_PASSOS_SIMULACAO_POR_QUADRO, limitando o custo por quadro); a
+// fração que sobra interpola entre os dois últimos estados para o desenho,
+// de modo que o movimento é suave em qualquer taxa de atualização da tela.
+const float PASSO_SIMULACAO_S = 1.0f / 120.0f;
+const int MAX_PASSOS_SIMULACAO_POR_QUADRO = 8;
+const float ACELERACAO_CAMERA = 12.0f;  // Fração da diferença de velocidade corrigida por segundo
+const int MAX_SISTEMAS_SIMULACAO = 16;
+
+struct EstadoSimulacao {
+    float posicaoCamera[3];
+    float anguloCamera;
+    float velocidadeFrente, velocidadeVertical, velocidadeGiro;
+    float alphaFiltro;
+    int modoNoite;
+    float tempoNoModo;
+    bool vooAtivo;
+    Vetor3 olhoVoo;
+    double tempo;               // Tempo de simulação acumulado (s)
+};
+
+// Sistemas futuros (multidão, partículas...) avançam junto com a simulação
+typedef void (*FuncaoSistemaSimulacao)(float dt);
+FuncaoSistemaSimulacao sistemasSimulacao[MAX_SISTEMAS_SIMULACAO];
+int numSistemasSimulacao = 0;
+
+EstadoSimulacao simulacaoAnterior, simulacaoAtual;
+bool simulacaoIniciada = false;
+double ultimoAvancoSimulacaoMs = -1.0;
+double acumuladorSimulacaoS = 0.0;
+float fracaoInterpolacao = 0.0f;        // Posição do desenho entre o passo anterior e o atual
+
+void registrarSistemaSimulacao(FuncaoSistemaSimulacao sistema) {
+    if (numSistemasSimulacao < MAX_SISTEMAS_SIMULACAO) {
+        sistemasSimulacao[numSistemasSimulacao++] = sistema;
+    } else {
+        fprintf(stderr, "Aviso: limite de sistemas de simulação atingido\n");
+    }
+}
+
+// Copia as variáveis globais (estado visível) para a simulação
+void sincronizarSimulacaoComGlobais() {
+    for (int i = 0; i < 3; i++) simulacaoAtual.posicaoCamera[i] = camera_position[i];
+    simulacaoAtual.anguloCamera = cameraAngle;
+    simulacaoAtual.alphaFiltro = alphaFiltro;
+    simulacaoAtual.modoNoite = modoNoite;
+    simulacaoAtual.velocidadeFrente = simulacaoAtual.velocidadeVertical = simulacaoAtual.velocidadeGiro = 0.0f;
+    simulacaoAnterior = simulacaoAtual;
+}
+
+// Ciclo dia/noite: alterna de modo periodicamente e move o filtro em direção ao modo atual
+void atualizarTransicao(EstadoSimulacao &estado, float dt) {
+    RASTREAR_FUNCAO();
+    estado.tempoNoModo += dt;
+    if (estado.tempoNoModo >= DURACAO_MODO_DIA_NOITE_S) {
+        estado.modoNoite = !estado.modoNoite;
+        estado.tempoNoModo = 0.0f;
+    }
+    float passo = velocidadeTransicao * dt;
+    if (estado.modoNoite && estado.alphaFiltro < 1.5f) {
+        estado.alphaFiltro += passo;
+        if (estado.alphaFiltro > 1.5f) estado.alphaFiltro = 1.5f;
+    } else if (!estado.modoNoite && estado.alphaFiltro > 0.0f) {
+        estado.alphaFiltro -= passo;
+        if (estado.alphaFiltro < 0.0f) estado.alphaFiltro = 0.0f;
+    }
+}
+
+// Aproxima a velocidade do alvo com aceleração limitada
+float acelerarVelocidade(float atual, float alvo, float dt) {
+    float fator = ACELERACAO_CAMERA * dt;
+    if (fator > 1.0f) fator = 1.0f;
+    return atual + (alvo - atual) * fator;
+}
+
+void passoSimulacao(EstadoSimulacao &estado, float dt) {
+    estado.velocidadeFrente = acelerarVelocidade(estado.velocidadeFrente, intencaoCamera.frente * VELOCIDADE_CAMERA, dt);
+    estado.velocidadeVertical = acelerarVelocidade(estado.velocidadeVertical, intencaoCamera.vertical * VELOCIDADE_CAMERA, dt);
+    estado.velocidadeGiro = acelerarVelocidade(estado.velocidadeGiro, intencaoCamera.giro * VELOCIDADE_GIRO_CAMERA, dt);
+
+    estado.anguloCamera += estado.velocidadeGiro * dt;
+    if (estado.anguloCamera > 360.0f) estado.anguloCamera -= 360.0f;
+    if (estado.anguloCamera < 0.0f) estado.anguloCamera += 360.0f;
+    float rad = estado.anguloCamera * M_PI / 180.0f;
+    estado.posicaoCamera[0] += sinf(rad) * estado.velocidadeFrente * dt;
+    estado.posicaoCamera[2] += -cosf(rad) * estado.velocidadeFrente * dt;
+    estado.posicaoCamera[1] += estado.velocidadeVertical * dt;
+
+    atualizarTransicao(estado, dt);
+    estado.tempo += dt;
+
+    avancarVooQuiosque(dt);
+    estado.vooAtivo = vooAtivo && voltasBenchmarkVoo == 0;
+    if (estado.vooAtivo) estado.olhoVoo = posicaoCursorTrilho(trilhoVoo, cursorVoo);
+
+    for (int i = 0; i < numSistemasSimulacao; i++) sistemasSimulacao[i](dt);
+}
+
+float interpolarAngulo(float anterior, float atual, float t) {
+    float diferenca = atual - anterior;
+    if (diferenca > 180.0f) diferenca -= 360.0f;
+    if (diferenca < -180.0f) diferenca += 360.0f;
+    float angulo = anterior + diferenca * t;
+    if (angulo >= 360.0f) angulo -= 360.0f;
+    if (angulo < 0.0f) angulo += 360.0f;
+    return angulo;
+}
+
+// Chamada uma vez por quadro pelo lado da simulação
+void avancarSimulacao() {
+    RASTREAR_FUNCAO();
+    if (!simulacaoIniciada) {
+        sincronizarSimulacaoComGlobais();
+        simulacaoIniciada = true;
+    }
+    processarEventosEntrada();
+
+    double agora = tempoAtualMs();
+    double dtQuadro = (ultimoAvancoSimulacaoMs < 0.0) ? 0.0 : (agora - ultimoAvancoSimulacaoMs) / 1000.0;
+    ultimoAvancoSimulacaoMs = agora;
+    if (dtQuadro > 0.25) dtQuadro = 0.25; // Pausas longas (janela arrastada, depurador) não disparam avalanche
+    acumuladorSimulacaoS += dtQuadro;
+
+    if (reproducaoAtiva) {
+        // A sessão reproduzida controla as globais; a simulação só as acompanha
+        sincronizarSimulacaoComGlobais();
+        acumuladorSimulacaoS = 0.0;
+        intencaoCamera.giroMouseGraus = 0.0f;
+        return;
+    }
+
+    // O arrasto do mouse é manipulação direta: gira os dois estados, sem atraso de interpolação
+    simulacaoAtual.anguloCamera += intencaoCamera.giroMouseGraus;
+    simulacaoAnterior.anguloCamera += intencaoCamera.giroMouseGraus;
+    intencaoCamera.giroMouseGraus = 0.0f;
+
+    // Voo recém-iniciado: começa do ponto inicial do trilho, sem interpolar a partir da origem
+    if (vooAtivo && voltasBenchmarkVoo == 0 && !simulacaoAtual.vooAtivo) {
+        simulacaoAtual.olhoVoo = simulacaoAnterior.olhoVoo = posicaoCursorTrilho(trilhoVoo, cursorVoo);
+    }
+
+    int passos = 0;
+    while (acumuladorSimulacaoS >= PASSO_SIMULACAO_S && passos < MAX_PASSOS_SIMULACAO_POR_QUADRO) {
+        simulacaoAnterior = simulacaoAtual;
+        passoSimulacao(simulacaoAtual, PASSO_SIMULACAO_S);
+        acumuladorSimulacaoS -= PASSO_SIMULACAO_S;
+        passos++;
+    }
+    if (passos == MAX_PASSOS_SIMULACAO_POR_QUADRO) {
+        acumuladorSimulacaoS = fmod(acumuladorSimulacaoS, (double)PASSO_SIMULACAO_S); // Descarta o atraso
+    }
+    passosSimulacaoUltimoQuadro.store(passos);
+
+    // Estado visível = interpolação entre os dois últimos passos
+    float t = (float)(acumuladorSimulacaoS / PASSO_SIMULACAO_S);
+    fracaoInterpolacao = t;
+    for (int i = 0; i < 3; i++) {
+        camera_position[i] = simulacaoAnterior.posicaoCamera[i]
+                           + (simulacaoAtual.posicaoCamera[i] - simulacaoAnterior.posicaoCamera[i]) * t;
+    }
+    cameraAngle = interpolarAngulo(simulacaoAnterior.anguloCamera, simulacaoAtual.anguloCamera, t);
+    alphaFiltro = simulacaoAnterior.alphaFiltro + (simulacaoAtual.alphaFiltro - simulacaoAnterior.alphaFiltro) * t;
+    modoNoite = simulacaoAtual.modoNoite;
+    tempoCenaS = simulacaoAnterior.tempo + (simulacaoAtual.tempo - simulacaoAnterior.tempo) * t;
+    if (simulacaoAtual.vooAtivo) {
+        olhoVoo = interpolar(simulacaoAnterior.olhoVoo, simulacaoAtual.olhoVoo, t);
+    }
+}
+
+//  Função para capturar o clique do mouse
+void mouse(int botao, int estado, int x, int y) {
+    if (botao == GLUT_LEFT_BUTTON) {
+        if (estado == GLUT_DOWN) {
+            mouseEsquerdoPressionado = true;
+            ultimoXMouse = x;
+            xCliqueMouse = x;
+            yCliqueMouse = y;
+        } else if (estado == GLUT_UP) {
+            mouseEsquerdoPressionado = false;
+            // Clique sem arrasto: seleciona o que está sob o cursor
+            if (abs(x - xCliqueMouse) + abs(y - yCliqueMouse) <= TOLERANCIA_CLIQUE_PIXELS
+                && x >= 0 && y >= 0 && x < 32768 && y < 65536) {
+                empilharEventoEntrada(EVENTO_CLIQUE_MOUSE, 0, x, y);
+            }
+        }
+    }
+}
+
+
+// Mouse - Pressionar ou soltar botão
+void motion(int x, int y) {
+    if (mouseEsquerdoPressionado) {
+        empilharEventoEntrada(EVENTO_ARRASTO_MOUSE, 0, x - ultimoXMouse, 0);
+        ultimoXMouse = x;
+    }
+}
+
+
+// --- Funções Utilitárias ---
+GLuint carregarTextura(const char *nomeArquivo) {
+    RASTREAR_FUNCAO();
+    GLuint idTextura;
+    int largura, altura, numCanais;
+
+    // Configura stb_image para inverter a imagem verticalmente no carregamento
+    // (necessário pois OpenGL espera origem no canto inferior esquerdo)
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *dados = stbi_load(nomeArquivo, &largura, &altura, &numCanais, 0);
+
+    if (dados) {
+        GLenum formato = GL_RGB; // Formato padrão (3 canais)
+        if (numCanais == 1) {
+            formato = GL_RED; // Formato para imagens em escala de cinza (1 canal)
+        } else if (numCanais == 4) {
+            formato = GL_RGBA; // Formato para imagens com canal alfa (4 canais)
+        }
+
+        glGenTextures(1, &idTextura);               // Gera um ID de textura
+        glBindTexture(GL_TEXTURE_2D, idTextura);    // Vincula a textura para configuração
+
+        // Envia os dados da imagem para a GPU
+        glTexImage2D(GL_TEXTURE_2D, 0, formato, largura, altura, 0, formato, GL_UNSIGNED_BYTE, dados);
+        estatisticasQuadro.bytesEnviados += (unsigned long)largura * altura * numCanais;
+
+        // Define parâmetros de repetição e filtragem da textura
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // Repete a textura na coordenada S (horizontal)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // Repete a textura na coordenada T (vertical)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Filtragem linear para minificação (quando objeto está longe)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Filtragem linear para magnificação (quando objeto está perto)
+
+        // Libera a memória da imagem carregada na CPU, pois já está na GPU
+        stbi_image_free(dados);
+
+        // Desvincula a textura (boa prática)
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        printf("Textura '%s' carregada (Largura: %d, Altura: %d, Canais: %d, ID: %u)\n",
+               nomeArquivo, largura, altura, numCanais, idTextura);
+        return idTextura;
+    } else {
+        // Exibe erro se o carregamento falhar
+        fprintf(stderr, "Erro ao carregar textura '%s': %s\n", nomeArquivo, stbi_failure_reason());
+        return 0; // Retorna 0 para indicar falha
+    }
+}
+
+// --- Malha do Estádio (geração em paralelo + descarte por frustum) ---
+// A geometria é gerada uma vez (e novamente ao mudar o detalhe) em vetores de
+// vértices na CPU e desenhada com glDrawArrays. Os arcos são cortados em
+// setores de GRAUS_POR_SETOR_MALHA; cada setor de cada arco é uma "peça"
+// independente, gerada numa tarefa do sistema de tarefas e desenhada como um
+// objeto com caixa de limites própria, descartado se estiver fora da câmera.
+const float GRAUS_POR_SETOR_MALHA = 10.0f;
+const float GRAUS_POR_SEGMENTO_MARQUISE = 1.25f;    // Divide o passo do vão (PASSO_VAO_MARQUISE_GRAUS)
+
+int versaoMalhaEstadio = 0;                         // Incrementada a cada construção
+float anguloInicialMarquiseMalha = MARQUISE_ANGULO_INICIAL; // Vão usado na malha atual
+
+struct VerticeMalha {           // Arrays intercalados (ver apontarVerticesMalha)
+    float s, t;
+    float r, g, b;
+    float nx, ny, nz;           // Normal analítica da superfície, calculada na geração
+    float x, y, z;
+};
+
+struct CaixaLimites {
+    Vetor3 minimo, maximo;
+};
+
+void incluirNaCaixa(CaixaLimites &c, const Vetor3 &p) {
+    if (p.x < c.minimo.x) c.minimo.x = p.x;
+    if (p.y < c.minimo.y) c.minimo.y = p.y;
+    if (p.z < c.minimo.z) c.minimo.z = p.z;
+    if (p.x > c.maximo.x) c.maximo.x = p.x;
+    if (p.y > c.maximo.y) c.maximo.y = p.y;
+    if (p.z > c.maximo.z) c.maximo.z = p.z;
+}
+
+// Gera triângulos a partir de chamadas no estilo glBegin/glEnd
+struct ConstrutorMalha {
+    std::vector<VerticeMalha> vertices;
+    CaixaLimites caixa;
+    GLenum modo;
+    VerticeMalha atual;                 // Cor, coordenada de textura e normal correntes
+    std::vector<VerticeMalha> primitiva; // Vértices desde o último iniciarPrimitivaMalha
+    std::vector<unsigned char> cantos;  // Por vértice de saída: canto no quadrilátero de origem
+};
+
+void reiniciarConstrutorMalha(ConstrutorMalha &malha) {
+    malha.vertices.clear();
+    malha.primitiva.clear();
+    malha.cantos.clear();
+    malha.caixa.minimo = vetor3(1e30f, 1e30f, 1e30f);
+    malha.caixa.maximo = vetor3(-1e30f, -1e30f, -1e30f);
+    malha.atual.s = malha.atual.t = 0.0f;
+    malha.atual.r = malha.atual.g = malha.atual.b = 1.0f;
+    malha.atual.nx = malha.atual.ny = 0.0f;
+    malha.atual.nz = 1.0f;
+}
+
+void iniciarPrimitivaMalha(ConstrutorMalha &malha, GLenum modo) {
+    malha.modo = modo;
+    malha.primitiva.clear();
+}
+
+void corMalha(ConstrutorMalha &malha, float r, float g, float b) {
+    malha.atual.r = r; malha.atual.g = g; malha.atual.b = b;
+}
+
+void coordTexturaMalha(ConstrutorMalha &malha, float s, float t) {
+    malha.atual.s = s; malha.atual.t = t;
+}
+
+void normalMalha(ConstrutorMalha &malha, const Vetor3 &n) {
+    malha.atual.nx = n.x; malha.atual.ny = n.y; malha.atual.nz = n.z;
+}
+
+// Normal horizontal da elipse (rx, ry) no ângulo dado (gradiente de x²/rx² + y²/ry²)
+Vetor3 normalElipse(float rx, float ry, float cos_a, float sin_a) {
+    return normalizar(vetor3(cos_a / rx, sin_a / ry, 0.0f));
+}
+
+// Normal da superfície entre duas elipses concêntricas, (rx0, ry0, z0) e
+// (rx1, ry1, z1), no ponto do anel (rx, ry): produto das derivadas da
+// parametrização no ângulo e ao longo da geratriz. Cobre as paredes
+// inclinadas (INCLINACAO_PAREDE_OFFSET) e os tampos da marquise.
+Vetor3 normalEntreElipses(float rx0, float ry0, float z0, float rx1, float ry1, float z1,
+                          float rx, float ry, float cos_a, float sin_a) {
+    Vetor3 tangente = vetor3(-rx * sin_a, ry * cos_a, 0.0f);
+    Vetor3 geratriz = vetor3((rx1 - rx0) * cos_a, (ry1 - ry0) * sin_a, z1 - z0);
+    return normalizar(produtoVetorial(tangente, geratriz));
+}
+
+// Normal de um quadrilátero plano (tampas), pelas diagonais
+Vetor3 normalQuadrilatero(const float *v1, const float *v2, const float *v3, const float *v4) {
+    Vetor3 d1 = vetor3(v3[0] - v1[0], v3[1] - v1[1], v3[2] - v1[2]);
+    Vetor3 d2 = vetor3(v4[0] - v2[0], v4[1] - v2[1], v4[2] - v2[2]);
+    return normalizar(produtoVetorial(d1, d2));
+}
+
+void verticeMalha(ConstrutorMalha &malha, float x, float y, float z) {
+    VerticeMalha v = malha.atual;
+    v.x = x; v.y = y; v.z = z;
+    malha.primitiva.push_back(v);
+    incluirNaCaixa(malha.caixa, vetor3(x, y, z));
+}
+
+void verticeMalhav(ConstrutorMalha &malha, const float *v) {
+    verticeMalha(malha, v[0], v[1], v[2]);
+}
+
+// Converte a primitiva (faixa, leque ou quadriláteros) em triângulos,
+// preservando a orientação dos vértices. Faixas e quadriláteros saem como
+// pares de triângulos, um par por quadrilátero, e cada vértice leva o seu
+// canto no quadrilátero (bit 0: ao longo da faixa, bit 1: através dela),
+// usado pelas coordenadas do mapa de luz. As normais dos geradores dão só a
+// direção: o sentido é acertado aqui para a face da frente (anti-horária) de
+// cada triângulo, como a iluminação dos dois lados do GL espera.
+void finalizarPrimitivaMalha(ConstrutorMalha &malha) {
+    const std::vector<VerticeMalha> &p = malha.primitiva;
+    std::vector<VerticeMalha> &saida = malha.vertices;
+    std::vector<unsigned char> &cantos = malha.cantos;
+    int n = (int)p.size();
+    size_t inicio = saida.size();
+    switch (malha.modo) {
+        case GL_TRIANGLE_STRIP:
+            for (int i = 2; i < n; i++) {
+                int j = (i - 2) / 2; // Quadrilátero p[2j..2j+3]
+                int a = i % 2 == 0 ? i - 2 : i - 1, b = i % 2 == 0 ? i - 1 : i - 2;
+                saida.push_back(p[a]); saida.push_back(p[b]); saida.push_back(p[i]);
+                cantos.push_back((unsigned char)((a / 2 - j) | (a % 2) << 1));
+                cantos.push_back((unsigned char)((b / 2 - j) | (b % 2) << 1));
+                cantos.push_back((unsigned char)((i / 2 - j) | (i % 2) << 1));
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+            for (int i = 2; i < n; i++) {
+                saida.push_back(p[0]); saida.push_back(p[i - 1]); saida.push_back(p[i]);
+            }
+            cantos.resize(saida.size(), 0);
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < n; i += 4) {
+                saida.push_back(p[i]); saida.push_back(p[i + 1]); saida.push_back(p[i + 2]);
+                saida.push_back(p[i]); saida.push_back(p[i + 2]); saida.push_back(p[i + 3]);
+                const unsigned char cantosQuad[6] = {0, 1, 3, 0, 3, 2};
+                cantos.insert(cantos.end(), cantosQuad, cantosQuad + 6);
+            }
+            break;
+        case GL_TRIANGLES:
+            saida.insert(saida.end(), p.begin(), p.end() - n % 3);
+            cantos.resize(saida.size(), 0);
+            break;
+    }
+    for (size_t i = inicio; i + 2 < saida.size(); i += 3) {
+        VerticeMalha *v = &saida[i];
+        Vetor3 frente = produtoVetorial(vetor3(v[1].x - v[0].x, v[1].y - v[0].y, v[1].z - v[0].z),
+                                        vetor3(v[2].x - v[0].x, v[2].y - v[0].y, v[2].z - v[0].z));
+        for (int k = 0; k < 3; k++) {
+            if (frente.x * v[k].nx + frente.y * v[k].ny + frente.z * v[k].nz < 0.0f) {
+                v[k].nx = -v[k].nx; v[k].ny = -v[k].ny; v[k].nz = -v[k].nz;
+            }
+        }
+    }
+    malha.primitiva.clear();
+}
+
+// 's_inicial'/'s_final': coordenada de textura ao longo do trecho [angulo_inicial, angulo_final],
+// para que setores de um mesmo arco continuem a textura uns dos outros
+void gerarDegrauArquibancada(ConstrutorMalha &malha, float cx, float cy,
+                             float rx_int, float ry_int, float rx_ext, float ry_ext,
+                             float z_base, float z_topo,
+                             float angulo_inicial_graus, float angulo_final_graus,
+                             int num_segmentos_curva, float s_inicial, float s_final) {
+    RASTREAR_FUNCAO();
+    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
+    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
+    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
+    float intervalo_rad = rad_final - rad_inicial;
+
+    // --- Face Superior (Topo) ---
+    normalMalha(malha, vetor3(0.0f, 0.0f, 1.0f));
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad);
+        float sin_a = sinf(angulo_atual_rad);
+        float s_coord = s_inicial + fracao * (s_final - s_inicial); // Repetição de textura ao longo do arco
+        coordTexturaMalha(malha, s_coord, 1.0f); // Coord T = 1 (borda externa da textura?)
+        verticeMalha(malha, cx + rx_ext * cos_a, cy + ry_ext * sin_a, z_topo);
+        coordTexturaMalha(malha, s_coord, 0.0f); // Coord T = 0 (borda interna da textura?)
+        verticeMalha(malha, cx + rx_int * cos_a, cy + ry_int * sin_a, z_topo);
+    }
+    finalizarPrimitivaMalha(malha);
+
+    // --- Face Frontal (Vertical) ---
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad);
+        float sin_a = sinf(angulo_atual_rad);
+        float s_coord = s_inicial + fracao * (s_final - s_inicial);
+        normalMalha(malha, normalElipse(rx_int, ry_int, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 1.0f); // Coord T = 1 (topo da face vertical)
+        verticeMalha(malha, cx + rx_int * cos_a, cy + ry_int * sin_a, z_topo);
+        coordTexturaMalha(malha, s_coord, 0.0f); // Coord T = 0 (base da face vertical)
+        verticeMalha(malha, cx + rx_int * cos_a, cy + ry_int * sin_a, z_base);
+    }
+    finalizarPrimitivaMalha(malha);
+}
+
+void gerarParedeExterna(ConstrutorMalha &malha, float cx, float cy,
+                        float rx_base, float ry_base, float rx_topo, float ry_topo,
+                        float z_baixo, float z_alto,
+                        float angulo_inicial_graus, float angulo_final_graus,
+                        int num_segmentos_curva, float s_inicial, float s_final) {
+    RASTREAR_FUNCAO();
+    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
+    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
+    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
+    float intervalo_rad = rad_final - rad_inicial;
+
+    // --- Face da Parede ---
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad);
+        float sin_a = sinf(angulo_atual_rad);
+        float s_coord = s_inicial + fracao * (s_final - s_inicial); // Repetição de textura (maior para paredes)
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_baixo, rx_topo, ry_topo, z_alto,
+                                              rx_topo, ry_topo, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 1.0f); // Coord T = 1 (topo da parede)
+        verticeMalha(malha, cx + rx_topo * cos_a, cy + ry_topo * sin_a, z_alto);
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_baixo, rx_topo, ry_topo, z_alto,
+                                              rx_base, ry_base, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 0.0f); // Coord T = 0 (base da parede)
+        verticeMalha(malha, cx + rx_base * cos_a, cy + ry_base * sin_a, z_baixo);
+    }
+    finalizarPrimitivaMalha(malha);
+}
+
+void gerarTampaLateral(ConstrutorMalha &malha, float cx, float cy, float angulo_graus,
+                       float rx_int_base, float ry_int_base, float z_int_base,
+                       float rx_ext_base, float ry_ext_base, float z_ext_base,
+                       float rx_ext_topo, float ry_ext_topo, float z_ext_topo,
+                       float rx_int_topo, float ry_int_topo, float z_int_topo) {
+    float angulo_rad = GRAUS_PARA_RAD(angulo_graus);
+    float cos_a = cosf(angulo_rad);
+    float sin_a = sinf(angulo_rad);
+
+    // Vértices do quadrilátero da tampa
+    float v1[3] = {cx + rx_int_base * cos_a, cy + ry_int_base * sin_a, z_int_base}; // Interno, Base
+    float v2[3] = {cx + rx_ext_base * cos_a, cy + ry_ext_base * sin_a, z_ext_base}; // Externo, Base
+    float v3[3] = {cx + rx_ext_topo * cos_a, cy + ry_ext_topo * sin_a, z_ext_topo}; // Externo, Topo
+    float v4[3] = {cx + rx_int_topo * cos_a, cy + ry_int_topo * sin_a, z_int_topo}; // Interno, Topo
+
+    // --- Tampa (Quadrilátero) ---
+    normalMalha(malha, normalQuadrilatero(v1, v2, v3, v4));
+    iniciarPrimitivaMalha(malha, GL_QUADS);
+        coordTexturaMalha(malha, 0.0f, 0.0f); verticeMalhav(malha, v1); // Canto inf-int
+        coordTexturaMalha(malha, 1.0f, 0.0f); verticeMalhav(malha, v2); // Canto inf-ext
+        coordTexturaMalha(malha, 1.0f, 1.0f); verticeMalhav(malha, v3); // Canto sup-ext
+        coordTexturaMalha(malha, 0.0f, 1.0f); verticeMalhav(malha, v4); // Canto sup-int
+    finalizarPrimitivaMalha(malha);
+}
+
+void gerarMarquiseCobertura(ConstrutorMalha &malha, float cx, float cy,
+    float rx_base, float ry_base, float z_base, // Ponto de trás/base
+    float rx_frente, float ry_frente, float z_frente, float espessura,
+    float angulo_inicial_graus, float angulo_final_graus,
+    int num_segmentos_curva) {
+    RASTREAR_FUNCAO();
+    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
+    float z_base_inf = z_base - espessura;
+    float z_frente_inf = z_frente - espessura;
+
+    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
+    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
+    float intervalo_rad = rad_final - rad_inicial;
+
+    // --- 1. Superfície SUPERIOR ---
+    corMalha(malha, 0.7f, 0.7f, 0.75f); // Cor da superfície superior
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
+        float s_coord = fracao;
+        // Vértice Trás/Base (Superior)
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_base, rx_frente, ry_frente, z_frente,
+                                              rx_base, ry_base, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 1.0f); verticeMalha(malha, cx + rx_base * cos_a, cy + ry_base * sin_a, z_base);
+        // Vértice Frente (Superior)
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_base, rx_frente, ry_frente, z_frente,
+                                              rx_frente, ry_frente, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 0.0f); verticeMalha(malha, cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente);
+    }
+    finalizarPrimitivaMalha(malha);
+
+    // --- 2. Superfície INFERIOR ---
+    corMalha(malha, 0.6f, 0.6f, 0.65f); // Cor um pouco mais escura para baixo
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
+        float s_coord = fracao;
+        // Vértice Trás/Base (Inferior)
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_base_inf, rx_frente, ry_frente, z_frente_inf,
+                                              rx_base, ry_base, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 1.0f); verticeMalha(malha, cx + rx_base * cos_a, cy + ry_base * sin_a, z_base_inf);
+        // Vértice Frente (Inferior)
+        normalMalha(malha, normalEntreElipses(rx_base, ry_base, z_base_inf, rx_frente, ry_frente, z_frente_inf,
+                                              rx_frente, ry_frente, cos_a, sin_a));
+        coordTexturaMalha(malha, s_coord, 0.0f); verticeMalha(malha, cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente_inf);
+    }
+    finalizarPrimitivaMalha(malha);
+
+    // --- 3. Borda FRONTAL (Espessura) ---
+    corMalha(malha, 0.65f, 0.65f, 0.7f); // Cor da borda
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
+        float s_coord = fracao;
+        normalMalha(malha, normalElipse(rx_frente, ry_frente, cos_a, sin_a));
+        // Vértice Frente (Superior)
+        coordTexturaMalha(malha, s_coord, 1.0f); verticeMalha(malha, cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente);
+        // Vértice Frente (Inferior)
+        coordTexturaMalha(malha, s_coord, 0.0f); verticeMalha(malha, cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente_inf);
+    }
+    finalizarPrimitivaMalha(malha);
+
+    // --- 4. Borda TRASEIRA (Espessura) ---
+    // (Antes ficava aninhada dentro do laço da borda frontal, sem o glEnd desta)
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+    for (int i = 0; i <= num_segmentos_curva; i++) {
+        float fracao = (float)i / (float)num_segmentos_curva;
+        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
+        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
+        float s_coord = fracao;
+        normalMalha(malha, normalElipse(rx_base, ry_base, cos_a, sin_a));
+        // Vértice Trás/Base (Superior)
+        coordTexturaMalha(malha, s_coord, 1.0f); verticeMalha(malha, cx + rx_base * cos_a, cy + ry_base * sin_a, z_base);
+        // Vértice Trás/Base (Inferior)
+        coordTexturaMalha(malha, s_coord, 0.0f); verticeMalha(malha, cx + rx_base * cos_a, cy + ry_base * sin_a, z_base_inf);
+    }
+    finalizarPrimitivaMalha(malha);
+
+    // --- 5. Tampas Laterais da Marquise ---
+    // Tampa no ângulo inicial
+    float cos_ini = cosf(rad_inicial); float sin_ini = sinf(rad_inicial);
+    float v1_ini[3] = {cx + rx_frente * cos_ini, cy + ry_frente * sin_ini, z_frente_inf}; // Frente Inf
+    float v2_ini[3] = {cx + rx_base * cos_ini, cy + ry_base * sin_ini, z_base_inf};     // Trás Inf
+    float v3_ini[3] = {cx + rx_base * cos_ini, cy + ry_base * sin_ini, z_base};         // Trás Sup
+    float v4_ini[3] = {cx + rx_frente * cos_ini, cy + ry_frente * sin_ini, z_frente};     // Frente Sup
+    normalMalha(malha, normalQuadrilatero(v1_ini, v2_ini, v3_ini, v4_ini));
+    iniciarPrimitivaMalha(malha, GL_QUADS);
+        coordTexturaMalha(malha, 0.0f, 0.0f); verticeMalhav(malha, v1_ini);
+        coordTexturaMalha(malha, 1.0f, 0.0f); verticeMalhav(malha, v2_ini);
+        coordTexturaMalha(malha, 1.0f, 1.0f); verticeMalhav(malha, v3_ini);
+        coordTexturaMalha(malha, 0.0f, 1.0f); verticeMalhav(malha, v4_ini);
+    finalizarPrimitivaMalha(malha);
+
+    // Tampa no ângulo final
+    float cos_fim = cosf(rad_final); float sin_fim = sinf(rad_final);
+    float v1_fim[3] = {cx + rx_frente * cos_fim, cy + ry_frente * sin_fim, z_frente_inf}; // Frente Inf
+    float v2_fim[3] = {cx + rx_base * cos_fim, cy + ry_base * sin_fim, z_base_inf};     // Trás Inf
+    float v3_fim[3] = {cx + rx_base * cos_fim, cy + ry_base * sin_fim, z_base};         // Trás Sup
+    float v4_fim[3] = {cx + rx_frente * cos_fim, cy + ry_frente * sin_fim, z_frente};     // Frente Sup
+    normalMalha(malha, normalQuadrilatero(v1_fim, v2_fim, v3_fim, v4_fim));
+    iniciarPrimitivaMalha(malha, GL_QUADS);
+        // Ordem dos vértices para o Quad apontar para fora no fim do arco
+        coordTexturaMalha(malha, 0.0f, 0.0f); verticeMalhav(malha, v1_fim); // Frente Inf
+        coordTexturaMalha(malha, 0.0f, 1.0f); verticeMalhav(malha, v4_fim); // Frente Sup
+        coordTexturaMalha(malha, 1.0f, 1.0f); verticeMalhav(malha, v3_fim); // Trás Sup
+        coordTexturaMalha(malha, 1.0f, 0.0f); verticeMalhav(malha, v2_fim); // Trás Inf
+    finalizarPrimitivaMalha(malha);
+}
+
+// Chão e gramado (peças únicas)
+void gerarChao(ConstrutorMalha &malha) {
+    float tamChao = 20.0f;
+    float repTexturaChao = 15.0f;
+    iniciarPrimitivaMalha(malha, GL_QUADS);
+        coordTexturaMalha(malha, 0.0f, 0.0f);                     verticeMalha(malha, -tamChao, -tamChao, Z_CHAO);
+        coordTexturaMalha(malha, repTexturaChao, 0.0f);           verticeMalha(malha,  tamChao, -tamChao, Z_CHAO);
+        coordTexturaMalha(malha, repTexturaChao, repTexturaChao); verticeMalha(malha,  tamChao,  tamChao, Z_CHAO);
+        coordTexturaMalha(malha, 0.0f, repTexturaChao);           verticeMalha(malha, -tamChao,  tamChao, Z_CHAO);
+    finalizarPrimitivaMalha(malha);
+}
+
+void gerarGrama(ConstrutorMalha &malha, int segmentos_curva_grama) {
+    const float repTexturaGrama = 8.0f;
+
+    iniciarPrimitivaMalha(malha, GL_TRIANGLE_FAN);
+        coordTexturaMalha(malha, 0.5f * repTexturaGrama, 0.5f * repTexturaGrama);
+        verticeMalha(malha, estadio.centro_x, estadio.centro_y, Z_GRAMADO);
+
+        for (int i = 0; i <= segmentos_curva_grama; i++) {
+            float fracao = (float)i / (float)segmentos_curva_grama;
+            float angulo_rad = fracao * 2.0f * PI;
+            float cos_a = cosf(angulo_rad);
+            float sin_a = sinf(angulo_rad);
+
+            float vx = estadio.centro_x + RAIO_X_GRAMADO * cos_a;
+            float vy = estadio.centro_y + RAIO_Y_GRAMADO * sin_a;
+
+            float s_tex = (cos_a + 1.0f) * 0.5f * repTexturaGrama;
+            float t_tex = (sin_a + 1.0f) * 0.5f * repTexturaGrama;
+
+            coordTexturaMalha(malha, s_tex, t_tex);
+            verticeMalha(malha, vx, vy, Z_GRAMADO);
+        }
+    finalizarPrimitivaMalha(malha);
+}
+
+// Tampas laterais de todos os arcos principais (pulando 0, 140, 220, 360)
+void gerarTampasLaterais(ConstrutorMalha &malha) {
+    RASTREAR_FUNCAO();
+    const ParametrosEstadio &e = estadio;
+    float altura_interna_tampa = e.altura_arco_conexao; // Altura interna da tampa é sempre a de conexão
+    for (int i = 0; i < NUM_ARCOS_PRINCIPAIS; ++i) {
+        float ang_inicio_arco = ARCOS_PRINCIPAIS[i][0];
+        float ang_fim_arco = ARCOS_PRINCIPAIS[i][1];
+
+        // Verifica se a tampa INICIAL deve ser desenhada
+        bool desenhar_tampa_inicial =
+               fabs(ang_inicio_arco -   0.0f) > FLOAT_COMPARISON_TOLERANCE
+            && fabs(ang_inicio_arco - 140.0f) > FLOAT_COMPARISON_TOLERANCE
+            && fabs(ang_inicio_arco - 220.0f) > FLOAT_COMPARISON_TOLERANCE;
+
+        if (desenhar_tampa_inicial) {
+             // Determina parâmetros do TOPO EXTERNO para a tampa INICIAL
+             float rx_final_topo_ext = e.rx_topo_parede_padrao;      // Default
+             float ry_final_topo_ext = e.ry_topo_parede_padrao;
+             float z_final_topo_ext = e.altura_max_parede_padrao;
+
+             // Se a tampa inicial for em 240 graus, ela encontra a parede superior que termina em 220
+             if (fabs(ang_inicio_arco - 240.0f) < FLOAT_COMPARISON_TOLERANCE) {
+                 rx_final_topo_ext = e.rx_topo_parede_superior; // Usa topo da parede superior
+                 ry_final_topo_ext = e.ry_topo_parede_superior;
+                 z_final_topo_ext = e.z_topo_parede_superior;
+             }
+
+             gerarTampaLateral(malha,
+                e.centro_x, e.centro_y, ang_inicio_arco,
+                e.raio_x_geral_int, e.raio_y_geral_int, Z_BASE_INICIAL,      // Base interna
+                e.raio_x_geral_ext, e.raio_y_geral_ext, Z_BASE_INICIAL,      // Base externa
+                rx_final_topo_ext, ry_final_topo_ext, z_final_topo_ext,     // Topo externo (Calculado)
+                e.raio_x_geral_int, e.raio_y_geral_int, altura_interna_tampa // Topo interno
+             );
+        }
+
+        // Verifica se a tampa FINAL deve ser desenhada
+        bool desenhar_tampa_final =
+               fabs(ang_fim_arco - 360.0f) > FLOAT_COMPARISON_TOLERANCE
+            && fabs(ang_fim_arco - 140.0f) > FLOAT_COMPARISON_TOLERANCE
+            && fabs(ang_fim_arco - 220.0f) > FLOAT_COMPARISON_TOLERANCE;
+
+        if (desenhar_tampa_final) {
+             // Determina parâmetros do TOPO EXTERNO para a tampa FINAL
+             float rx_final_topo_ext = e.rx_topo_parede_padrao;      // Default
+             float ry_final_topo_ext = e.ry_topo_parede_padrao;
+             float z_final_topo_ext = e.altura_max_parede_padrao;
+
+             // Se a tampa final for em 120 graus, ela encontra a parede superior que começa em 140
+             if (fabs(ang_fim_arco - 120.0f) < FLOAT_COMPARISON_TOLERANCE) {
+                 rx_final_topo_ext = e.rx_topo_parede_superior; // Usa topo da parede superior
+                 ry_final_topo_ext = e.ry_topo_parede_superior;
+                 z_final_topo_ext = e.z_topo_parede_superior;
+             }
+
+             gerarTampaLateral(malha,
+                e.centro_x, e.centro_y, ang_fim_arco,
+                e.raio_x_geral_int, e.raio_y_geral_int, Z_BASE_INICIAL,      // Base interna
+                e.raio_x_geral_ext, e.raio_y_geral_ext, Z_BASE_INICIAL,      // Base externa
+                rx_final_topo_ext, ry_final_topo_ext, z_final_topo_ext,     // Topo externo (Calculado)
+                e.raio_x_geral_int, e.raio_y_geral_int, altura_interna_tampa // Topo interno
+             );
+        }
+    }
+}
+
+// Uma unidade de trabalho da geração: um setor de arco ou uma peça única
+enum TipoPecaMalha { PECA_CHAO, PECA_GRAMA, PECA_DEGRAUS, PECA_PAREDE, PECA_MARQUISE, PECA_TAMPAS };
+
+struct PecaMalha {
+    TipoPecaMalha tipo;
+    PassoRender passo;
+    float cor[3];                       // Cor inicial dos vértices
+    float ang_inicio, ang_fim;          // Setor (graus)
+    float s_inicio, s_fim;              // Coordenada de textura ao longo do setor
+    int segmentos;
+    int arco;                           // PECA_DEGRAUS: índice em ARCOS_PRINCIPAIS
+    float rx_base, ry_base, rx_topo, ry_topo, z_baixo, z_alto; // PECA_PAREDE
+    bool projetaSombra;                 // Entra nos mapas de sombra (marquise e parede superior)
+};
+
+// Objetos de um lote: intervalo de vértices + caixa para o descarte
+struct ObjetoMalha {
+    int primeiro, quantidade;
+    CaixaLimites caixa;
+    bool projetaSombra;
+};
+
+struct LoteMalha {
+    const GLuint *textura;
+    std::vector<VerticeMalha> vertices;
+    std::vector<unsigned char> cantos;  // Canto de cada vértice no seu quadrilátero
+    std::vector<float> coordsLuz;       // Coordenadas no atlas do mapa de luz (2 por vértice)
+    std::vector<ObjetoMalha> objetos;
+    std::vector<unsigned char> visivel;
+};
+
+LoteMalha lotesMalha[NUM_PASSOS_RENDER];
+
+PecaMalha novaPecaMalha(TipoPecaMalha tipo, PassoRender passo, float r, float g, float b) {
+    PecaMalha peca;
+    memset(&peca, 0, sizeof(peca));
+    peca.tipo = tipo;
+    peca.passo = passo;
+    peca.cor[0] = r; peca.cor[1] = g; peca.cor[2] = b;
+    return peca;
+}
+
+// Corta [ang_inicio, ang_fim] em setores, repartindo os segmentos e a coordenada s
+// (que vai de 0 a 'repeticao_s' no arco inteiro, como no desenho original)
+void adicionarSetoresArco(std::vector<PecaMalha> &pecas, const PecaMalha &base,
+                          float ang_inicio, float ang_fim, int segmentos_arco,
+                          float repeticao_s, int fatorDetalhe) {
+    float intervalo = ang_fim - ang_inicio;
+    int num_setores = (int)ceilf(intervalo / GRAUS_POR_SETOR_MALHA - 1e-4f);
+    if (num_setores < 1) num_setores = 1;
+    for (int i = 0; i < num_setores; i++) {
+        PecaMalha peca = base;
+        float f0 = (float)i / num_setores;
+        float f1 = (float)(i + 1) / num_setores;
+        peca.ang_inicio = ang_inicio + intervalo * f0;
+        peca.ang_fim = ang_inicio + intervalo * f1;
+        peca.s_inicio = repeticao_s * f0;
+        peca.s_fim = repeticao_s * f1;
+        peca.segmentos = (int)ceilf((float)segmentos_arco * fatorDetalhe / num_setores);
+        pecas.push_back(peca);
+    }
+}
+
+void listarPecasMalha(std::vector<PecaMalha> &pecas, int fatorDetalhe) {
+    const ParametrosEstadio &e = estadio;
+    pecas.push_back(novaPecaMalha(PECA_CHAO, PASSO_CHAO, 0.8f, 0.8f, 0.8f));
+    PecaMalha grama = novaPecaMalha(PECA_GRAMA, PASSO_GRAMA, 1.0f, 1.0f, 1.0f);
+    grama.segmentos = 60 * fatorDetalhe;
+    pecas.push_back(grama);
+
+    for (int i = 0; i < NUM_ARCOS_PRINCIPAIS; ++i) {
+        PecaMalha degraus = novaPecaMalha(PECA_DEGRAUS, PASSO_ARQUIBANCADA, 1.0f, 1.0f, 1.0f);
+        degraus.arco = i;
+        adicionarSetoresArco(pecas, degraus, ARCOS_PRINCIPAIS[i][0], ARCOS_PRINCIPAIS[i][1],
+                             SEGMENTOS_CURVA_DEGRAU, 5.0f, fatorDetalhe);
+    }
+
+    // Paredes principais (até a altura padrão) e de conexão
+    PecaMalha parede = novaPecaMalha(PECA_PAREDE, PASSO_PAREDES, 0.9f, 0.9f, 0.9f);
+    parede.rx_base = e.raio_x_geral_ext;      parede.ry_base = e.raio_y_geral_ext;
+    parede.rx_topo = e.rx_topo_parede_padrao; parede.ry_topo = e.ry_topo_parede_padrao;
+    parede.z_baixo = Z_BASE_INICIAL;
+    parede.z_alto = e.altura_max_parede_padrao;
+    for (int i = 0; i < NUM_ARCOS_PRINCIPAIS; ++i) {
+        adicionarSetoresArco(pecas, parede, ARCOS_PRINCIPAIS[i][0], ARCOS_PRINCIPAIS[i][1],
+                             SEGMENTOS_CURVA_PAREDE, 10.0f, fatorDetalhe);
+    }
+    parede.z_alto = e.altura_arco_conexao;
+    for (int i = 0; i < NUM_ARCOS_CONEXAO; ++i) {
+        adicionarSetoresArco(pecas, parede, ARCOS_CONEXAO[i][0], ARCOS_CONEXAO[i][1],
+                             SEGMENTOS_CURVA_PAREDE, 10.0f, fatorDetalhe);
+    }
+
+    // Parede superior adicional (140-220), acima da parede padrão
+    parede.rx_base = e.rx_base_parede_superior; parede.ry_base = e.ry_base_parede_superior;
+    parede.rx_topo = e.rx_topo_parede_superior; parede.ry_topo = e.ry_topo_parede_superior;
+    parede.z_baixo = e.z_base_parede_superior;
+    parede.z_alto = e.z_topo_parede_superior;
+    parede.projetaSombra = true;
+    adicionarSetoresArco(pecas, parede, 140.0f, 220.0f, SEGMENTOS_CURVA_PAREDE, 10.0f, fatorDetalhe);
+
+    PecaMalha marquise = novaPecaMalha(PECA_MARQUISE, PASSO_MARQUISE, 0.7f, 0.7f, 0.75f);
+    marquise.ang_inicio = anguloInicialMarquiseMalha;
+    marquise.ang_fim = MARQUISE_ANGULO_FINAL;
+    // Segmentos de tamanho fixo: ao mudar o vão, o trecho que fica não muda
+    marquise.segmentos = (int)lroundf((marquise.ang_fim - marquise.ang_inicio) / GRAUS_POR_SEGMENTO_MARQUISE)
+                       * fatorDetalhe;
+    marquise.projetaSombra = true;
+    pecas.push_back(marquise);
+
+    pecas.push_back(novaPecaMalha(PECA_TAMPAS, PASSO_TAMPAS, 0.9f, 0.9f, 0.9f));
+}
+
+void gerarPecaMalha(const PecaMalha &peca, ConstrutorMalha &malha) {
+    const ParametrosEstadio &e = estadio;
+    reiniciarConstrutorMalha(malha);
+    corMalha(malha, peca.cor[0], peca.cor[1], peca.cor[2]);
+    switch (peca.tipo) {
+        case PECA_CHAO:
+            gerarChao(malha);
+            break;
+        case PECA_GRAMA:
+            gerarGrama(malha, peca.segmentos);
+            break;
+        case PECA_DEGRAUS:
+            for (int k = 0; k < numDegrausArco(peca.arco); ++k) {
+                GeometriaDegrau d = geometriaDegrau(peca.arco, k);
+                gerarDegrauArquibancada(malha, e.centro_x, e.centro_y,
+                                        d.rx_int, d.ry_int, d.rx_ext, d.ry_ext,
+                                        d.z_base, d.z_topo,
+                                        peca.ang_inicio, peca.ang_fim,
+                                        peca.segmentos, peca.s_inicio, peca.s_fim);
+            }
+            break;
+        case PECA_PAREDE:
+            gerarParedeExterna(malha, e.centro_x, e.centro_y,
+                               peca.rx_base, peca.ry_base, peca.rx_topo, peca.ry_topo,
+                               peca.z_baixo, peca.z_alto,
+                               peca.ang_inicio, peca.ang_fim,
+                               peca.segmentos, peca.s_inicio, peca.s_fim);
+            break;
+        case PECA_MARQUISE:
+            gerarMarquiseCobertura(malha, e.centro_x, e.centro_y,
+                                   e.rx_base_marquise, e.ry_base_marquise, e.z_base_marquise,
+                                   e.rx_frente_marquise, e.ry_frente_marquise, e.z_frente_marquise,
+                                   MARQUISE_ESPESSURA,
+                                   peca.ang_inicio, peca.ang_fim,
+                                   peca.segmentos);
+            break;
+        case PECA_TAMPAS:
+            gerarTampasLaterais(malha);
+            break;
+    }
+}
+
+// Mapa de luz (segunda coordenada de textura): cada quadrilátero dos lotes
+// iluminados ganha uma célula de N x N texels num atlas por lote. Os cantos
+// do quadrilátero caem nos centros dos texels dos cantos da célula, de modo
+// que o filtro bilinear nunca lê a célula vizinha e dois quadriláteros com
+// uma aresta em comum têm os mesmos valores nela. N diminui com o detalhe da
+// malha para o atlas caber em LARGURA_ATLAS_LUZ² texels por face; a metade
+// de baixo do atlas guarda a face da frente (anti-horária) e a de cima o verso.
+const int LARGURA_ATLAS_LUZ = 1024;
+const int TEXELS_QUAD_LUZ_MINIMO = 2;
+const int TEXELS_QUAD_LUZ_MAXIMO = 8;
+const PassoRender PASSOS_MAPA_LUZ[] = {PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS};
+const int NUM_LOTES_MAPA_LUZ = sizeof(PASSOS_MAPA_LUZ) / sizeof(PASSOS_MAPA_LUZ[0]);
+
+struct AtlasLuz {
+    int numQuads, texelsQuad, colunas;
+    int largura, altura;                // 'altura' inclui as duas faces
+};
+
+AtlasLuz dimensionarAtlasLuz(int numQuads) {
+    AtlasLuz atlas;
+    atlas.numQuads = numQuads;
+    int n = numQuads > 0 ? (int)sqrtf((float)LARGURA_ATLAS_LUZ * LARGURA_ATLAS_LUZ / numQuads) : TEXELS_QUAD_LUZ_MAXIMO;
+    atlas.texelsQuad = std::max(TEXELS_QUAD_LUZ_MINIMO, std::min(n, TEXELS_QUAD_LUZ_MAXIMO));
+    atlas.colunas = LARGURA_ATLAS_LUZ / atlas.texelsQuad;
+    atlas.largura = LARGURA_ATLAS_LUZ;
+    int linhas = (numQuads + atlas.colunas - 1) / atlas.colunas;
+    int alturaFace = 1;
+    while (alturaFace < linhas * atlas.texelsQuad) alturaFace *= 2;  // Potência de 2 para o GL 1.x
+    atlas.altura = 2 * alturaFace;
+    return atlas;
+}
+
+// Lotes que não são só de quadriláteros (pares de triângulos) ficam sem coordenadas
+void gerarCoordenadasLuz(LoteMalha &lote) {
+    lote.coordsLuz.clear();
+    if (lote.vertices.empty() || lote.vertices.size() % 6 != 0) return;
+    AtlasLuz atlas = dimensionarAtlasLuz((int)lote.vertices.size() / 6);
+    int n = atlas.texelsQuad;
+    lote.coordsLuz.resize(lote.vertices.size() * 2);
+    for (size_t i = 0; i < lote.vertices.size(); i++) {
+        int q = (int)(i / 6);
+        int a = lote.cantos[i] & 1, b = lote.cantos[i] >> 1;
+        lote.coordsLuz[i * 2] = ((q % atlas.colunas) * n + 0.5f + a * (n - 1)) / atlas.largura;
+        lote.coordsLuz[i * 2 + 1] = ((q / atlas.colunas) * n + 0.5f + b * (n - 1)) / atlas.altura;
+    }
+}
+
+// Mapa de luz carregado (--mapa-luz), válido só para a malha em que foi calculado
+struct MapaLuz {
+    float anguloMarquise;
+    int numQuads[NUM_LOTES_MAPA_LUZ];
+    GLuint texturas[NUM_LOTES_MAPA_LUZ];    // 0: lote sem mapa
+};
+
+MapaLuz mapaLuz = MapaLuz();
+const char *arquivoMapaLuz = NULL;
+PFNGLACTIVETEXTUREPROC pglActiveTexture = NULL;
+PFNGLCLIENTACTIVETEXTUREARBPROC pglClientActiveTexture = NULL; // Mesma assinatura do núcleo 1.3
+
+GLuint texturaLuzDoLote(const LoteMalha &lote) {
+    if (!mapaLuzLigado.load() || mapaLuz.anguloMarquise != anguloInicialMarquiseMalha) return 0;
+    for (int i = 0; i < NUM_LOTES_MAPA_LUZ; i++) {
+        if (&lotesMalha[PASSOS_MAPA_LUZ[i]] != &lote) continue;
+        bool mesmaMalha = !lote.coordsLuz.empty() && mapaLuz.numQuads[i] == (int)lote.vertices.size() / 6;
+        return mesmaMalha ? mapaLuz.texturas[i] : 0;
+    }
+    return 0;
+}
+
+// Gera todas as peças em paralelo e junta cada uma no lote do seu passo
+void construirMalhaEstadio(int fatorDetalhe) {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    anguloInicialMarquiseMalha = anguloInicialMarquisePedido.load();
+    versaoMalhaEstadio++;
+
+    std::vector<PecaMalha> pecas;
+    listarPecasMalha(pecas, fatorDetalhe);
+    int numPecas = (int)pecas.size();
+    std::vector<ConstrutorMalha> construtores(numPecas);
+    executarEmParalelo(0, numPecas, 1, [&](int i) {
+        gerarPecaMalha(pecas[i], construtores[i]);
+    });
+
+    // Posição de cada peça no seu lote (serial, só somas)
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        lotesMalha[p].vertices.clear();
+        lotesMalha[p].cantos.clear();
+        lotesMalha[p].objetos.clear();
+    }
+    std::vector<int> destino(numPecas);
+    size_t totalVertices = 0;
+    for (int i = 0; i < numPecas; i++) {
+        LoteMalha &lote = lotesMalha[pecas[i].passo];
+        ObjetoMalha objeto;
+        objeto.primeiro = (int)lote.vertices.size();
+        objeto.quantidade = (int)construtores[i].vertices.size();
+        objeto.caixa = construtores[i].caixa;
+        objeto.projetaSombra = pecas[i].projetaSombra;
+        destino[i] = objeto.primeiro;
+        lote.objetos.push_back(objeto);
+        lote.vertices.resize(lote.vertices.size() + objeto.quantidade);
+        lote.cantos.resize(lote.vertices.size());
+        totalVertices += objeto.quantidade;
+    }
+    executarEmParalelo(0, numPecas, 1, [&](int i) {
+        const std::vector<VerticeMalha> &origem = construtores[i].vertices;
+        if (!origem.empty()) {
+            memcpy(&lotesMalha[pecas[i].passo].vertices[destino[i]], &origem[0],
+                   origem.size() * sizeof(VerticeMalha));
+            memcpy(&lotesMalha[pecas[i].passo].cantos[destino[i]], &construtores[i].cantos[0], origem.size());
+        }
+    });
+    for (int i = 0; i < NUM_LOTES_MAPA_LUZ; i++) gerarCoordenadasLuz(lotesMalha[PASSOS_MAPA_LUZ[i]]);
+
+    lotesMalha[PASSO_CHAO].textura = &idTexturaTerra;
+    lotesMalha[PASSO_GRAMA].textura = &idTexturaGrama;
+    lotesMalha[PASSO_ARQUIBANCADA].textura = &idTexturaConcreto;
+    lotesMalha[PASSO_PAREDES].textura = &idTexturaConcretoExterno;
+    lotesMalha[PASSO_MARQUISE].textura = &idTexturaConcretoExterno;
+    lotesMalha[PASSO_TAMPAS].textura = &idTexturaConcretoExterno;
+
+    printf("Malha do estádio (detalhe %d): %d peças, %lu vértices em %.2f ms (%d threads)\n",
+           fatorDetalhe, numPecas, (unsigned long)totalVertices,
+           tempoAtualMs() - inicio, numTrabalhadores + 1);
+}
+
+// Planos do frustum (ax + by + cz + d >= 0 dentro) extraídos de projeção * modelview
+void extrairPlanosFrustum(float planos[6][4]) {
+    float p[16], m[16], c[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, p);
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    for (int col = 0; col < 4; col++) {
+        for (int lin = 0; lin < 4; lin++) {
+            c[col * 4 + lin] = p[0 * 4 + lin] * m[col * 4 + 0] + p[1 * 4 + lin] * m[col * 4 + 1]
+                             + p[2 * 4 + lin] * m[col * 4 + 2] + p[3 * 4 + lin] * m[col * 4 + 3];
+        }
+    }
+    // Linha 3 +/- linhas 0 (esq./dir.), 1 (baixo/cima) e 2 (perto/longe)
+    for (int i = 0; i < 6; i++) {
+        int linha = i / 2;
+        float sinal = (i % 2 == 0) ? 1.0f : -1.0f;
+        for (int k = 0; k < 4; k++) {
+            planos[i][k] = c[k * 4 + 3] + sinal * c[k * 4 + linha];
+        }
+    }
+}
+
+// Falso só se a caixa estiver inteira atrás de algum plano
+bool caixaNoFrustum(const CaixaLimites &caixa, const float planos[6][4]) {
+    for (int i = 0; i < 6; i++) {
+        const float *pl = planos[i];
+        float x = pl[0] >= 0.0f ? caixa.maximo.x : caixa.minimo.x;
+        float y = pl[1] >= 0.0f ? caixa.maximo.y : caixa.minimo.y;
+        float z = pl[2] >= 0.0f ? caixa.maximo.z : caixa.minimo.z;
+        if (pl[0] * x + pl[1] * y + pl[2] * z + pl[3] < 0.0f) return false;
+    }
+    return true;
+}
+
+// Unidade de textura 1: mapa de luz modulando a cor já texturizada
+void ativarMapaLuz(const LoteMalha &lote, GLuint textura) {
+    pglActiveTexture(GL_TEXTURE1);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textura);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    pglClientActiveTexture(GL_TEXTURE1);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, &lote.coordsLuz[0]);
+    pglClientActiveTexture(GL_TEXTURE0);
+    pglActiveTexture(GL_TEXTURE0);
+    alterarEstadoGL(GL_CULL_FACE, true);
+}
+
+// Face 0: frente, metade de baixo do atlas; face 1: verso, metade de cima
+void selecionarFaceMapaLuz(int face) {
+    glCullFace(face == 0 ? GL_BACK : GL_FRONT);
+    pglActiveTexture(GL_TEXTURE1);
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    if (face == 1) glTranslatef(0.0f, 0.5f, 0.0f);
+    glMatrixMode(GL_MODELVIEW);
+    pglActiveTexture(GL_TEXTURE0);
+}
+
+void desativarMapaLuz() {
+    pglActiveTexture(GL_TEXTURE1);
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glDisable(GL_TEXTURE_2D);
+    pglClientActiveTexture(GL_TEXTURE1);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    pglClientActiveTexture(GL_TEXTURE0);
+    pglActiveTexture(GL_TEXTURE0);
+    alterarEstadoGL(GL_CULL_FACE, false);
+}
+
+// Sem formato de glInterleavedArrays com cor de 3 floats e normal, os
+// ponteiros são dados um a um sobre o mesmo arranjo
+void apontarVerticesMalha(const VerticeMalha *v) {
+    GLsizei passo = sizeof(VerticeMalha);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, passo, &v->s);
+    glColorPointer(3, GL_FLOAT, passo, &v->r);
+    glNormalPointer(GL_FLOAT, passo, &v->nx);
+    glVertexPointer(3, GL_FLOAT, passo, &v->x);
+}
+
+// Testa os objetos do lote contra o frustum. Um lote tem no máximo algumas
+// dezenas de objetos (um microssegundo de testes), menos que o custo de
+// distribuir tarefas, então o teste fica na thread de renderização
+void testarVisibilidadeLote(LoteMalha &lote, const float planos[6][4]) {
+    int numObjetos = (int)lote.objetos.size();
+    lote.visivel.resize(numObjetos);
+    for (int i = 0; i < numObjetos; i++) {
+        lote.visivel[i] = caixaNoFrustum(lote.objetos[i].caixa, planos) ? 1 : 0;
+    }
+}
+
+// Próximo trecho de objetos visíveis vizinhos a partir do objeto 'i' (que
+// avança); falso no fim do lote
+bool proximoTrechoVisivel(const LoteMalha &lote, int &i, int &primeiro, int &quantidade, bool contarDescartados) {
+    int numObjetos = (int)lote.objetos.size();
+    while (i < numObjetos && !lote.visivel[i]) {
+        if (contarDescartados) estatisticasQuadro.objetosDescartados++;
+        i++;
+    }
+    if (i == numObjetos) return false;
+    primeiro = lote.objetos[i].primeiro;
+    quantidade = 0;
+    while (i < numObjetos && lote.visivel[i]) {
+        quantidade += lote.objetos[i].quantidade;
+        i++;
+    }
+    return true;
+}
+
+// Testa os objetos do lote e desenha os visíveis, juntando
+// objetos vizinhos visíveis numa só chamada
+void desenharLoteMalha(LoteMalha &lote, const float planos[6][4]) {
+    if (lote.objetos.empty()) return;
+    testarVisibilidadeLote(lote, planos);
+
+    vincularTextura(*lote.textura);
+    apontarVerticesMalha(&lote.vertices[0]);
+    GLuint texturaLuz = texturaLuzDoLote(lote);
+    if (texturaLuz) ativarMapaLuz(lote, texturaLuz);
+    // Com mapa de luz: frente e verso em duas passadas, cada uma com a sua metade do atlas
+    for (int face = 0; face < (texturaLuz ? 2 : 1); face++) {
+        if (texturaLuz) selecionarFaceMapaLuz(face);
+        int i = 0, primeiro, quantidade;
+        while (proximoTrechoVisivel(lote, i, primeiro, quantidade, face == 0)) {
+            desenharArrays(GL_TRIANGLES, primeiro, quantidade);
+            estatisticasQuadro.bytesEnviados += (unsigned long)quantidade * sizeof(VerticeMalha);
+        }
+    }
+    if (texturaLuz) desativarMapaLuz();
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+// Posição do olho em coordenadas do estádio (inversa de uma modelview rígida)
+Vetor3 posicaoOlhoMatriz(const float m[16]) {
+    float tx = m[12], ty = m[13], tz = m[14];
+    return vetor3(-(m[0] * tx + m[1] * ty + m[2] * tz),
+                  -(m[4] * tx + m[5] * ty + m[6] * tz),
+                  -(m[8] * tx + m[9] * ty + m[10] * tz));
+}
+
+Vetor3 posicaoOlhoModelview() {
+    float m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    return posicaoOlhoMatriz(m);
+}
+
+// --- Assentos (instâncias com nível de detalhe) ---
+// Cada assento é uma instância (posição, direção, cor) num buffer SoA; os
+// assentos de um setor de 10° de um arco formam um bloco, com caixa de limites
+// própria. Sem atributos por instância no pipeline fixo, cada bloco guarda a
+// geometria expandida dos seus assentos nos três níveis de detalhe, gerada em
+// paralelo a partir das instâncias; o nível é escolhido a cada quadro pelo
+// tamanho do assento na tela:
+//   0: assento e encosto com frente e verso (perto)
+//   1: só o tampo e a frente do encosto
+//   2: uma faixa por fileira (impostor), com a cor amostrada a cada poucos assentos
+// O espaçamento dá uma capacidade da ordem da do estádio real (cerca de 40 mil).
+const float PASSO_ASSENTO = 0.0014f;            // Distância entre assentos ao longo da fileira
+const float LARGURA_ASSENTO = PASSO_ASSENTO * 0.8f;
+const float PROFUNDIDADE_ASSENTO = 0.006f;
+const float ALTURA_ASSENTO = 0.004f;
+const float ALTURA_ENCOSTO = 0.009f;
+const float FRACAO_RADIAL_ASSENTO = 0.6f;       // Posição no degrau (0 = borda interna, 1 = externa)
+const float PASSO_ANGULAR_FILEIRA_GRAUS = 0.01f; // Integração do comprimento de arco
+const int ASSENTOS_POR_TRECHO_IMPOSTOR = 8;
+const float PIXELS_LOD_0 = 6.0f;                // Largura mínima na tela para cada nível
+const float PIXELS_LOD_1 = 1.5f;
+const int NUM_LODS_ASSENTO = 3;
+
+struct InstanciasAssentos {
+    std::vector<float> x, y, z;         // Centro do tampo, sobre o degrau
+    std::vector<float> direcao;         // Para onde o assento olha (rad), no plano XY
+    std::vector<unsigned char> arco, fileira;
+    std::vector<unsigned int> cor;      // RGBA8, na ordem de GL_C4UB
+};
+
+struct VerticeAssento {                 // Layout de GL_C4UB_V3F
+    unsigned char r, g, b, a;
+    float x, y, z;
+};
+
+struct BlocoAssentos {
+    int arco;
+    float ang_inicio, ang_fim;
+    int primeiro, quantidade;           // Intervalo em 'instanciasAssentos'
+    CaixaLimites caixa;
+    std::vector<VerticeAssento> lod[NUM_LODS_ASSENTO];
+};
+
+InstanciasAssentos instanciasAssentos;
+std::vector<BlocoAssentos> blocosAssentos;
+int versaoAssentos = 0;                 // Incrementada a cada expansão dos blocos
+
+unsigned int empacotarCor(unsigned char r, unsigned char g, unsigned char b) {
+    unsigned char c[4] = {r, g, b, 255};
+    unsigned int cor;
+    memcpy(&cor, c, sizeof(cor));
+    return cor;
+}
+
+// Mistura de bits (pseudoaleatório determinístico por índice)
+unsigned int hashInteiro(unsigned int x) {
+    x ^= x >> 16; x *= 0x7feb352dU;
+    x ^= x >> 15; x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+float hashUnitario(unsigned int x) {
+    return (hashInteiro(x) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Comprimento de arco da elipse por radiano no parâmetro 'angulo'
+float velocidadeArcoElipse(float rx, float ry, float angulo) {
+    float dx = rx * sinf(angulo);
+    float dy = ry * cosf(angulo);
+    return sqrtf(dx * dx + dy * dy);
+}
+
+// Assentos de um bloco: percorre cada fileira desde o início do arco (o
+// espaçamento é contínuo entre blocos) e guarda os que caem no setor
+void gerarAssentosBloco(const BlocoAssentos &bloco, InstanciasAssentos &saida) {
+    float ang_arco = ARCOS_PRINCIPAIS[bloco.arco][0];
+    float passo_rad = GRAUS_PARA_RAD(PASSO_ANGULAR_FILEIRA_GRAUS);
+    float rad_inicio = GRAUS_PARA_RAD(bloco.ang_inicio);
+    float rad_fim = GRAUS_PARA_RAD(bloco.ang_fim);
+    for (int k = 0; k < numDegrausArco(bloco.arco); k++) {
+        GeometriaDegrau d = geometriaDegrau(bloco.arco, k);
+        float rx = d.rx_int + (d.rx_ext - d.rx_int) * FRACAO_RADIAL_ASSENTO;
+        float ry = d.ry_int + (d.ry_ext - d.ry_int) * FRACAO_RADIAL_ASSENTO;
+
+        float angulo = GRAUS_PARA_RAD(ang_arco);
+        float comprimento = 0.0f;
+        float proximo = PASSO_ASSENTO * 0.5f;
+        while (angulo < rad_fim) {
+            float trecho = velocidadeArcoElipse(rx, ry, angulo + passo_rad * 0.5f) * passo_rad;
+            while (comprimento + trecho >= proximo) {
+                float a = angulo + passo_rad * (proximo - comprimento) / trecho;
+                proximo += PASSO_ASSENTO;
+                // Meio assento de folga nas pontas do arco
+                if (a < rad_inicio || a >= rad_fim || a > GRAUS_PARA_RAD(ARCOS_PRINCIPAIS[bloco.arco][1])
+                    - PASSO_ASSENTO * 0.5f / velocidadeArcoElipse(rx, ry, a)) continue;
+                float cos_a = cosf(a), sin_a = sinf(a);
+                saida.x.push_back(estadio.centro_x + rx * cos_a);
+                saida.y.push_back(estadio.centro_y + ry * sin_a);
+                saida.z.push_back(d.z_topo);
+                // Normal da elipse para dentro (de frente para o campo)
+                saida.direcao.push_back(atan2f(-rx * sin_a, -ry * cos_a));
+                saida.arco.push_back((unsigned char)bloco.arco);
+                saida.fileira.push_back((unsigned char)k);
+                saida.cor.push_back(0);
+            }
+            comprimento += trecho;
+            angulo += passo_rad;
+        }
+    }
+}
+
+// Cor de uma instância no layout dado
+unsigned int corAssento(int layout, int arco, int fileira, float x, float y) {
+    static const unsigned char CORES_ARCOS[NUM_ARCOS_PRINCIPAIS][3] = {
+        {30, 90, 200}, {220, 200, 40}, {200, 40, 40}, {220, 200, 40}, {30, 90, 200}
+    };
+    if (layout == LAYOUT_SETORES) {
+        return empacotarCor(CORES_ARCOS[arco][0], CORES_ARCOS[arco][1], CORES_ARCOS[arco][2]);
+    }
+    float graus = atan2f(y - estadio.centro_y, x - estadio.centro_x) * 180.0f / PI;
+    if (graus < 0.0f) graus += 360.0f;
+    if (fileira == 0) return empacotarCor(40, 110, 230);                          // Acessibilidade
+    if (fabs(ARCOS_PRINCIPAIS[arco][0] - 220.0f) < FLOAT_COMPARISON_TOLERANCE)
+        return empacotarCor(230, 60, 50);                                         // Visitantes (220-240)
+    if (arcoSecaoEspecial(arco) && graus >= 170.0f && graus <= 190.0f
+        && fileira >= numDegrausArco(arco) - 4) return empacotarCor(240, 200, 40); // Imprensa
+    return empacotarCor(150, 150, 150);
+}
+
+void colorirAssentos(int layout) {
+    InstanciasAssentos &inst = instanciasAssentos;
+    executarEmParalelo(0, (int)inst.cor.size(), 4096, [&](int i) {
+        inst.cor[i] = corAssento(layout, inst.arco[i], inst.fileira[i], inst.x[i], inst.y[i]);
+    });
+}
+
+void adicionarQuadAssento(std::vector<VerticeAssento> &saida, unsigned int cor, float sombra,
+                          const Vetor3 &a, const Vetor3 &b, const Vetor3 &c, const Vetor3 &d) {
+    unsigned char rgba[4];
+    memcpy(rgba, &cor, sizeof(rgba));
+    VerticeAssento v;
+    v.r = (unsigned char)(rgba[0] * sombra);
+    v.g = (unsigned char)(rgba[1] * sombra);
+    v.b = (unsigned char)(rgba[2] * sombra);
+    v.a = 255;
+    const Vetor3 *cantos[6] = {&a, &b, &c, &a, &c, &d};
+    for (int i = 0; i < 6; i++) {
+        v.x = cantos[i]->x; v.y = cantos[i]->y; v.z = cantos[i]->z;
+        saida.push_back(v);
+    }
+}
+
+// Expande as instâncias do bloco nos três níveis de detalhe
+void expandirBlocoAssentos(BlocoAssentos &bloco) {
+    const InstanciasAssentos &inst = instanciasAssentos;
+    for (int l = 0; l < NUM_LODS_ASSENTO; l++) bloco.lod[l].clear();
+    bloco.caixa.minimo = vetor3(1e30f, 1e30f, 1e30f);
+    bloco.caixa.maximo = vetor3(-1e30f, -1e30f, -1e30f);
+
+    int inicioFileira = bloco.primeiro;
+    for (int i = bloco.primeiro; i < bloco.primeiro + bloco.quantidade; i++) {
+        Vetor3 centro = vetor3(inst.x[i], inst.y[i], inst.z[i]);
+        Vetor3 frente = vetor3(cosf(inst.direcao[i]), sinf(inst.direcao[i]), 0.0f);
+        Vetor3 lado = vetor3(-frente.y, frente.x, 0.0f) * (LARGURA_ASSENTO * 0.5f);
+        Vetor3 cima = vetor3(0.0f, 0.0f, 1.0f);
+        Vetor3 f = centro + frente * (PROFUNDIDADE_ASSENTO * 0.5f);
+        Vetor3 t = centro - frente * (PROFUNDIDADE_ASSENTO * 0.5f);
+        Vetor3 hA = cima * ALTURA_ASSENTO, hE = cima * ALTURA_ENCOSTO;
+        unsigned int cor = inst.cor[i];
+
+        // Tampo e frente do encosto (níveis 0 e 1), frente do tampo e verso do encosto (só 0)
+        for (int l = 0; l < 2; l++) {
+            adicionarQuadAssento(bloco.lod[l], cor, 1.0f, t - lado + hA, f - lado + hA, f + lado + hA, t + lado + hA);
+            adicionarQuadAssento(bloco.lod[l], cor, 0.85f, t - lado + hA, t + lado + hA, t + lado + hE, t - lado + hE);
+        }
+        adicionarQuadAssento(bloco.lod[0], cor, 0.7f, f - lado, f + lado, f + lado + hA, f - lado + hA);
+        adicionarQuadAssento(bloco.lod[0], cor, 0.55f, t + lado, t - lado, t - lado + hE, t + lado + hE);
+
+        incluirNaCaixa(bloco.caixa, f - lado);
+        incluirNaCaixa(bloco.caixa, f + lado);
+        incluirNaCaixa(bloco.caixa, t - lado);
+        incluirNaCaixa(bloco.caixa, t + lado + hE);
+
+        // Impostor (nível 2): ao fim de cada fileira, uma faixa pelos encostos,
+        // com um trecho a cada ASSENTOS_POR_TRECHO_IMPOSTOR assentos
+        bool fimFileira = (i + 1 == bloco.primeiro + bloco.quantidade) || inst.fileira[i + 1] != inst.fileira[i];
+        if (!fimFileira) continue;
+        if (i == inicioFileira) {
+            adicionarQuadAssento(bloco.lod[2], cor, 0.85f, t - lado, t + lado, t + lado + hE, t - lado + hE);
+        }
+        for (int j = inicioFileira; j < i; j += ASSENTOS_POR_TRECHO_IMPOSTOR) {
+            int fim = j + ASSENTOS_POR_TRECHO_IMPOSTOR < i ? j + ASSENTOS_POR_TRECHO_IMPOSTOR : i;
+            Vetor3 a = vetor3(inst.x[j], inst.y[j], inst.z[j])
+                     - vetor3(cosf(inst.direcao[j]), sinf(inst.direcao[j]), 0.0f) * (PROFUNDIDADE_ASSENTO * 0.5f);
+            Vetor3 b = vetor3(inst.x[fim], inst.y[fim], inst.z[fim])
+                     - vetor3(cosf(inst.direcao[fim]), sinf(inst.direcao[fim]), 0.0f) * (PROFUNDIDADE_ASSENTO * 0.5f);
+            adicionarQuadAssento(bloco.lod[2], inst.cor[j], 0.85f, a, b, b + hE, a + hE);
+        }
+        inicioFileira = i + 1;
+    }
+}
+
+void expandirAssentos() {
+    executarEmParalelo(0, (int)blocosAssentos.size(), 1, [](int b) {
+        expandirBlocoAssentos(blocosAssentos[b]);
+    });
+    versaoAssentos++;
+}
+
+// Gera as instâncias (em paralelo por bloco), junta no buffer SoA, colore e expande
+void construirAssentos(int layout) {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+
+    blocosAssentos.clear();
+    for (int a = 0; a < NUM_ARCOS_PRINCIPAIS; a++) {
+        float ang_inicio = ARCOS_PRINCIPAIS[a][0], ang_fim = ARCOS_PRINCIPAIS[a][1];
+        int num_setores = (int)ceilf((ang_fim - ang_inicio) / GRAUS_POR_SETOR_MALHA - 1e-4f);
+        for (int s = 0; s < num_setores; s++) {
+            BlocoAssentos bloco;
+            bloco.arco = a;
+            bloco.ang_inicio = ang_inicio + (ang_fim - ang_inicio) * s / num_setores;
+            bloco.ang_fim = ang_inicio + (ang_fim - ang_inicio) * (s + 1) / num_setores;
+            bloco.primeiro = bloco.quantidade = 0;
+            bloco.caixa.minimo = bloco.caixa.maximo = vetor3(0.0f, 0.0f, 0.0f);
+            blocosAssentos.push_back(bloco);
+        }
+    }
+
+    int numBlocos = (int)blocosAssentos.size();
+    std::vector<InstanciasAssentos> locais(numBlocos);
+    executarEmParalelo(0, numBlocos, 1, [&](int b) {
+        gerarAssentosBloco(blocosAssentos[b], locais[b]);
+    });
+
+    int total = 0;
+    for (int b = 0; b < numBlocos; b++) {
+        blocosAssentos[b].primeiro = total;
+        blocosAssentos[b].quantidade = (int)locais[b].x.size();
+        total += blocosAssentos[b].quantidade;
+    }
+    InstanciasAssentos &inst = instanciasAssentos;
+    inst.x.resize(total); inst.y.resize(total); inst.z.resize(total);
+    inst.direcao.resize(total); inst.arco.resize(total); inst.fileira.resize(total);
+    inst.cor.resize(total);
+    executarEmParalelo(0, numBlocos, 1, [&](int b) {
+        const InstanciasAssentos &l = locais[b];
+        int p = blocosAssentos[b].primeiro;
+        std::copy(l.x.begin(), l.x.end(), inst.x.begin() + p);
+        std::copy(l.y.begin(), l.y.end(), inst.y.begin() + p);
+        std::copy(l.z.begin(), l.z.end(), inst.z.begin() + p);
+        std::copy(l.direcao.begin(), l.direcao.end(), inst.direcao.begin() + p);
+        std::copy(l.arco.begin(), l.arco.end(), inst.arco.begin() + p);
+        std::copy(l.fileira.begin(), l.fileira.end(), inst.fileira.begin() + p);
+    });
+
+    colorirAssentos(layout);
+    expandirAssentos();
+
+    unsigned long vertices = 0;
+    for (int b = 0; b < numBlocos; b++) vertices += blocosAssentos[b].lod[0].size();
+    printf("Assentos: %d em %d blocos (%lu vértices no nível 0) em %.2f ms\n",
+           total, numBlocos, vertices, tempoAtualMs() - inicio);
+}
+
+// Novo layout: recolore as instâncias e reexpande os blocos, tudo em paralelo
+void aplicarLayoutAssentos(int layout) {
+    RASTREAR_FUNCAO();
+    if (layout == LAYOUT_OCULTO) return;
+    colorirAssentos(layout);
+    expandirAssentos();
+}
+
+// Nível de detalhe do bloco pelo tamanho do assento na tela ('focoPixels':
+// altura da janela / (2 tan(fov/2)))
+int nivelDetalheBlocoAssentos(const BlocoAssentos &bloco, const Vetor3 &olho, float focoPixels) {
+    const CaixaLimites &c = bloco.caixa;
+    // Ponto da caixa mais próximo do olho
+    Vetor3 p = vetor3(fminf(fmaxf(olho.x, c.minimo.x), c.maximo.x),
+                      fminf(fmaxf(olho.y, c.minimo.y), c.maximo.y),
+                      fminf(fmaxf(olho.z, c.minimo.z), c.maximo.z));
+    float distancia = fmaxf(comprimento(p - olho), 1e-4f);
+    float pixels = LARGURA_ASSENTO / distancia * focoPixels;
+    return pixels >= PIXELS_LOD_0 ? 0 : (pixels >= PIXELS_LOD_1 ? 1 : 2);
+}
+
+// Descarta blocos fora do frustum e escolhe o nível de cada um neste quadro
+// (-1: fora da câmera), em paralelo
+void escolherNiveisAssentos(const float planos[6][4], const Vetor3 &olho, float focoPixels,
+                            std::vector<signed char> &nivel) {
+    nivel.resize(blocosAssentos.size());
+    executarEmParalelo(0, (int)blocosAssentos.size(), 64, [&](int b) {
+        if (blocosAssentos[b].quantidade == 0 || !caixaNoFrustum(blocosAssentos[b].caixa, planos)) {
+            nivel[b] = -1;
+            return;
+        }
+        nivel[b] = (signed char)nivelDetalheBlocoAssentos(blocosAssentos[b], olho, focoPixels);
+    });
+}
+
+void desenharAssentos(const float planos[6][4], const Vetor3 &olho, float focoPixels) {
+    int numBlocos = (int)blocosAssentos.size();
+    std::vector<signed char> nivel;
+    escolherNiveisAssentos(planos, olho, focoPixels, nivel);
+
+    alterarEstadoGL(GL_TEXTURE_2D, false);
+    for (int b = 0; b < numBlocos; b++) {
+        if (nivel[b] < 0) {
+            estatisticasQuadro.objetosDescartados++;
+            continue;
+        }
+        const std::vector<VerticeAssento> &v = blocosAssentos[b].lod[(int)nivel[b]];
+        if (v.empty()) continue;
+        glInterleavedArrays(GL_C4UB_V3F, 0, &v[0]);
+        desenharArrays(GL_TRIANGLES, 0, (GLsizei)v.size());
+        estatisticasQuadro.bytesEnviados += (unsigned long)v.size() * sizeof(VerticeAssento);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    alterarEstadoGL(GL_TEXTURE_2D, true);
+}
+
+// --- Ola (onda da torcida) ---
+// Meio excitável numa grade de células (fileira x coluna angular) ao longo
+// das arquibancadas. Cada célula guarda só o tempo desde que a pessoa se
+// levantou: enquanto menor que DURACAO_PE_OLA ela está de pé (altura em
+// parábola), depois fica em refratário até DURACAO_CICLO_OLA. Em repouso,
+// ela se levanta quando a soma ponderada das alturas das células de trás
+// (coluna anterior, duas antes e as diagonais) passa do seu limiar, de modo
+// que a onda anda no sentido anti-horário. O passo é um estêncil sobre
+// arranjos SoA, sem desvios, em SSE (4 células por instrução) quando
+// disponível e com um laço escalar equivalente para o resto; as colunas dão a
+// volta no estádio (bordas fantasmas copiadas antes de cada passo) e as
+// fileiras têm uma borda de zeros.
+const float GRAUS_POR_COLUNA_OLA = 0.15f;   // Da ordem do espaçamento dos assentos
+const float DURACAO_PE_OLA = 0.6f;          // s de pé
+const float DURACAO_CICLO_OLA = 4.6f;       // s até poder levantar de novo
+const float LIMIAR_OLA = 0.16f;
+const float VARIACAO_LIMIAR_OLA = 0.25f;    // +/- fração do limiar, por pessoa
+const float PESO_OLA_COLUNA_1 = 1.0f;
+const float PESO_OLA_COLUNA_2 = 0.5f;
+const float PESO_OLA_DIAGONAL = 0.25f;
+const float AMPLITUDE_OLA = 0.006f;         // Elevação do torcedor de pé, com os braços
+const int BORDA_OLA = 2;                    // Colunas fantasmas de cada lado
+
+struct GradeOla {
+    int linhas, colunas, largura;           // largura = colunas + 2 * BORDA_OLA
+    std::vector<float> tempo;               // s desde o último levantar
+    std::vector<float> altura;              // 0..1, calculada de 'tempo'
+    std::vector<float> limiar;
+    std::vector<float> mascara;             // 1 = célula com assentos
+};
+
+GradeOla gradeOla;
+
+inline int indiceCelulaOla(const GradeOla &g, int linha, int coluna) {
+    return (linha + 1) * g.largura + coluna + BORDA_OLA;
+}
+
+void iniciarGradeOla(GradeOla &g, int linhas, int colunas) {
+    g.linhas = linhas;
+    g.colunas = colunas;
+    g.largura = colunas + 2 * BORDA_OLA;
+    size_t total = (size_t)(linhas + 2) * g.largura;
+    g.tempo.assign(total, DURACAO_CICLO_OLA);
+    g.altura.assign(total, 0.0f);
+    g.limiar.assign(total, LIMIAR_OLA);
+    g.mascara.assign(total, 0.0f);
+    for (size_t i = 0; i < total; i++) {
+        g.limiar[i] = LIMIAR_OLA * (1.0f + (2.0f * hashUnitario((unsigned int)i * 7u + 5u) - 1.0f) * VARIACAO_LIMIAR_OLA);
+    }
+}
+
+// Coluna da grade para um ponto do estádio
+int colunaOla(const GradeOla &g, float x, float y) {
+    float graus = atan2f(y - estadio.centro_y, x - estadio.centro_x) * 180.0f / PI;
+    if (graus < 0.0f) graus += 360.0f;
+    int coluna = (int)(graus / GRAUS_POR_COLUNA_OLA);
+    return coluna < g.colunas ? coluna : g.colunas - 1;
+}
+
+// Grade do estádio: uma fileira por degrau, células ativas onde há assentos
+void construirGradeOla() {
+    RASTREAR_FUNCAO();
+    int linhas = 0;
+    for (int a = 0; a < NUM_ARCOS_PRINCIPAIS; a++) linhas = std::max(linhas, numDegrausArco(a));
+    GradeOla &g = gradeOla;
+    iniciarGradeOla(g, linhas, (int)(360.0f / GRAUS_POR_COLUNA_OLA + 0.5f));
+    const InstanciasAssentos &inst = instanciasAssentos;
+    for (size_t i = 0; i < inst.x.size(); i++) {
+        g.mascara[indiceCelulaOla(g, inst.fileira[i], colunaOla(g, inst.x[i], inst.y[i]))] = 1.0f;
+    }
+    alturasOlaAtuais.assign((size_t)g.linhas * g.colunas, 0);
+}
+
+// Um passo do estêncil; devolve quantas células estão de pé
+int passoOla(GradeOla &g, float dt) {
+    const int L = g.largura;
+    // 1. Altura a partir do tempo (parábola 4x(1-x) enquanto de pé)
+    for (int j = 1; j <= g.linhas; j++) {
+        const float *__restrict tempo = &g.tempo[j * L + BORDA_OLA];
+        const float *__restrict mascara = &g.mascara[j * L + BORDA_OLA];
+        float *__restrict altura = &g.altura[j * L + BORDA_OLA];
+        int c = 0;
+#ifdef USAR_SSE
+        const __m128 escala = _mm_set1_ps(1.0f / DURACAO_PE_OLA);
+        const __m128 um = _mm_set1_ps(1.0f), quatro = _mm_set1_ps(4.0f);
+        for (; c + 4 <= g.colunas; c += 4) {
+            __m128 x = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(tempo + c), escala), um);
+            __m128 h = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(mascara + c), quatro), _mm_mul_ps(x, _mm_sub_ps(um, x)));
+            _mm_storeu_ps(altura + c, h);
+        }
+#endif
+        for (; c < g.colunas; c++) {
+            float x = tempo[c] * (1.0f / DURACAO_PE_OLA);
+            x = x < 1.0f ? x : 1.0f;
+            altura[c] = mascara[c] * 4.0f * (x * (1.0f - x));
+        }
+        // Bordas fantasmas: o estádio é fechado
+        float *linha = &g.altura[j * L];
+        for (int b = 0; b < BORDA_OLA; b++) {
+            linha[b] = linha[g.colunas + b];
+            linha[g.colunas + BORDA_OLA + b] = linha[BORDA_OLA + b];
+        }
+    }
+
+    // 2. Quem está em repouso e foi excitado pelas células de trás se levanta
+    int dePe = 0;
+    for (int j = 1; j <= g.linhas; j++) {
+        const float *__restrict h = &g.altura[j * L + BORDA_OLA];
+        const float *__restrict hAcima = &g.altura[(j - 1) * L + BORDA_OLA];
+        const float *__restrict hAbaixo = &g.altura[(j + 1) * L + BORDA_OLA];
+        const float *__restrict limiar = &g.limiar[j * L + BORDA_OLA];
+        const float *__restrict mascara = &g.mascara[j * L + BORDA_OLA];
+        float *__restrict tempo = &g.tempo[j * L + BORDA_OLA];
+        int c = 0;
+#ifdef USAR_SSE
+        const __m128 p1 = _mm_set1_ps(PESO_OLA_COLUNA_1), p2 = _mm_set1_ps(PESO_OLA_COLUNA_2);
+        const __m128 pd = _mm_set1_ps(PESO_OLA_DIAGONAL), vdt = _mm_set1_ps(dt);
+        const __m128 ciclo = _mm_set1_ps(DURACAO_CICLO_OLA), pe = _mm_set1_ps(DURACAO_PE_OLA);
+        __m128i contagem = _mm_setzero_si128();
+        for (; c + 4 <= g.colunas; c += 4) {
+            __m128 excitacao = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p1, _mm_loadu_ps(h + c - 1)),
+                                                     _mm_mul_ps(p2, _mm_loadu_ps(h + c - 2))),
+                                          _mm_mul_ps(pd, _mm_add_ps(_mm_loadu_ps(hAcima + c - 1),
+                                                                    _mm_loadu_ps(hAbaixo + c - 1))));
+            __m128 t = _mm_loadu_ps(tempo + c);
+            __m128 avancado = _mm_min_ps(_mm_add_ps(t, vdt), ciclo);
+            __m128 levanta = _mm_and_ps(_mm_cmpge_ps(t, ciclo),
+                                        _mm_cmpgt_ps(_mm_mul_ps(excitacao, _mm_loadu_ps(mascara + c)),
+                                                     _mm_loadu_ps(limiar + c)));
+            __m128 novo = _mm_andnot_ps(levanta, avancado);
+            _mm_storeu_ps(tempo + c, novo);
+            contagem = _mm_sub_epi32(contagem, _mm_castps_si128(_mm_cmplt_ps(novo, pe)));
+        }
+        int parciais[4];
+        _mm_storeu_si128((__m128i *)parciais, contagem);
+        dePe += parciais[0] + parciais[1] + parciais[2] + parciais[3];
+#endif
+        for (; c < g.colunas; c++) {
+            float excitacao = PESO_OLA_COLUNA_1 * h[c - 1] + PESO_OLA_COLUNA_2 * h[c - 2]
+                            + PESO_OLA_DIAGONAL * (hAcima[c - 1] + hAbaixo[c - 1]);
+            float avancado = tempo[c] + dt;
+            avancado = avancado < DURACAO_CICLO_OLA ? avancado : DURACAO_CICLO_OLA;
+            bool levanta = (tempo[c] >= DURACAO_CICLO_OLA) & (excitacao * mascara[c] > limiar[c]);
+            float novo = levanta ? 0.0f : avancado;
+            tempo[c] = novo;
+            dePe += novo < DURACAO_PE_OLA ? 1 : 0;
+        }
+    }
+    return dePe;
+}
+
+// Faz levantar uma faixa de colunas a partir de 'graus' (todas as fileiras)
+void dispararOla(GradeOla &g, float graus) {
+    int inicio = (int)(graus / GRAUS_POR_COLUNA_OLA);
+    for (int j = 0; j < g.linhas; j++) {
+        for (int c = inicio; c < inicio + 3; c++) {
+            int i = indiceCelulaOla(g, j, (c + g.colunas) % g.colunas);
+            if (g.mascara[i] > 0.0f) g.tempo[i] = 0.0f;
+        }
+    }
+}
+
+// Sistema da simulação (passo fixo): avança a grade e quantiza as alturas
+// que seguem no instantâneo da cena para a torcida
+void avancarOla(float dt) {
+    GradeOla &g = gradeOla;
+    if (g.linhas == 0) return;
+    if (pedidoIniciarOla) {
+        pedidoIniciarOla = false;
+        // Começo (no sentido da onda) de cada lance de arquibancada
+        dispararOla(g, 300.0f);
+        dispararOla(g, 120.0f);
+        olaAtiva = true;
+    }
+    if (!olaAtiva) return;
+    olaAtiva = passoOla(g, dt) > 0;
+    for (int j = 0; j < g.linhas; j++) {
+        const float *altura = &g.altura[indiceCelulaOla(g, j, 0)];
+        unsigned char *saida = &alturasOlaAtuais[(size_t)j * g.colunas];
+        for (int c = 0; c < g.colunas; c++) saida[c] = (unsigned char)(altura[c] * 255.0f + 0.5f);
+    }
+}
+
+// --benchmark-ola: mede o passo numa grade cheia, sem janela nem desenho
+void executarBenchmarkOla(int numCelulas) {
+    const int linhas = 40;
+    int colunas = std::max(numCelulas / linhas, 8);
+    GradeOla g;
+    iniciarGradeOla(g, linhas, colunas);
+    for (int j = 0; j < linhas; j++) {
+        for (int c = 0; c < colunas; c++) g.mascara[indiceCelulaOla(g, j, c)] = 1.0f;
+    }
+    const float dt = 1.0f / 120.0f;
+    const int passos = 2000;
+    std::vector<double> tempos;
+    tempos.reserve(passos);
+    for (int p = 0; p < passos; p++) {
+        if (p % 600 == 0) dispararOla(g, 0.0f);
+        double inicio = tempoAtualMs();
+        int dePe = passoOla(g, dt);
+        tempos.push_back(tempoAtualMs() - inicio);
+        if (p == passos / 2) printf("  (%d células de pé no passo %d)\n", dePe, p);
+    }
+    double soma = 0.0;
+    for (size_t i = 0; i < tempos.size(); i++) soma += tempos[i];
+    double p50 = percentil(tempos, 0.50);
+    printf("Ola: %d células (%d x %d), %d passos\n", linhas * colunas, linhas, colunas, passos);
+    printf("  ms por passo: média %.4f | p50 %.4f | p99 %.4f | mín %.4f\n",
+           soma / passos, p50, percentil(tempos, 0.99), *std::min_element(tempos.begin(), tempos.end()));
+    printf("  %.1f células por microssegundo (p50)\n", linhas * colunas / (p50 * 1000.0));
+}
+
+
+// --- Torcida (billboards instanciados) ---
+// Um torcedor por assento ocupado, desenhado como billboard vertical (corpo +
+// cabeça) virado para a câmera. O buffer de instâncias é SoA e compacto
+// (posição, fase e duas cores); a cada quadro, para cada bloco visível, a
+// elevação de todos os torcedores é avaliada num laço simples sobre os
+// arranjos, com os blocos em paralelo. No pipeline de shaders só as elevações
+// vão para a GPU, e um billboard modelo é desenhado por instância
+// (desenharTorcidaShader); no pipeline fixo os billboards são expandidos na
+// CPU, em arranjos por bloco que mantêm o tamanho entre quadros. A fase
+// combina uma onda que dá ONDAS_POR_VOLTA_TORCIDA voltas no estádio com um
+// deslocamento aleatório por torcedor.
+const float OCUPACAO_TORCIDA = 0.95f;
+const float LARGURA_TORCEDOR = PASSO_ASSENTO * 0.75f;
+const float ALTURA_CORPO_TORCEDOR = 0.0055f;
+const float ALTURA_CABECA_TORCEDOR = 0.002f;
+const float ESCALA_CABECA_TORCEDOR = 0.6f;  // Largura da cabeça / largura do corpo
+const float AMPLITUDE_PULO_TORCEDOR = 0.003f;
+const float FREQUENCIA_TORCIDA_HZ = 0.6f;
+const float ONDAS_POR_VOLTA_TORCIDA = 3.0f;
+const float DISPERSAO_FASE_TORCIDA = 0.8f;   // rad
+
+struct InstanciasTorcida {
+    std::vector<float> x, y, z;         // Pés, sobre o tampo do assento
+    std::vector<float> fase;
+    std::vector<unsigned int> corCamisa, corPele;
+    std::vector<int> celulaOla;         // Índice em alturasOla (fileira * colunas + coluna)
+    std::vector<float> elevacao;        // Atualizada a cada quadro
+};
+
+// Mesmos índices de 'blocosAssentos'
+struct BlocoTorcida {
+    int primeiro, quantidade;
+    std::vector<VerticeAssento> vertices;   // Só no pipeline fixo
+};
+
+InstanciasTorcida instanciasTorcida;
+std::vector<BlocoTorcida> blocosTorcida;
+int versaoTorcida = 0;                  // Incrementada a cada construção
+
+void construirTorcida() {
+    RASTREAR_FUNCAO();
+    static const unsigned char CAMISAS[][3] = {
+        {20, 20, 20}, {235, 235, 235}, {200, 30, 30}, {20, 20, 20}, {235, 235, 235}, {40, 90, 190}
+    };
+    static const unsigned char PELES[][3] = {
+        {240, 200, 170}, {200, 150, 110}, {150, 100, 70}, {100, 65, 45}
+    };
+    const int numCamisas = sizeof(CAMISAS) / sizeof(CAMISAS[0]);
+    const int numPeles = sizeof(PELES) / sizeof(PELES[0]);
+    const InstanciasAssentos &assentos = instanciasAssentos;
+
+    int numBlocos = (int)blocosAssentos.size();
+    std::vector<InstanciasTorcida> locais(numBlocos);
+    executarEmParalelo(0, numBlocos, 1, [&](int b) {
+        InstanciasTorcida &l = locais[b];
+        const BlocoAssentos &bloco = blocosAssentos[b];
+        for (int i = bloco.primeiro; i < bloco.primeiro + bloco.quantidade; i++) {
+            if (hashUnitario(i * 4u) >= OCUPACAO_TORCIDA) continue;
+            float angulo = atan2f(assentos.y[i] - estadio.centro_y, assentos.x[i] - estadio.centro_x);
+            l.x.push_back(assentos.x[i]);
+            l.y.push_back(assentos.y[i]);
+            l.z.push_back(assentos.z[i] + ALTURA_ASSENTO);
+            l.fase.push_back(-ONDAS_POR_VOLTA_TORCIDA * angulo
+                             + (hashUnitario(i * 4u + 1) - 0.5f) * DISPERSAO_FASE_TORCIDA);
+            const unsigned char *c = CAMISAS[hashInteiro(i * 4u + 2) % numCamisas];
+            const unsigned char *p = PELES[hashInteiro(i * 4u + 3) % numPeles];
+            l.corCamisa.push_back(empacotarCor(c[0], c[1], c[2]));
+            l.corPele.push_back(empacotarCor(p[0], p[1], p[2]));
+            l.celulaOla.push_back(assentos.fileira[i] * gradeOla.colunas + colunaOla(gradeOla, assentos.x[i], assentos.y[i]));
+        }
+    });
+
+    InstanciasTorcida &inst = instanciasTorcida;
+    inst = InstanciasTorcida();
+    blocosTorcida.assign(numBlocos, BlocoTorcida());
+    for (int b = 0; b < numBlocos; b++) {
+        const InstanciasTorcida &l = locais[b];
+        blocosTorcida[b].primeiro = (int)inst.x.size();
+        blocosTorcida[b].quantidade = (int)l.x.size();
+        inst.x.insert(inst.x.end(), l.x.begin(), l.x.end());
+        inst.y.insert(inst.y.end(), l.y.begin(), l.y.end());
+        inst.z.insert(inst.z.end(), l.z.begin(), l.z.end());
+        inst.fase.insert(inst.fase.end(), l.fase.begin(), l.fase.end());
+        inst.corCamisa.insert(inst.corCamisa.end(), l.corCamisa.begin(), l.corCamisa.end());
+        inst.corPele.insert(inst.corPele.end(), l.corPele.begin(), l.corPele.end());
+        inst.celulaOla.insert(inst.celulaOla.end(), l.celulaOla.begin(), l.celulaOla.end());
+    }
+    inst.elevacao.assign(inst.x.size(), 0.0f);
+    versaoTorcida++;
+    printf("Torcida: %lu torcedores\n", (unsigned long)inst.x.size());
+}
+
+// Elevação para os torcedores [inicio, fim): pulo no instante 'fase0' (rad)
+// ou, com ola em andamento, a altura da célula da grade
+void animarTorcida(int inicio, int fim, float fase0, const std::vector<unsigned char> &alturasOla) {
+    const float *fase = &instanciasTorcida.fase[0];
+    float *elevacao = &instanciasTorcida.elevacao[0];
+    if (!alturasOla.empty()) {
+        const int *celula = &instanciasTorcida.celulaOla[0];
+        for (int i = inicio; i < fim; i++) {
+            elevacao[i] = alturasOla[celula[i]] * (AMPLITUDE_OLA / 255.0f);
+        }
+        return;
+    }
+    for (int i = inicio; i < fim; i++) {
+        float s = sinf(fase0 + fase[i]);
+        elevacao[i] = s > 0.0f ? AMPLITUDE_PULO_TORCEDOR * s * s : 0.0f;
+    }
+}
+
+// Lado (-1 a 1) e altura (base 0, topo 1) dos dois triângulos de um quadrilátero
+const float CANTOS_QUAD_TORCEDOR[6][2] = {{-1, 0}, {1, 0}, {1, 1}, {-1, 0}, {1, 1}, {-1, 1}};
+
+// Escreve os 6 vértices de um quadrilátero a partir de 'saida'
+VerticeAssento *escreverQuadTorcedor(VerticeAssento *saida, unsigned int cor,
+                                     const Vetor3 &base, const Vetor3 &lado, float z0, float z1) {
+    VerticeAssento v;
+    memcpy(&v.r, &cor, sizeof(cor));
+    for (int i = 0; i < 6; i++) {
+        v.x = base.x + lado.x * CANTOS_QUAD_TORCEDOR[i][0];
+        v.y = base.y + lado.y * CANTOS_QUAD_TORCEDOR[i][0];
+        v.z = CANTOS_QUAD_TORCEDOR[i][1] > 0.0f ? z1 : z0;
+        *saida++ = v;
+    }
+    return saida;
+}
+
+// Descarta os blocos fora do frustum, escolhe o nível de cada um (-1: fora
+// da câmera, 0: corpo e cabeça, 1: longe, um único quadrilátero) e anima os
+// visíveis, em paralelo. Com 'expandir' (pipeline fixo), também monta os
+// billboards de cada bloco visível nos seus vértices
+void prepararTorcida(const float planos[6][4], const Vetor3 &olho, const Vetor3 &direitaCamera,
+                     float focoPixels, double tempoS, const std::vector<unsigned char> &alturasOla,
+                     bool expandir, std::vector<signed char> &nivel) {
+    int numBlocos = (int)blocosTorcida.size();
+    nivel.resize(numBlocos);
+    float fase0 = (float)(fmod(tempoS * FREQUENCIA_TORCIDA_HZ, 1.0) * 2.0 * PI);
+    Vetor3 lado = direitaCamera * (LARGURA_TORCEDOR * 0.5f);
+    Vetor3 ladoCabeca = lado * ESCALA_CABECA_TORCEDOR;
+
+    executarEmParalelo(0, numBlocos, 1, [&](int b) {
+        BlocoTorcida &bloco = blocosTorcida[b];
+        CaixaLimites caixa = blocosAssentos[b].caixa;
+        caixa.maximo.z += ALTURA_CORPO_TORCEDOR + ALTURA_CABECA_TORCEDOR + std::max(AMPLITUDE_PULO_TORCEDOR, AMPLITUDE_OLA);
+        if (bloco.quantidade == 0 || !caixaNoFrustum(caixa, planos)) {
+            nivel[b] = -1;
+            return;
+        }
+
+        Vetor3 p = vetor3(fminf(fmaxf(olho.x, caixa.minimo.x), caixa.maximo.x),
+                          fminf(fmaxf(olho.y, caixa.minimo.y), caixa.maximo.y),
+                          fminf(fmaxf(olho.z, caixa.minimo.z), caixa.maximo.z));
+        float pixels = LARGURA_TORCEDOR / fmaxf(comprimento(p - olho), 1e-4f) * focoPixels;
+        bool simplificado = pixels < PIXELS_LOD_1;
+        nivel[b] = simplificado ? 1 : 0;
+
+        int fim = bloco.primeiro + bloco.quantidade;
+        animarTorcida(bloco.primeiro, fim, fase0, alturasOla);
+        if (!expandir) return;
+
+        // resize() só aloca quando o bloco passa ao nível mais detalhado
+        const InstanciasTorcida &inst = instanciasTorcida;
+        bloco.vertices.resize((size_t)bloco.quantidade * (simplificado ? 6 : 12));
+        VerticeAssento *v = &bloco.vertices[0];
+        for (int i = bloco.primeiro; i < fim; i++) {
+            Vetor3 base = vetor3(inst.x[i], inst.y[i], 0.0f);
+            float z0 = inst.z[i] + inst.elevacao[i];
+            float zOmbro = z0 + ALTURA_CORPO_TORCEDOR;
+            if (simplificado) {
+                v = escreverQuadTorcedor(v, inst.corCamisa[i], base, lado, z0, zOmbro + ALTURA_CABECA_TORCEDOR);
+            } else {
+                v = escreverQuadTorcedor(v, inst.corCamisa[i], base, lado, z0, zOmbro);
+                v = escreverQuadTorcedor(v, inst.corPele[i], base, ladoCabeca,
+                                         zOmbro, zOmbro + ALTURA_CABECA_TORCEDOR);
+            }
+        }
+    });
+}
+
+// Pipeline fixo: billboards expandidos na CPU e enviados como arranjos
+void desenharTorcida(const float planos[6][4], const Vetor3 &olho, const Vetor3 &direitaCamera,
+                     float focoPixels, double tempoS, const std::vector<unsigned char> &alturasOla) {
+    int numBlocos = (int)blocosTorcida.size();
+    if (numBlocos == 0) return;
+    std::vector<signed char> nivel;
+    prepararTorcida(planos, olho, direitaCamera, focoPixels, tempoS, alturasOla, true, nivel);
+
+    alterarEstadoGL(GL_TEXTURE_2D, false);
+    for (int b = 0; b < numBlocos; b++) {
+        if (nivel[b] < 0) {
+            if (blocosTorcida[b].quantidade > 0) estatisticasQuadro.objetosDescartados++;
+            continue;
+        }
+        const std::vector<VerticeAssento> &v = blocosTorcida[b].vertices;
+        glInterleavedArrays(GL_C4UB_V3F, 0, &v[0]);
+        desenharArrays(GL_TRIANGLES, 0, (GLsizei)v.size());
+        estatisticasQuadro.bytesEnviados += (unsigned long)v.size() * sizeof(VerticeAssento);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    alterarEstadoGL(GL_TEXTURE_2D, true);
+}
+
+// Direção horizontal "direita" da câmera (primeira linha da modelview)
+Vetor3 direitaCameraModelview() {
+    float m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    Vetor3 direita = vetor3(m[0], m[4], 0.0f);
+    if (comprimento(direita) < 1e-4f) return vetor3(1.0f, 0.0f, 0.0f);
+    return normalizar(direita);
+}
+
+// --- Análise de Visibilidade dos Assentos ---
+// Para cada assento (as mesmas instâncias desenhadas, derivadas de
+// geometriaDegrau()), avalia em paralelo a linha de visão até o gramado:
+//   - C-value: quanto a linha de visão até a borda mais próxima do gramado
+//     passa acima do olho da fileira da frente, C = D (N + R) / (D + T) - R
+//     (D: distância horizontal até o foco, N: desnível entre as fileiras,
+//     R: altura do olho sobre o foco, T: profundidade até a fileira da frente),
+//     em milímetros "reais" (via ESCALA_OPENGL);
+//   - obstrução pela fileira da frente: fração de pontos amostrados no
+//     gramado cuja linha de visão passa abaixo do topo das cabeças à frente;
+//   - obstrução pela marquise: fração dos mesmos pontos, à altura de uma bola
+//     alta, cuja linha de visão atravessa a marquise.
+// As interseções com as elipses (borda do gramado, fileira da frente e borda
+// da marquise) são analíticas, e cada assento é independente dos outros. O
+// resultado vira uma textura (ângulo x fileira) estendida sobre os degraus.
+const float ALTURA_OLHO_SENTADO = ALTURA_ASSENTO + ALTURA_CORPO_TORCEDOR + ALTURA_CABECA_TORCEDOR * 0.5f;
+const float ALTURA_CABECA_SENTADO = ALTURA_ASSENTO + ALTURA_CORPO_TORCEDOR + ALTURA_CABECA_TORCEDOR;
+const float ALTURA_BOLA_ALTA = 1.5f;
+const float C_VALOR_EXCELENTE_MM = 120.0f;  // Referência usual: 60 aceitável, 90 bom, 120 excelente
+const float PESO_OBSTRUCAO_MARQUISE = 0.5f;
+const int ANGULOS_ALVOS_GRAMADO = 8;        // Alvos: centro + dois anéis
+const int LARGURA_TEXTURA_ANALISE = 2048;   // Colunas: ângulo paramétrico de 0 a 360°
+const int ALTURA_TEXTURA_ANALISE = 32;      // Linhas: fileiras (potência de 2 para o GL 1.x)
+const float ELEVACAO_MANTO_ANALISE = 0.0005f;
+
+struct ResultadosVisibilidade {
+    std::vector<float> cValorMm;
+    std::vector<float> obstrucaoFileira, obstrucaoMarquise;
+    std::vector<float> qualidade;       // 0 (ruim) a 1 (excelente)
+};
+
+ResultadosVisibilidade resultadosVisibilidade;
+bool visibilidadeCalculada = false;
+GLuint idTexturaAnalise = 0;
+int modoTexturaAnalise = ANALISE_DESLIGADA; // Conteúdo atual da textura
+LoteMalha mantoAnalise;                     // Tampos dos degraus com coordenadas da textura
+
+// Raízes t0 <= t1 de o + t d, no plano XY, sobre a elipse de semieixos rx, ry
+// centrada no estádio; falso se a reta não a cruza
+bool intersecaoElipseXY(float ox, float oy, float dx, float dy, float rx, float ry,
+                        float &t0, float &t1) {
+    float px = (ox - estadio.centro_x) / rx, py = (oy - estadio.centro_y) / ry;
+    float qx = dx / rx, qy = dy / ry;
+    float a = qx * qx + qy * qy;
+    if (a < 1e-12f) return false;
+    float b = px * qx + py * qy;
+    float c = px * px + py * py - 1.0f;
+    float discriminante = b * b - a * c;
+    if (discriminante < 0.0f) return false;
+    float raiz = sqrtf(discriminante);
+    t0 = (-b - raiz) / a;
+    t1 = (-b + raiz) / a;
+    return true;
+}
+
+// Ângulo paramétrico (graus, [0, 360)) do ponto na elipse de semieixos rx, ry
+float anguloParametricoGraus(float x, float y, float rx, float ry) {
+    float graus = atan2f((y - estadio.centro_y) / ry, (x - estadio.centro_x) / rx) * 180.0f / PI;
+    return graus < 0.0f ? graus + 360.0f : graus;
+}
+
+// Elipse dos assentos (e dos olhos) da fileira 'k'
+void elipseFileira(int arco, int k, float &rx, float &ry) {
+    GeometriaDegrau d = geometriaDegrau(arco, k);
+    rx = d.rx_int + (d.rx_ext - d.rx_int) * FRACAO_RADIAL_ASSENTO;
+    ry = d.ry_int + (d.ry_ext - d.ry_int) * FRACAO_RADIAL_ASSENTO;
+}
+
+void listarAlvosGramado(std::vector<Vetor3> &alvos) {
+    static const float ANEIS[] = {0.5f, 0.95f};
+    alvos.clear();
+    alvos.push_back(vetor3(estadio.centro_x, estadio.centro_y, Z_GRAMADO));
+    for (size_t a = 0; a < sizeof(ANEIS) / sizeof(ANEIS[0]); a++) {
+        for (int i = 0; i < ANGULOS_ALVOS_GRAMADO; i++) {
+            float ang = 2.0f * PI * (i + 0.5f * a) / ANGULOS_ALVOS_GRAMADO;
+            alvos.push_back(vetor3(estadio.centro_x + RAIO_X_GRAMADO * ANEIS[a] * cosf(ang),
+                                   estadio.centro_y + RAIO_Y_GRAMADO * ANEIS[a] * sinf(ang), Z_GRAMADO));
+        }
+    }
+}
+
+void analisarVisibilidadeAssento(int i, const std::vector<Vetor3> &alvos, ResultadosVisibilidade &r) {
+    const InstanciasAssentos &inst = instanciasAssentos;
+    const ParametrosEstadio &e = estadio;
+    int arco = inst.arco[i], k = inst.fileira[i];
+    float ox = inst.x[i], oy = inst.y[i], oz = inst.z[i] + ALTURA_OLHO_SENTADO;
+    float fx = cosf(inst.direcao[i]), fy = sinf(inst.direcao[i]);
+    int numAlvos = (int)alvos.size();
+    float t0, t1;
+
+    // Foco: borda do gramado à frente do assento
+    float D = intersecaoElipseXY(ox, oy, fx, fy, RAIO_X_GRAMADO, RAIO_Y_GRAMADO, t0, t1) && t0 > 0.0f
+            ? t0 : hypotf(ox - e.centro_x, oy - e.centro_y);
+    float R = oz - Z_GRAMADO;
+
+    // Fileira da frente (a primeira não tem ninguém à frente)
+    float cValorMm = C_VALOR_EXCELENTE_MM;
+    int obstruidosFileira = 0;
+    if (k > 0) {
+        float rxFrente, ryFrente;
+        elipseFileira(arco, k - 1, rxFrente, ryFrente);
+        float zTopoFrente = geometriaDegrau(arco, k - 1).z_topo;
+        float zCabecaFrente = zTopoFrente + ALTURA_CABECA_SENTADO;
+        float N = inst.z[i] - zTopoFrente;
+        float T = intersecaoElipseXY(ox, oy, fx, fy, rxFrente, ryFrente, t0, t1) && t0 > 0.0f ? t0 : 0.0f;
+        cValorMm = (D * (N + R) / (D + T) - R) * ESCALA_OPENGL * 1000.0f;
+        for (int a = 0; a < numAlvos; a++) {
+            float dx = alvos[a].x - ox, dy = alvos[a].y - oy;
+            if (!intersecaoElipseXY(ox, oy, dx, dy, rxFrente, ryFrente, t0, t1) || t0 <= 0.0f || t0 >= 1.0f) continue;
+            if (oz + (alvos[a].z - oz) * t0 < zCabecaFrente) obstruidosFileira++;
+        }
+    }
+
+    // Marquise: a linha até a bola alta cruza a borda frontal dentro do vão
+    // e acima da face inferior (se passar acima da face superior, já a
+    // atravessou por baixo)
+    int obstruidosMarquise = 0;
+    float zFrenteInf = e.z_frente_marquise - MARQUISE_ESPESSURA;
+    for (int a = 0; a < numAlvos; a++) {
+        float dx = alvos[a].x - ox, dy = alvos[a].y - oy;
+        if (!intersecaoElipseXY(ox, oy, dx, dy, e.rx_frente_marquise, e.ry_frente_marquise, t0, t1)
+            || t0 <= 0.0f || t0 >= 1.0f) continue;
+        float graus = anguloParametricoGraus(ox + dx * t0, oy + dy * t0, e.rx_frente_marquise, e.ry_frente_marquise);
+        if (graus < anguloInicialMarquiseMalha || graus > MARQUISE_ANGULO_FINAL) continue;
+        if (oz + (ALTURA_BOLA_ALTA - oz) * t0 >= zFrenteInf) obstruidosMarquise++;
+    }
+
+    float fileira = (float)obstruidosFileira / numAlvos;
+    float marquise = (float)obstruidosMarquise / numAlvos;
+    float nota = fminf(fmaxf(cValorMm / C_VALOR_EXCELENTE_MM, 0.0f), 1.0f);
+    r.cValorMm[i] = cValorMm;
+    r.obstrucaoFileira[i] = fileira;
+    r.obstrucaoMarquise[i] = marquise;
+    r.qualidade[i] = nota * (1.0f - fileira) * (1.0f - PESO_OBSTRUCAO_MARQUISE * marquise);
+}
+
+// Analisa todos os assentos; devolve o tempo gasto em ms
+double analisarVisibilidadeAssentos() {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    std::vector<Vetor3> alvos;
+    listarAlvosGramado(alvos);
+    int n = (int)instanciasAssentos.x.size();
+    ResultadosVisibilidade &r = resultadosVisibilidade;
+    r.cValorMm.resize(n);
+    r.obstrucaoFileira.resize(n);
+    r.obstrucaoMarquise.resize(n);
+    r.qualidade.resize(n);
+    executarEmParalelo(0, n, 256, [&](int i) {
+        analisarVisibilidadeAssento(i, alvos, r);
+    });
+    visibilidadeCalculada = true;
+    return tempoAtualMs() - inicio;
+}
+
+void imprimirResumoVisibilidade(double ms) {
+    const ResultadosVisibilidade &r = resultadosVisibilidade;
+    int n = (int)r.qualidade.size();
+    if (n == 0) return;
+    int abaixo60 = 0, fileira = 0, marquise = 0;
+    double soma = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (r.cValorMm[i] < 60.0f) abaixo60++;
+        if (r.obstrucaoFileira[i] > 0.0f) fileira++;
+        if (r.obstrucaoMarquise[i] > 0.0f) marquise++;
+        soma += r.qualidade[i];
+    }
+    printf("Visibilidade: %d assentos em %.2f ms (%d threads) | C < 60 mm: %d | "
+           "obstruídos pela fileira: %d | pela marquise: %d | qualidade média %.2f\n",
+           n, ms, numTrabalhadores + 1, abaixo60, fileira, marquise, soma / n);
+}
+
+// Vermelho (0) -> amarelo -> verde (1)
+void corEscalaAnalise(float v, unsigned char *rgba) {
+    v = fminf(fmaxf(v, 0.0f), 1.0f);
+    rgba[0] = (unsigned char)(v < 0.5f ? 220 : 220 * (1.0f - v) * 2.0f);
+    rgba[1] = (unsigned char)(v < 0.5f ? 200 * v * 2.0f : 200);
+    rgba[2] = 40;
+    rgba[3] = 255;
+}
+
+// Média do valor dos assentos de cada célula (ângulo x fileira) na textura
+// de análise; células sem assento ficam transparentes
+void atualizarTexturaAnalise(const std::vector<float> &valor) {
+    RASTREAR_FUNCAO();
+    const InstanciasAssentos &inst = instanciasAssentos;
+    int celulas = LARGURA_TEXTURA_ANALISE * ALTURA_TEXTURA_ANALISE;
+    std::vector<float> soma(celulas, 0.0f);
+    std::vector<int> contagem(celulas, 0);
+    for (size_t i = 0; i < valor.size(); i++) {
+        float rx, ry;
+        elipseFileira(inst.arco[i], inst.fileira[i], rx, ry);
+        int coluna = (int)(anguloParametricoGraus(inst.x[i], inst.y[i], rx, ry) / 360.0f * LARGURA_TEXTURA_ANALISE);
+        if (coluna >= LARGURA_TEXTURA_ANALISE) coluna = LARGURA_TEXTURA_ANALISE - 1;
+        int celula = inst.fileira[i] * LARGURA_TEXTURA_ANALISE + coluna;
+        soma[celula] += valor[i];
+        contagem[celula]++;
+    }
+    std::vector<unsigned char> rgba(celulas * 4, 0);
+    for (int c = 0; c < celulas; c++) {
+        if (contagem[c] > 0) corEscalaAnalise(soma[c] / contagem[c], &rgba[c * 4]);
+    }
+
+    if (idTexturaAnalise == 0) {
+        glGenTextures(1, &idTexturaAnalise);
+        glBindTexture(GL_TEXTURE_2D, idTexturaAnalise);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, idTexturaAnalise);
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, LARGURA_TEXTURA_ANALISE, ALTURA_TEXTURA_ANALISE, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+    estatisticasQuadro.bytesEnviados += (unsigned long)rgba.size();
+    vincularTextura(0);
+}
+
+// Tampos dos degraus, um objeto por setor de cada arco, com s = ângulo / 360
+// e t no centro da linha da fileira
+void construirMantoAnalise() {
+    RASTREAR_FUNCAO();
+    LoteMalha &lote = mantoAnalise;
+    lote.vertices.clear();
+    lote.objetos.clear();
+    lote.textura = &idTexturaAnalise;
+    ConstrutorMalha malha;
+    for (int arco = 0; arco < NUM_ARCOS_PRINCIPAIS; arco++) {
+        float ang_ini = ARCOS_PRINCIPAIS[arco][0], ang_fim = ARCOS_PRINCIPAIS[arco][1];
+        int num_setores = (int)ceilf((ang_fim - ang_ini) / GRAUS_POR_SETOR_MALHA - 1e-4f);
+        for (int setor = 0; setor < num_setores; setor++) {
+            float a0 = ang_ini + (ang_fim - ang_ini) * setor / num_setores;
+            float a1 = ang_ini + (ang_fim - ang_ini) * (setor + 1) / num_setores;
+            int segmentos = (int)ceilf(a1 - a0);
+            reiniciarConstrutorMalha(malha);
+            for (int k = 0; k < numDegrausArco(arco); k++) {
+                GeometriaDegrau d = geometriaDegrau(arco, k);
+                float z = d.z_topo + ELEVACAO_MANTO_ANALISE;
+                float t = (k + 0.5f) / ALTURA_TEXTURA_ANALISE;
+                iniciarPrimitivaMalha(malha, GL_TRIANGLE_STRIP);
+                for (int i = 0; i <= segmentos; i++) {
+                    float graus = a0 + (a1 - a0) * i / segmentos;
+                    float cos_a = cosf(GRAUS_PARA_RAD(graus)), sin_a = sinf(GRAUS_PARA_RAD(graus));
+                    coordTexturaMalha(malha, graus / 360.0f, t);
+                    verticeMalha(malha, estadio.centro_x + d.rx_int * cos_a, estadio.centro_y + d.ry_int * sin_a, z);
+                    verticeMalha(malha, estadio.centro_x + d.rx_ext * cos_a, estadio.centro_y + d.ry_ext * sin_a, z);
+                }
+                finalizarPrimitivaMalha(malha);
+            }
+            ObjetoMalha objeto;
+            objeto.primeiro = (int)lote.vertices.size();
+            objeto.quantidade = (int)malha.vertices.size();
+            objeto.caixa = malha.caixa;
+            objeto.projetaSombra = false;
+            lote.objetos.push_back(objeto);
+            lote.vertices.insert(lote.vertices.end(), malha.vertices.begin(), malha.vertices.end());
+        }
+    }
+}
+
+// --- BVH da Malha do Estádio ---
+// Hierarquia de caixas sobre os triângulos das arquibancadas, paredes,
+// marquise e tampas, base dos raios na CPU (análises de sombra, seleção com
+// o mouse, renderização de referência). Chão e gramado ficam de fora: estão
+// abaixo de tudo o que é analisado.
+// A construção usa SAH com baldes (heurística de área de superfície sobre
+// NUM_BALDES_SAH faixas dos centroides no eixo mais longo), com as duas
+// metades de cada nó grande construídas em paralelo pelo sistema de tarefas.
+// Depois a árvore é achatada num arranjo linear em pré-ordem de nós de 32
+// bytes (dois por linha de cache): o filho esquerdo de um nó interno é o nó
+// seguinte e o direito fica em 'indice'. Cada folha tem até 4 triângulos,
+// guardados em SoA num pacote para que o raio seja testado contra os quatro
+// de uma vez (SSE); o teste raio-caixa também usa SSE. O percurso visita
+// primeiro o filho do lado de onde o raio vem.
+const int MAX_TRIANGULOS_FOLHA_BVH = 4;         // Um pacote por folha
+const int NUM_BALDES_SAH = 16;
+const float CUSTO_TRAVESSIA_SAH = 1.0f;         // Relativo ao teste de um pacote de triângulos
+const int MIN_TRIANGULOS_CONSTRUCAO_PARALELA = 4096;
+const int PROFUNDIDADE_MAXIMA_BVH = 64;
+
+struct NoBvh {                          // 32 bytes
+    float minimo[3];
+    int indice;                         // Interno: filho direito; folha: pacote de triângulos
+    float maximo[3];
+    unsigned short quantidade;          // Triângulos na folha (0: nó interno)
+    unsigned char eixo;                 // Eixo da divisão (nó interno)
+    unsigned char reservado;
+};
+
+struct PacoteTriangulos {               // Até 4 triângulos em SoA (Möller-Trumbore)
+    float v0[3][4], aresta1[3][4], aresta2[3][4];
+    int triangulo[4];                   // Índice na entrada da construção (-1: vazio)
+};
+
+struct Bvh {
+    std::vector<NoBvh> nos;
+    std::vector<PacoteTriangulos> pacotes;
+    std::vector<Vetor3> vertices;       // 3 por triângulo, na ordem da entrada
+    int versaoMalha;
+};
+
+Bvh bvhEstadio = Bvh();
+
+// Raio com os dados derivados usados no percurso
+struct RaioBvh {
+    Vetor3 origem, direcao, inverso;
+    int direcaoNegativa[3];
+};
+
+struct AcertoRaio {
+    float t;
+    int triangulo;                      // Índice na entrada (Bvh::vertices / 3)
+    float u, v;                         // Coordenadas baricêntricas
+};
+
+RaioBvh prepararRaio(const Vetor3 &origem, const Vetor3 &direcao) {
+    RaioBvh raio;
+    raio.origem = origem;
+    raio.direcao = direcao;
+    raio.inverso = vetor3(direcao.x != 0.0f ? 1.0f / direcao.x : 1e30f,
+                          direcao.y != 0.0f ? 1.0f / direcao.y : 1e30f,
+                          direcao.z != 0.0f ? 1.0f / direcao.z : 1e30f);
+    raio.direcaoNegativa[0] = direcao.x < 0.0f;
+    raio.direcaoNegativa[1] = direcao.y < 0.0f;
+    raio.direcaoNegativa[2] = direcao.z < 0.0f;
+    return raio;
+}
+
+// Nó temporário da construção (antes do achatamento)
+struct NoConstrucaoBvh {
+    CaixaLimites caixa;
+    int filhos[2];                      // -1 nas folhas
+    int inicio, fim;                    // Folha: trecho de 'indices'
+    int eixo;
+};
+
+// Caixa e centroide junto do índice: a partição move as referências e os
+// baldes as percorrem em sequência
+struct ReferenciaTriangulo {
+    CaixaLimites caixa;
+    Vetor3 centroide;
+    int indice;
+};
+
+struct ConstrucaoBvh {
+    std::vector<ReferenciaTriangulo> referencias;
+    std::vector<NoConstrucaoBvh> nos;   // Reservado para 2N - 1 nós
+    std::atomic<int> numNos;
+};
+
+float areaCaixa(const CaixaLimites &c) {
+    Vetor3 d = c.maximo - c.minimo;
+    if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f) return 0.0f;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// Sem desvios (min/max), pois roda no laço interno da construção
+inline void unirCaixas(CaixaLimites &c, const CaixaLimites &outra) {
+    c.minimo = vetor3(std::min(c.minimo.x, outra.minimo.x), std::min(c.minimo.y, outra.minimo.y),
+                      std::min(c.minimo.z, outra.minimo.z));
+    c.maximo = vetor3(std::max(c.maximo.x, outra.maximo.x), std::max(c.maximo.y, outra.maximo.y),
+                      std::max(c.maximo.z, outra.maximo.z));
+}
+
+inline void incluirCentroide(CaixaLimites &c, const Vetor3 &p) {
+    c.minimo = vetor3(std::min(c.minimo.x, p.x), std::min(c.minimo.y, p.y), std::min(c.minimo.z, p.z));
+    c.maximo = vetor3(std::max(c.maximo.x, p.x), std::max(c.maximo.y, p.y), std::max(c.maximo.z, p.z));
+}
+
+CaixaLimites caixaVazia() {
+    CaixaLimites c = {vetor3(1e30f, 1e30f, 1e30f), vetor3(-1e30f, -1e30f, -1e30f)};
+    return c;
+}
+
+// 'caixa' e 'centroides' já vêm calculadas (pelos baldes do nó pai), então
+// cada nível percorre os triângulos só duas vezes: baldes e partição. Perto
+// de PROFUNDIDADE_MAXIMA_BVH o corte passa a ser pela metade da lista, que
+// garante folhas até a profundidade PROFUNDIDADE_MAXIMA_BVH - 1 (a pilha do
+// percurso cabe sempre)
+void construirNoBvh(ConstrucaoBvh &cons, int indiceNo, int inicio, int fim,
+                    const CaixaLimites &caixa, const CaixaLimites &centroides, int profundidade) {
+    NoConstrucaoBvh &no = cons.nos[indiceNo];
+    no.inicio = inicio;
+    no.fim = fim;
+    no.filhos[0] = no.filhos[1] = -1;
+    no.caixa = caixa;
+    int quantidade = fim - inicio;
+    if (quantidade <= 1) return;
+    int niveisMetade = 0;               // Níveis até as folhas cortando sempre pela metade
+    for (int q = quantidade; q > MAX_TRIANGULOS_FOLHA_BVH; q = (q + 1) / 2) niveisMetade++;
+    bool cortarMetade = profundidade + 1 + niveisMetade > PROFUNDIDADE_MAXIMA_BVH - 1;
+    if (cortarMetade && quantidade <= MAX_TRIANGULOS_FOLHA_BVH) return;
+
+    Vetor3 extensao = centroides.maximo - centroides.minimo;
+    int eixo = (extensao.x > extensao.y && extensao.x > extensao.z) ? 0 : (extensao.y > extensao.z ? 1 : 2);
+    float minimoEixo = (&centroides.minimo.x)[eixo];
+    float extensaoEixo = (&extensao.x)[eixo];
+    if (extensaoEixo <= 0.0f && quantidade <= MAX_TRIANGULOS_FOLHA_BVH) return;
+
+    int contagem[NUM_BALDES_SAH] = {0};
+    CaixaLimites caixasBaldes[NUM_BALDES_SAH], centroidesBaldes[NUM_BALDES_SAH];
+    for (int b = 0; b < NUM_BALDES_SAH; b++) caixasBaldes[b] = centroidesBaldes[b] = caixaVazia();
+    float escala = extensaoEixo > 0.0f ? NUM_BALDES_SAH / extensaoEixo : 0.0f;
+    for (int i = inicio; i < fim; i++) {
+        const ReferenciaTriangulo &r = cons.referencias[i];
+        int b = (int)(((&r.centroide.x)[eixo] - minimoEixo) * escala);
+        if (b >= NUM_BALDES_SAH) b = NUM_BALDES_SAH - 1;
+        contagem[b]++;
+        unirCaixas(caixasBaldes[b], r.caixa);
+        incluirCentroide(centroidesBaldes[b], r.centroide);
+    }
+
+    // Custo de cada corte entre baldes (área x pacotes de 4 triângulos),
+    // acumulando da direita para a esquerda e depois ao contrário
+    float areaDireita[NUM_BALDES_SAH];
+    int contagemDireita[NUM_BALDES_SAH];
+    CaixaLimites acumulada = caixaVazia();
+    int soma = 0;
+    for (int b = NUM_BALDES_SAH - 1; b > 0; b--) {
+        unirCaixas(acumulada, caixasBaldes[b]);
+        soma += contagem[b];
+        areaDireita[b] = areaCaixa(acumulada);
+        contagemDireita[b] = soma;
+    }
+    acumulada = caixaVazia();
+    soma = 0;
+    float melhorCusto = 1e30f;
+    int melhorCorte = -1;
+    for (int b = 1; b < NUM_BALDES_SAH; b++) {
+        unirCaixas(acumulada, caixasBaldes[b - 1]);
+        soma += contagem[b - 1];
+        if (soma == 0 || contagemDireita[b] == 0) continue;
+        float custo = areaCaixa(acumulada) * ((soma + 3) / 4) + areaDireita[b] * ((contagemDireita[b] + 3) / 4);
+        if (custo < melhorCusto) {
+            melhorCusto = custo;
+            melhorCorte = b;
+        }
+    }
+    if (quantidade <= MAX_TRIANGULOS_FOLHA_BVH
+        && (melhorCorte < 0 || 1.0f <= CUSTO_TRAVESSIA_SAH + melhorCusto / fmaxf(areaCaixa(caixa), 1e-20f))) {
+        return;
+    }
+    if (cortarMetade) melhorCorte = -1;
+
+    int meio;
+    CaixaLimites caixas[2] = {caixaVazia(), caixaVazia()};
+    CaixaLimites centroidesFilhos[2] = {caixaVazia(), caixaVazia()};
+    if (melhorCorte < 0) {
+        // Todos no mesmo balde (centroides coincidentes) ou profundidade no
+        // limite: divide ao meio
+        meio = (inicio + fim) / 2;
+        for (int i = inicio; i < fim; i++) {
+            unirCaixas(caixas[i >= meio], cons.referencias[i].caixa);
+            incluirCentroide(centroidesFilhos[i >= meio], cons.referencias[i].centroide);
+        }
+    } else {
+        ReferenciaTriangulo *base = &cons.referencias[0];
+        ReferenciaTriangulo *separador = std::partition(base + inicio, base + fim, [&](const ReferenciaTriangulo &r) {
+            int b = (int)(((&r.centroide.x)[eixo] - minimoEixo) * escala);
+            return (b >= NUM_BALDES_SAH ? NUM_BALDES_SAH - 1 : b) < melhorCorte;
+        });
+        meio = (int)(separador - base);
+        for (int b = 0; b < NUM_BALDES_SAH; b++) {
+            if (contagem[b] == 0) continue;
+            unirCaixas(caixas[b >= melhorCorte], caixasBaldes[b]);
+            unirCaixas(centroidesFilhos[b >= melhorCorte], centroidesBaldes[b]);
+        }
+    }
+
+    int filhos = cons.numNos.fetch_add(2);
+    no.filhos[0] = filhos;
+    no.filhos[1] = filhos + 1;
+    no.eixo = eixo;
+    if (quantidade >= MIN_TRIANGULOS_CONSTRUCAO_PARALELA) {
+        executarEmParalelo(0, 2, 1, [&](int lado) {
+            construirNoBvh(cons, filhos + lado, lado ? meio : inicio, lado ? fim : meio,
+                           caixas[lado], centroidesFilhos[lado], profundidade + 1);
+        });
+    } else {
+        construirNoBvh(cons, filhos, inicio, meio, caixas[0], centroidesFilhos[0], profundidade + 1);
+        construirNoBvh(cons, filhos + 1, meio, fim, caixas[1], centroidesFilhos[1], profundidade + 1);
+    }
+}
+
+// Pré-ordem: nós e pacotes de triângulos das folhas
+int achatarNoBvh(const ConstrucaoBvh &cons, int indiceNo, Bvh &bvh) {
+    const NoConstrucaoBvh &origem = cons.nos[indiceNo];
+    int destino = (int)bvh.nos.size();
+    bvh.nos.push_back(NoBvh());
+    NoBvh no;
+    memset(&no, 0, sizeof(no));
+    memcpy(no.minimo, &origem.caixa.minimo.x, sizeof(no.minimo));
+    memcpy(no.maximo, &origem.caixa.maximo.x, sizeof(no.maximo));
+    if (origem.filhos[0] < 0) {
+        PacoteTriangulos pacote;
+        memset(&pacote, 0, sizeof(pacote));
+        for (int k = 0; k < 4; k++) {
+            int i = origem.inicio + k;
+            pacote.triangulo[k] = i < origem.fim ? cons.referencias[i].indice : -1;
+            if (pacote.triangulo[k] < 0) continue;  // Arestas nulas: nunca atingido
+            const Vetor3 *v = &bvh.vertices[pacote.triangulo[k] * 3];
+            Vetor3 a1 = v[1] - v[0], a2 = v[2] - v[0];
+            for (int eixo = 0; eixo < 3; eixo++) {
+                pacote.v0[eixo][k] = (&v[0].x)[eixo];
+                pacote.aresta1[eixo][k] = (&a1.x)[eixo];
+                pacote.aresta2[eixo][k] = (&a2.x)[eixo];
+            }
+        }
+        no.indice = (int)bvh.pacotes.size();
+        no.quantidade = (unsigned short)(origem.fim - origem.inicio);
+        bvh.pacotes.push_back(pacote);
+    } else {
+        no.eixo = (unsigned char)origem.eixo;
+        achatarNoBvh(cons, origem.filhos[0], bvh);
+        no.indice = achatarNoBvh(cons, origem.filhos[1], bvh);
+    }
+    bvh.nos[destino] = no;
+    return destino;
+}
+
+// Constrói a BVH a partir de uma lista de triângulos (3 vértices cada)
+void construirBvh(Bvh &bvh, std::vector<Vetor3> &vertices) {
+    bvh.vertices.swap(vertices);
+    bvh.nos.clear();
+    bvh.pacotes.clear();
+    int numTriangulos = (int)bvh.vertices.size() / 3;
+    if (numTriangulos == 0) return;
+
+    ConstrucaoBvh cons;
+    cons.referencias.resize(numTriangulos);
+    cons.nos.resize(2 * numTriangulos);
+    cons.numNos.store(1);
+    executarEmParalelo(0, numTriangulos, 4096, [&](int t) {
+        const Vetor3 *v = &bvh.vertices[t * 3];
+        ReferenciaTriangulo &r = cons.referencias[t];
+        r.caixa.minimo = r.caixa.maximo = v[0];
+        incluirNaCaixa(r.caixa, v[1]);
+        incluirNaCaixa(r.caixa, v[2]);
+        r.centroide = (v[0] + v[1] + v[2]) * (1.0f / 3.0f);
+        r.indice = t;
+    });
+    CaixaLimites caixa = caixaVazia(), centroides = caixaVazia();
+    for (int t = 0; t < numTriangulos; t++) {
+        unirCaixas(caixa, cons.referencias[t].caixa);
+        incluirCentroide(centroides, cons.referencias[t].centroide);
+    }
+    construirNoBvh(cons, 0, 0, numTriangulos, caixa, centroides, 0);
+    bvh.nos.reserve(cons.numNos.load());
+    bvh.pacotes.reserve(cons.numNos.load() / 2 + 1);
+    achatarNoBvh(cons, 0, bvh);
+}
+
+void construirBvhEstadio() {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    const PassoRender passos[] = {PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS};
+    std::vector<Vetor3> vertices;
+    for (size_t p = 0; p < sizeof(passos) / sizeof(passos[0]); p++) {
+        const std::vector<VerticeMalha> &v = lotesMalha[passos[p]].vertices;
+        for (size_t i = 0; i < v.size(); i++) vertices.push_back(vetor3(v[i].x, v[i].y, v[i].z));
+    }
+    construirBvh(bvhEstadio, vertices);
+    bvhEstadio.versaoMalha = versaoMalhaEstadio;
+    printf("BVH: %lu triângulos, %lu nós, %lu folhas em %.2f ms (%d threads)\n",
+           (unsigned long)bvhEstadio.vertices.size() / 3, (unsigned long)bvhEstadio.nos.size(),
+           (unsigned long)bvhEstadio.pacotes.size(), tempoAtualMs() - inicio, numTrabalhadores + 1);
+}
+
+void garantirBvhEstadio() {
+    if (bvhEstadio.nos.empty() || bvhEstadio.versaoMalha != versaoMalhaEstadio) construirBvhEstadio();
+}
+
+// Teste das placas; 'inverso' = 1 / direção (valor enorme nos eixos nulos)
+bool raioAtingeCaixa(const CaixaLimites &c, const Vetor3 &origem, const Vetor3 &inverso, float tMax) {
+    float t0 = 0.0f, t1 = tMax;
+    const float *o = &origem.x, *inv = &inverso.x, *mn = &c.minimo.x, *mx = &c.maximo.x;
+    for (int eixo = 0; eixo < 3; eixo++) {
+        float ta = (mn[eixo] - o[eixo]) * inv[eixo];
+        float tb = (mx[eixo] - o[eixo]) * inv[eixo];
+        if (ta > tb) std::swap(ta, tb);
+        t0 = ta > t0 ? ta : t0;
+        t1 = tb < t1 ? tb : t1;
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+#ifdef USAR_SSE
+// Os três eixos numa operação; a quarta faixa (o campo inteiro do nó) é descartada
+inline bool raioAtingeNo(const NoBvh &no, const __m128 &origem, const __m128 &inverso, float tMax) {
+    const __m128 mascaraXYZ = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 ta = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(no.minimo), origem), inverso);
+    __m128 tb = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(no.maximo), origem), inverso);
+    __m128 perto = _mm_and_ps(_mm_min_ps(ta, tb), mascaraXYZ);                 // Quarta faixa: 0
+    __m128 longe = _mm_or_ps(_mm_and_ps(_mm_max_ps(ta, tb), mascaraXYZ),
+                             _mm_andnot_ps(mascaraXYZ, _mm_set1_ps(tMax)));    // Quarta faixa: tMax
+    perto = _mm_max_ps(perto, _mm_shuffle_ps(perto, perto, _MM_SHUFFLE(1, 0, 3, 2)));
+    perto = _mm_max_ps(perto, _mm_shuffle_ps(perto, perto, _MM_SHUFFLE(2, 3, 0, 1)));
+    longe = _mm_min_ps(longe, _mm_shuffle_ps(longe, longe, _MM_SHUFFLE(1, 0, 3, 2)));
+    longe = _mm_min_ps(longe, _mm_shuffle_ps(longe, longe, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_comile_ss(perto, longe) && _mm_comile_ss(perto, _mm_set_ss(tMax));
+}
+
+// Möller-Trumbore nos 4 triângulos do pacote (dos dois lados); devolve a
+// máscara das faixas atingidas em (1e-5, tMax) e os t, u, v de cada faixa
+inline int raioAtingePacote(const PacoteTriangulos &p, const RaioBvh &raio, float tMax,
+                            float *t, float *u, float *v) {
+    __m128 dx = _mm_set1_ps(raio.direcao.x), dy = _mm_set1_ps(raio.direcao.y), dz = _mm_set1_ps(raio.direcao.z);
+    __m128 e1x = _mm_loadu_ps(p.aresta1[0]), e1y = _mm_loadu_ps(p.aresta1[1]), e1z = _mm_loadu_ps(p.aresta1[2]);
+    __m128 e2x = _mm_loadu_ps(p.aresta2[0]), e2y = _mm_loadu_ps(p.aresta2[1]), e2z = _mm_loadu_ps(p.aresta2[2]);
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 valido = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(_mm_and_ps(valido, det),
+                                                            _mm_andnot_ps(valido, _mm_set1_ps(1.0f))));
+    // s = o - v0
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(raio.origem.x), _mm_loadu_ps(p.v0[0]));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(raio.origem.y), _mm_loadu_ps(p.v0[1]));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(raio.origem.z), _mm_loadu_ps(p.v0[2]));
+    __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+    __m128 zero = _mm_setzero_ps();
+    valido = _mm_and_ps(valido, _mm_cmpge_ps(uu, zero));
+    valido = _mm_and_ps(valido, _mm_cmpge_ps(vv, zero));
+    valido = _mm_and_ps(valido, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+    valido = _mm_and_ps(valido, _mm_cmpgt_ps(tt, _mm_set1_ps(1e-5f)));
+    valido = _mm_and_ps(valido, _mm_cmplt_ps(tt, _mm_set1_ps(tMax)));
+    _mm_storeu_ps(t, tt);
+    _mm_storeu_ps(u, uu);
+    _mm_storeu_ps(v, vv);
+    return _mm_movemask_ps(valido);
+}
+#else
+inline bool raioAtingeNo(const NoBvh &no, const RaioBvh &raio, float tMax) {
+    CaixaLimites c = {vetor3(no.minimo[0], no.minimo[1], no.minimo[2]),
+                      vetor3(no.maximo[0], no.maximo[1], no.maximo[2])};
+    return raioAtingeCaixa(c, raio.origem, raio.inverso, tMax);
+}
+
+inline int raioAtingePacote(const PacoteTriangulos &p, const RaioBvh &raio, float tMax,
+                            float *t, float *u, float *v) {
+    int mascara = 0;
+    for (int k = 0; k < 4; k++) {
+        Vetor3 v0 = vetor3(p.v0[0][k], p.v0[1][k], p.v0[2][k]);
+        Vetor3 a1 = vetor3(p.aresta1[0][k], p.aresta1[1][k], p.aresta1[2][k]);
+        Vetor3 a2 = vetor3(p.aresta2[0][k], p.aresta2[1][k], p.aresta2[2][k]);
+        Vetor3 pv = produtoVetorial(raio.direcao, a2);
+        float det = produtoEscalar(a1, pv);
+        if (fabsf(det) <= 1e-12f) continue;
+        float invDet = 1.0f / det;
+        Vetor3 s = raio.origem - v0;
+        u[k] = produtoEscalar(s, pv) * invDet;
+        Vetor3 q = produtoVetorial(s, a1);
+        v[k] = produtoEscalar(raio.direcao, q) * invDet;
+        t[k] = produtoEscalar(a2, q) * invDet;
+        if (u[k] >= 0.0f && v[k] >= 0.0f && u[k] + v[k] <= 1.0f && t[k] > 1e-5f && t[k] < tMax) {
+            mascara |= 1 << k;
+        }
+    }
+    return mascara;
+}
+#endif
+
+// Percorre a BVH; com 'qualquer', para no primeiro triângulo atingido
+// (raios de sombra), senão devolve o mais próximo em 'acerto'
+bool percorrerBvh(const Bvh &bvh, const RaioBvh &raio, float tMax, bool qualquer, AcertoRaio *acerto) {
+    if (bvh.nos.empty()) return false;
+#ifdef USAR_SSE
+    __m128 origem = _mm_set_ps(0.0f, raio.origem.z, raio.origem.y, raio.origem.x);
+    __m128 inverso = _mm_set_ps(0.0f, raio.inverso.z, raio.inverso.y, raio.inverso.x);
+#define TESTAR_NO_BVH(no) raioAtingeNo(no, origem, inverso, tMax)
+#else
+#define TESTAR_NO_BVH(no) raioAtingeNo(no, raio, tMax)
+#endif
+    int pilha[PROFUNDIDADE_MAXIMA_BVH];
+    int topo = 0;
+    int atual = 0;
+    bool atingiu = false;
+    while (true) {
+        const NoBvh &no = bvh.nos[atual];
+        if (TESTAR_NO_BVH(no)) {
+            if (no.quantidade > 0) {
+                float t[4], u[4], v[4];
+                int mascara = raioAtingePacote(bvh.pacotes[no.indice], raio, tMax, t, u, v);
+                if (mascara) {
+                    if (qualquer) return true;
+                    for (int k = 0; k < 4; k++) {
+                        if (!(mascara & (1 << k)) || t[k] >= tMax) continue;
+                        tMax = t[k];
+                        acerto->t = t[k];
+                        acerto->u = u[k];
+                        acerto->v = v[k];
+                        acerto->triangulo = bvh.pacotes[no.indice].triangulo[k];
+                        atingiu = true;
+                    }
+                }
+            } else {
+                // O filho mais perto primeiro, segundo o sinal da direção no eixo da
+                // divisão; a construção limita a profundidade ao tamanho da pilha
+                if (raio.direcaoNegativa[no.eixo]) {
+                    pilha[topo++] = atual + 1;
+                    atual = no.indice;
+                } else {
+                    pilha[topo++] = no.indice;
+                    atual = atual + 1;
+                }
+                continue;
+            }
+        }
+        if (topo == 0) break;
+        atual = pilha[--topo];
+    }
+#undef TESTAR_NO_BVH
+    return atingiu;
+}
+
+// Verdadeiro se o raio atinge algum triângulo antes de 'tMax' (raios de sombra)
+bool raioOcluido(const Bvh &bvh, const RaioBvh &raio, float tMax) {
+    return percorrerBvh(bvh, raio, tMax, true, NULL);
+}
+
+// Triângulo mais próximo antes de 'tMax'
+bool intersectarRaio(const Bvh &bvh, const RaioBvh &raio, float tMax, AcertoRaio &acerto) {
+    return percorrerBvh(bvh, raio, tMax, false, &acerto);
+}
+
+// --- Análise de Sombra ao Longo do Dia ---
+// Fração das horas de sol de um dia em que cada assento (na altura da cabeça
+// do torcedor sentado) fica à sombra, em João Pessoa. O dia é amostrado a
+// cada 15 minutos de tempo solar; para cada amostra com o sol acima do
+// horizonte lança-se um raio de sombra contra a BVH. As tarefas pegam lotes
+// de assentos vizinhos e percorrem as amostras por fora, de modo que raios
+// consecutivos têm a mesma direção e origens próximas e visitam os mesmos
+// nós. O resultado de cada raio fica guardado (um bit por amostra): quando o
+// vão da marquise muda, só são refeitos os raios que cruzam a caixa do
+// trecho acrescentado ou removido.
+const float LATITUDE_JOAO_PESSOA = -7.12f;      // Graus
+const float AZIMUTE_EIXO_Y_ESTADIO = 0.0f;      // Graus a partir do norte (suposto: +Y para o norte)
+const int NUM_AMOSTRAS_SOL = 96;                // Uma a cada 15 min
+const int PALAVRAS_AMOSTRAS_SOL = (NUM_AMOSTRAS_SOL + 63) / 64;
+const int ASSENTOS_POR_LOTE_SOMBRA = 64;
+
+int diaDoAnoSol = 355;                          // Solstício de dezembro (verão)
+
+struct SombraAssentos {
+    int dia;
+    Vetor3 direcaoSol[NUM_AMOSTRAS_SOL];
+    unsigned long long amostrasDia[PALAVRAS_AMOSTRAS_SOL]; // Sol acima do horizonte
+    std::vector<unsigned long long> bits;       // [assento * PALAVRAS_AMOSTRAS_SOL + palavra]
+    std::vector<float> fracao;                  // Fração das horas de sol à sombra
+};
+
+SombraAssentos sombraAssentos;
+bool sombraCalculada = false;
+
+// Direção do sol (unitária, coordenadas do estádio: Z para cima) na hora
+// solar dada; declinação pela aproximação de Cooper
+Vetor3 direcaoSol(int diaDoAno, float horaSolar) {
+    float declinacao = GRAUS_PARA_RAD(-23.44f) * cosf(2.0f * PI / 365.0f * (diaDoAno + 10));
+    float latitude = GRAUS_PARA_RAD(LATITUDE_JOAO_PESSOA);
+    float anguloHorario = GRAUS_PARA_RAD(15.0f * (horaSolar - 12.0f));
+    float leste = -cosf(declinacao) * sinf(anguloHorario);
+    float norte = cosf(latitude) * sinf(declinacao) - sinf(latitude) * cosf(declinacao) * cosf(anguloHorario);
+    float cima = sinf(latitude) * sinf(declinacao) + cosf(latitude) * cosf(declinacao) * cosf(anguloHorario);
+    float az = GRAUS_PARA_RAD(AZIMUTE_EIXO_Y_ESTADIO);
+    return vetor3(leste * cosf(az) - norte * sinf(az), leste * sinf(az) + norte * cosf(az), cima);
+}
+
+Vetor3 posicaoCabecaAssento(int i) {
+    const InstanciasAssentos &inst = instanciasAssentos;
+    return vetor3(inst.x[i], inst.y[i], inst.z[i] + ALTURA_OLHO_SENTADO);
+}
+
+void atualizarFracaoSombra(int i) {
+    SombraAssentos &s = sombraAssentos;
+    int sombra = 0, dia = 0;
+    for (int w = 0; w < PALAVRAS_AMOSTRAS_SOL; w++) {
+        sombra += __builtin_popcountll(s.bits[i * PALAVRAS_AMOSTRAS_SOL + w] & s.amostrasDia[w]);
+        dia += __builtin_popcountll(s.amostrasDia[w]);
+    }
+    s.fracao[i] = dia > 0 ? (float)sombra / dia : 1.0f;
+}
+
+void imprimirResumoSombra(const char *titulo, double ms, long raios) {
+    const SombraAssentos &s = sombraAssentos;
+    int n = (int)s.fracao.size();
+    if (n == 0) return;
+    int sempreSombra = 0, sempreSol = 0;
+    double soma = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (s.fracao[i] >= 1.0f) sempreSombra++;
+        if (s.fracao[i] <= 0.0f) sempreSol++;
+        soma += s.fracao[i];
+    }
+    printf("%s (dia %d): %ld raios em %.2f ms (%d threads) | sempre à sombra: %d | "
+           "sempre ao sol: %d | fração média à sombra %.2f\n",
+           titulo, s.dia, raios, ms, numTrabalhadores + 1, sempreSombra, sempreSol, soma / n);
+}
+
+void calcularSombraAssentos(int diaDoAno) {
+    RASTREAR_FUNCAO();
+    garantirBvhEstadio();
+    double inicio = tempoAtualMs();
+    SombraAssentos &s = sombraAssentos;
+    s.dia = diaDoAno;
+    memset(s.amostrasDia, 0, sizeof(s.amostrasDia));
+    long raiosPorAssento = 0;
+    for (int a = 0; a < NUM_AMOSTRAS_SOL; a++) {
+        s.direcaoSol[a] = direcaoSol(diaDoAno, (a + 0.5f) * 24.0f / NUM_AMOSTRAS_SOL);
+        if (s.direcaoSol[a].z > 0.0f) {
+            s.amostrasDia[a / 64] |= 1ULL << (a % 64);
+            raiosPorAssento++;
+        }
+    }
+    int n = (int)instanciasAssentos.x.size();
+    s.bits.assign((size_t)n * PALAVRAS_AMOSTRAS_SOL, 0);
+    s.fracao.resize(n);
+
+    executarTrechosEmParalelo(0, n, ASSENTOS_POR_LOTE_SOMBRA, [&](int ini, int fim) {
+        for (int a = 0; a < NUM_AMOSTRAS_SOL; a++) {
+            if (!(s.amostrasDia[a / 64] & (1ULL << (a % 64)))) continue;
+            for (int i = ini; i < fim; i++) {
+                if (raioOcluido(bvhEstadio, prepararRaio(posicaoCabecaAssento(i), s.direcaoSol[a]), 1e30f)) {
+                    s.bits[i * PALAVRAS_AMOSTRAS_SOL + a / 64] |= 1ULL << (a % 64);
+                }
+            }
+        }
+        for (int i = ini; i < fim; i++) atualizarFracaoSombra(i);
+    });
+    sombraCalculada = true;
+    imprimirResumoSombra("Sombra", tempoAtualMs() - inicio, raiosPorAssento * n);
+}
+
+// Caixa do trecho da marquise entre os ângulos dados (graus)
+CaixaLimites caixaTrechoMarquise(float angulo0, float angulo1) {
+    const ParametrosEstadio &e = estadio;
+    CaixaLimites caixa = {vetor3(1e30f, 1e30f, 1e30f), vetor3(-1e30f, -1e30f, -1e30f)};
+    int passos = (int)ceilf(fabsf(angulo1 - angulo0) * 2.0f) + 1;
+    for (int i = 0; i <= passos; i++) {
+        float rad = GRAUS_PARA_RAD(angulo0 + (angulo1 - angulo0) * i / passos);
+        float c = cosf(rad), s = sinf(rad);
+        incluirNaCaixa(caixa, vetor3(e.centro_x + e.rx_base_marquise * c, e.centro_y + e.ry_base_marquise * s,
+                                     e.z_base_marquise - MARQUISE_ESPESSURA));
+        incluirNaCaixa(caixa, vetor3(e.centro_x + e.rx_frente_marquise * c, e.centro_y + e.ry_frente_marquise * s,
+                                     e.z_frente_marquise));
+    }
+    Vetor3 folga = vetor3(1e-3f, 1e-3f, 1e-3f);
+    caixa.minimo = caixa.minimo - folga;
+    caixa.maximo = caixa.maximo + folga;
+    return caixa;
+}
+
+// Depois de mudar o vão da marquise (a malha já regerada): refaz só os
+// raios que passam pelo trecho que mudou
+void atualizarSombraMarquise(float anguloAnterior) {
+    RASTREAR_FUNCAO();
+    if (!sombraCalculada) return;
+    garantirBvhEstadio();
+    double inicio = tempoAtualMs();
+    SombraAssentos &s = sombraAssentos;
+    CaixaLimites trecho = caixaTrechoMarquise(std::min(anguloAnterior, anguloInicialMarquiseMalha),
+                                              std::max(anguloAnterior, anguloInicialMarquiseMalha));
+    int n = (int)s.fracao.size();
+    std::atomic<long> refeitos(0);
+    executarTrechosEmParalelo(0, n, ASSENTOS_POR_LOTE_SOMBRA, [&](int ini, int fim) {
+        long local = 0;
+        for (int a = 0; a < NUM_AMOSTRAS_SOL; a++) {
+            if (!(s.amostrasDia[a / 64] & (1ULL << (a % 64)))) continue;
+            unsigned long long bit = 1ULL << (a % 64);
+            for (int i = ini; i < fim; i++) {
+                RaioBvh raio = prepararRaio(posicaoCabecaAssento(i), s.direcaoSol[a]);
+                if (!raioAtingeCaixa(trecho, raio.origem, raio.inverso, 1e30f)) continue;
+                unsigned long long &palavra = s.bits[i * PALAVRAS_AMOSTRAS_SOL + a / 64];
+                if (raioOcluido(bvhEstadio, raio, 1e30f)) palavra |= bit;
+                else palavra &= ~bit;
+                local++;
+            }
+        }
+        for (int i = ini; i < fim; i++) atualizarFracaoSombra(i);
+        refeitos.fetch_add(local);
+    });
+    imprimirResumoSombra("Sombra (incremental)", tempoAtualMs() - inicio, refeitos.load());
+}
+
+// Chamada pela thread que desenha depois de regerar a malha com outro vão
+void atualizarAnalisesMarquise(float anguloAnterior) {
+    visibilidadeCalculada = false;
+    atualizarSombraMarquise(anguloAnterior);
+    modoTexturaAnalise = ANALISE_DESLIGADA;     // Reenvia a textura do modo atual
+}
+
+// Calcula (na primeira vez) e envia o mapa do modo pedido
+void prepararAnalise(int modo) {
+    if (modo == modoTexturaAnalise) return;
+    if (mantoAnalise.objetos.empty()) construirMantoAnalise();
+    if (modo == ANALISE_VISIBILIDADE) {
+        if (!visibilidadeCalculada) imprimirResumoVisibilidade(analisarVisibilidadeAssentos());
+        atualizarTexturaAnalise(resultadosVisibilidade.qualidade);
+    } else if (modo == ANALISE_SOMBRA) {
+        if (!sombraCalculada) calcularSombraAssentos(diaDoAnoSol);
+        atualizarTexturaAnalise(sombraAssentos.fracao);
+    }
+    modoTexturaAnalise = modo;
+}
+
+// Tempo da análise com 1, 2, 4... threads até 'maxThreads' (<= 0: todos os
+// núcleos), sem janela
+void executarBenchmarkVisibilidade(int maxThreads) {
+    iniciarSistemaTarefas(maxThreads);
+    construirAssentos(LAYOUT_SETORES);
+    int maximo = numTrabalhadores + 1;
+    double base = 0.0, melhor = 0.0;
+    printf("threads  ms  aceleração\n");
+    for (int threads = 1; ; threads = std::min(threads * 2, maximo)) {
+        iniciarSistemaTarefas(threads);
+        melhor = 1e30;
+        for (int repeticao = 0; repeticao < 5; repeticao++) {
+            melhor = std::min(melhor, analisarVisibilidadeAssentos());
+        }
+        if (threads == 1) base = melhor;
+        printf("%7d  %.2f  %.2fx\n", threads, melhor, base / melhor);
+        if (threads == maximo) break;
+    }
+    imprimirResumoVisibilidade(melhor);
+}
+
+// --- Seleção com o Mouse ---
+// Um clique sem arrasto vira um raio pela posição do cursor, desprojetada com
+// a projeção e a câmera do quadro corrente, testado contra duas BVHs: a da
+// malha do estádio, outra construída no primeiro clique com o tampo e o
+// encosto de cada assento e, para os degraus, as superfícies analíticas. O
+// acerto mais próximo é classificado em setor (bloco de GRAUS_POR_SETOR_MALHA
+// graus), degrau e assento. O destaque é desenhado à parte a cada quadro,
+// sem reconstruir nenhuma malha.
+const int TRIANGULOS_POR_ASSENTO_BVH = 4;       // Tampo e encosto (dois quads)
+const int SEGMENTOS_DESTAQUE_SELECAO = 24;
+const float ELEVACAO_DESTAQUE_SELECAO = 0.001f; // Acima do manto de análise
+
+struct SelecaoEstadio {
+    bool valida;
+    int arco, bloco, degrau;            // -1 quando não se aplica
+    int assento;                        // Índice em 'instanciasAssentos' (-1: nenhum)
+    int passo;                          // Passo da malha atingida (-1: assento)
+    Vetor3 ponto;
+};
+
+SelecaoEstadio selecaoAtual = SelecaoEstadio();
+Bvh bvhAssentos = Bvh();
+
+// Cantos da caixa do assento: base (trás-esq., frente-esq., frente-dir.,
+// trás-dir.) e os mesmos na altura do encosto
+void cantosAssento(int i, Vetor3 cantos[8]) {
+    const InstanciasAssentos &inst = instanciasAssentos;
+    Vetor3 centro = vetor3(inst.x[i], inst.y[i], inst.z[i]);
+    Vetor3 frente = vetor3(cosf(inst.direcao[i]), sinf(inst.direcao[i]), 0.0f);
+    Vetor3 lado = vetor3(-frente.y, frente.x, 0.0f) * (LARGURA_ASSENTO * 0.5f);
+    Vetor3 f = centro + frente * (PROFUNDIDADE_ASSENTO * 0.5f);
+    Vetor3 t = centro - frente * (PROFUNDIDADE_ASSENTO * 0.5f);
+    Vetor3 hE = vetor3(0.0f, 0.0f, ALTURA_ENCOSTO);
+    cantos[0] = t - lado; cantos[1] = f - lado; cantos[2] = f + lado; cantos[3] = t + lado;
+    for (int c = 0; c < 4; c++) cantos[c + 4] = cantos[c] + hE;
+}
+
+// Os assentos não mudam depois da construção (o layout só recolore)
+void construirBvhAssentos() {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    int numAssentos = (int)instanciasAssentos.x.size();
+    std::vector<Vetor3> vertices(numAssentos * TRIANGULOS_POR_ASSENTO_BVH * 3);
+    executarEmParalelo(0, numAssentos, 4096, [&](int i) {
+        Vetor3 c[8];
+        cantosAssento(i, c);
+        Vetor3 hA = vetor3(0.0f, 0.0f, ALTURA_ASSENTO);
+        const Vetor3 quads[2][4] = {
+            {c[0] + hA, c[1] + hA, c[2] + hA, c[3] + hA},   // Tampo
+            {c[0], c[3], c[7], c[4]}                        // Encosto
+        };
+        Vetor3 *v = &vertices[i * TRIANGULOS_POR_ASSENTO_BVH * 3];
+        for (int q = 0; q < 2; q++) {
+            *v++ = quads[q][0]; *v++ = quads[q][1]; *v++ = quads[q][2];
+            *v++ = quads[q][0]; *v++ = quads[q][2]; *v++ = quads[q][3];
+        }
+    });
+    construirBvh(bvhAssentos, vertices);
+    printf("BVH dos assentos: %d assentos, %lu nós em %.2f ms\n",
+           numAssentos, (unsigned long)bvhAssentos.nos.size(), tempoAtualMs() - inicio);
+}
+
+// Bloco de assentos do arco que contém o ângulo paramétrico dado
+int blocoDoAngulo(int arco, float graus) {
+    for (int b = 0; b < (int)blocosAssentos.size(); b++) {
+        const BlocoAssentos &bloco = blocosAssentos[b];
+        if (bloco.arco == arco && graus >= bloco.ang_inicio && graus <= bloco.ang_fim) return b;
+    }
+    return -1;
+}
+
+// Assento da fileira mais próximo do ponto, dentro do bloco
+int assentoMaisProximo(int bloco, int fileira, const Vetor3 &p) {
+    const InstanciasAssentos &inst = instanciasAssentos;
+    const BlocoAssentos &b = blocosAssentos[bloco];
+    int melhor = -1;
+    float menor = 1e30f;
+    for (int i = b.primeiro; i < b.primeiro + b.quantidade; i++) {
+        if (inst.fileira[i] != fileira) continue;
+        float dx = inst.x[i] - p.x, dy = inst.y[i] - p.y;
+        if (dx * dx + dy * dy < menor) {
+            menor = dx * dx + dy * dy;
+            melhor = i;
+        }
+    }
+    return melhor;
+}
+
+// Passo da malha de origem de um triângulo da BVH do estádio (mesma ordem de construirBvhEstadio)
+int passoDoTrianguloEstadio(int triangulo) {
+    const PassoRender passos[] = {PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS};
+    int primeiro = 0;
+    for (size_t p = 0; p < sizeof(passos) / sizeof(passos[0]); p++) {
+        primeiro += (int)lotesMalha[passos[p]].vertices.size() / 3;
+        if (triangulo < primeiro) return passos[p];
+    }
+    return -1;
+}
+
+// Interseção analítica com os degraus: cada degrau é um bloco entre duas
+// elipses (as mesmas de gerarDegrauArquibancada), com o tampo numa faixa
+// elíptica plana em z_topo e o espelho num cilindro elíptico de raio interno
+// entre z_base e z_topo. O raio é testado contra as duas superfícies de todos
+// os degraus de todos os arcos, sem triângulos: o acerto é exato e não
+// depende do número de segmentos da malha.
+struct AcertoDegrau {
+    float t;
+    int arco, degrau;
+    bool espelho;                       // Face vertical (falso: tampo)
+};
+
+const int ITERACOES_FRACAO_RADIAL = 20;
+
+// Fração radial s em [0, 1] e ângulo paramétrico de um ponto no tampo do
+// degrau: o tampo é a família de elipses de raios rx_int + s (rx_ext - rx_int),
+// ry_int + s (ry_ext - ry_int); falso se o ponto está fora da faixa
+bool coordenadasTampoDegrau(const GeometriaDegrau &d, float x, float y, float &s, float &graus) {
+    float dx = x - estadio.centro_x, dy = y - estadio.centro_y;
+    float sInt = (dx / d.rx_int) * (dx / d.rx_int) + (dy / d.ry_int) * (dy / d.ry_int);
+    float sExt = (dx / d.rx_ext) * (dx / d.rx_ext) + (dy / d.ry_ext) * (dy / d.ry_ext);
+    if (sInt < 1.0f || sExt > 1.0f) return false;
+    // A norma elíptica cai monotonamente com s: bisseção
+    float baixo = 0.0f, alto = 1.0f;
+    for (int i = 0; i < ITERACOES_FRACAO_RADIAL; i++) {
+        float meio = 0.5f * (baixo + alto);
+        float rx = d.rx_int + (d.rx_ext - d.rx_int) * meio, ry = d.ry_int + (d.ry_ext - d.ry_int) * meio;
+        if ((dx / rx) * (dx / rx) + (dy / ry) * (dy / ry) > 1.0f) baixo = meio;
+        else alto = meio;
+    }
+    s = 0.5f * (baixo + alto);
+    graus = anguloParametricoGraus(x, y, d.rx_int + (d.rx_ext - d.rx_int) * s, d.ry_int + (d.ry_ext - d.ry_int) * s);
+    return true;
+}
+
+// Degrau mais próximo atingido pelo raio o + t d com t em (0, tMax)
+bool intersectarDegrausAnalitico(const Vetor3 &origem, const Vetor3 &direcao, float tMax, AcertoDegrau &acerto) {
+    acerto.t = tMax;
+    bool atingiu = false;
+    for (int a = 0; a < NUM_ARCOS_PRINCIPAIS; a++) {
+        float grausIni = ARCOS_PRINCIPAIS[a][0], grausFim = ARCOS_PRINCIPAIS[a][1];
+        for (int k = 0; k < numDegrausArco(a); k++) {
+            GeometriaDegrau d = geometriaDegrau(a, k);
+            // Tampo: plano z = z_topo, de cima ou de baixo
+            if (direcao.z != 0.0f) {
+                float t = (d.z_topo - origem.z) / direcao.z;
+                float s, graus;
+                if (t > 0.0f && t < acerto.t
+                    && coordenadasTampoDegrau(d, origem.x + direcao.x * t, origem.y + direcao.y * t, s, graus)
+                    && graus >= grausIni && graus <= grausFim) {
+                    acerto.t = t;
+                    acerto.arco = a;
+                    acerto.degrau = k;
+                    acerto.espelho = false;
+                    atingiu = true;
+                }
+            }
+            // Espelho: as duas raízes do cilindro (o raio pode vir do campo ou de trás)
+            float raizes[2];
+            if (!intersecaoElipseXY(origem.x, origem.y, direcao.x, direcao.y, d.rx_int, d.ry_int,
+                                    raizes[0], raizes[1])) continue;
+            for (int r = 0; r < 2; r++) {
+                float t = raizes[r];
+                if (t <= 0.0f || t >= acerto.t) continue;
+                float z = origem.z + direcao.z * t;
+                if (z < d.z_base || z > d.z_topo) continue;
+                float graus = anguloParametricoGraus(origem.x + direcao.x * t, origem.y + direcao.y * t,
+                                                     d.rx_int, d.ry_int);
+                if (graus < grausIni || graus > grausFim) continue;
+                acerto.t = t;
+                acerto.arco = a;
+                acerto.degrau = k;
+                acerto.espelho = true;
+                atingiu = true;
+            }
+        }
+    }
+    return atingiu;
+}
+
+// Classifica o acerto mais próximo do raio o + t d, t em [0, 1]. Os degraus
+// vêm do caminho analítico; da BVH da malha só contam as outras peças
+// (paredes, marquise, tampas), que também escondem o que está atrás delas.
+SelecaoEstadio selecionarPorRaio(const Vetor3 &origem, const Vetor3 &direcao) {
+    RaioBvh raio = prepararRaio(origem, direcao);
+    SelecaoEstadio s = SelecaoEstadio();
+    s.arco = s.bloco = s.degrau = s.assento = s.passo = -1;
+    AcertoDegrau acertoDegrau;
+    AcertoRaio acertoMalha, acertoAssento;
+    bool degrau = intersectarDegrausAnalitico(origem, direcao, 1.0f, acertoDegrau);
+    float tMax = degrau ? acertoDegrau.t : 1.0f;
+    // Um triângulo de degrau antes do acerto analítico é só a corda da malha
+    bool malha = intersectarRaio(bvhEstadio, raio, tMax, acertoMalha)
+              && passoDoTrianguloEstadio(acertoMalha.triangulo) != PASSO_ARQUIBANCADA;
+    if (malha) tMax = acertoMalha.t;
+    bool assento = layoutAssentosAtual.load() != LAYOUT_OCULTO
+                && intersectarRaio(bvhAssentos, raio, tMax, acertoAssento);
+    if (assento) {
+        const InstanciasAssentos &inst = instanciasAssentos;
+        s.valida = true;
+        s.ponto = origem + direcao * acertoAssento.t;
+        s.assento = acertoAssento.triangulo / TRIANGULOS_POR_ASSENTO_BVH;
+        s.arco = inst.arco[s.assento];
+        s.degrau = inst.fileira[s.assento];
+        for (int b = 0; b < (int)blocosAssentos.size(); b++) {
+            const BlocoAssentos &bloco = blocosAssentos[b];
+            if (s.assento >= bloco.primeiro && s.assento < bloco.primeiro + bloco.quantidade) s.bloco = b;
+        }
+    } else if (malha) {
+        s.valida = true;
+        s.ponto = origem + direcao * acertoMalha.t;
+        s.passo = passoDoTrianguloEstadio(acertoMalha.triangulo);
+    } else if (degrau) {
+        s.valida = true;
+        s.ponto = origem + direcao * acertoDegrau.t;
+        s.passo = PASSO_ARQUIBANCADA;
+        s.arco = acertoDegrau.arco;
+        s.degrau = acertoDegrau.degrau;
+        float rx, ry;
+        elipseFileira(s.arco, s.degrau, rx, ry);
+        s.bloco = blocoDoAngulo(s.arco, anguloParametricoGraus(s.ponto.x, s.ponto.y, rx, ry));
+        // Clique no degrau, entre encostos: o lugar é o do assento mais próximo
+        if (s.bloco >= 0) s.assento = assentoMaisProximo(s.bloco, s.degrau, s.ponto);
+    }
+    return s;
+}
+
+// Atende um clique na posição (x, y) da janela; usa as matrizes GL correntes
+void selecionarNaTela(int x, int y) {
+    RASTREAR_FUNCAO();
+    // As BVHs só são (re)construídas quando faltam; o tempo fica fora da latência
+    garantirBvhEstadio();
+    if (bvhAssentos.nos.empty() && !instanciasAssentos.x.empty()) construirBvhAssentos();
+
+    double inicio = tempoAtualMs();
+    GLdouble modelview[16], projecao[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projecao);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    // O GLUT conta y de cima para baixo; o GL, de baixo para cima
+    GLdouble wy = viewport[1] + viewport[3] - 1 - y;
+    GLdouble perto[3], longe[3];
+    gluUnProject(x, wy, 0.0, modelview, projecao, viewport, &perto[0], &perto[1], &perto[2]);
+    gluUnProject(x, wy, 1.0, modelview, projecao, viewport, &longe[0], &longe[1], &longe[2]);
+    Vetor3 origem = vetor3((float)perto[0], (float)perto[1], (float)perto[2]);
+    Vetor3 direcao = vetor3((float)(longe[0] - perto[0]), (float)(longe[1] - perto[1]), (float)(longe[2] - perto[2]));
+    SelecaoEstadio s = selecionarPorRaio(origem, direcao);
+    double latencia = tempoAtualMs() - inicio;
+    selecaoAtual = s;
+
+    if (!s.valida) {
+        printf("Seleção: nada sob o cursor (%.3f ms)\n", latencia);
+    } else if (s.degrau < 0) {
+        printf("Seleção: %s, fora das arquibancadas (%.3f ms)\n",
+               s.passo >= 0 ? NOMES_PASSOS[s.passo] : "?", latencia);
+    } else {
+        float ini = s.bloco >= 0 ? blocosAssentos[s.bloco].ang_inicio : ARCOS_PRINCIPAIS[s.arco][0];
+        float fim = s.bloco >= 0 ? blocosAssentos[s.bloco].ang_fim : ARCOS_PRINCIPAIS[s.arco][1];
+        printf("Seleção: setor %d (arco %d, %.0f-%.0f graus), degrau %d, assento %d (%.3f ms)\n",
+               s.bloco, s.arco, ini, fim, s.degrau, s.assento, latencia);
+    }
+}
+
+// Faixa sobre o tampo do degrau no setor e contorno do assento selecionados
+void desenharSelecao() {
+    const SelecaoEstadio &s = selecaoAtual;
+    if (!s.valida || s.degrau < 0) return;
+    alterarEstadoGL(GL_TEXTURE_2D, false);
+    glDepthMask(GL_FALSE);
+
+    GeometriaDegrau d = geometriaDegrau(s.arco, s.degrau);
+    float ini = s.bloco >= 0 ? blocosAssentos[s.bloco].ang_inicio : ARCOS_PRINCIPAIS[s.arco][0];
+    float fim = s.bloco >= 0 ? blocosAssentos[s.bloco].ang_fim : ARCOS_PRINCIPAIS[s.arco][1];
+    float z = d.z_topo + ELEVACAO_DESTAQUE_SELECAO;
+    glColor4f(1.0f, 0.55f, 0.0f, 0.5f);
+    iniciarPrimitiva(GL_QUAD_STRIP);
+    for (int i = 0; i <= SEGMENTOS_DESTAQUE_SELECAO; i++) {
+        float a = GRAUS_PARA_RAD(ini + (fim - ini) * i / SEGMENTOS_DESTAQUE_SELECAO);
+        enviarVertice3f(estadio.centro_x + d.rx_ext * cosf(a), estadio.centro_y + d.ry_ext * sinf(a), z);
+        enviarVertice3f(estadio.centro_x + d.rx_int * cosf(a), estadio.centro_y + d.ry_int * sinf(a), z);
+    }
+    finalizarPrimitiva();
+
+    // O contorno do assento fica visível mesmo atrás dos encostos vizinhos
+    if (s.assento >= 0 && layoutAssentosAtual.load() != LAYOUT_OCULTO) {
+        Vetor3 c[8];
+        cantosAssento(s.assento, c);
+        alterarEstadoGL(GL_DEPTH_TEST, false);
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        iniciarPrimitiva(GL_LINES);
+        for (int i = 0; i < 4; i++) {
+            int j = (i + 1) % 4;
+            enviarVertice3fv(&c[i].x); enviarVertice3fv(&c[j].x);
+            enviarVertice3fv(&c[i + 4].x); enviarVertice3fv(&c[j + 4].x);
+            enviarVertice3fv(&c[i].x); enviarVertice3fv(&c[i + 4].x);
+        }
+        finalizarPrimitiva();
+        alterarEstadoGL(GL_DEPTH_TEST, true);
+    }
+
+    glDepthMask(GL_TRUE);
+    alterarEstadoGL(GL_TEXTURE_2D, true);
+}
+
+// --- Renderizador de Referência na CPU ---
+// Rasterizador em software que desenha a mesma cena de renderizarCena()
+// (chão, gramado, degraus, paredes, marquise, tampas, assentos e o filtro
+// noturno) sem GPU, para servidores sem placa de vídeo e imagens de
+// referência. A imagem é dividida em blocos de TAMANHO_BLOCO_CPU pixels. Na
+// preparação, trechos de triângulos são transformados, recortados no plano
+// próximo e distribuídos nos blocos que cobrem, em paralelo e com uma lista
+// por trecho e bloco. Depois cada bloco é rasterizado por uma tarefa, com
+// profundidade e cor locais, percorrendo as listas dos trechos na ordem de
+// envio. As funções de aresta e a profundidade são avaliadas para 4 pixels de
+// uma vez (SSE); a textura é amostrada com correção de perspectiva e filtro
+// bilinear com repetição (GL_LINEAR + GL_REPEAT, sem mipmaps, como no GL) e
+// modulada pela cor do vértice (GL_MODULATE). A torcida, os mapas de análise
+// e o painel ficam de fora.
+const int TAMANHO_BLOCO_CPU = 64;
+const int NUM_TRECHOS_PREPARACAO_CPU = 64;
+const float LIMIAR_PSNR_REFERENCIA = 30.0f;     // dB; abaixo disso a comparação falha
+
+struct TexturaCpu {
+    int largura, altura, canais;
+    std::vector<unsigned char> texels;  // Linha 0 embaixo, como no GL
+};
+
+struct ImagemCpu {
+    int largura, altura;
+    std::vector<unsigned char> rgb;     // Linha 0 embaixo, como no GL
+};
+
+// Texturas dos lotes, indexadas pelos mesmos ids que os lotes referenciam
+const GLuint *const IDS_TEXTURAS_CPU[] = {
+    &idTexturaConcreto, &idTexturaTerra, &idTexturaConcretoExterno, &idTexturaGrama
+};
+const char *const ARQUIVOS_TEXTURAS_CPU[] = {
+    "concreto.jpg", "terra.jpeg", "concreto_externo.jpg", "grama.jpg"
+};
+const int NUM_TEXTURAS_CPU = sizeof(IDS_TEXTURAS_CPU) / sizeof(IDS_TEXTURAS_CPU[0]);
+TexturaCpu texturasCpu[NUM_TEXTURAS_CPU];
+
+struct VerticeClipCpu {
+    float x, y, z, w;
+    float s, t, r, g, b;
+};
+
+// Triângulo pronto para rasterizar, em pixels (y para cima)
+struct TrianguloCpu {
+    float origemX, origemY;             // Primeiro vértice: as equações usam (x, y) relativos a ele
+    float aresta[3][3];                 // a x + b y + c de cada aresta, positiva por dentro
+    float plano[7][3];                  // z, 1/w, s/w, t/w, r/w, g/w, b/w no mesmo formato
+    int minX, minY, maxX, maxY;         // Caixa em pixels, já dentro da imagem
+    const TexturaCpu *textura;          // NULL: só a cor
+};
+
+// Trecho contíguo de triângulos de entrada com a mesma textura
+struct LoteCpu {
+    const VerticeMalha *vertices;
+    int numTriangulos;
+    const TexturaCpu *textura;
+};
+
+// Saída da preparação de um trecho: os triângulos e, por bloco, quais o tocam
+struct TrechoPreparadoCpu {
+    std::vector<TrianguloCpu> triangulos;
+    std::vector<std::vector<int> > blocos;
+};
+
+// Falha não é fatal: como no GL com a textura 0, o lote fica só com a cor
+bool carregarTexturaCpu(const char *nomeArquivo, TexturaCpu &textura) {
+    int largura, altura, numCanais;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *dados = stbi_load(nomeArquivo, &largura, &altura, &numCanais, 0);
+    if (!dados) {
+        fprintf(stderr, "Aviso: textura '%s' não carregada (%s), lote só com a cor\n",
+                nomeArquivo, stbi_failure_reason());
+        textura.texels.clear();
+        return false;
+    }
+    textura.largura = largura;
+    textura.altura = altura;
+    textura.canais = numCanais;
+    textura.texels.assign(dados, dados + (size_t)largura * altura * numCanais);
+    stbi_image_free(dados);
+    return true;
+}
+
+const TexturaCpu *texturaCpuDoLote(const LoteMalha &lote) {
+    for (int i = 0; i < NUM_TEXTURAS_CPU; i++) {
+        if (IDS_TEXTURAS_CPU[i] == lote.textura) return texturasCpu[i].texels.empty() ? NULL : &texturasCpu[i];
+    }
+    return NULL;
+}
+
+// Bilinear com repetição; texturas de um canal viram (r, 0, 0) como GL_RED
+void amostrarTexturaCpu(const TexturaCpu &textura, float s, float t, float cor[3]) {
+    int w = textura.largura, h = textura.altura, n = textura.canais;
+    float u = s * w - 0.5f, v = t * h - 0.5f;
+    float fu = floorf(u), fv = floorf(v);
+    float ax = u - fu, ay = v - fv;
+    int x0 = (int)fmodf(fu, (float)w), y0 = (int)fmodf(fv, (float)h);
+    if (x0 < 0) x0 += w;
+    if (y0 < 0) y0 += h;
+    int x1 = x0 + 1 < w ? x0 + 1 : 0, y1 = y0 + 1 < h ? y0 + 1 : 0;
+    const unsigned char *l0 = &textura.texels[(size_t)y0 * w * n], *l1 = &textura.texels[(size_t)y1 * w * n];
+    int canais = n >= 3 ? 3 : 1;
+    for (int c = 0; c < canais; c++) {
+        float baixo = l0[x0 * n + c] + (l0[x1 * n + c] - l0[x0 * n + c]) * ax;
+        float cima = l1[x0 * n + c] + (l1[x1 * n + c] - l1[x0 * n + c]) * ax;
+        cor[c] = (baixo + (cima - baixo) * ay) * (1.0f / 255.0f);
+    }
+    if (canais == 1) cor[1] = cor[2] = 0.0f;
+}
+
+// Matrizes 4x4 por colunas, como no GL; r = a b
+void multiplicarMatrizes(const float a[16], const float b[16], float r[16]) {
+    for (int c = 0; c < 4; c++) {
+        for (int l = 0; l < 4; l++) {
+            r[c * 4 + l] = a[l] * b[c * 4] + a[4 + l] * b[c * 4 + 1] + a[8 + l] * b[c * 4 + 2] + a[12 + l] * b[c * 4 + 3];
+        }
+    }
+}
+
+// m = m b, como cada chamada de transformação do GL
+void posMultiplicarMatriz(float m[16], const float b[16]) {
+    float r[16];
+    multiplicarMatrizes(m, b, r);
+    memcpy(m, r, sizeof(r));
+}
+
+void matrizIdentidade(float m[16]) {
+    for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+}
+
+void transladarMatriz(float m[16], float x, float y, float z) {
+    float t[16];
+    matrizIdentidade(t);
+    t[12] = x; t[13] = y; t[14] = z;
+    posMultiplicarMatriz(m, t);
+}
+
+// glRotatef
+void rotacionarMatriz(float m[16], float graus, float x, float y, float z) {
+    Vetor3 e = normalizar(vetor3(x, y, z));
+    float c = cosf(GRAUS_PARA_RAD(graus)), s = sinf(GRAUS_PARA_RAD(graus)), k = 1.0f - c;
+    float r[16] = {
+        e.x * e.x * k + c,       e.y * e.x * k + e.z * s, e.x * e.z * k - e.y * s, 0.0f,
+        e.x * e.y * k - e.z * s, e.y * e.y * k + c,       e.y * e.z * k + e.x * s, 0.0f,
+        e.x * e.z * k + e.y * s, e.y * e.z * k - e.x * s, e.z * e.z * k + c,       0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    posMultiplicarMatriz(m, r);
+}
+
+// gluLookAt
+void olharMatriz(float m[16], Vetor3 olho, Vetor3 alvo, Vetor3 cima) {
+    Vetor3 f = normalizar(alvo - olho);
+    Vetor3 s = normalizar(produtoVetorial(f, cima));
+    Vetor3 u = produtoVetorial(s, f);
+    float r[16] = {
+        s.x, u.x, -f.x, 0.0f,
+        s.y, u.y, -f.y, 0.0f,
+        s.z, u.z, -f.z, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    posMultiplicarMatriz(m, r);
+    transladarMatriz(m, -olho.x, -olho.y, -olho.z);
+}
+
+// gluPerspective
+void matrizPerspectiva(float m[16], float fovyGraus, float proporcao, float perto, float longe) {
+    float f = 1.0f / tanf(GRAUS_PARA_RAD(fovyGraus) * 0.5f);
+    for (int i = 0; i < 16; i++) m[i] = 0.0f;
+    m[0] = f / proporcao;
+    m[5] = f;
+    m[10] = (longe + perto) / (perto - longe);
+    m[11] = -1.0f;
+    m[14] = 2.0f * longe * perto / (perto - longe);
+}
+
+// A mesma câmera de renderizarCena()
+void matrizCameraCena(const EstadoCena &cena, float m[16]) {
+    matrizIdentidade(m);
+    if (cena.vooAtivo) {
+        olharMatriz(m, cena.olhoVoo, ALVO_VOO, vetor3(0.0f, 0.0f, 1.0f));
+        return;
+    }
+    const float *p = cena.posicaoCamera;
+    transladarMatriz(m, -p[0], -p[1], -p[2]);
+    float rad = cena.anguloCamera * M_PI / 180.0f;
+    olharMatriz(m, vetor3(p[0], p[1], p[2]), vetor3(p[0] + sinf(rad), 0.0f, p[2] - cosf(rad)),
+                vetor3(0.0f, 1.0f, 0.0f));
+    rotacionarMatriz(m, anguloRotacaoX, 1.0f, 0.0f, 0.0f);
+    rotacionarMatriz(m, anguloRotacaoY, 0.0f, 1.0f, 0.0f);
+    rotacionarMatriz(m, anguloRotacaoZ, 0.0f, 0.0f, 1.0f);
+}
+
+VerticeClipCpu transformarVerticeCpu(const float mvp[16], const VerticeMalha &v) {
+    VerticeClipCpu c;
+    c.x = mvp[0] * v.x + mvp[4] * v.y + mvp[8] * v.z + mvp[12];
+    c.y = mvp[1] * v.x + mvp[5] * v.y + mvp[9] * v.z + mvp[13];
+    c.z = mvp[2] * v.x + mvp[6] * v.y + mvp[10] * v.z + mvp[14];
+    c.w = mvp[3] * v.x + mvp[7] * v.y + mvp[11] * v.z + mvp[15];
+    c.s = v.s; c.t = v.t; c.r = v.r; c.g = v.g; c.b = v.b;
+    return c;
+}
+
+VerticeClipCpu interpolarVerticeClip(const VerticeClipCpu &a, const VerticeClipCpu &b, float t) {
+    const float *pa = &a.x, *pb = &b.x;
+    VerticeClipCpu r;
+    float *pr = &r.x;
+    for (int i = 0; i < 9; i++) pr[i] = pa[i] + (pb[i] - pa[i]) * t;
+    return r;
+}
+
+// Monta o triângulo em pixels; falso se degenerado ou sem centro de pixel na
+// caixa. A montagem é em double e relativa ao primeiro vértice: a profundidade
+// do gramado fica a ~1e-5 da do chão e não pode perder precisão
+bool prepararTrianguloCpu(const VerticeClipCpu v[3], int largura, int altura,
+                          const TexturaCpu *textura, TrianguloCpu &tri) {
+    double x[3], y[3], atributos[3][7];
+    for (int i = 0; i < 3; i++) {
+        double invW = 1.0 / v[i].w;
+        x[i] = (v[i].x * invW * 0.5 + 0.5) * largura;
+        y[i] = (v[i].y * invW * 0.5 + 0.5) * altura;
+        double a[7] = {v[i].z * invW, invW, v[i].s * invW, v[i].t * invW, v[i].r * invW, v[i].g * invW, v[i].b * invW};
+        memcpy(atributos[i], a, sizeof(a));
+    }
+    tri.origemX = (float)x[0];
+    tri.origemY = (float)y[0];
+    // Aresta oposta a cada vértice (o peso baricêntrico dele), com origem no vértice 0
+    double aresta[3][3];
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3, k = (i + 2) % 3;
+        double xj = x[j] - tri.origemX, yj = y[j] - tri.origemY, xk = x[k] - tri.origemX, yk = y[k] - tri.origemY;
+        aresta[i][0] = yj - yk;
+        aresta[i][1] = xk - xj;
+        aresta[i][2] = xj * yk - yj * xk;
+    }
+    double area = aresta[0][2] + aresta[0][0] * (x[0] - tri.origemX) + aresta[0][1] * (y[0] - tri.origemY);
+    if (fabs(area) < 1e-8) return false;
+    if (area < 0.0) {                   // Sem descarte de faces: só orienta as arestas
+        for (int i = 0; i < 3; i++) for (int c = 0; c < 3; c++) aresta[i][c] = -aresta[i][c];
+        area = -area;
+    }
+    for (int i = 0; i < 3; i++) for (int c = 0; c < 3; c++) tri.aresta[i][c] = (float)aresta[i][c];
+    for (int a = 0; a < 7; a++) {
+        for (int c = 0; c < 3; c++) {
+            tri.plano[a][c] = (float)((atributos[0][a] * aresta[0][c] + atributos[1][a] * aresta[1][c]
+                                     + atributos[2][a] * aresta[2][c]) / area);
+        }
+    }
+    // Pixels cujo centro (p + 0.5) pode estar dentro
+    double minX = std::min(x[0], std::min(x[1], x[2])), maxX = std::max(x[0], std::max(x[1], x[2]));
+    double minY = std::min(y[0], std::min(y[1], y[2])), maxY = std::max(y[0], std::max(y[1], y[2]));
+    tri.minX = (int)std::max(0.0, ceil(minX - 0.5));
+    tri.minY = (int)std::max(0.0, ceil(minY - 0.5));
+    tri.maxX = (int)std::min(largura - 1.0, floor(maxX - 0.5));
+    tri.maxY = (int)std::min(altura - 1.0, floor(maxY - 0.5));
+    tri.textura = textura;
+    return tri.minX <= tri.maxX && tri.minY <= tri.maxY;
+}
+
+// Recorta no plano próximo (z >= -w) e prepara até dois triângulos
+void prepararTrianguloClipCpu(const VerticeClipCpu v[3], int largura, int altura, const TexturaCpu *textura,
+                              int colunasBlocos, TrechoPreparadoCpu &saida) {
+    VerticeClipCpu poligono[4];
+    int n = 0;
+    for (int i = 0; i < 3; i++) {
+        const VerticeClipCpu &a = v[i], &b = v[(i + 1) % 3];
+        float da = a.z + a.w, db = b.z + b.w;
+        if (da >= 0.0f) poligono[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f)) poligono[n++] = interpolarVerticeClip(a, b, da / (da - db));
+    }
+    for (int i = 2; i < n; i++) {
+        VerticeClipCpu t[3] = {poligono[0], poligono[i - 1], poligono[i]};
+        TrianguloCpu tri;
+        if (!prepararTrianguloCpu(t, largura, altura, textura, tri)) continue;
+        int indice = (int)saida.triangulos.size();
+        saida.triangulos.push_back(tri);
+        for (int by = tri.minY / TAMANHO_BLOCO_CPU; by <= tri.maxY / TAMANHO_BLOCO_CPU; by++) {
+            for (int bx = tri.minX / TAMANHO_BLOCO_CPU; bx <= tri.maxX / TAMANHO_BLOCO_CPU; bx++) {
+                saida.blocos[by * colunasBlocos + bx].push_back(indice);
+            }
+        }
+    }
+}
+
+// Sombreia um pixel coberto (atributos já divididos por w)
+inline void sombrearPixelCpu(const TrianguloCpu &tri, float w, float sw, float tw,
+                             float rw, float gw, float bw, float *cor) {
+    float r = rw * w, g = gw * w, b = bw * w;
+    if (tri.textura) {
+        float texel[3];
+        amostrarTexturaCpu(*tri.textura, sw * w, tw * w, texel);
+        r *= texel[0]; g *= texel[1]; b *= texel[2];
+    }
+    cor[0] = r; cor[1] = g; cor[2] = b;
+}
+
+// Rasteriza o triângulo dentro do bloco [x0, x1] x [y0, y1] (inclusivos);
+// 'profundidade' e 'cor' são do bloco, com origem em (bx, by)
+void rasterizarTrianguloBloco(const TrianguloCpu &tri, int bx, int by, int x0, int y0, int x1, int y1,
+                              float *profundidade, float *cor) {
+    x0 = std::max(x0, tri.minX); y0 = std::max(y0, tri.minY);
+    x1 = std::min(x1, tri.maxX); y1 = std::min(y1, tri.maxY);
+    if (x0 > x1 || y0 > y1) return;
+    const float (*e)[3] = tri.aresta;
+    const float (*p)[3] = tri.plano;
+    for (int y = y0; y <= y1; y++) {
+        float py = y + 0.5f - tri.origemY;
+        float *linhaZ = profundidade + (y - by) * TAMANHO_BLOCO_CPU - bx;
+        float *linhaCor = cor + ((y - by) * TAMANHO_BLOCO_CPU - bx) * 3;
+#ifdef USAR_SSE
+        const __m128 deslocamentos = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 origemX = _mm_set1_ps(tri.origemX);
+        __m128 limiteX = _mm_set1_ps((float)x1 + 0.5f);
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 pixel = _mm_add_ps(_mm_set1_ps((float)x), deslocamentos);
+            __m128 dentro = _mm_cmple_ps(pixel, limiteX);
+            __m128 px = _mm_sub_ps(pixel, origemX);
+            for (int a = 0; a < 3; a++) {
+                __m128 valor = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e[a][0]), px), _mm_set1_ps(e[a][1] * py + e[a][2]));
+                dentro = _mm_and_ps(dentro, _mm_cmpge_ps(valor, _mm_setzero_ps()));
+            }
+            if (_mm_movemask_ps(dentro) == 0) continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0][0]), px), _mm_set1_ps(p[0][1] * py + p[0][2]));
+            // Carga sem alinhamento; as pistas além de x1 já estão fora da máscara
+            float zAtual[4];
+            for (int l = 0; l < 4; l++) zAtual[l] = (x + l <= x1) ? linhaZ[x + l] : 0.0f;
+            dentro = _mm_and_ps(dentro, _mm_cmplt_ps(z, _mm_loadu_ps(zAtual)));
+            int mascara = _mm_movemask_ps(dentro);
+            if (mascara == 0) continue;
+            float atributos[6][4], zPistas[4];
+            _mm_storeu_ps(zPistas, z);
+            for (int a = 1; a < 7; a++) {
+                __m128 valor = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[a][0]), px), _mm_set1_ps(p[a][1] * py + p[a][2]));
+                _mm_storeu_ps(atributos[a - 1], valor);
+            }
+            for (int l = 0; l < 4; l++) {
+                if (!(mascara & (1 << l))) continue;
+                linhaZ[x + l] = zPistas[l];
+                sombrearPixelCpu(tri, 1.0f / atributos[0][l], atributos[1][l], atributos[2][l],
+                                 atributos[3][l], atributos[4][l], atributos[5][l], linhaCor + (x + l) * 3);
+            }
+        }
+#else
+        for (int x = x0; x <= x1; x++) {
+            float px = x + 0.5f - tri.origemX;
+            if (e[0][0] * px + e[0][1] * py + e[0][2] < 0.0f || e[1][0] * px + e[1][1] * py + e[1][2] < 0.0f
+                || e[2][0] * px + e[2][1] * py + e[2][2] < 0.0f) continue;
+            float z = p[0][0] * px + p[0][1] * py + p[0][2];
+            if (z >= linhaZ[x]) continue;
+            linhaZ[x] = z;
+            float a[6];
+            for (int i = 0; i < 6; i++) a[i] = p[i + 1][0] * px + p[i + 1][1] * py + p[i + 1][2];
+            sombrearPixelCpu(tri, 1.0f / a[0], a[1], a[2], a[3], a[4], a[5], linhaCor + x * 3);
+        }
+#endif
+    }
+}
+
+// Desenha a cena em 'imagem' (largura e altura da cena) e imprime os tempos por bloco
+void renderizarCenaCpu(const EstadoCena &cena, ImagemCpu &imagem) {
+    RASTREAR_FUNCAO();
+    int largura = std::max(cena.larguraJanela, 1), altura = std::max(cena.alturaJanela, 1);
+    imagem.largura = largura;
+    imagem.altura = altura;
+    imagem.rgb.assign((size_t)largura * altura * 3, 0);
+    double inicio = tempoAtualMs();
+
+    float modelview[16], mvp[16];
+    matrizCameraCena(cena, modelview);
+    matrizPerspectiva(mvp, CAMPO_VISAO_GRAUS, (float)largura / altura, PLANO_PROXIMO, PLANO_DISTANTE);
+    posMultiplicarMatriz(mvp, modelview);
+
+    // Entrada na ordem do GL: passos da malha e depois os assentos
+    std::vector<LoteCpu> lotes;
+    const PassoRender passos[] = {
+        PASSO_CHAO, PASSO_GRAMA, PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS
+    };
+    for (size_t i = 0; i < sizeof(passos) / sizeof(passos[0]); i++) {
+        const LoteMalha &lote = lotesMalha[passos[i]];
+        if (lote.vertices.empty()) continue;
+        LoteCpu l = {&lote.vertices[0], (int)lote.vertices.size() / 3, texturaCpuDoLote(lote)};
+        lotes.push_back(l);
+    }
+    // Assentos no mesmo nível de detalhe que o GL escolheria
+    std::vector<VerticeMalha> verticesAssentos;
+    if (layoutAssentosAtual.load() != LAYOUT_OCULTO) {
+        Vetor3 olho = posicaoOlhoMatriz(modelview);
+        float focoPixels = altura / (2.0f * tanf(GRAUS_PARA_RAD(CAMPO_VISAO_GRAUS) * 0.5f));
+        for (size_t b = 0; b < blocosAssentos.size(); b++) {
+            if (blocosAssentos[b].quantidade == 0) continue;
+            const std::vector<VerticeAssento> &v =
+                blocosAssentos[b].lod[nivelDetalheBlocoAssentos(blocosAssentos[b], olho, focoPixels)];
+            for (size_t i = 0; i < v.size(); i++) {
+                VerticeMalha m = {0.0f, 0.0f, v[i].r / 255.0f, v[i].g / 255.0f, v[i].b / 255.0f,
+                                  0.0f, 0.0f, 1.0f, v[i].x, v[i].y, v[i].z};
+                verticesAssentos.push_back(m);
+            }
+        }
+        if (!verticesAssentos.empty()) {
+            LoteCpu l = {&verticesAssentos[0], (int)verticesAssentos.size() / 3, NULL};
+            lotes.push_back(l);
+        }
+    }
+    std::vector<int> primeiroTriangulo(lotes.size() + 1, 0);
+    for (size_t i = 0; i < lotes.size(); i++) primeiroTriangulo[i + 1] = primeiroTriangulo[i] + lotes[i].numTriangulos;
+    int totalTriangulos = primeiroTriangulo.back();
+
+    // Preparação e distribuição nos blocos, por trechos da entrada
+    int colunasBlocos = (largura + TAMANHO_BLOCO_CPU - 1) / TAMANHO_BLOCO_CPU;
+    int linhasBlocos = (altura + TAMANHO_BLOCO_CPU - 1) / TAMANHO_BLOCO_CPU;
+    int numBlocos = colunasBlocos * linhasBlocos;
+    std::vector<TrechoPreparadoCpu> trechos(NUM_TRECHOS_PREPARACAO_CPU);
+    executarEmParalelo(0, NUM_TRECHOS_PREPARACAO_CPU, 1, [&](int c) {
+        TrechoPreparadoCpu &trecho = trechos[c];
+        trecho.blocos.resize(numBlocos);
+        int ini = (int)((long long)totalTriangulos * c / NUM_TRECHOS_PREPARACAO_CPU);
+        int fim = (int)((long long)totalTriangulos * (c + 1) / NUM_TRECHOS_PREPARACAO_CPU);
+        size_t l = std::upper_bound(primeiroTriangulo.begin(), primeiroTriangulo.end(), ini) - primeiroTriangulo.begin() - 1;
+        for (int t = ini; t < fim; t++) {
+            while (t >= primeiroTriangulo[l + 1]) l++;
+            const VerticeMalha *v = lotes[l].vertices + (t - primeiroTriangulo[l]) * 3;
+            VerticeClipCpu clip[3] = {transformarVerticeCpu(mvp, v[0]), transformarVerticeCpu(mvp, v[1]),
+                                      transformarVerticeCpu(mvp, v[2])};
+            // Fora por inteiro de um dos planos laterais (ou atrás do olho)
+            bool fora = false;
+            for (int eixo = 0; eixo < 3 && !fora; eixo++) {
+                const float *c0 = &clip[0].x, *c1 = &clip[1].x, *c2 = &clip[2].x;
+                fora = (c0[eixo] > c0[3] && c1[eixo] > c1[3] && c2[eixo] > c2[3])
+                    || (c0[eixo] < -c0[3] && c1[eixo] < -c1[3] && c2[eixo] < -c2[3]);
+            }
+            if (!fora) prepararTrianguloClipCpu(clip, largura, altura, lotes[l].textura, colunasBlocos, trecho);
+        }
+    });
+    double fimPreparacao = tempoAtualMs();
+
+    // Rasterização: uma tarefa por bloco
+    std::vector<double> tempoBloco(numBlocos, 0.0);
+    float fatorNoite = powf(1.0f - std::min(std::max(cena.alphaFiltro, 0.0f), 1.0f), 4.0f); // 4 quads pretos
+    executarEmParalelo(0, numBlocos, 1, [&](int b) {
+        double inicioBloco = tempoAtualMs();
+        int bx = (b % colunasBlocos) * TAMANHO_BLOCO_CPU, by = (b / colunasBlocos) * TAMANHO_BLOCO_CPU;
+        int x1 = std::min(bx + TAMANHO_BLOCO_CPU, largura) - 1, y1 = std::min(by + TAMANHO_BLOCO_CPU, altura) - 1;
+        std::vector<float> profundidade(TAMANHO_BLOCO_CPU * TAMANHO_BLOCO_CPU, 1.0f);
+        std::vector<float> cor(TAMANHO_BLOCO_CPU * TAMANHO_BLOCO_CPU * 3);
+        for (int i = 0; i < TAMANHO_BLOCO_CPU * TAMANHO_BLOCO_CPU; i++) {
+            for (int c = 0; c < 3; c++) cor[i * 3 + c] = COR_CEU[c];
+        }
+        for (int c = 0; c < NUM_TRECHOS_PREPARACAO_CPU; c++) {
+            const TrechoPreparadoCpu &trecho = trechos[c];
+            const std::vector<int> &lista = trecho.blocos[b];
+            for (size_t i = 0; i < lista.size(); i++) {
+                rasterizarTrianguloBloco(trecho.triangulos[lista[i]], bx, by, bx, by, x1, y1,
+                                         &profundidade[0], &cor[0]);
+            }
+        }
+        for (int y = by; y <= y1; y++) {
+            for (int x = bx; x <= x1; x++) {
+                const float *c = &cor[((y - by) * TAMANHO_BLOCO_CPU + (x - bx)) * 3];
+                unsigned char *saida = &imagem.rgb[((size_t)y * largura + x) * 3];
+                for (int k = 0; k < 3; k++) {
+                    float v = std::min(std::max(c[k], 0.0f), 1.0f) * fatorNoite;
+                    saida[k] = (unsigned char)(v * 255.0f + 0.5f);
+                }
+            }
+        }
+        tempoBloco[b] = tempoAtualMs() - inicioBloco;
+    });
+    double fimRasterizacao = tempoAtualMs();
+
+    unsigned long preparados = 0, referencias = 0;
+    for (int c = 0; c < NUM_TRECHOS_PREPARACAO_CPU; c++) {
+        preparados += trechos[c].triangulos.size();
+        for (int b = 0; b < numBlocos; b++) referencias += trechos[c].blocos[b].size();
+    }
+    int maisLento = (int)(std::max_element(tempoBloco.begin(), tempoBloco.end()) - tempoBloco.begin());
+    double soma = 0.0;
+    for (int b = 0; b < numBlocos; b++) soma += tempoBloco[b];
+    printf("Render CPU %dx%d: %d triângulos, %lu na tela, %lu referências em %d blocos de %d px\n",
+           largura, altura, totalTriangulos, preparados, referencias, numBlocos, TAMANHO_BLOCO_CPU);
+    printf("  preparação %.2f ms, rasterização %.2f ms (%d threads)\n",
+           fimPreparacao - inicio, fimRasterizacao - fimPreparacao, numTrabalhadores + 1);
+    printf("  por bloco: média %.3f ms, máximo %.3f ms no bloco (%d, %d)\n", soma / numBlocos,
+           tempoBloco[maisLento], maisLento % colunasBlocos, maisLento / colunasBlocos);
+    // Mapa dos tempos (ms), com a linha de cima da imagem primeiro
+    for (int by = linhasBlocos - 1; by >= 0; by--) {
+        printf("  ");
+        for (int bx = 0; bx < colunasBlocos; bx++) printf("%6.2f", tempoBloco[by * colunasBlocos + bx]);
+        printf("\n");
+    }
+}
+
+// PPM binário (P6), linha de cima primeiro
+bool gravarImagemPpm(const char *nomeArquivo, const ImagemCpu &imagem) {
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao gravar '%s'\n", nomeArquivo);
+        return false;
+    }
+    fprintf(arquivo, "P6\n%d %d\n255\n", imagem.largura, imagem.altura);
+    for (int y = imagem.altura - 1; y >= 0; y--) {
+        fwrite(&imagem.rgb[(size_t)y * imagem.largura * 3], 1, imagem.largura * 3, arquivo);
+    }
+    fclose(arquivo);
+    return true;
+}
+
+// CRC-32 do PNG (polinômio 0xEDB88320), acumulável
+unsigned int crc32Png(unsigned int crc, const unsigned char *dados, size_t n) {
+    static unsigned int tabela[256];
+    static bool tabelaPronta = false;
+    if (!tabelaPronta) {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            tabela[i] = c;
+        }
+        tabelaPronta = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = tabela[(crc ^ dados[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void anexarInteiroBigEndian(std::vector<unsigned char> &saida, unsigned int v) {
+    saida.push_back((unsigned char)(v >> 24));
+    saida.push_back((unsigned char)(v >> 16));
+    saida.push_back((unsigned char)(v >> 8));
+    saida.push_back((unsigned char)v);
+}
+
+void gravarBlocoPng(FILE *arquivo, const char *tipo, const std::vector<unsigned char> &dados) {
+    std::vector<unsigned char> bloco;
+    anexarInteiroBigEndian(bloco, (unsigned int)dados.size());
+    bloco.insert(bloco.end(), tipo, tipo + 4);
+    bloco.insert(bloco.end(), dados.begin(), dados.end());
+    anexarInteiroBigEndian(bloco, crc32Png(0, &bloco[4], bloco.size() - 4));
+    fwrite(&bloco[0], 1, bloco.size(), arquivo);
+}
+
+// PNG RGB de 8 bits sem dependências: o zlib usa blocos 'stored' (sem
+// compressão), o que basta para imagens de saída e é lido por qualquer leitor
+bool gravarImagemPng(const char *nomeArquivo, const ImagemCpu &imagem) {
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao gravar '%s'\n", nomeArquivo);
+        return false;
+    }
+    const unsigned char assinatura[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(assinatura, 1, sizeof(assinatura), arquivo);
+    std::vector<unsigned char> cabecalho;
+    anexarInteiroBigEndian(cabecalho, imagem.largura);
+    anexarInteiroBigEndian(cabecalho, imagem.altura);
+    const unsigned char formato[5] = {8, 2, 0, 0, 0}; // 8 bits, RGB, deflate, filtro 0, sem entrelaçamento
+    cabecalho.insert(cabecalho.end(), formato, formato + 5);
+    gravarBlocoPng(arquivo, "IHDR", cabecalho);
+
+    // Linhas de cima para baixo, cada uma com o byte de filtro 0
+    size_t bytesLinha = (size_t)imagem.largura * 3;
+    std::vector<unsigned char> bruto;
+    bruto.reserve((bytesLinha + 1) * imagem.altura);
+    for (int y = imagem.altura - 1; y >= 0; y--) {
+        bruto.push_back(0);
+        const unsigned char *linha = &imagem.rgb[(size_t)y * bytesLinha];
+        bruto.insert(bruto.end(), linha, linha + bytesLinha);
+    }
+    std::vector<unsigned char> zlib;
+    zlib.reserve(bruto.size() + bruto.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    unsigned int adlerA = 1, adlerB = 0;
+    for (size_t inicio = 0; inicio < bruto.size(); inicio += 65535) {
+        size_t n = std::min(bruto.size() - inicio, (size_t)65535);
+        zlib.push_back(inicio + n >= bruto.size() ? 1 : 0);
+        zlib.push_back((unsigned char)n);
+        zlib.push_back((unsigned char)(n >> 8));
+        zlib.push_back((unsigned char)~n);
+        zlib.push_back((unsigned char)(~n >> 8));
+        zlib.insert(zlib.end(), bruto.begin() + inicio, bruto.begin() + inicio + n);
+        for (size_t i = inicio; i < inicio + n; i++) {
+            adlerA = (adlerA + bruto[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+    anexarInteiroBigEndian(zlib, (adlerB << 16) | adlerA);
+    gravarBlocoPng(arquivo, "IDAT", zlib);
+    gravarBlocoPng(arquivo, "IEND", std::vector<unsigned char>());
+    bool ok = !ferror(arquivo);
+    fclose(arquivo);
+    return ok;
+}
+
+bool extensaoArquivo(const char *nomeArquivo, const char *extensao) {
+    size_t n = strlen(nomeArquivo), m = strlen(extensao);
+    if (n < m) return false;
+    for (size_t i = 0; i < m; i++) {
+        if (tolower((unsigned char)nomeArquivo[n - m + i]) != extensao[i]) return false;
+    }
+    return true;
+}
+
+// PNG se o nome terminar em .png, PPM nos demais casos
+bool gravarImagem(const char *nomeArquivo, const ImagemCpu &imagem) {
+    if (extensaoArquivo(nomeArquivo, ".png")) return gravarImagemPng(nomeArquivo, imagem);
+    return gravarImagemPpm(nomeArquivo, imagem);
+}
+
+// PSNR (dB) contra uma imagem de referência do mesmo tamanho (qualquer
+// formato lido pelo stb_image, como o PPM de --capturar-gl); negativo se não der
+float compararImagemReferencia(const ImagemCpu &imagem, const char *nomeArquivo) {
+    int largura, altura, numCanais;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *dados = stbi_load(nomeArquivo, &largura, &altura, &numCanais, 3);
+    if (!dados) {
+        fprintf(stderr, "Erro ao ler a referência '%s': %s\n", nomeArquivo, stbi_failure_reason());
+        return -1.0f;
+    }
+    if (largura != imagem.largura || altura != imagem.altura) {
+        fprintf(stderr, "Referência '%s' com %dx%d, imagem com %dx%d\n",
+                nomeArquivo, largura, altura, imagem.largura, imagem.altura);
+        stbi_image_free(dados);
+        return -1.0f;
+    }
+    double somaQuadrados = 0.0;
+    size_t n = (size_t)largura * altura * 3;
+    for (size_t i = 0; i < n; i++) {
+        double d = (double)dados[i] - imagem.rgb[i];
+        somaQuadrados += d * d;
+    }
+    stbi_image_free(dados);
+    double mse = somaQuadrados / n;
+    return mse > 0.0 ? (float)(10.0 * log10(255.0 * 255.0 / mse)) : 99.0f;
+}
+
+// --render-cpu: sem janela nem contexto GL; retorna o código de saída
+int executarRenderCpu(const char *arquivoSaida, const char *arquivoReferencia) {
+    for (int i = 0; i < NUM_TEXTURAS_CPU; i++) carregarTexturaCpu(ARQUIVOS_TEXTURAS_CPU[i], texturasCpu[i]);
+    construirMalhaEstadio(fatorDetalheMalha.load());
+    construirAssentos(layoutAssentosAtual.load());
+    publicarEstadoCena();
+    ImagemCpu imagem;
+    renderizarCenaCpu(consumirEstadoCena(), imagem);
+    if (!gravarImagem(arquivoSaida, imagem)) return 1;
+    printf("Imagem gravada em '%s'\n", arquivoSaida);
+    if (!arquivoReferencia) return 0;
+    float psnr = compararImagemReferencia(imagem, arquivoReferencia);
+    if (psnr < 0.0f) return 1;
+    printf("PSNR contra '%s': %.2f dB (mínimo %.0f dB)\n", arquivoReferencia, psnr, LIMIAR_PSNR_REFERENCIA);
+    return psnr >= LIMIAR_PSNR_REFERENCIA ? 0 : 1;
+}
+
+// --capturar-gl: grava o primeiro quadro do GL no mesmo formato e encerra
+const char *arquivoCapturaGl = NULL;
+
+void capturarQuadroGl(const char *nomeArquivo, int largura, int altura) {
+    ImagemCpu imagem;
+    imagem.largura = largura;
+    imagem.altura = altura;
+    imagem.rgb.resize((size_t)largura * altura * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, largura, altura, GL_RGB, GL_UNSIGNED_BYTE, &imagem.rgb[0]);
+    if (gravarImagem(nomeArquivo, imagem)) printf("Quadro do GL gravado em '%s'\n", nomeArquivo);
+}
+
+// --- Imagens Estáticas com Traçado de Caminhos ---
+// Modo --render-still: traçado de caminhos da mesma cena, sem janela, para
+// imagens de divulgação. Uma BVH própria cobre todos os triângulos da malha
+// (inclusive chão e gramado) e os assentos no nível de detalhe 0; para cada
+// triângulo guardam-se os três vértices originais, cujas coordenadas de
+// textura e cores são interpoladas pelas coordenadas baricêntricas do
+// acerto. As superfícies são lambertianas, com albedo = textura x cor do
+// vértice em espaço linear. De dia a luz vem do sol de direcaoSol() (disco de
+// 0,53°, amostrado em cada vértice do caminho com um raio de sombra) e de um
+// céu em degradê; com o sol abaixo do horizonte acendem-se os refletores da
+// borda da marquise, luzes pontuais com abertura em cone das quais uma é
+// sorteada por vértice. Os caminhos seguem com rebatimentos cossenoidais e
+// roleta russa. O refinamento é progressivo: cada passada soma uma amostra
+// por pixel, em blocos de TAMANHO_BLOCO_CAMINHOS pixels distribuídos pelo
+// sistema de tarefas, e a imagem parcial é regravada a cada
+// PERIODO_GRAVACAO_CAMINHOS_S. A saída é EXR (radiância linear em ponto
+// flutuante) ou PNG/PPM (exposição automática pela área do estádio, curva
+// ACES e sRGB), conforme a extensão. A torcida fica de fora.
+const int TAMANHO_BLOCO_CAMINHOS = 32;
+const int PROFUNDIDADE_MAXIMA_CAMINHO = 8;
+const int SALTOS_ANTES_ROLETA = 2;
+const float DISTANCIA_MAXIMA_CAMINHO = 1000.0f;
+const float DESLOCAMENTO_RAIO_CAMINHO = 1e-4f;  // Afasta da superfície a origem dos raios seguintes
+const float RAIO_ANGULAR_SOL = 0.00465f;        // rad (metade dos 0,53° do disco)
+const float IRRADIANCIA_SOL = 3.0f;             // Mesma escala relativa de RADIANCIA_CEU
+const float RADIANCIA_CEU = 0.4f;
+const float RADIANCIA_CEU_NOITE = 0.002f;
+const float INTENSIDADE_REFLETOR = 0.004f;      // Por refletor
+const float ABERTURA_REFLETOR_GRAUS = 35.0f;    // Meia abertura do cone a partir do eixo
+const float PENUMBRA_REFLETOR_GRAUS = 10.0f;
+const float CHAVE_EXPOSICAO = 0.18f;            // Cinza médio da exposição automática
+const double PERIODO_GRAVACAO_CAMINHOS_S = 30.0;
+
+struct CenaCaminhos {
+    Bvh bvh;
+    std::vector<VerticeMalha> vertices;         // 3 por triângulo, na ordem de bvh.vertices
+    std::vector<const TexturaCpu *> texturas;   // Por triângulo (NULL: só a cor)
+    int primeiroTrianguloEstadio;               // Os anteriores são do chão
+};
+
+struct LuzesCaminhos {
+    Vetor3 sol, corSol;
+    bool dia;                                   // Sol acima do horizonte
+    float fatorCeu;                             // 1 de dia, cai no crepúsculo
+    std::vector<Vetor3> refletores, eixosRefletores;
+};
+
+void adicionarTriangulosCaminhos(CenaCaminhos &cena, const VerticeMalha *v, int numTriangulos,
+                                 const TexturaCpu *textura) {
+    cena.vertices.insert(cena.vertices.end(), v, v + numTriangulos * 3);
+    cena.texturas.insert(cena.texturas.end(), numTriangulos, textura);
+}
+
+void construirCenaCaminhos(CenaCaminhos &cena) {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    cena.primeiroTrianguloEstadio = 0;
+    const PassoRender passos[] = {
+        PASSO_CHAO, PASSO_GRAMA, PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS
+    };
+    for (size_t i = 0; i < sizeof(passos) / sizeof(passos[0]); i++) {
+        const LoteMalha &lote = lotesMalha[passos[i]];
+        if (lote.vertices.empty()) continue;
+        adicionarTriangulosCaminhos(cena, &lote.vertices[0], (int)lote.vertices.size() / 3, texturaCpuDoLote(lote));
+        if (passos[i] == PASSO_CHAO) cena.primeiroTrianguloEstadio = (int)cena.texturas.size();
+    }
+    if (layoutAssentosAtual.load() != LAYOUT_OCULTO) {
+        std::vector<VerticeMalha> assentos;
+        for (size_t b = 0; b < blocosAssentos.size(); b++) {
+            const std::vector<VerticeAssento> &v = blocosAssentos[b].lod[0];
+            for (size_t i = 0; i < v.size(); i++) {
+                VerticeMalha m = {0.0f, 0.0f, v[i].r / 255.0f, v[i].g / 255.0f, v[i].b / 255.0f,
+                                  0.0f, 0.0f, 1.0f, v[i].x, v[i].y, v[i].z};
+                assentos.push_back(m);
+            }
+        }
+        if (!assentos.empty()) adicionarTriangulosCaminhos(cena, &assentos[0], (int)assentos.size() / 3, NULL);
+    }
+    std::vector<Vetor3> posicoes(cena.vertices.size());
+    for (size_t i = 0; i < posicoes.size(); i++) {
+        posicoes[i] = vetor3(cena.vertices[i].x, cena.vertices[i].y, cena.vertices[i].z);
+    }
+    construirBvh(cena.bvh, posicoes);
+    printf("Traçado de caminhos: %lu triângulos, BVH com %lu nós em %.2f ms\n",
+           (unsigned long)cena.texturas.size(), (unsigned long)cena.bvh.nos.size(), tempoAtualMs() - inicio);
+}
+
+// Refletor na fração dada do vão da marquise: logo abaixo da borda frontal,
+// apontado para o centro do gramado
+void refletorMarquise(float fracao, Vetor3 &posicao, Vetor3 &eixo) {
+    float angulo = GRAUS_PARA_RAD(anguloInicialMarquiseMalha
+                                  + fracao * (MARQUISE_ANGULO_FINAL - anguloInicialMarquiseMalha));
+    posicao = vetor3(estadio.centro_x + (estadio.rx_frente_marquise - 0.005f) * cosf(angulo),
+                     estadio.centro_y + (estadio.ry_frente_marquise - 0.005f) * sinf(angulo),
+                     estadio.z_frente_marquise - MARQUISE_ESPESSURA - 0.005f);
+    eixo = normalizar(vetor3(estadio.centro_x, estadio.centro_y, Z_GRAMADO) - posicao);
+}
+
+void prepararLuzesCaminhos(LuzesCaminhos &luzes, float horaSolar) {
+    luzes.sol = direcaoSol(diaDoAnoSol, horaSolar);
+    luzes.dia = luzes.sol.z > 0.0f;
+    // Mais avermelhado perto do horizonte
+    float altura = std::min(std::max(luzes.sol.z / 0.3f, 0.0f), 1.0f);
+    luzes.corSol = vetor3(1.0f, 0.55f + 0.4f * altura, 0.3f + 0.6f * altura) * IRRADIANCIA_SOL;
+    // O céu escurece até o sol ficar 6° abaixo do horizonte
+    luzes.fatorCeu = std::min(std::max((luzes.sol.z + 0.105f) / 0.305f, 0.0f), 1.0f);
+    luzes.refletores.clear();
+    luzes.eixosRefletores.clear();
+    if (luzes.dia) return;
+    for (int i = 0; i < NUM_REFLETORES_MARQUISE; i++) {
+        Vetor3 p, eixo;
+        refletorMarquise((float)i / (float)(NUM_REFLETORES_MARQUISE - 1), p, eixo);
+        luzes.refletores.push_back(p);
+        luzes.eixosRefletores.push_back(eixo);
+    }
+}
+
+inline float aleatorioCaminho(unsigned int &semente) {
+    semente = semente * 747796405U + 2891336453U;
+    return hashUnitario(semente);
+}
+
+// Base ortonormal (t, b, n) sem ramos (Duff et al.)
+void baseOrtonormal(const Vetor3 &n, Vetor3 &t, Vetor3 &b) {
+    float sinal = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (sinal + n.z);
+    float c = n.x * n.y * a;
+    t = vetor3(1.0f + sinal * n.x * n.x * a, sinal * c, -sinal * n.x);
+    b = vetor3(c, sinal + n.y * n.y * a, -n.y);
+}
+
+Vetor3 direcaoCossenoidal(const Vetor3 &n, float u1, float u2) {
+    Vetor3 t, b;
+    baseOrtonormal(n, t, b);
+    float r = sqrtf(u1), fi = 2.0f * PI * u2;
+    return t * (r * cosf(fi)) + b * (r * sinf(fi)) + n * sqrtf(std::max(0.0f, 1.0f - u1));
+}
+
+// Uniforme no cone de cosseno mínimo 'cosMaximo' em torno de 'eixo'
+Vetor3 direcaoNoCone(const Vetor3 &eixo, float cosMaximo, float u1, float u2) {
+    Vetor3 t, b;
+    baseOrtonormal(eixo, t, b);
+    float cosTeta = 1.0f - u1 * (1.0f - cosMaximo);
+    float sinTeta = sqrtf(std::max(0.0f, 1.0f - cosTeta * cosTeta)), fi = 2.0f * PI * u2;
+    return t * (sinTeta * cosf(fi)) + b * (sinTeta * sinf(fi)) + eixo * cosTeta;
+}
+
+Vetor3 albedoCaminhos(const CenaCaminhos &cena, const AcertoRaio &acerto) {
+    const VerticeMalha *v = &cena.vertices[acerto.triangulo * 3];
+    float w0 = 1.0f - acerto.u - acerto.v, w1 = acerto.u, w2 = acerto.v;
+    float cor[3] = {w0 * v[0].r + w1 * v[1].r + w2 * v[2].r,
+                    w0 * v[0].g + w1 * v[1].g + w2 * v[2].g,
+                    w0 * v[0].b + w1 * v[1].b + w2 * v[2].b};
+    const TexturaCpu *textura = cena.texturas[acerto.triangulo];
+    if (textura) {
+        float texel[3];
+        amostrarTexturaCpu(*textura, w0 * v[0].s + w1 * v[1].s + w2 * v[2].s,
+                           w0 * v[0].t + w1 * v[1].t + w2 * v[2].t, texel);
+        for (int c = 0; c < 3; c++) cor[c] *= texel[c];
+    }
+    // Texturas e cores estão em sRGB
+    return vetor3(powf(cor[0], 2.2f), powf(cor[1], 2.2f), powf(cor[2], 2.2f));
+}
+
+Vetor3 radianciaCeu(const LuzesCaminhos &luzes, const Vetor3 &direcao) {
+    float altura = sqrtf(std::max(direcao.z, 0.0f));
+    Vetor3 horizonte = vetor3(0.75f, 0.85f, 0.95f);
+    Vetor3 zenite = vetor3(powf(COR_CEU[0], 2.2f), powf(COR_CEU[1], 2.2f), powf(COR_CEU[2], 2.2f));
+    float brilho = RADIANCIA_CEU_NOITE + (RADIANCIA_CEU - RADIANCIA_CEU_NOITE) * luzes.fatorCeu;
+    return interpolar(horizonte, zenite, altura) * brilho;
+}
+
+// Luz direta refletida em 'p' (já afastado da superfície), com um raio de sombra
+Vetor3 luzDiretaCaminhos(const CenaCaminhos &cena, const LuzesCaminhos &luzes, const Vetor3 &p, const Vetor3 &n,
+                         unsigned int &semente, long &raios) {
+    Vetor3 nada = vetor3(0.0f, 0.0f, 0.0f);
+    if (luzes.dia) {
+        Vetor3 l = direcaoNoCone(luzes.sol, cosf(RAIO_ANGULAR_SOL), aleatorioCaminho(semente), aleatorioCaminho(semente));
+        float cosTeta = produtoEscalar(n, l);
+        if (cosTeta <= 0.0f) return nada;
+        raios++;
+        if (raioOcluido(cena.bvh, prepararRaio(p, l), DISTANCIA_MAXIMA_CAMINHO)) return nada;
+        return luzes.corSol * (cosTeta / PI);
+    }
+    int numRefletores = (int)luzes.refletores.size();
+    if (numRefletores == 0) return nada;
+    int i = std::min((int)(aleatorioCaminho(semente) * numRefletores), numRefletores - 1);
+    Vetor3 paraLuz = luzes.refletores[i] - p;
+    float distancia2 = produtoEscalar(paraLuz, paraLuz), distancia = sqrtf(distancia2);
+    Vetor3 l = paraLuz * (1.0f / distancia);
+    float cosTeta = produtoEscalar(n, l);
+    if (cosTeta <= 0.0f) return nada;
+    float cosDentro = cosf(GRAUS_PARA_RAD(ABERTURA_REFLETOR_GRAUS));
+    float cosFora = cosf(GRAUS_PARA_RAD(ABERTURA_REFLETOR_GRAUS + PENUMBRA_REFLETOR_GRAUS));
+    float cone = (-produtoEscalar(l, luzes.eixosRefletores[i]) - cosFora) / (cosDentro - cosFora);
+    if (cone <= 0.0f) return nada;
+    cone = std::min(cone, 1.0f);
+    cone = cone * cone * (3.0f - 2.0f * cone);
+    raios++;
+    if (raioOcluido(cena.bvh, prepararRaio(p, l), distancia * 0.999f)) return nada;
+    // Uma luz sorteada entre numRefletores: peso numRefletores
+    return vetor3(1.0f, 0.92f, 0.8f) * (INTENSIDADE_REFLETOR * cone * cosTeta * numRefletores / (distancia2 * PI));
+}
+
+Vetor3 radianciaCaminho(const CenaCaminhos &cena, const LuzesCaminhos &luzes, Vetor3 origem, Vetor3 direcao,
+                        unsigned int &semente, long &raios, bool &viuEstadio) {
+    Vetor3 total = vetor3(0.0f, 0.0f, 0.0f), peso = vetor3(1.0f, 1.0f, 1.0f);
+    for (int salto = 0; salto < PROFUNDIDADE_MAXIMA_CAMINHO; salto++) {
+        AcertoRaio acerto;
+        raios++;
+        if (!intersectarRaio(cena.bvh, prepararRaio(origem, direcao), DISTANCIA_MAXIMA_CAMINHO, acerto)) {
+            Vetor3 ceu = radianciaCeu(luzes, direcao);
+            // O disco do sol só conta visto da câmera; nos rebatimentos já entrou como luz direta
+            if (salto == 0 && luzes.dia && produtoEscalar(direcao, luzes.sol) >= cosf(RAIO_ANGULAR_SOL)) {
+                ceu = ceu + luzes.corSol * (1.0f / (PI * RAIO_ANGULAR_SOL * RAIO_ANGULAR_SOL));
+            }
+            total = total + produtoComponentes(peso, ceu);
+            break;
+        }
+        if (salto == 0) viuEstadio = acerto.triangulo >= cena.primeiroTrianguloEstadio;
+        const Vetor3 *v = &cena.bvh.vertices[acerto.triangulo * 3];
+        Vetor3 n = normalizar(produtoVetorial(v[1] - v[0], v[2] - v[0]));
+        if (produtoEscalar(n, direcao) > 0.0f) n = n * -1.0f;  // Faces dos dois lados, como no GL
+        Vetor3 p = origem + direcao * acerto.t + n * DESLOCAMENTO_RAIO_CAMINHO;
+        peso = produtoComponentes(peso, albedoCaminhos(cena, acerto));
+        total = total + produtoComponentes(peso, luzDiretaCaminhos(cena, luzes, p, n, semente, raios));
+        if (salto + 1 >= SALTOS_ANTES_ROLETA) {
+            float q = std::min(std::max(std::max(peso.x, std::max(peso.y, peso.z)), 0.05f), 0.95f);
+            if (aleatorioCaminho(semente) > q) break;
+            peso = peso * (1.0f / q);
+        }
+        origem = p;
+        direcao = direcaoCossenoidal(n, aleatorioCaminho(semente), aleatorioCaminho(semente));
+    }
+    return total;
+}
+
+void anexarInteiroLittleEndian(std::vector<unsigned char> &saida, unsigned int v) {
+    for (int i = 0; i < 4; i++) saida.push_back((unsigned char)(v >> (8 * i)));
+}
+
+void anexarFloatLittleEndian(std::vector<unsigned char> &saida, float f) {
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    anexarInteiroLittleEndian(saida, bits);
+}
+
+void anexarAtributoExr(std::vector<unsigned char> &saida, const char *nome, const char *tipo,
+                       const std::vector<unsigned char> &valor) {
+    saida.insert(saida.end(), nome, nome + strlen(nome) + 1);
+    saida.insert(saida.end(), tipo, tipo + strlen(tipo) + 1);
+    anexarInteiroLittleEndian(saida, (unsigned int)valor.size());
+    saida.insert(saida.end(), valor.begin(), valor.end());
+}
+
+// OpenEXR mínimo: linhas de varredura sem compressão, canais B, G, R em
+// FLOAT; 'rgb' com a linha 0 embaixo, como ImagemCpu
+bool gravarImagemExr(const char *nomeArquivo, int largura, int altura, const std::vector<float> &rgb) {
+    std::vector<unsigned char> dados, valor;
+    anexarInteiroLittleEndian(dados, 20000630);         // Número mágico
+    anexarInteiroLittleEndian(dados, 2);                // Versão 2, uma parte, linhas de varredura
+    const char *canais = "BGR";                         // Em ordem alfabética
+    for (int c = 0; c < 3; c++) {
+        valor.push_back(canais[c]);
+        valor.push_back(0);
+        anexarInteiroLittleEndian(valor, 2);            // FLOAT
+        for (int k = 0; k < 4; k++) valor.push_back(0); // pLinear e reservados
+        anexarInteiroLittleEndian(valor, 1);            // Amostragem x e y
+        anexarInteiroLittleEndian(valor, 1);
+    }
+    valor.push_back(0);
+    anexarAtributoExr(dados, "channels", "chlist", valor);
+    anexarAtributoExr(dados, "compression", "compression", std::vector<unsigned char>(1, 0));
+    valor.clear();
+    anexarInteiroLittleEndian(valor, 0);
+    anexarInteiroLittleEndian(valor, 0);
+    anexarInteiroLittleEndian(valor, largura - 1);
+    anexarInteiroLittleEndian(valor, altura - 1);
+    anexarAtributoExr(dados, "dataWindow", "box2i", valor);
+    anexarAtributoExr(dados, "displayWindow", "box2i", valor);
+    anexarAtributoExr(dados, "lineOrder", "lineOrder", std::vector<unsigned char>(1, 0));
+    valor.clear();
+    anexarFloatLittleEndian(valor, 1.0f);
+    anexarAtributoExr(dados, "pixelAspectRatio", "float", valor);
+    anexarAtributoExr(dados, "screenWindowWidth", "float", valor);
+    anexarAtributoExr(dados, "screenWindowCenter", "v2f", std::vector<unsigned char>(8, 0));
+    dados.push_back(0);                                 // Fim do cabeçalho
+
+    // Tabela de deslocamentos (64 bits) e as linhas, de cima para baixo
+    size_t bytesLinha = 8 + (size_t)largura * 3 * sizeof(float);
+    size_t primeiraLinha = dados.size() + (size_t)altura * 8;
+    for (int y = 0; y < altura; y++) {
+        unsigned long long deslocamento = primeiraLinha + (size_t)y * bytesLinha;
+        anexarInteiroLittleEndian(dados, (unsigned int)deslocamento);
+        anexarInteiroLittleEndian(dados, (unsigned int)(deslocamento >> 32));
+    }
+    for (int y = 0; y < altura; y++) {
+        const float *linha = &rgb[(size_t)(altura - 1 - y) * largura * 3];
+        anexarInteiroLittleEndian(dados, y);
+        anexarInteiroLittleEndian(dados, (unsigned int)(bytesLinha - 8));
+        for (int c = 2; c >= 0; c--) {
+            for (int x = 0; x < largura; x++) anexarFloatLittleEndian(dados, linha[x * 3 + c]);
+        }
+    }
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao gravar '%s'\n", nomeArquivo);
+        return false;
+    }
+    bool ok = fwrite(&dados[0], 1, dados.size(), arquivo) == dados.size();
+    fclose(arquivo);
+    return ok;
+}
+
+float cinzaAces(float x) {
+    return std::min(std::max(x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f), 1.0f);
+}
+
+float linearParaSrgb(float x) {
+    return x <= 0.0031308f ? 12.92f * x : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+}
+
+// Exposição pela média logarítmica da luminância dos pixels que veem o
+// estádio (o chão, o céu e o sol não contam), curva ACES e sRGB
+void revelarImagemCaminhos(const std::vector<float> &radiancia, const std::vector<unsigned char> &mascara,
+                           int largura, int altura, ImagemCpu &imagem) {
+    double somaLog = 0.0;
+    long contagem = 0;
+    for (size_t i = 0; i < mascara.size(); i++) {
+        if (!mascara[i]) continue;
+        const float *c = &radiancia[i * 3];
+        somaLog += log(1e-4 + 0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2]);
+        contagem++;
+    }
+    float exposicao = contagem > 0 ? CHAVE_EXPOSICAO / (float)exp(somaLog / contagem) : 1.0f;
+    imagem.largura = largura;
+    imagem.altura = altura;
+    imagem.rgb.resize(radiancia.size());
+    for (size_t i = 0; i < radiancia.size(); i++) {
+        imagem.rgb[i] = (unsigned char)(linearParaSrgb(cinzaAces(radiancia[i] * exposicao)) * 255.0f + 0.5f);
+    }
+}
+
+bool gravarImagemCaminhos(const char *nomeArquivo, const std::vector<float> &soma,
+                          const std::vector<unsigned char> &mascara, int amostras, int largura, int altura) {
+    std::vector<float> radiancia(soma.size());
+    for (size_t i = 0; i < soma.size(); i++) radiancia[i] = soma[i] / amostras;
+    if (extensaoArquivo(nomeArquivo, ".exr")) return gravarImagemExr(nomeArquivo, largura, altura, radiancia);
+    ImagemCpu imagem;
+    revelarImagemCaminhos(radiancia, mascara, largura, altura, imagem);
+    return gravarImagem(nomeArquivo, imagem);
+}
+
+// --render-still: sem janela nem contexto GL; retorna o código de saída
+int executarRenderStill(const char *arquivoSaida, int amostras, float horaSolar) {
+    for (int i = 0; i < NUM_TEXTURAS_CPU; i++) carregarTexturaCpu(ARQUIVOS_TEXTURAS_CPU[i], texturasCpu[i]);
+    construirMalhaEstadio(fatorDetalheMalha.load());
+    construirAssentos(layoutAssentosAtual.load());
+    publicarEstadoCena();
+    const EstadoCena &estado = consumirEstadoCena();
+    CenaCaminhos cena;
+    construirCenaCaminhos(cena);
+    LuzesCaminhos luzes;
+    prepararLuzesCaminhos(luzes, horaSolar);
+    printf("Sol às %.2f h (dia %d): elevação %.1f°, %s\n", horaSolar, diaDoAnoSol,
+           asinf(std::max(-1.0f, std::min(luzes.sol.z, 1.0f))) * 180.0f / PI,
+           luzes.dia ? "luz do sol e do céu" : "refletores da marquise");
+
+    int largura = std::max(estado.larguraJanela, 1), altura = std::max(estado.alturaJanela, 1);
+    float m[16];
+    matrizCameraCena(estado, m);
+    Vetor3 olho = posicaoOlhoMatriz(m);
+    float tanMeio = tanf(GRAUS_PARA_RAD(CAMPO_VISAO_GRAUS) * 0.5f), proporcao = (float)largura / altura;
+    std::vector<float> soma((size_t)largura * altura * 3, 0.0f);
+    std::vector<unsigned char> mascara((size_t)largura * altura, 0);
+    int colunasBlocos = (largura + TAMANHO_BLOCO_CAMINHOS - 1) / TAMANHO_BLOCO_CAMINHOS;
+    int linhasBlocos = (altura + TAMANHO_BLOCO_CAMINHOS - 1) / TAMANHO_BLOCO_CAMINHOS;
+    int numBlocos = colunasBlocos * linhasBlocos;
+    std::vector<long> raiosBloco(numBlocos);
+    double inicio = tempoAtualMs(), ultimaGravacao = inicio;
+    long totalRaios = 0;
+
+    for (int amostra = 0; amostra < amostras; amostra++) {
+        double inicioPassada = tempoAtualMs();
+        executarEmParalelo(0, numBlocos, 1, [&](int b) {
+            int bx = (b % colunasBlocos) * TAMANHO_BLOCO_CAMINHOS, by = (b / colunasBlocos) * TAMANHO_BLOCO_CAMINHOS;
+            int x1 = std::min(bx + TAMANHO_BLOCO_CAMINHOS, largura), y1 = std::min(by + TAMANHO_BLOCO_CAMINHOS, altura);
+            long raios = 0;
+            for (int y = by; y < y1; y++) {
+                for (int x = bx; x < x1; x++) {
+                    int indice = y * largura + x;
+                    unsigned int semente = hashInteiro((unsigned int)indice * 0x9E3779B9U ^ hashInteiro(amostra + 1));
+                    // Posição sorteada dentro do pixel, no plano z = -1 do olho
+                    float px = (2.0f * (x + aleatorioCaminho(semente)) / largura - 1.0f) * tanMeio * proporcao;
+                    float py = (2.0f * (y + aleatorioCaminho(semente)) / altura - 1.0f) * tanMeio;
+                    Vetor3 direcao = normalizar(vetor3(m[0] * px + m[1] * py - m[2],
+                                                       m[4] * px + m[5] * py - m[6],
+                                                       m[8] * px + m[9] * py - m[10]));
+                    bool viuEstadio = false;
+                    Vetor3 l = radianciaCaminho(cena, luzes, olho, direcao, semente, raios, viuEstadio);
+                    soma[indice * 3 + 0] += l.x;
+                    soma[indice * 3 + 1] += l.y;
+                    soma[indice * 3 + 2] += l.z;
+                    if (viuEstadio) mascara[indice] = 1;
+                }
+            }
+            raiosBloco[b] = raios;
+        });
+        long raiosPassada = 0;
+        for (int b = 0; b < numBlocos; b++) raiosPassada += raiosBloco[b];
+        totalRaios += raiosPassada;
+        double agora = tempoAtualMs();
+        bool ultima = amostra + 1 == amostras;
+        if (ultima || ((amostra + 1) & amostra) == 0) {
+            printf("  %d/%d amostras por pixel: %.1f s, %.2f Mraios/s na última passada\n", amostra + 1, amostras,
+                   (agora - inicio) / 1000.0, raiosPassada / ((agora - inicioPassada) * 1000.0));
+        }
+        if (ultima || agora - ultimaGravacao >= PERIODO_GRAVACAO_CAMINHOS_S * 1000.0) {
+            if (!gravarImagemCaminhos(arquivoSaida, soma, mascara, amostra + 1, largura, altura)) return 1;
+            ultimaGravacao = agora;
+        }
+    }
+    double total = tempoAtualMs() - inicio;
+    printf("Imagem gravada em '%s': %dx%d, %d amostras por pixel em %.1f s, %.2f Mraios/s (%d threads)\n",
+           arquivoSaida, largura, altura, amostras, total / 1000.0, totalRaios / (total * 1000.0),
+           numTrabalhadores + 1);
+    return 0;
+}
+
+// --- Mapas de Luz Pré-calculados ---
+// Passo offline (--bake-luz) que calcula, para cada texel dos atlas de
+// AtlasLuz (degraus, paredes, marquise e tampas, as duas faces), a luz do céu
+// e do sol que chega à superfície, e grava o resultado num arquivo. Na
+// execução normal (--mapa-luz) os atlas viram texturas de luminância na
+// unidade 1, moduladas sobre a cor texturizada: a iluminação não custa nada
+// por quadro além da amostragem. Cada texel fica na posição interpolada
+// entre os quatro cantos do seu quadrilátero, com a normal da face, e lança
+// RAIOS_CEU_MAPA_LUZ raios cossenoidais estratificados contra a BVH do
+// estádio: os que escapam para cima veem o céu e os que escapam para baixo
+// chegam ao chão, que devolve ALBEDO_CHAO_MAPA_LUZ. O sol (na hora de --hora
+// e no dia de --dia-sol) soma o cosseno com a normal quando o raio de sombra
+// passa. As tarefas pegam trechos de quadriláteros.
+const int LADO_ESTRATOS_MAPA_LUZ = 8;
+const int RAIOS_CEU_MAPA_LUZ = LADO_ESTRATOS_MAPA_LUZ * LADO_ESTRATOS_MAPA_LUZ;
+const float ALBEDO_CHAO_MAPA_LUZ = 0.3f;
+const float PESO_CEU_MAPA_LUZ = 0.55f;          // Céu aberto com o sol a pino: 1, a cor sem mapa
+const float PESO_SOL_MAPA_LUZ = 0.45f;
+const char MAGICO_MAPA_LUZ[4] = {'A', 'L', 'M', 'L'};
+const unsigned int VERSAO_MAPA_LUZ = 1;
+
+float luzTexelMapa(const Vetor3 &p, const Vetor3 &n, const Vetor3 &sol, unsigned int semente, long &raios) {
+    float ceu = 0.0f;
+    for (int k = 0; k < RAIOS_CEU_MAPA_LUZ; k++) {
+        float u1 = (k % LADO_ESTRATOS_MAPA_LUZ + aleatorioCaminho(semente)) / LADO_ESTRATOS_MAPA_LUZ;
+        float u2 = (k / LADO_ESTRATOS_MAPA_LUZ + aleatorioCaminho(semente)) / LADO_ESTRATOS_MAPA_LUZ;
+        Vetor3 d = direcaoCossenoidal(n, u1, u2);
+        if (raioOcluido(bvhEstadio, prepararRaio(p, d), DISTANCIA_MAXIMA_CAMINHO)) continue;
+        ceu += d.z > 0.0f ? 1.0f : ALBEDO_CHAO_MAPA_LUZ;
+    }
+    raios += RAIOS_CEU_MAPA_LUZ;
+    float direta = 0.0f, cosSol = produtoEscalar(n, sol);
+    if (sol.z > 0.0f && cosSol > 0.0f) {
+        raios++;
+        if (!raioOcluido(bvhEstadio, prepararRaio(p, sol), DISTANCIA_MAXIMA_CAMINHO)) direta = cosSol;
+    }
+    return PESO_CEU_MAPA_LUZ * ceu / RAIOS_CEU_MAPA_LUZ + PESO_SOL_MAPA_LUZ * direta;
+}
+
+// Preenche o atlas do lote (as duas metades); retorna o número de raios
+long calcularAtlasLuz(const LoteMalha &lote, const Vetor3 &sol, AtlasLuz &atlas, std::vector<unsigned char> &texels) {
+    atlas = dimensionarAtlasLuz((int)lote.vertices.size() / 6);
+    texels.assign((size_t)atlas.largura * atlas.altura, 255);
+    if (lote.coordsLuz.empty()) return 0;
+    int n = atlas.texelsQuad, alturaFace = atlas.altura / 2;
+    std::atomic<long> raios(0);
+    executarEmParalelo(0, atlas.numQuads, 16, [&](int q) {
+        const VerticeMalha *v = &lote.vertices[q * 6];
+        Vetor3 cantos[4];
+        for (int k = 0; k < 6; k++) cantos[lote.cantos[q * 6 + k]] = vetor3(v[k].x, v[k].y, v[k].z);
+        Vetor3 normal = produtoVetorial(vetor3(v[1].x - v[0].x, v[1].y - v[0].y, v[1].z - v[0].z),
+                                        vetor3(v[2].x - v[0].x, v[2].y - v[0].y, v[2].z - v[0].z));
+        if (comprimento(normal) == 0.0f) return;
+        normal = normalizar(normal);
+        long raiosQuad = 0;
+        for (int face = 0; face < 2; face++) {
+            Vetor3 nf = face == 0 ? normal : normal * -1.0f;
+            for (int j = 0; j < n; j++) {
+                for (int i = 0; i < n; i++) {
+                    float a = (float)i / (n - 1), b = (float)j / (n - 1);
+                    Vetor3 p = cantos[0] * ((1.0f - a) * (1.0f - b)) + cantos[1] * (a * (1.0f - b))
+                             + cantos[2] * ((1.0f - a) * b) + cantos[3] * (a * b);
+                    unsigned int semente = hashInteiro((unsigned int)(((q * 2 + face) * n + j) * n + i));
+                    float luz = luzTexelMapa(p + nf * DESLOCAMENTO_RAIO_CAMINHO, nf, sol, semente, raiosQuad);
+                    int x = (q % atlas.colunas) * n + i, y = face * alturaFace + (q / atlas.colunas) * n + j;
+                    texels[(size_t)y * atlas.largura + x] = (unsigned char)(std::min(luz, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        }
+        raios += raiosQuad;
+    });
+    return raios.load();
+}
+
+// --bake-luz: sem janela nem contexto GL; retorna o código de saída
+int executarBakeLuz(const char *nomeArquivo, float horaSolar) {
+    construirMalhaEstadio(fatorDetalheMalha.load());
+    garantirBvhEstadio();
+    Vetor3 sol = direcaoSol(diaDoAnoSol, horaSolar);
+    FILE *arquivo = fopen(nomeArquivo, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao criar '%s'\n", nomeArquivo);
+        return 1;
+    }
+    unsigned int numLotes = NUM_LOTES_MAPA_LUZ;
+    fwrite(MAGICO_MAPA_LUZ, 1, 4, arquivo);
+    fwrite(&VERSAO_MAPA_LUZ, sizeof(VERSAO_MAPA_LUZ), 1, arquivo);
+    fwrite(&anguloInicialMarquiseMalha, sizeof(float), 1, arquivo);
+    fwrite(&diaDoAnoSol, sizeof(int), 1, arquivo);
+    fwrite(&horaSolar, sizeof(float), 1, arquivo);
+    fwrite(&numLotes, sizeof(numLotes), 1, arquivo);
+    double inicio = tempoAtualMs();
+    long totalRaios = 0;
+    for (int i = 0; i < NUM_LOTES_MAPA_LUZ; i++) {
+        double inicioLote = tempoAtualMs();
+        AtlasLuz atlas;
+        std::vector<unsigned char> texels;
+        long raios = calcularAtlasLuz(lotesMalha[PASSOS_MAPA_LUZ[i]], sol, atlas, texels);
+        totalRaios += raios;
+        fwrite(&atlas.numQuads, sizeof(int), 1, arquivo);
+        fwrite(&atlas.largura, sizeof(int), 1, arquivo);
+        fwrite(&atlas.altura, sizeof(int), 1, arquivo);
+        fwrite(&texels[0], 1, texels.size(), arquivo);
+        printf("Mapa de luz '%s': %d quadriláteros, %d x %d texels cada, atlas %dx%d em %.2f s\n",
+               NOMES_PASSOS[PASSOS_MAPA_LUZ[i]], atlas.numQuads, atlas.texelsQuad, atlas.texelsQuad,
+               atlas.largura, atlas.altura, (tempoAtualMs() - inicioLote) / 1000.0);
+    }
+    bool ok = !ferror(arquivo);
+    fclose(arquivo);
+    if (!ok) {
+        fprintf(stderr, "Erro ao gravar '%s'\n", nomeArquivo);
+        return 1;
+    }
+    double total = tempoAtualMs() - inicio;
+    printf("Mapa de luz gravado em '%s' (sol às %.2f h do dia %d): %.1f s, %.2f Mraios/s (%d threads)\n",
+           nomeArquivo, horaSolar, diaDoAnoSol, total / 1000.0, totalRaios / (total * 1000.0), numTrabalhadores + 1);
+    return 0;
+}
+
+// Lê o arquivo de --bake-luz e cria as texturas (precisa do contexto GL)
+bool carregarMapaLuz(const char *nomeArquivo) {
+    pglActiveTexture = (PFNGLACTIVETEXTUREPROC)glutGetProcAddress("glActiveTexture");
+    pglClientActiveTexture = (PFNGLCLIENTACTIVETEXTUREARBPROC)glutGetProcAddress("glClientActiveTexture");
+    if (!pglActiveTexture || !pglClientActiveTexture) {
+        fprintf(stderr, "Aviso: sem multitextura (GL 1.3); mapa de luz desligado\n");
+        return false;
+    }
+    FILE *arquivo = fopen(nomeArquivo, "rb");
+    if (!arquivo) {
+        fprintf(stderr, "Erro ao abrir mapa de luz '%s'\n", nomeArquivo);
+        return false;
+    }
+    char magico[4];
+    unsigned int versao = 0, numLotes = 0;
+    int dia = 0;
+    float hora = 0.0f;
+    bool valido = fread(magico, 1, 4, arquivo) == 4 && memcmp(magico, MAGICO_MAPA_LUZ, 4) == 0
+               && fread(&versao, sizeof(versao), 1, arquivo) == 1 && versao == VERSAO_MAPA_LUZ
+               && fread(&mapaLuz.anguloMarquise, sizeof(float), 1, arquivo) == 1
+               && fread(&dia, sizeof(int), 1, arquivo) == 1
+               && fread(&hora, sizeof(float), 1, arquivo) == 1
+               && fread(&numLotes, sizeof(numLotes), 1, arquivo) == 1 && numLotes == NUM_LOTES_MAPA_LUZ;
+    for (int i = 0; i < NUM_LOTES_MAPA_LUZ && valido; i++) {
+        int largura = 0, altura = 0;
+        valido = fread(&mapaLuz.numQuads[i], sizeof(int), 1, arquivo) == 1
+              && fread(&largura, sizeof(int), 1, arquivo) == 1
+              && fread(&altura, sizeof(int), 1, arquivo) == 1;
+        AtlasLuz atlas = dimensionarAtlasLuz(mapaLuz.numQuads[i]);
+        valido = valido && largura == atlas.largura && altura == atlas.altura;
+        if (!valido) break;
+        std::vector<unsigned char> texels((size_t)largura * altura);
+        valido = fread(&texels[0], 1, texels.size(), arquivo) == texels.size();
+        if (!valido) break;
+        if (!mapaLuz.texturas[i]) glGenTextures(1, &mapaLuz.texturas[i]);
+        glBindTexture(GL_TEXTURE_2D, mapaLuz.texturas[i]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, largura, altura, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, &texels[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        estatisticasQuadro.bytesEnviados += (unsigned long)texels.size();
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    fclose(arquivo);
+    if (!valido) {
+        fprintf(stderr, "Mapa de luz '%s' inválido ou de versão incompatível\n", nomeArquivo);
+        for (int i = 0; i < NUM_LOTES_MAPA_LUZ; i++) {
+            if (mapaLuz.texturas[i]) glDeleteTextures(1, &mapaLuz.texturas[i]);
+            mapaLuz.texturas[i] = 0;
+        }
+        return false;
+    }
+    printf("Mapa de luz '%s' carregado (sol às %.2f h do dia %d)\n", nomeArquivo, hora, dia);
+    for (int i = 0; i < NUM_LOTES_MAPA_LUZ; i++) {
+        if (!texturaLuzDoLote(lotesMalha[PASSOS_MAPA_LUZ[i]])) {
+            fprintf(stderr, "Aviso: mapa de luz feito para outra malha (detalhe ou vão da marquise); "
+                            "refaça com --bake-luz\n");
+            break;
+        }
+    }
+    return true;
+}
+
+// --- Sombras da Marquise (mapas de sombra em cascata) ---
+// As peças marcadas com projetaSombra (marquise e parede superior) são
+// desenhadas, vistas do sol, em NUM_CASCATAS_SOMBRA mapas de profundidade que
+// cobrem fatias consecutivas do trecho do frustum que atravessa o estádio.
+// Cada cascata é uma projeção ortográfica ajustada à esfera que envolve a sua
+// fatia. O raio sobe para o próximo degrau de uma escala geométrica
+// (DEGRAUS_RAIO_CASCATA por oitava), então o tamanho do texel fica fixo
+// enquanto a câmera se move dentro do estádio, e o centro é arredondado para
+// esse texel: as bordas das sombras não tremem, e um mapa só é redesenhado
+// quando o centro da sua fatia passa de um texel (ao andar ou girar), quando o
+// raio troca de degrau, ou quando o sol ou a malha mudaram. Os receptores
+// ganham uma passada por cascata, com planos de corte na profundidade da fatia
+// e coordenadas de textura geradas pelo pipeline fixo (GL_EYE_LINEAR); a
+// comparação de profundidade do GL 1.4 devolve 1 onde há sombra, e o alfa
+// resultante escurece a cor já desenhada.
+const int NUM_CASCATAS_SOMBRA = 3;
+const int TAMANHO_MAPA_SOMBRA = 1024;
+const float LAMBDA_CASCATAS = 0.75f;            // Mistura da divisão logarítmica com a uniforme
+const float DEGRAUS_RAIO_CASCATA = 8.0f;        // Degraus do raio por oitava (cada um ~9% maior)
+const float MARGEM_RECEPTORES_SOMBRA = 0.5f;    // Folga da caixa do estádio (sombras longas no chão)
+const float OPACIDADE_SOMBRA = 0.45f;
+const float ELEVACAO_MINIMA_SOL_SOMBRA = 0.05f; // Seno da elevação; abaixo disso, sem sombras
+const PassoRender PASSOS_RECEPTORES_SOMBRA[] = {
+    PASSO_CHAO, PASSO_GRAMA, PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_TAMPAS
+};
+
+struct CascataSombra {
+    float perto, longe;                 // Fatia do frustum (distância ao longo da visão)
+    float raio;                         // Esfera envolvente da fatia
+    int centro[2];                      // Centro da esfera no plano da luz, em texels
+    float matriz[16];                   // Estádio -> recorte da luz (ortográfica)
+    GLuint textura;
+    bool valida;
+};
+
+struct SombrasMarquise {
+    bool iniciadas, disponiveis;
+    GLuint fbo;
+    CascataSombra cascatas[NUM_CASCATAS_SOMBRA];
+    Vetor3 sol;
+    int versaoMalha;                    // Malha em que a caixa e a profundidade foram medidas
+    CaixaLimites caixaEstadio;          // Receptores, sem o chão, com folga
+    float profundidade[2];              // Intervalo dos projetores na direção do sol
+};
+
+SombrasMarquise sombras = SombrasMarquise();
+
+// Framebuffer objects (GL 3.0 / ARB_framebuffer_object), carregados em tempo de execução
+PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus = NULL;
+
+bool iniciarSombras() {
+    sombras.iniciadas = true;
+    pglGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)glutGetProcAddress("glGenFramebuffers");
+    pglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)glutGetProcAddress("glBindFramebuffer");
+    pglFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)glutGetProcAddress("glFramebufferTexture2D");
+    pglCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)glutGetProcAddress("glCheckFramebufferStatus");
+    if (!pglGenFramebuffers || !pglBindFramebuffer || !pglFramebufferTexture2D || !pglCheckFramebufferStatus) {
+        fprintf(stderr, "Aviso: framebuffer objects indisponíveis; sombras desligadas\n");
+        return false;
+    }
+
+    const float bordaLuz[4] = {1.0f, 1.0f, 1.0f, 1.0f};    // Fora do mapa: sem sombra
+    for (int i = 0; i < NUM_CASCATAS_SOMBRA; i++) {
+        CascataSombra &c = sombras.cascatas[i];
+        glGenTextures(1, &c.textura);
+        glBindTexture(GL_TEXTURE_2D, c.textura);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, TAMANHO_MAPA_SOMBRA, TAMANHO_MAPA_SOMBRA, 0,
+                     GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, bordaLuz);
+        // r > profundidade do mapa (mais longe do sol que o projetor) -> 1 (sombra), no alfa
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_GREATER);
+        glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_ALPHA);
+        c.valida = false;
+    }
+    pglGenFramebuffers(1, &sombras.fbo);
+    pglBindFramebuffer(GL_FRAMEBUFFER, sombras.fbo);
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sombras.cascatas[0].textura, 0);
+    glDrawBuffer(GL_NONE);              // Só profundidade
+    glReadBuffer(GL_NONE);
+    GLenum estado = pglCheckFramebufferStatus(GL_FRAMEBUFFER);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, texturaVinculadaAtual);
+    if (estado != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Aviso: framebuffer de profundidade incompleto (0x%x); sombras desligadas\n", estado);
+        return false;
+    }
+    sombras.disponiveis = true;
+    return true;
+}
+
+// Esfera que envolve a fatia [perto, longe] do frustum: o centro fica no eixo
+// da visão, à distância 'centro', e o raio só depende da projeção
+void esferaFatiaFrustum(float perto, float longe, float proporcao, float &centro, float &raio) {
+    float tangente = tanf(GRAUS_PARA_RAD(CAMPO_VISAO_GRAUS) * 0.5f);
+    float k = tangente * tangente * (1.0f + proporcao * proporcao);    // (meia diagonal / distância)²
+    centro = std::min(0.5f * (perto + longe) * (1.0f + k), longe);     // Equidistante dos cantos das duas faces
+    float dPerto = (centro - perto) * (centro - perto) + k * perto * perto;
+    float dLonge = (longe - centro) * (longe - centro) + k * longe * longe;
+    raio = sqrtf(std::max(dPerto, dLonge));
+}
+
+// Caixa dos receptores e intervalo dos projetores na direção do sol, por malha e sol
+void medirCenaSombras(const Vetor3 &sol) {
+    CaixaLimites caixa = {vetor3(1e30f, 1e30f, 1e30f), vetor3(-1e30f, -1e30f, -1e30f)};
+    float dMin = 1e30f, dMax = -1e30f;
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        for (size_t i = 0; i < lotesMalha[p].objetos.size(); i++) {
+            const ObjetoMalha &o = lotesMalha[p].objetos[i];
+            if (p != PASSO_CHAO) {
+                incluirNaCaixa(caixa, o.caixa.minimo);
+                incluirNaCaixa(caixa, o.caixa.maximo);
+            }
+            if (!o.projetaSombra) continue;
+            for (int k = 0; k < 8; k++) {
+                Vetor3 canto = vetor3((k & 1) ? o.caixa.maximo.x : o.caixa.minimo.x,
+                                      (k & 2) ? o.caixa.maximo.y : o.caixa.minimo.y,
+                                      (k & 4) ? o.caixa.maximo.z : o.caixa.minimo.z);
+                float d = produtoEscalar(canto, sol);
+                dMin = std::min(dMin, d);
+                dMax = std::max(dMax, d);
+            }
+        }
+    }
+    Vetor3 folga = vetor3(MARGEM_RECEPTORES_SOMBRA, MARGEM_RECEPTORES_SOMBRA, MARGEM_RECEPTORES_SOMBRA);
+    sombras.caixaEstadio.minimo = caixa.minimo - folga;
+    sombras.caixaEstadio.maximo = caixa.maximo + folga;
+    // Receptores atrás de todos os projetores ficam com r >= 1 e comparam com o
+    // mapa normalmente; não precisam entrar no intervalo
+    sombras.profundidade[0] = dMin - 0.01f;
+    sombras.profundidade[1] = dMax + 0.01f;
+}
+
+// Projeção ortográfica da cascata: x e y no plano da luz, z = distância ao
+// projetor mais próximo do sol (0 a 1 no intervalo de profundidade)
+void matrizCascataSombra(CascataSombra &c, const Vetor3 &sol) {
+    Vetor3 eixoX, eixoY;
+    baseOrtonormal(sol, eixoX, eixoY);
+    float texel = 2.0f * c.raio / TAMANHO_MAPA_SOMBRA;
+    float x0 = c.centro[0] * texel, y0 = c.centro[1] * texel;
+    float dMin = sombras.profundidade[0], dMax = sombras.profundidade[1];
+    float escalaZ = -2.0f / (dMax - dMin);
+    const float linhas[3][4] = {
+        {eixoX.x / c.raio, eixoX.y / c.raio, eixoX.z / c.raio, -x0 / c.raio},
+        {eixoY.x / c.raio, eixoY.y / c.raio, eixoY.z / c.raio, -y0 / c.raio},
+        {sol.x * escalaZ, sol.y * escalaZ, sol.z * escalaZ, 1.0f - dMin * escalaZ},
+    };
+    for (int col = 0; col < 4; col++) {
+        for (int lin = 0; lin < 3; lin++) c.matriz[col * 4 + lin] = linhas[lin][col];
+        c.matriz[col * 4 + 3] = (col == 3) ? 1.0f : 0.0f;
+    }
+}
+
+// Desenha só as posições dos objetos marcados do lote, juntando vizinhos
+void desenharPosicoesLote(const LoteMalha &lote, const std::vector<unsigned char> &marcados) {
+    int numObjetos = (int)lote.objetos.size();
+    int i = 0;
+    while (i < numObjetos) {
+        if (!marcados[i]) {
+            i++;
+            continue;
+        }
+        int primeiro = lote.objetos[i].primeiro;
+        int quantidade = 0;
+        while (i < numObjetos && marcados[i]) {
+            quantidade += lote.objetos[i].quantidade;
+            i++;
+        }
+        desenharArrays(GL_TRIANGLES, primeiro, quantidade);
+    }
+}
+
+// Só a marquise e a parede superior, e só as que caem dentro da cascata
+void desenharProjetoresSombra(const CascataSombra &c) {
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(c.matriz);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    float planos[6][4];
+    extrairPlanosFrustum(planos);
+    std::vector<unsigned char> marcados;
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        const LoteMalha &lote = lotesMalha[p];
+        bool algum = false;
+        marcados.assign(lote.objetos.size(), 0);
+        for (size_t i = 0; i < lote.objetos.size(); i++) {
+            if (!lote.objetos[i].projetaSombra) continue;
+            if (caixaNoFrustum(lote.objetos[i].caixa, planos)) {
+                marcados[i] = 1;
+                algum = true;
+            } else {
+                estatisticasQuadro.objetosDescartados++;
+            }
+        }
+        if (!algum) continue;
+        glVertexPointer(3, GL_FLOAT, sizeof(VerticeMalha), &lote.vertices[0].x);
+        desenharPosicoesLote(lote, marcados);
+        // Vista quase de lado, a parede vira triângulos mais finos que um
+        // texel, que o preenchimento pula; as arestas garantem um texel
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        desenharPosicoesLote(lote, marcados);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+}
+
+// Ajusta as cascatas à câmera do quadro e redesenha os mapas que mudaram
+void atualizarMapasSombra(const Vetor3 &sol, float proporcao) {
+    RASTREAR_FUNCAO();
+    bool tudoNovo = sombras.versaoMalha != versaoMalhaEstadio || sombras.sol.x != sol.x
+                 || sombras.sol.y != sol.y || sombras.sol.z != sol.z;
+    if (tudoNovo) {
+        medirCenaSombras(sol);
+        sombras.sol = sol;
+        sombras.versaoMalha = versaoMalhaEstadio;
+    }
+
+    // Trecho do frustum que atravessa o estádio; muda com a posição do olho,
+    // por isso o raio de cada fatia é arredondado para um degrau logo abaixo
+    float m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    Vetor3 olho = posicaoOlhoMatriz(m);
+    Vetor3 frente = vetor3(-m[2], -m[6], -m[10]);
+    const CaixaLimites &caixa = sombras.caixaEstadio;
+    float pertoTotal = PLANO_DISTANTE, longeTotal = 0.0f;
+    for (int k = 0; k < 8; k++) {
+        Vetor3 canto = vetor3((k & 1) ? caixa.maximo.x : caixa.minimo.x,
+                              (k & 2) ? caixa.maximo.y : caixa.minimo.y,
+                              (k & 4) ? caixa.maximo.z : caixa.minimo.z);
+        longeTotal = std::max(longeTotal, comprimento(canto - olho));
+    }
+    Vetor3 maisPerto = vetor3(std::max(caixa.minimo.x, std::min(olho.x, caixa.maximo.x)),
+                              std::max(caixa.minimo.y, std::min(olho.y, caixa.maximo.y)),
+                              std::max(caixa.minimo.z, std::min(olho.z, caixa.maximo.z)));
+    pertoTotal = std::max(PLANO_PROXIMO, comprimento(maisPerto - olho));
+    longeTotal = std::min(longeTotal, PLANO_DISTANTE);
+    if (longeTotal <= pertoTotal) longeTotal = pertoTotal + 1.0f;
+
+    Vetor3 eixoX, eixoY;
+    baseOrtonormal(sol, eixoX, eixoY);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bool vinculado = false;
+    for (int i = 0; i < NUM_CASCATAS_SOMBRA; i++) {
+        CascataSombra &c = sombras.cascatas[i];
+        float f0 = (float)i / NUM_CASCATAS_SOMBRA, f1 = (float)(i + 1) / NUM_CASCATAS_SOMBRA;
+        float perto = LAMBDA_CASCATAS * pertoTotal * powf(longeTotal / pertoTotal, f0)
+                    + (1.0f - LAMBDA_CASCATAS) * (pertoTotal + (longeTotal - pertoTotal) * f0);
+        float longe = LAMBDA_CASCATAS * pertoTotal * powf(longeTotal / pertoTotal, f1)
+                    + (1.0f - LAMBDA_CASCATAS) * (pertoTotal + (longeTotal - pertoTotal) * f1);
+        // pertoTotal é uma distância euclidiana, mas o plano de corte testa a
+        // profundidade no olho: pontos da caixa vistos de lado ficam mais rasos
+        // que ele, então a primeira fatia começa no plano próximo da câmera
+        if (i == 0) perto = PLANO_PROXIMO;
+        float distanciaCentro, raio;
+        esferaFatiaFrustum(perto, longe, proporcao, distanciaCentro, raio);
+        // Um texel de folga cobre o arredondamento do centro
+        raio *= 1.0f + 2.0f / TAMANHO_MAPA_SOMBRA;
+        raio = exp2f(ceilf(log2f(raio) * DEGRAUS_RAIO_CASCATA) / DEGRAUS_RAIO_CASCATA);
+        Vetor3 centro = olho + frente * distanciaCentro;
+        float texel = 2.0f * raio / TAMANHO_MAPA_SOMBRA;
+        int cx = (int)floorf(produtoEscalar(centro, eixoX) / texel + 0.5f);
+        int cy = (int)floorf(produtoEscalar(centro, eixoY) / texel + 0.5f);
+        c.perto = perto;
+        c.longe = longe;
+        if (!tudoNovo && c.valida && c.raio == raio && c.centro[0] == cx && c.centro[1] == cy) continue;
+
+        c.raio = raio;
+        c.centro[0] = cx;
+        c.centro[1] = cy;
+        matrizCascataSombra(c, sol);
+        if (!vinculado) {
+            pglBindFramebuffer(GL_FRAMEBUFFER, sombras.fbo);
+            glViewport(0, 0, TAMANHO_MAPA_SOMBRA, TAMANHO_MAPA_SOMBRA);
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix();
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix();
+            alterarEstadoGL(GL_TEXTURE_2D, false);
+            alterarEstadoGL(GL_POLYGON_OFFSET_FILL, true);
+            alterarEstadoGL(GL_POLYGON_OFFSET_LINE, true);
+            glPolygonOffset(1.5f, 4.0f);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            vinculado = true;
+        }
+        pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, c.textura, 0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        desenharProjetoresSombra(c);
+        c.valida = true;
+        estatisticasQuadro.cascatasSombra++;
+    }
+    if (vinculado) {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        alterarEstadoGL(GL_POLYGON_OFFSET_FILL, false);
+        alterarEstadoGL(GL_POLYGON_OFFSET_LINE, false);
+        alterarEstadoGL(GL_TEXTURE_2D, true);
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+}
+
+// Escurece os receptores já desenhados (objetos visíveis deste quadro) onde
+// o mapa da cascata da sua profundidade indica sombra. Lotes com mapa de luz
+// já têm a sombra do sol no mapa e ficam de fora.
+void aplicarSombras(float opacidade) {
+    const GLenum coordenadas[4] = {GL_S, GL_T, GL_R, GL_Q};
+    const GLenum geracao[4] = {GL_TEXTURE_GEN_S, GL_TEXTURE_GEN_T, GL_TEXTURE_GEN_R, GL_TEXTURE_GEN_Q};
+    GLuint texturaAnterior = texturaVinculadaAtual;   // Passos seguintes contam com ela
+    for (int k = 0; k < 4; k++) {
+        glTexGeni(coordenadas[k], GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+        glEnable(geracao[k]);
+    }
+    glEnable(GL_CLIP_PLANE0);
+    glEnable(GL_CLIP_PLANE1);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    // Mesmos vértices, mas com planos de corte o GL pode transformá-los por
+    // outro caminho: o deslocamento evita que a passada perca para o z-buffer
+    alterarEstadoGL(GL_POLYGON_OFFSET_FILL, true);
+    glPolygonOffset(-1.0f, -2.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glColor4f(0.0f, 0.0f, 0.0f, opacidade);
+
+    for (int i = 0; i < NUM_CASCATAS_SOMBRA; i++) {
+        const CascataSombra &c = sombras.cascatas[i];
+        // Planos do olho dados com a câmera na modelview: o GL os leva para o
+        // espaço do olho, e as coordenadas saem das posições do estádio
+        for (int k = 0; k < 4; k++) {
+            float plano[4];
+            for (int col = 0; col < 4; col++) {
+                plano[col] = (k < 3) ? 0.5f * (c.matriz[col * 4 + k] + c.matriz[col * 4 + 3])
+                                     : c.matriz[col * 4 + 3];
+            }
+            glTexGenfv(coordenadas[k], GL_EYE_PLANE, plano);
+        }
+        // Planos de corte dados no espaço do olho: -z entre perto e longe
+        glPushMatrix();
+        glLoadIdentity();
+        const double planoPerto[4] = {0.0, 0.0, -1.0, -c.perto};
+        const double planoLonge[4] = {0.0, 0.0, 1.0, c.longe};
+        glClipPlane(GL_CLIP_PLANE0, planoPerto);
+        glClipPlane(GL_CLIP_PLANE1, planoLonge);
+        glPopMatrix();
+
+        vincularTextura(c.textura);
+        for (size_t r = 0; r < sizeof(PASSOS_RECEPTORES_SOMBRA) / sizeof(PASSOS_RECEPTORES_SOMBRA[0]); r++) {
+            const LoteMalha &lote = lotesMalha[PASSOS_RECEPTORES_SOMBRA[r]];
+            if (lote.objetos.empty() || texturaLuzDoLote(lote)) continue;
+            glVertexPointer(3, GL_FLOAT, sizeof(VerticeMalha), &lote.vertices[0].x);
+            desenharPosicoesLote(lote, lote.visivel);
+        }
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    alterarEstadoGL(GL_POLYGON_OFFSET_FILL, false);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_CLIP_PLANE0);
+    glDisable(GL_CLIP_PLANE1);
+    for (int k = 0; k < 4; k++) glDisable(geracao[k]);
+    vincularTextura(texturaAnterior);
+}
+
+// Passo de sombras do quadro: a modelview deve estar com a câmera
+void desenharSombras(const EstadoCena &cena) {
+    if (!sombrasLigadas.load()) return;
+    if (!sombras.iniciadas) iniciarSombras();
+    if (!sombras.disponiveis) return;
+    Vetor3 sol = direcaoSol(diaDoAnoSol, horaSolCena.load());
+    float opacidade = OPACIDADE_SOMBRA * (1.0f - std::min(cena.alphaFiltro, 1.0f));
+    if (sol.z < ELEVACAO_MINIMA_SOL_SOMBRA || opacidade <= 0.01f) return;
+    atualizarMapasSombra(sol, (float)cena.larguraJanela / std::max(cena.alturaJanela, 1));
+    aplicarSombras(opacidade);
+}
+
+// --- Iluminação do Pipeline Fixo ---
+// Modo iluminado (tecla 'i'): os lotes da malha usam as normais geradas junto
+// com a geometria, guardadas nos vértices; por quadro só as luzes são
+// posicionadas. A luz 0 é o sol (direcional, na hora das sombras) e, com os
+// refletores ligados, cada uma das luzes 1 a 7 é um spot no centro de um
+// grupo de refletores da borda da marquise, apontado para o centro do
+// gramado como no traçado de caminhos. A cor dos vértices entra como
+// material (GL_COLOR_MATERIAL) e a textura continua modulando o resultado.
+const int NUM_GRUPOS_REFLETORES_GL = 7;         // Luzes 1 a 7 (o GL 1.x garante 8)
+const float LUZ_AMBIENTE_DIA = 0.35f;
+const float LUZ_AMBIENTE_NOITE = 0.1f;
+const float LUZ_DIFUSA_SOL = 0.75f;
+const float LUZ_DIFUSA_GRUPO_REFLETORES = 0.25f;
+const float EXPOENTE_SPOT_REFLETOR = 8.0f;
+const float ATENUACAO_QUADRATICA_REFLETOR = 1.0f;
+
+void ligarIluminacao(const EstadoCena &cena) {
+    const float preto[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    float noite = std::min(cena.alphaFiltro, 1.0f);
+    float ambiente = LUZ_AMBIENTE_DIA + (LUZ_AMBIENTE_NOITE - LUZ_AMBIENTE_DIA) * noite;
+    const float corAmbiente[4] = {ambiente, ambiente, ambiente, 1.0f};
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, corAmbiente);
+    glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);   // Paredes e marquise são vistas dos dois lados
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    alterarEstadoGL(GL_COLOR_MATERIAL, true);
+
+    // Posições dadas com a câmera na modelview: ficam em coordenadas do estádio
+    Vetor3 sol = direcaoSol(diaDoAnoSol, horaSolCena.load());
+    float difusaSol = sol.z > 0.0f ? LUZ_DIFUSA_SOL * (1.0f - noite) : 0.0f;
+    const float posicaoSol[4] = {sol.x, sol.y, sol.z, 0.0f};
+    const float corSol[4] = {difusaSol, difusaSol * 0.95f, difusaSol * 0.9f, 1.0f};
+    glLightfv(GL_LIGHT0, GL_POSITION, posicaoSol);
+    glLightfv(GL_LIGHT0, GL_AMBIENT, preto);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, corSol);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, preto);
+    alterarEstadoGL(GL_LIGHT0, true);
+
+    const float corRefletor[4] = {LUZ_DIFUSA_GRUPO_REFLETORES, LUZ_DIFUSA_GRUPO_REFLETORES * 0.92f,
+                                  LUZ_DIFUSA_GRUPO_REFLETORES * 0.8f, 1.0f};
+    for (int g = 0; g < NUM_GRUPOS_REFLETORES_GL; g++) {
+        GLenum luz = GL_LIGHT1 + g;
+        if (!cena.luzesRefletoresLigadas) {
+            alterarEstadoGL(luz, false);
+            continue;
+        }
+        Vetor3 p, eixo;
+        refletorMarquise((g + 0.5f) / NUM_GRUPOS_REFLETORES_GL, p, eixo);
+        const float posicao[4] = {p.x, p.y, p.z, 1.0f};
+        const float direcao[3] = {eixo.x, eixo.y, eixo.z};
+        glLightfv(luz, GL_POSITION, posicao);
+        glLightfv(luz, GL_SPOT_DIRECTION, direcao);
+        glLightf(luz, GL_SPOT_CUTOFF, ABERTURA_REFLETOR_GRAUS + PENUMBRA_REFLETOR_GRAUS);
+        glLightf(luz, GL_SPOT_EXPONENT, EXPOENTE_SPOT_REFLETOR);
+        glLightf(luz, GL_QUADRATIC_ATTENUATION, ATENUACAO_QUADRATICA_REFLETOR);
+        glLightfv(luz, GL_AMBIENT, preto);
+        glLightfv(luz, GL_DIFFUSE, corRefletor);
+        glLightfv(luz, GL_SPECULAR, preto);
+        alterarEstadoGL(luz, true);
+    }
+    alterarEstadoGL(GL_LIGHTING, true);
+}
+
+void desligarIluminacao() {
+    alterarEstadoGL(GL_LIGHTING, false);
+    alterarEstadoGL(GL_COLOR_MATERIAL, false);
+}
+
+// --- Pipeline de Shaders (GLSL 3.30) ---
+// Caminho principal para a geometria estática: os lotes da malha e os
+// assentos ficam em buffers de vértices na GPU (um VAO por lote e por nível de
+// detalhe dos assentos), enviados só quando a malha ou as cores mudam, e são
+// desenhados por programas GLSL 3.30 que leem a câmera e a hora do dia de dois
+// blocos de uniformes atualizados uma vez por quadro. O programa da malha faz
+// a textura, o mapa de luz (a face do atlas sai de gl_FrontFacing, numa
+// passada só) e o modo iluminado por pixel, com o mesmo sol e os mesmos spots
+// de ligarIluminacao(). A torcida é instanciada: um billboard modelo, com os
+// pés e as cores de cada torcedor num buffer estático e só as elevações
+// enviadas por quadro. O contexto continua de compatibilidade: sombras, céu,
+// filtro e painéis seguem no pipeline fixo, que também desenha tudo quando o
+// GL não tem GLSL 3.30, quando um programa não compila, com --pipeline-fixo
+// ou com a tecla 'f'.
+//
+// Os programas ligados vão para um cache binário (glGetProgramBinary) ao lado
+// do executável, com a chave feita do hash das fontes e da identificação do
+// driver (fabricante, renderizador e versão): nas execuções seguintes eles são
+// carregados sem compilar. Qualquer divergência (outra fonte, outro driver,
+// arquivo truncado ou binário recusado pelo driver) faz compilar de novo e
+// regravar o cache.
+const int VINCULO_UBO_CAMERA = 0;
+const int VINCULO_UBO_HORA = 1;
+const int ATRIBUTO_POSICAO = 0, ATRIBUTO_COR = 1, ATRIBUTO_NORMAL = 2;
+const int ATRIBUTO_COORD_TEXTURA = 3, ATRIBUTO_COORD_LUZ = 4;
+const int ATRIBUTO_CANTO_TORCEDOR = 0, ATRIBUTO_PES_TORCEDOR = 1, ATRIBUTO_CAMISA_TORCEDOR = 2;
+const int ATRIBUTO_PELE_TORCEDOR = 3, ATRIBUTO_ELEVACAO_TORCEDOR = 4;
+const int NUM_PROGRAMAS_SHADER = 3;
+const char MAGICO_CACHE_SHADERS[4] = {'A', 'L', 'M', 'S'};
+const unsigned int VERSAO_CACHE_SHADERS = 1;
+const char *NOME_CACHE_SHADERS = "almeidao_shaders.cache";
+const char *CABECALHO_GLSL = "#version 330 core\n";
+
+const char *FONTE_BLOCOS_UNIFORMES =
+    "layout(std140) uniform Camera {\n"
+    "    mat4 projecao;\n"
+    "    mat4 vista;\n"
+    "};\n"
+    "layout(std140) uniform HoraDoDia {\n"
+    "    vec4 direcaoSol;            // w: 1 no modo iluminado\n"
+    "    vec4 corSol;\n"
+    "    vec4 ambiente;\n"
+    "    vec4 corRefletor;           // w: cosseno do corte do spot\n"
+    "    vec4 parametrosRefletor;    // x: expoente, y: atenuação quadrática\n"
+    "    vec4 posicaoRefletor[7];    // w: 1 ligado\n"
+    "    vec4 eixoRefletor[7];\n"
+    "};\n";
+
+const char *FONTE_VERTICES_MALHA =
+    "layout(location = 0) in vec3 posicao;\n"
+    "layout(location = 1) in vec3 cor;\n"
+    "layout(location = 2) in vec3 normal;\n"
+    "layout(location = 3) in vec2 coordTextura;\n"
+    "layout(location = 4) in vec2 coordLuz;\n"
+    "out vec3 corVertice, normalEstadio, posicaoEstadio;\n"
+    "out vec2 st, stLuz;\n"
+    "void main() {\n"
+    "    corVertice = cor;\n"
+    "    normalEstadio = normal;\n"
+    "    posicaoEstadio = posicao;\n"
+    "    st = coordTextura;\n"
+    "    stLuz = coordLuz;\n"
+    "    gl_Position = projecao * (vista * vec4(posicao, 1.0));\n"
+    "}\n";
+
+const char *FONTE_FRAGMENTOS_MALHA =
+    "uniform sampler2D textura;\n"
+    "uniform sampler2D mapaLuz;\n"
+    "uniform int usarTextura;           // 0: lote sem textura carregada, só a cor\n"
+    "uniform int usarMapaLuz;\n"
+    "in vec3 corVertice, normalEstadio, posicaoEstadio;\n"
+    "in vec2 st, stLuz;\n"
+    "out vec4 corFinal;\n"
+    "void main() {\n"
+    "    vec3 cor = corVertice;\n"
+    "    if (direcaoSol.w > 0.0) {\n"
+    "        vec3 n = normalize(gl_FrontFacing ? normalEstadio : -normalEstadio);\n"
+    "        vec3 luz = ambiente.rgb + corSol.rgb * max(dot(n, direcaoSol.xyz), 0.0);\n"
+    "        for (int i = 0; i < 7; i++) {\n"
+    "            if (posicaoRefletor[i].w == 0.0) continue;\n"
+    "            vec3 d = posicaoRefletor[i].xyz - posicaoEstadio;\n"
+    "            float distancia2 = dot(d, d);\n"
+    "            d *= inversesqrt(distancia2);\n"
+    "            float spot = dot(-d, eixoRefletor[i].xyz);\n"
+    "            if (spot < corRefletor.w) continue;\n"
+    "            luz += corRefletor.rgb * max(dot(n, d), 0.0) * pow(spot, parametrosRefletor.x)\n"
+    "                 / (1.0 + parametrosRefletor.y * distancia2);\n"
+    "        }\n"
+    "        cor *= min(luz, vec3(1.0));\n"
+    "    }\n"
+    "    if (usarTextura != 0) cor *= texture(textura, st).rgb;\n"
+    "    if (usarMapaLuz != 0) {\n"
+    "        // Frente na metade de baixo do atlas, verso na de cima\n"
+    "        cor *= texture(mapaLuz, stLuz + vec2(0.0, gl_FrontFacing ? 0.0 : 0.5)).rgb;\n"
+    "    }\n"
+    "    corFinal = vec4(cor, 1.0);\n"
+    "}\n";
+
+const char *FONTE_VERTICES_ASSENTOS =
+    "layout(location = 0) in vec3 posicao;\n"
+    "layout(location = 1) in vec4 cor;\n"
+    "out vec4 corVertice;\n"
+    "void main() {\n"
+    "    corVertice = cor;\n"
+    "    gl_Position = projecao * (vista * vec4(posicao, 1.0));\n"
+    "}\n";
+
+const char *FONTE_FRAGMENTOS_ASSENTOS =
+    "in vec4 corVertice;\n"
+    "out vec4 corFinal;\n"
+    "void main() {\n"
+    "    corFinal = corVertice;\n"
+    "}\n";
+
+// Os atributos 1 a 4 avançam por instância (glVertexAttribDivisor)
+const char *FONTE_VERTICES_TORCIDA =
+    "layout(location = 0) in vec3 canto;        // x: lado (-1 a 1), y: base (0) ou topo (1), z: parte\n"
+    "layout(location = 1) in vec3 pes;\n"
+    "layout(location = 2) in vec4 corCamisa;\n"
+    "layout(location = 3) in vec4 corPele;\n"
+    "layout(location = 4) in float elevacao;\n"
+    "uniform vec3 lado;                         // Meia largura do corpo, para a direita da câmera\n"
+    "uniform vec3 dimensoes;                    // Altura do corpo, altura da cabeça, largura da cabeça\n"
+    "out vec4 corVertice;\n"
+    "void main() {\n"
+    "    // Parte 0: corpo; 1: cabeça; 2: corpo e cabeça num quadrilátero só (longe)\n"
+    "    bool cabeca = canto.z == 1.0;\n"
+    "    float z0 = cabeca ? dimensoes.x : 0.0;\n"
+    "    float z1 = canto.z == 0.0 ? dimensoes.x : dimensoes.x + dimensoes.y;\n"
+    "    vec3 p = pes + lado * (canto.x * (cabeca ? dimensoes.z : 1.0));\n"
+    "    p.z += elevacao + mix(z0, z1, canto.y);\n"
+    "    corVertice = cabeca ? corPele : corCamisa;\n"
+    "    gl_Position = projecao * (vista * vec4(p, 1.0));\n"
+    "}\n";
+
+struct UniformesCamera {                // std140: duas mat4
+    float projecao[16];
+    float vista[16];
+};
+
+struct UniformesHora {                  // std140: só vec4
+    float direcaoSol[4];
+    float corSol[4];
+    float ambiente[4];
+    float corRefletor[4];
+    float parametrosRefletor[4];
+    float posicaoRefletor[NUM_GRUPOS_REFLETORES_GL][4];
+    float eixoRefletor[NUM_GRUPOS_REFLETORES_GL][4];
+};
+
+struct BufferLote {
+    GLuint vao, vboVertices, vboLuz;
+    int versaoMalha;
+    bool comCoordsLuz;
+};
+
+struct InstanciaTorcidaGpu {             // Parte estática de um torcedor (20 bytes)
+    float x, y, z;
+    unsigned int corCamisa, corPele;
+};
+
+struct PipelineShaders {
+    bool disponivel;
+    GLuint programaMalha, programaAssentos, programaTorcida;
+    GLint localTextura, localMapaLuz, localLadoTorcida;
+    GLuint uboCamera, uboHora;
+    BufferLote lotes[NUM_PASSOS_RENDER];
+    GLuint vaoAssentos[NUM_LODS_ASSENTO], vboAssentos[NUM_LODS_ASSENTO];
+    std::vector<int> inicioBlocoAssentos[NUM_LODS_ASSENTO];   // Primeiro vértice de cada bloco
+    int versaoAssentos;
+    // Torcida: billboard modelo (os dois níveis em sequência), instâncias e elevações
+    GLuint vaoTorcida, vboModeloTorcida, vboInstanciasTorcida, vboElevacaoTorcida;
+    int versaoTorcida;
+};
+
+PipelineShaders pipeline = PipelineShaders();
+
+// Shaders, buffers e VAOs (GL 2.0 / 3.0 / 3.1), carregados em tempo de execução
+PFNGLCREATESHADERPROC pglCreateShader = NULL;
+PFNGLSHADERSOURCEPROC pglShaderSource = NULL;
+PFNGLCOMPILESHADERPROC pglCompileShader = NULL;
+PFNGLGETSHADERIVPROC pglGetShaderiv = NULL;
+PFNGLGETSHADERINFOLOGPROC pglGetShaderInfoLog = NULL;
+PFNGLDELETESHADERPROC pglDeleteShader = NULL;
+PFNGLCREATEPROGRAMPROC pglCreateProgram = NULL;
+PFNGLATTACHSHADERPROC pglAttachShader = NULL;
+PFNGLLINKPROGRAMPROC pglLinkProgram = NULL;
+PFNGLGETPROGRAMIVPROC pglGetProgramiv = NULL;
+PFNGLGETPROGRAMINFOLOGPROC pglGetProgramInfoLog = NULL;
+PFNGLDELETEPROGRAMPROC pglDeleteProgram = NULL;
+PFNGLUSEPROGRAMPROC pglUseProgram = NULL;
+PFNGLGETUNIFORMLOCATIONPROC pglGetUniformLocation = NULL;
+PFNGLUNIFORM1IPROC pglUniform1i = NULL;
+PFNGLUNIFORM3FPROC pglUniform3f = NULL;
+PFNGLGETUNIFORMBLOCKINDEXPROC pglGetUniformBlockIndex = NULL;
+PFNGLUNIFORMBLOCKBINDINGPROC pglUniformBlockBinding = NULL;
+PFNGLGENBUFFERSPROC pglGenBuffers = NULL;
+PFNGLBINDBUFFERPROC pglBindBuffer = NULL;
+PFNGLBUFFERDATAPROC pglBufferData = NULL;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData = NULL;
+PFNGLBINDBUFFERBASEPROC pglBindBufferBase = NULL;
+PFNGLGENVERTEXARRAYSPROC pglGenVertexArrays = NULL;
+PFNGLBINDVERTEXARRAYPROC pglBindVertexArray = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC pglVertexAttribPointer = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC pglEnableVertexAttribArray = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = NULL;
+PFNGLVERTEXATTRIB2FPROC pglVertexAttrib2f = NULL;
+PFNGLVERTEXATTRIBDIVISORPROC pglVertexAttribDivisor = NULL;
+PFNGLDRAWARRAYSINSTANCEDPROC pglDrawArraysInstanced = NULL;
+// Binários de programa (GL 4.1 / ARB_get_program_binary), opcionais
+PFNGLGETPROGRAMBINARYPROC pglGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC pglProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC pglProgramParameteri = NULL;
+bool cacheShadersDisponivel = false;
+const char *caminhoExecutavel = NULL;           // argv[0]: reserva para o diretório do cache
+double msEconomizadosCacheShaders = 0.0;        // Relatado no tempo de inicialização
+
+bool carregarFuncoesShaders() {
+    pglCreateShader = (PFNGLCREATESHADERPROC)glutGetProcAddress("glCreateShader");
+    pglShaderSource = (PFNGLSHADERSOURCEPROC)glutGetProcAddress("glShaderSource");
+    pglCompileShader = (PFNGLCOMPILESHADERPROC)glutGetProcAddress("glCompileShader");
+    pglGetShaderiv = (PFNGLGETSHADERIVPROC)glutGetProcAddress("glGetShaderiv");
+    pglGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)glutGetProcAddress("glGetShaderInfoLog");
+    pglDeleteShader = (PFNGLDELETESHADERPROC)glutGetProcAddress("glDeleteShader");
+    pglCreateProgram = (PFNGLCREATEPROGRAMPROC)glutGetProcAddress("glCreateProgram");
+    pglAttachShader = (PFNGLATTACHSHADERPROC)glutGetProcAddress("glAttachShader");
+    pglLinkProgram = (PFNGLLINKPROGRAMPROC)glutGetProcAddress("glLinkProgram");
+    pglGetProgramiv = (PFNGLGETPROGRAMIVPROC)glutGetProcAddress("glGetProgramiv");
+    pglGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)glutGetProcAddress("glGetProgramInfoLog");
+    pglDeleteProgram = (PFNGLDELETEPROGRAMPROC)glutGetProcAddress("glDeleteProgram");
+    pglUseProgram = (PFNGLUSEPROGRAMPROC)glutGetProcAddress("glUseProgram");
+    pglGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)glutGetProcAddress("glGetUniformLocation");
+    pglUniform1i = (PFNGLUNIFORM1IPROC)glutGetProcAddress("glUniform1i");
+    pglUniform3f = (PFNGLUNIFORM3FPROC)glutGetProcAddress("glUniform3f");
+    pglGetUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)glutGetProcAddress("glGetUniformBlockIndex");
+    pglUniformBlockBinding = (PFNGLUNIFORMBLOCKBINDINGPROC)glutGetProcAddress("glUniformBlockBinding");
+    pglGenBuffers = (PFNGLGENBUFFERSPROC)glutGetProcAddress("glGenBuffers");
+    pglBindBuffer = (PFNGLBINDBUFFERPROC)glutGetProcAddress("glBindBuffer");
+    pglBufferData = (PFNGLBUFFERDATAPROC)glutGetProcAddress("glBufferData");
+    pglBufferSubData = (PFNGLBUFFERSUBDATAPROC)glutGetProcAddress("glBufferSubData");
+    pglBindBufferBase = (PFNGLBINDBUFFERBASEPROC)glutGetProcAddress("glBindBufferBase");
+    pglGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)glutGetProcAddress("glGenVertexArrays");
+    pglBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)glutGetProcAddress("glBindVertexArray");
+    pglVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)glutGetProcAddress("glVertexAttribPointer");
+    pglEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)glutGetProcAddress("glEnableVertexAttribArray");
+    pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)glutGetProcAddress("glDisableVertexAttribArray");
+    pglVertexAttrib2f = (PFNGLVERTEXATTRIB2FPROC)glutGetProcAddress("glVertexAttrib2f");
+    pglVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)glutGetProcAddress("glVertexAttribDivisor");
+    pglDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDPROC)glutGetProcAddress("glDrawArraysInstanced");
+    return pglCreateShader && pglShaderSource && pglCompileShader && pglGetShaderiv && pglGetShaderInfoLog
+        && pglDeleteShader && pglCreateProgram && pglAttachShader && pglLinkProgram && pglGetProgramiv
+        && pglGetProgramInfoLog && pglDeleteProgram && pglUseProgram && pglGetUniformLocation && pglUniform1i
+        && pglUniform3f && pglVertexAttribDivisor && pglDrawArraysInstanced
+        && pglGetUniformBlockIndex && pglUniformBlockBinding && pglGenBuffers && pglBindBuffer && pglBufferData
+        && pglBufferSubData && pglBindBufferBase && pglGenVertexArrays && pglBindVertexArray
+        && pglVertexAttribPointer && pglEnableVertexAttribArray && pglDisableVertexAttribArray && pglVertexAttrib2f;
+}
+
+// O cache só é usado se o driver oferecer algum formato de binário
+bool carregarFuncoesCacheShaders() {
+    pglGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glutGetProcAddress("glGetProgramBinary");
+    pglProgramBinary = (PFNGLPROGRAMBINARYPROC)glutGetProcAddress("glProgramBinary");
+    pglProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glutGetProcAddress("glProgramParameteri");
+    if (!pglGetProgramBinary || !pglProgramBinary || !pglProgramParameteri) return false;
+    GLint numFormatos = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormatos);
+    return numFormatos > 0;
+}
+
+// Versão da GLSL como inteiro (1.30 -> 130); 0 se a GLSL não existir
+int versaoGlsl() {
+    const char *texto = (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION);
+    int maior = 0, menor = 0;
+    if (!texto || sscanf(texto, "%d.%d", &maior, &menor) != 2) return 0;
+    return maior * 100 + (menor < 10 ? menor * 10 : menor);
+}
+
+// Compila um estágio: cabeçalho da versão, blocos de uniformes e o corpo
+GLuint compilarShader(GLenum tipo, const char *corpo, const char *nome) {
+    const char *partes[3] = {CABECALHO_GLSL, FONTE_BLOCOS_UNIFORMES, corpo};
+    GLuint shader = pglCreateShader(tipo);
+    pglShaderSource(shader, 3, partes, NULL);
+    pglCompileShader(shader);
+    GLint ok = GL_FALSE;
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char registro[2048];
+        pglGetShaderInfoLog(shader, sizeof(registro), NULL, registro);
+        fprintf(stderr, "Aviso: shader de %s (%s) não compilou:\n%s\n",
+                tipo == GL_VERTEX_SHADER ? "vértices" : "fragmentos", nome, registro);
+        pglDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Blocos de uniformes nos seus vínculos (refeito também nos programas vindos do cache)
+void vincularBlocosUniformes(GLuint programa) {
+    GLuint blocoCamera = pglGetUniformBlockIndex(programa, "Camera");
+    GLuint blocoHora = pglGetUniformBlockIndex(programa, "HoraDoDia");
+    if (blocoCamera != GL_INVALID_INDEX) pglUniformBlockBinding(programa, blocoCamera, VINCULO_UBO_CAMERA);
+    if (blocoHora != GL_INVALID_INDEX) pglUniformBlockBinding(programa, blocoHora, VINCULO_UBO_HORA);
+}
+
+// Liga os dois estágios; 0 se falhar
+GLuint criarPrograma(const char *fonteVertices, const char *fonteFragmentos, const char *nome) {
+    GLuint vertices = compilarShader(GL_VERTEX_SHADER, fonteVertices, nome);
+    GLuint fragmentos = compilarShader(GL_FRAGMENT_SHADER, fonteFragmentos, nome);
+    if (!vertices || !fragmentos) {
+        if (vertices) pglDeleteShader(vertices);
+        if (fragmentos) pglDeleteShader(fragmentos);
+        return 0;
+    }
+    GLuint programa = pglCreateProgram();
+    pglAttachShader(programa, vertices);
+    pglAttachShader(programa, fragmentos);
+    if (cacheShadersDisponivel) pglProgramParameteri(programa, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    pglLinkProgram(programa);
+    pglDeleteShader(vertices);          // Só marcados: saem junto com o programa
+    pglDeleteShader(fragmentos);
+    GLint ok = GL_FALSE;
+    pglGetProgramiv(programa, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char registro[2048];
+        pglGetProgramInfoLog(programa, sizeof(registro), NULL, registro);
+        fprintf(stderr, "Aviso: programa %s não foi ligado:\n%s\n", nome, registro);
+        pglDeleteProgram(programa);
+        return 0;
+    }
+    return programa;
+}
+
+// FNV-1a de 64 bits, acumulado sobre vários textos
+unsigned long long hashTexto(unsigned long long hash, const char *texto) {
+    for (const unsigned char *c = (const unsigned char *)texto; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Fabricante, renderizador e versão do GL: um binário só vale para o mesmo driver
+void identificarDriver(char *saida, size_t tamanho) {
+    const char *fabricante = (const char *)glGetString(GL_VENDOR);
+    const char *renderizador = (const char *)glGetString(GL_RENDERER);
+    const char *versao = (const char *)glGetString(GL_VERSION);
+    snprintf(saida, tamanho, "%s|%s|%s", fabricante ? fabricante : "?",
+             renderizador ? renderizador : "?", versao ? versao : "?");
+}
+
+// Diretório do executável + NOME_CACHE_SHADERS. O argv[0] não tem barra
+// quando o programa é achado pelo PATH, então vale primeiro o /proc/self/exe;
+// o argv[0] (ou o diretório atual) fica só para quando ele falha
+void montarCaminhoCacheShaders(char *saida, size_t tamanho) {
+    const char *executavel = caminhoExecutavel;
+#if defined(__linux__)
+    char resolvido[1024];
+    ssize_t lidos = readlink("/proc/self/exe", resolvido, sizeof(resolvido) - 1);
+    if (lidos > 0) {
+        resolvido[lidos] = '\0';
+        executavel = resolvido;
+    }
+#endif
+    const char *barra = executavel ? strrchr(executavel, '/') : NULL;
+    int diretorio = barra ? (int)(barra - executavel + 1) : 0;
+    snprintf(saida, tamanho, "%.*s%s", diretorio, executavel ? executavel : "", NOME_CACHE_SHADERS);
+}
+
+// Carrega todos os programas do cache ou nenhum. Valida o cabeçalho, a
+// chave e o driver, e cada binário precisa ser aceito (GL_LINK_STATUS).
+bool carregarCacheShaders(const char *caminho, unsigned long long chave, const char *driver,
+                          GLuint programas[NUM_PROGRAMAS_SHADER], double &msCompilacao) {
+    FILE *arquivo = fopen(caminho, "rb");
+    if (!arquivo) return false;
+    char magico[4];
+    unsigned int versao = 0, tamanhoDriver = 0;
+    unsigned long long chaveArquivo = 0;
+    char driverArquivo[512];
+    bool valido = fread(magico, 1, 4, arquivo) == 4 && memcmp(magico, MAGICO_CACHE_SHADERS, 4) == 0
+               && fread(&versao, sizeof(versao), 1, arquivo) == 1 && versao == VERSAO_CACHE_SHADERS
+               && fread(&chaveArquivo, sizeof(chaveArquivo), 1, arquivo) == 1 && chaveArquivo == chave
+               && fread(&tamanhoDriver, sizeof(tamanhoDriver), 1, arquivo) == 1
+               && tamanhoDriver < sizeof(driverArquivo)
+               && fread(driverArquivo, 1, tamanhoDriver, arquivo) == tamanhoDriver
+               && fread(&msCompilacao, sizeof(msCompilacao), 1, arquivo) == 1;
+    if (valido) {
+        driverArquivo[tamanhoDriver] = '\0';
+        valido = strcmp(driverArquivo, driver) == 0;
+    }
+    int carregados = 0;
+    std::vector<char> binario;
+    while (valido && carregados < NUM_PROGRAMAS_SHADER) {
+        unsigned int formato = 0, tamanho = 0;
+        valido = fread(&formato, sizeof(formato), 1, arquivo) == 1 && fread(&tamanho, sizeof(tamanho), 1, arquivo) == 1
+              && tamanho > 0 && tamanho < (64u << 20);
+        if (!valido) break;
+        binario.resize(tamanho);
+        valido = fread(&binario[0], 1, tamanho, arquivo) == tamanho;
+        if (!valido) break;
+        GLuint programa = pglCreateProgram();
+        pglProgramBinary(programa, (GLenum)formato, &binario[0], (GLsizei)tamanho);
+        GLint ok = GL_FALSE;
+        pglGetProgramiv(programa, GL_LINK_STATUS, &ok);
+        if (!ok) {
+            pglDeleteProgram(programa);
+            valido = false;
+            break;
+        }
+        programas[carregados++] = programa;
+    }
+    fclose(arquivo);
+    if (!valido) {
+        for (int i = 0; i < carregados; i++) pglDeleteProgram(programas[i]);
+        fprintf(stderr, "Aviso: cache de shaders '%s' inválido ou de outro driver; recompilando.\n", caminho);
+    }
+    return valido;
+}
+
+void gravarCacheShaders(const char *caminho, unsigned long long chave, const char *driver,
+                        const GLuint programas[NUM_PROGRAMAS_SHADER], double msCompilacao) {
+    std::vector<char> binarios[NUM_PROGRAMAS_SHADER];
+    GLenum formatos[NUM_PROGRAMAS_SHADER];
+    for (int i = 0; i < NUM_PROGRAMAS_SHADER; i++) {
+        GLint tamanho = 0;
+        pglGetProgramiv(programas[i], GL_PROGRAM_BINARY_LENGTH, &tamanho);
+        if (tamanho <= 0) return;
+        binarios[i].resize(tamanho);
+        GLsizei obtido = 0;
+        pglGetProgramBinary(programas[i], tamanho, &obtido, &formatos[i], &binarios[i][0]);
+        if (obtido <= 0) return;
+        binarios[i].resize(obtido);
+    }
+    FILE *arquivo = fopen(caminho, "wb");
+    if (!arquivo) {
+        fprintf(stderr, "Aviso: não foi possível gravar o cache de shaders '%s'\n", caminho);
+        return;
+    }
+    unsigned int tamanhoDriver = (unsigned int)strlen(driver);
+    fwrite(MAGICO_CACHE_SHADERS, 1, 4, arquivo);
+    fwrite(&VERSAO_CACHE_SHADERS, sizeof(VERSAO_CACHE_SHADERS), 1, arquivo);
+    fwrite(&chave, sizeof(chave), 1, arquivo);
+    fwrite(&tamanhoDriver, sizeof(tamanhoDriver), 1, arquivo);
+    fwrite(driver, 1, tamanhoDriver, arquivo);
+    fwrite(&msCompilacao, sizeof(msCompilacao), 1, arquivo);
+    size_t total = 0;
+    for (int i = 0; i < NUM_PROGRAMAS_SHADER; i++) {
+        unsigned int formato = formatos[i], tamanho = (unsigned int)binarios[i].size();
+        fwrite(&formato, sizeof(formato), 1, arquivo);
+        fwrite(&tamanho, sizeof(tamanho), 1, arquivo);
+        fwrite(&binarios[i][0], 1, tamanho, arquivo);
+        total += tamanho;
+    }
+    bool ok = !ferror(arquivo);
+    ok = fclose(arquivo) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Aviso: erro ao gravar o cache de shaders '%s'\n", caminho);
+        remove(caminho);
+        return;
+    }
+    printf("Cache de shaders gravado em '%s' (%lu bytes)\n", caminho, (unsigned long)total);
+}
+
+GLuint criarBufferUniformes(GLsizeiptr tamanho, int vinculo) {
+    GLuint ubo;
+    pglGenBuffers(1, &ubo);
+    pglBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    pglBufferData(GL_UNIFORM_BUFFER, tamanho, NULL, GL_DYNAMIC_DRAW);
+    pglBindBufferBase(GL_UNIFORM_BUFFER, vinculo, ubo);
+    pglBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return ubo;
+}
+
+// Billboard modelo da torcida: corpo e cabeça (nível 0) seguidos do
+// quadrilátero único (nível 1). Os atributos por instância só ganham
+// ponteiros no desenho, que aponta para o primeiro torcedor de cada trecho
+const int INICIO_MODELO_TORCEDOR[2] = {0, 12};
+const int VERTICES_MODELO_TORCEDOR[2] = {12, 6};
+void iniciarBuffersTorcida() {
+    float modelo[18][3];
+    for (int parte = 0; parte < 3; parte++) {
+        for (int i = 0; i < 6; i++) {
+            modelo[parte * 6 + i][0] = CANTOS_QUAD_TORCEDOR[i][0];
+            modelo[parte * 6 + i][1] = CANTOS_QUAD_TORCEDOR[i][1];
+            modelo[parte * 6 + i][2] = (float)parte;
+        }
+    }
+    pglGenVertexArrays(1, &pipeline.vaoTorcida);
+    pglGenBuffers(1, &pipeline.vboModeloTorcida);
+    pglGenBuffers(1, &pipeline.vboInstanciasTorcida);
+    pglGenBuffers(1, &pipeline.vboElevacaoTorcida);
+    pglBindVertexArray(pipeline.vaoTorcida);
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboModeloTorcida);
+    pglBufferData(GL_ARRAY_BUFFER, sizeof(modelo), modelo, GL_STATIC_DRAW);
+    pglVertexAttribPointer(ATRIBUTO_CANTO_TORCEDOR, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    pglEnableVertexAttribArray(ATRIBUTO_CANTO_TORCEDOR);
+    const int porInstancia[4] = {
+        ATRIBUTO_PES_TORCEDOR, ATRIBUTO_CAMISA_TORCEDOR, ATRIBUTO_PELE_TORCEDOR, ATRIBUTO_ELEVACAO_TORCEDOR
+    };
+    for (int i = 0; i < 4; i++) {
+        pglEnableVertexAttribArray(porInstancia[i]);
+        pglVertexAttribDivisor(porInstancia[i], 1);
+    }
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pipeline.versaoTorcida = -1;
+}
+
+// Compila os programas na inicialização; sem eles, tudo fica no pipeline fixo
+bool iniciarShaders() {
+    RASTREAR_FUNCAO();
+    if (!shadersLigados.load()) return false;
+    int versao = versaoGlsl();
+    if (versao < 330 || !carregarFuncoesShaders()) {
+        fprintf(stderr, "Aviso: GLSL 3.30 indisponível (versão %d); usando o pipeline fixo.\n", versao);
+        shadersLigados.store(false);
+        return false;
+    }
+    double inicio = tempoAtualMs();
+    const char *fontes[NUM_PROGRAMAS_SHADER][3] = {
+        {"malha", FONTE_VERTICES_MALHA, FONTE_FRAGMENTOS_MALHA},
+        {"assentos", FONTE_VERTICES_ASSENTOS, FONTE_FRAGMENTOS_ASSENTOS},
+        {"torcida", FONTE_VERTICES_TORCIDA, FONTE_FRAGMENTOS_ASSENTOS},
+    };
+    GLuint programas[NUM_PROGRAMAS_SHADER] = {0, 0, 0};
+    char caminhoCache[1024], driver[512];
+    unsigned long long chave = 14695981039346656037ULL;
+    cacheShadersDisponivel = carregarFuncoesCacheShaders();
+    bool doCache = false;
+    double msCompilacao = 0.0;
+    if (cacheShadersDisponivel) {
+        identificarDriver(driver, sizeof(driver));
+        montarCaminhoCacheShaders(caminhoCache, sizeof(caminhoCache));
+        chave = hashTexto(hashTexto(chave, CABECALHO_GLSL), FONTE_BLOCOS_UNIFORMES);
+        for (int i = 0; i < NUM_PROGRAMAS_SHADER; i++) {
+            chave = hashTexto(hashTexto(hashTexto(chave, fontes[i][0]), fontes[i][1]), fontes[i][2]);
+        }
+        chave = hashTexto(chave, driver);
+        doCache = carregarCacheShaders(caminhoCache, chave, driver, programas, msCompilacao);
+    }
+    if (!doCache) {
+        bool ok = true;
+        for (int i = 0; i < NUM_PROGRAMAS_SHADER; i++) {
+            programas[i] = criarPrograma(fontes[i][1], fontes[i][2], fontes[i][0]);
+            ok = ok && programas[i] != 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Aviso: shaders indisponíveis; usando o pipeline fixo.\n");
+            shadersLigados.store(false);
+            return false;
+        }
+        msCompilacao = tempoAtualMs() - inicio;
+        if (cacheShadersDisponivel) gravarCacheShaders(caminhoCache, chave, driver, programas, msCompilacao);
+    }
+    for (int i = 0; i < NUM_PROGRAMAS_SHADER; i++) vincularBlocosUniformes(programas[i]);
+    pipeline.programaMalha = programas[0];
+    pipeline.programaAssentos = programas[1];
+    pipeline.programaTorcida = programas[2];
+    pglUseProgram(pipeline.programaMalha);
+    pglUniform1i(pglGetUniformLocation(pipeline.programaMalha, "textura"), 0);
+    pglUniform1i(pglGetUniformLocation(pipeline.programaMalha, "mapaLuz"), 1);
+    pipeline.localTextura = pglGetUniformLocation(pipeline.programaMalha, "usarTextura");
+    pipeline.localMapaLuz = pglGetUniformLocation(pipeline.programaMalha, "usarMapaLuz");
+    pglUseProgram(pipeline.programaTorcida);
+    pglUniform3f(pglGetUniformLocation(pipeline.programaTorcida, "dimensoes"),
+                 ALTURA_CORPO_TORCEDOR, ALTURA_CABECA_TORCEDOR, ESCALA_CABECA_TORCEDOR);
+    pipeline.localLadoTorcida = pglGetUniformLocation(pipeline.programaTorcida, "lado");
+    pglUseProgram(0);
+
+    pipeline.uboCamera = criarBufferUniformes(sizeof(UniformesCamera), VINCULO_UBO_CAMERA);
+    pipeline.uboHora = criarBufferUniformes(sizeof(UniformesHora), VINCULO_UBO_HORA);
+    for (int p = 0; p < NUM_PASSOS_RENDER; p++) {
+        BufferLote &b = pipeline.lotes[p];
+        pglGenVertexArrays(1, &b.vao);
+        pglGenBuffers(1, &b.vboVertices);
+        pglGenBuffers(1, &b.vboLuz);
+        b.versaoMalha = -1;
+    }
+    pglGenVertexArrays(NUM_LODS_ASSENTO, pipeline.vaoAssentos);
+    pglGenBuffers(NUM_LODS_ASSENTO, pipeline.vboAssentos);
+    pipeline.versaoAssentos = -1;
+    iniciarBuffersTorcida();
+    pipeline.disponivel = true;
+    shadersDisponiveis.store(true);
+    double ms = tempoAtualMs() - inicio;
+    if (doCache) {
+        msEconomizadosCacheShaders = std::max(0.0, msCompilacao - ms);
+        printf("Shaders: %d programas carregados do cache '%s' em %.2f ms (compilação: %.2f ms)\n",
+               NUM_PROGRAMAS_SHADER, caminhoCache, ms, msCompilacao);
+    } else {
+        printf("Shaders: %d programas GLSL %d.%02d compilados e ligados em %.2f ms\n",
+               NUM_PROGRAMAS_SHADER, versao / 100, versao % 100, ms);
+    }
+    return true;
+}
+
+// Envia o lote ao seu buffer se a malha mudou desde o último envio
+void atualizarBufferLote(PassoRender passo) {
+    const LoteMalha &lote = lotesMalha[passo];
+    BufferLote &b = pipeline.lotes[passo];
+    if (b.versaoMalha == versaoMalhaEstadio) return;
+    b.versaoMalha = versaoMalhaEstadio;
+    b.comCoordsLuz = !lote.coordsLuz.empty();
+
+    GLsizei passoVertice = sizeof(VerticeMalha);
+    pglBindVertexArray(b.vao);
+    pglBindBuffer(GL_ARRAY_BUFFER, b.vboVertices);
+    pglBufferData(GL_ARRAY_BUFFER, lote.vertices.size() * sizeof(VerticeMalha),
+                  lote.vertices.empty() ? NULL : &lote.vertices[0], GL_STATIC_DRAW);
+    pglVertexAttribPointer(ATRIBUTO_POSICAO, 3, GL_FLOAT, GL_FALSE, passoVertice,
+                           (const void *)offsetof(VerticeMalha, x));
+    pglVertexAttribPointer(ATRIBUTO_COR, 3, GL_FLOAT, GL_FALSE, passoVertice,
+                           (const void *)offsetof(VerticeMalha, r));
+    pglVertexAttribPointer(ATRIBUTO_NORMAL, 3, GL_FLOAT, GL_FALSE, passoVertice,
+                           (const void *)offsetof(VerticeMalha, nx));
+    pglVertexAttribPointer(ATRIBUTO_COORD_TEXTURA, 2, GL_FLOAT, GL_FALSE, passoVertice,
+                           (const void *)offsetof(VerticeMalha, s));
+    pglEnableVertexAttribArray(ATRIBUTO_POSICAO);
+    pglEnableVertexAttribArray(ATRIBUTO_COR);
+    pglEnableVertexAttribArray(ATRIBUTO_NORMAL);
+    pglEnableVertexAttribArray(ATRIBUTO_COORD_TEXTURA);
+    if (b.comCoordsLuz) {
+        pglBindBuffer(GL_ARRAY_BUFFER, b.vboLuz);
+        pglBufferData(GL_ARRAY_BUFFER, lote.coordsLuz.size() * sizeof(float), &lote.coordsLuz[0], GL_STATIC_DRAW);
+        pglVertexAttribPointer(ATRIBUTO_COORD_LUZ, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+        pglEnableVertexAttribArray(ATRIBUTO_COORD_LUZ);
+    } else {
+        pglDisableVertexAttribArray(ATRIBUTO_COORD_LUZ);
+    }
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);  // Os arranjos do pipeline fixo são ponteiros da CPU
+    estatisticasQuadro.bytesEnviados += lote.vertices.size() * sizeof(VerticeMalha)
+                                      + lote.coordsLuz.size() * sizeof(float);
+}
+
+// Um buffer por nível de detalhe com os blocos em sequência
+void atualizarBuffersAssentos() {
+    if (pipeline.versaoAssentos == versaoAssentos) return;
+    pipeline.versaoAssentos = versaoAssentos;
+    int numBlocos = (int)blocosAssentos.size();
+    std::vector<VerticeAssento> todos;
+    for (int n = 0; n < NUM_LODS_ASSENTO; n++) {
+        pipeline.inicioBlocoAssentos[n].resize(numBlocos);
+        size_t total = 0;
+        for (int b = 0; b < numBlocos; b++) {
+            pipeline.inicioBlocoAssentos[n][b] = (int)total;
+            total += blocosAssentos[b].lod[n].size();
+        }
+        todos.resize(total);
+        executarEmParalelo(0, numBlocos, 16, [&](int b) {
+            const std::vector<VerticeAssento> &v = blocosAssentos[b].lod[n];
+            if (!v.empty()) memcpy(&todos[pipeline.inicioBlocoAssentos[n][b]], &v[0], v.size() * sizeof(VerticeAssento));
+        });
+        pglBindVertexArray(pipeline.vaoAssentos[n]);
+        pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboAssentos[n]);
+        pglBufferData(GL_ARRAY_BUFFER, total * sizeof(VerticeAssento), total ? &todos[0] : NULL, GL_STATIC_DRAW);
+        pglVertexAttribPointer(ATRIBUTO_POSICAO, 3, GL_FLOAT, GL_FALSE, sizeof(VerticeAssento),
+                               (const void *)offsetof(VerticeAssento, x));
+        pglVertexAttribPointer(ATRIBUTO_COR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VerticeAssento),
+                               (const void *)offsetof(VerticeAssento, r));
+        pglEnableVertexAttribArray(ATRIBUTO_POSICAO);
+        pglEnableVertexAttribArray(ATRIBUTO_COR);
+        estatisticasQuadro.bytesEnviados += total * sizeof(VerticeAssento);
+    }
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Câmera e hora do dia nos blocos de uniformes, uma vez por quadro (com a
+// câmera já na modelview)
+void atualizarUniformesShaders(const EstadoCena &cena, bool iluminar) {
+    UniformesCamera camera;
+    glGetFloatv(GL_PROJECTION_MATRIX, camera.projecao);
+    glGetFloatv(GL_MODELVIEW_MATRIX, camera.vista);
+    pglBindBuffer(GL_UNIFORM_BUFFER, pipeline.uboCamera);
+    pglBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera), &camera);
+
+    // Os mesmos termos de ligarIluminacao()
+    UniformesHora hora;
+    memset(&hora, 0, sizeof(hora));
+    float noite = std::min(cena.alphaFiltro, 1.0f);
+    float ambiente = LUZ_AMBIENTE_DIA + (LUZ_AMBIENTE_NOITE - LUZ_AMBIENTE_DIA) * noite;
+    Vetor3 sol = direcaoSol(diaDoAnoSol, horaSolCena.load());
+    float difusaSol = sol.z > 0.0f ? LUZ_DIFUSA_SOL * (1.0f - noite) : 0.0f;
+    hora.direcaoSol[0] = sol.x; hora.direcaoSol[1] = sol.y; hora.direcaoSol[2] = sol.z;
+    hora.direcaoSol[3] = iluminar ? 1.0f : 0.0f;
+    hora.corSol[0] = difusaSol; hora.corSol[1] = difusaSol * 0.95f; hora.corSol[2] = difusaSol * 0.9f;
+    hora.ambiente[0] = hora.ambiente[1] = hora.ambiente[2] = ambiente;
+    hora.corRefletor[0] = LUZ_DIFUSA_GRUPO_REFLETORES;
+    hora.corRefletor[1] = LUZ_DIFUSA_GRUPO_REFLETORES * 0.92f;
+    hora.corRefletor[2] = LUZ_DIFUSA_GRUPO_REFLETORES * 0.8f;
+    hora.corRefletor[3] = cosf(GRAUS_PARA_RAD(ABERTURA_REFLETOR_GRAUS + PENUMBRA_REFLETOR_GRAUS));
+    hora.parametrosRefletor[0] = EXPOENTE_SPOT_REFLETOR;
+    hora.parametrosRefletor[1] = ATENUACAO_QUADRATICA_REFLETOR;
+    for (int g = 0; cena.luzesRefletoresLigadas && g < NUM_GRUPOS_REFLETORES_GL; g++) {
+        Vetor3 p, eixo;
+        refletorMarquise((g + 0.5f) / NUM_GRUPOS_REFLETORES_GL, p, eixo);
+        hora.posicaoRefletor[g][0] = p.x; hora.posicaoRefletor[g][1] = p.y;
+        hora.posicaoRefletor[g][2] = p.z; hora.posicaoRefletor[g][3] = 1.0f;
+        hora.eixoRefletor[g][0] = eixo.x; hora.eixoRefletor[g][1] = eixo.y; hora.eixoRefletor[g][2] = eixo.z;
+    }
+    pglBindBuffer(GL_UNIFORM_BUFFER, pipeline.uboHora);
+    pglBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(hora), &hora);
+    pglBindBuffer(GL_UNIFORM_BUFFER, 0);
+    estatisticasQuadro.bytesEnviados += sizeof(camera) + sizeof(hora);
+}
+
+// Pés e cores dos torcedores, enviados só quando a torcida é construída; o
+// buffer das elevações é reservado aqui e preenchido a cada quadro
+void atualizarBuffersTorcida() {
+    if (pipeline.versaoTorcida == versaoTorcida) return;
+    pipeline.versaoTorcida = versaoTorcida;
+    const InstanciasTorcida &inst = instanciasTorcida;
+    size_t numTorcedores = inst.x.size();
+    std::vector<InstanciaTorcidaGpu> dados(numTorcedores);
+    for (size_t i = 0; i < numTorcedores; i++) {
+        InstanciaTorcidaGpu &d = dados[i];
+        d.x = inst.x[i];
+        d.y = inst.y[i];
+        d.z = inst.z[i];
+        d.corCamisa = inst.corCamisa[i];
+        d.corPele = inst.corPele[i];
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboInstanciasTorcida);
+    pglBufferData(GL_ARRAY_BUFFER, numTorcedores * sizeof(InstanciaTorcidaGpu),
+                  numTorcedores ? &dados[0] : NULL, GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboElevacaoTorcida);
+    pglBufferData(GL_ARRAY_BUFFER, numTorcedores * sizeof(float), NULL, GL_STREAM_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    estatisticasQuadro.bytesEnviados += numTorcedores * sizeof(InstanciaTorcidaGpu);
+}
+
+bool usarShaders() {
+    return pipeline.disponivel && shadersLigados.load();
+}
+
+// Como desenharArrays(), contando os vértices e primitivas de todas as instâncias
+void desenharArraysInstanciado(GLenum modo, GLint primeiro, GLsizei quantidade, GLsizei instancias) {
+    pglDrawArraysInstanced(modo, primeiro, quantidade, instancias);
+    estatisticasQuadro.chamadasDesenho++;
+    estatisticasQuadro.vertices += (unsigned long)quantidade * instancias;
+    estatisticasQuadro.primitivas += contarPrimitivas(modo, quantidade) * instancias;
+}
+
+// Mesmo culling e mesmos trechos de desenharLoteMalha(), a partir do VAO do lote
+void desenharLoteMalhaShader(PassoRender passo, const float planos[6][4]) {
+    LoteMalha &lote = lotesMalha[passo];
+    if (lote.objetos.empty()) return;
+    testarVisibilidadeLote(lote, planos);
+    atualizarBufferLote(passo);
+
+    vincularTextura(*lote.textura);
+    GLuint texturaLuz = pipeline.lotes[passo].comCoordsLuz ? texturaLuzDoLote(lote) : 0;
+    if (texturaLuz) {
+        pglActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, texturaLuz);
+        pglActiveTexture(GL_TEXTURE0);
+    }
+    pglUseProgram(pipeline.programaMalha);
+    pglUniform1i(pipeline.localTextura, *lote.textura ? 1 : 0);
+    pglUniform1i(pipeline.localMapaLuz, texturaLuz ? 1 : 0);
+    pglBindVertexArray(pipeline.lotes[passo].vao);
+    int i = 0, primeiro, quantidade;
+    while (proximoTrechoVisivel(lote, i, primeiro, quantidade, true)) {
+        desenharArrays(GL_TRIANGLES, primeiro, quantidade);
+    }
+    pglBindVertexArray(0);
+    pglUseProgram(0);
+}
+
+void desenharAssentosShader(const float planos[6][4], const Vetor3 &olho, float focoPixels) {
+    std::vector<signed char> nivel;
+    escolherNiveisAssentos(planos, olho, focoPixels, nivel);
+    atualizarBuffersAssentos();
+    pglUseProgram(pipeline.programaAssentos);
+    for (int n = 0; n < NUM_LODS_ASSENTO; n++) {
+        pglBindVertexArray(pipeline.vaoAssentos[n]);
+        for (int b = 0; b < (int)blocosAssentos.size(); b++) {
+            if (nivel[b] < 0) {
+                if (n == 0) estatisticasQuadro.objetosDescartados++;
+                continue;
+            }
+            int quantidade = (int)blocosAssentos[b].lod[n].size();
+            if (nivel[b] != n || quantidade == 0) continue;
+            desenharArrays(GL_TRIANGLES, pipeline.inicioBlocoAssentos[n][b], quantidade);
+        }
+    }
+    pglBindVertexArray(0);
+    pglUseProgram(0);
+}
+
+// Atributos por instância a partir do torcedor 'primeiro' (o GL 3.3 não tem
+// instância base no desenho)
+void apontarInstanciasTorcida(int primeiro) {
+    GLsizei passo = sizeof(InstanciaTorcidaGpu);
+    size_t base = (size_t)primeiro * passo;
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboInstanciasTorcida);
+    pglVertexAttribPointer(ATRIBUTO_PES_TORCEDOR, 3, GL_FLOAT, GL_FALSE, passo,
+                           (const void *)(base + offsetof(InstanciaTorcidaGpu, x)));
+    pglVertexAttribPointer(ATRIBUTO_CAMISA_TORCEDOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, passo,
+                           (const void *)(base + offsetof(InstanciaTorcidaGpu, corCamisa)));
+    pglVertexAttribPointer(ATRIBUTO_PELE_TORCEDOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, passo,
+                           (const void *)(base + offsetof(InstanciaTorcidaGpu, corPele)));
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboElevacaoTorcida);
+    pglVertexAttribPointer(ATRIBUTO_ELEVACAO_TORCEDOR, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                           (const void *)((size_t)primeiro * sizeof(float)));
+}
+
+// Mesmo culling, níveis e animação de desenharTorcida(), mas só as elevações
+// dos blocos visíveis vão para a GPU; o modelo é desenhado uma vez por
+// torcedor, numa chamada por trecho de blocos vizinhos do mesmo nível
+void desenharTorcidaShader(const float planos[6][4], const Vetor3 &olho, const Vetor3 &direitaCamera,
+                           float focoPixels, double tempoS, const std::vector<unsigned char> &alturasOla) {
+    int numBlocos = (int)blocosTorcida.size();
+    if (numBlocos == 0) return;
+    std::vector<signed char> nivel;
+    prepararTorcida(planos, olho, direitaCamera, focoPixels, tempoS, alturasOla, false, nivel);
+    atualizarBuffersTorcida();
+
+    // Elevações dos trechos visíveis, num buffer novo para não esperar a GPU
+    // terminar o quadro anterior
+    const InstanciasTorcida &inst = instanciasTorcida;
+    pglBindBuffer(GL_ARRAY_BUFFER, pipeline.vboElevacaoTorcida);
+    pglBufferData(GL_ARRAY_BUFFER, inst.elevacao.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+    for (int b = 0; b < numBlocos;) {
+        if (nivel[b] < 0) {
+            if (blocosTorcida[b].quantidade > 0) estatisticasQuadro.objetosDescartados++;
+            b++;
+            continue;
+        }
+        int fim = b + 1;
+        while (fim < numBlocos && nivel[fim] >= 0) fim++;
+        int primeiro = blocosTorcida[b].primeiro;
+        int quantidade = blocosTorcida[fim - 1].primeiro + blocosTorcida[fim - 1].quantidade - primeiro;
+        pglBufferSubData(GL_ARRAY_BUFFER, primeiro * sizeof(float), quantidade * sizeof(float), &inst.elevacao[primeiro]);
+        estatisticasQuadro.bytesEnviados += quantidade * sizeof(float);
+        b = fim;
+    }
+
+    Vetor3 lado = direitaCamera * (LARGURA_TORCEDOR * 0.5f);
+    pglUseProgram(pipeline.programaTorcida);
+    pglUniform3f(pipeline.localLadoTorcida, lado.x, lado.y, lado.z);
+    pglBindVertexArray(pipeline.vaoTorcida);
+    for (int b = 0; b < numBlocos;) {
+        int n = nivel[b];
+        if (n < 0) {
+            b++;
+            continue;
+        }
+        int fim = b + 1;
+        while (fim < numBlocos && nivel[fim] == n) fim++;
+        int primeiro = blocosTorcida[b].primeiro;
+        int quantidade = blocosTorcida[fim - 1].primeiro + blocosTorcida[fim - 1].quantidade - primeiro;
+        apontarInstanciasTorcida(primeiro);
+        desenharArraysInstanciado(GL_TRIANGLES, INICIO_MODELO_TORCEDOR[n], VERTICES_MODELO_TORCEDOR[n], quantidade);
+        b = fim;
+    }
+    pglBindVertexArray(0);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglUseProgram(0);
+}
+
+// --- Céu Atmosférico (Rayleigh e Mie) ---
+// Modelo de céu físico no estilo de Hillaire (2020), sem o espalhamento
+// múltiplo: uma tabela de transmitância até o topo da atmosfera (altura x
+// cosseno zenital), calculada uma vez, e uma tabela da vista do céu a partir
+// do chão (azimute em relação ao sol x elevação, com mais linhas perto do
+// horizonte), integrada com espalhamento simples e refeita só quando a hora
+// muda mais que LIMIAR_HORA_CEU, numa thread em segundo plano que não segura o
+// quadro. As duas são calculadas em paralelo, linha a linha. O céu é desenhado
+// depois da cena numa única passada de tela cheia: uma grade de vértices no
+// plano distante, com a direção de cada vértice convertida em coordenadas da
+// tabela (o pipeline fixo não calcula por pixel), só onde a profundidade ficou
+// vazia. A hora segue o ciclo dia/noite: o filtro leva a hora das sombras até o
+// anoitecer (ou, de manhã, até a madrugada), e a cena, em vez de coberta pelo
+// filtro preto, é multiplicada pela iluminância do sol e do céu no chão
+// relativa à de um sol a ELEVACAO_REFERENCIA_CEU_GRAUS; o pôr do sol
+// avermelhado e a noite escura saem do mesmo modelo.
+const float RAIO_PLANETA_KM = 6360.0f;
+const float RAIO_ATMOSFERA_KM = 6460.0f;
+const float ALTURA_OBSERVADOR_KM = 0.001f;
+const Vetor3 ESPALHAMENTO_RAYLEIGH = {5.802e-3f, 13.558e-3f, 33.1e-3f};    // Por km, ao nível do mar
+const float ALTURA_ESCALA_RAYLEIGH_KM = 8.0f;
+const float ESPALHAMENTO_MIE = 3.996e-3f;
+const float EXTINCAO_MIE = 4.440e-3f;
+const float ALTURA_ESCALA_MIE_KM = 1.2f;
+const float ASSIMETRIA_MIE = 0.8f;
+const Vetor3 ABSORCAO_OZONIO = {0.650e-3f, 1.881e-3f, 0.085e-3f};
+const float CENTRO_OZONIO_KM = 25.0f, MEIA_LARGURA_OZONIO_KM = 15.0f;
+const int LARGURA_LUT_TRANSMITANCIA = 256, ALTURA_LUT_TRANSMITANCIA = 64;
+const int LARGURA_LUT_CEU = 192, ALTURA_LUT_CEU = 108;
+const int PASSOS_TRANSMITANCIA = 40, PASSOS_VISTA_CEU = 32;
+const float EXPOSICAO_CEU = 40.0f;                      // Radiância (sol = 1) -> tela
+const Vetor3 RADIANCIA_CEU_ESTRELADO = {0.0004f, 0.0006f, 0.0012f};
+const float LIMIAR_HORA_CEU = 0.05f;                    // Horas (3 minutos)
+const float HORA_NOITE_CEU = 19.0f;                     // Filtro noturno cheio, à tarde
+const float HORA_MADRUGADA_CEU = 5.0f;                  // Filtro noturno cheio, de manhã
+const float ELEVACAO_REFERENCIA_CEU_GRAUS = 25.0f;      // Acima disso, a cena fica como as texturas
+const float LUZ_MINIMA_CENA = 0.06f;
+const int COLUNAS_GRADE_CEU = 32, LINHAS_GRADE_CEU = 24;
+
+struct CeuAtmosferico {
+    bool iniciado;
+    std::vector<Vetor3> transmitancia;  // [altura][cosseno zenital]
+    std::vector<Vetor3> vista;          // Radiância [elevação][azimute relativo] (da thread do cálculo)
+    std::vector<unsigned char> texels;  // Vista revelada (RGB), ainda não enviada
+    GLuint textura;
+    float horaTabela;                   // Hora da tabela na textura
+    Vetor3 iluminanciaReferencia;
+    Vetor3 luzCena;                     // Fator da cena na hora da tabela
+    // Tabela em cálculo em segundo plano
+    std::thread *calculo;
+    float horaCalculo;
+    Vetor3 luzCalculo;
+};
+
+CeuAtmosferico ceu = CeuAtmosferico();
+std::atomic<bool> calculoCeuPronto(false);      // Fora da struct: ela é inicializada por cópia
+
+// Coeficientes na altura dada; devolve a extinção total
+Vetor3 coeficientesAtmosfera(float alturaKm, Vetor3 &espalhamentoRayleigh, float &espalhamentoMie) {
+    float densidadeRayleigh = expf(-alturaKm / ALTURA_ESCALA_RAYLEIGH_KM);
+    float densidadeMie = expf(-alturaKm / ALTURA_ESCALA_MIE_KM);
+    float densidadeOzonio = std::max(0.0f, 1.0f - fabsf(alturaKm - CENTRO_OZONIO_KM) / MEIA_LARGURA_OZONIO_KM);
+    espalhamentoRayleigh = ESPALHAMENTO_RAYLEIGH * densidadeRayleigh;
+    espalhamentoMie = ESPALHAMENTO_MIE * densidadeMie;
+    float extincaoMie = EXTINCAO_MIE * densidadeMie;
+    return espalhamentoRayleigh + ABSORCAO_OZONIO * densidadeOzonio
+         + vetor3(extincaoMie, extincaoMie, extincaoMie);
+}
+
+// Distância até a esfera de raio R a partir do raio r, na direção de cosseno
+// zenital mu (o ponto está dentro dela); -1 se o raio não a atinge para a frente
+float distanciaEsfera(float r, float mu, float R) {
+    float delta = r * r * (mu * mu - 1.0f) + R * R;
+    if (delta < 0.0f) return -1.0f;
+    float raiz = sqrtf(delta);
+    float t = -r * mu - raiz;
+    if (t > 0.0f) return t;
+    t = -r * mu + raiz;
+    return t > 0.0f ? t : -1.0f;
+}
+
+Vetor3 exponencialNegativa(Vetor3 v) {
+    return vetor3(expf(-v.x), expf(-v.y), expf(-v.z));
+}
+
+void calcularTabelaTransmitancia() {
+    ceu.transmitancia.resize(LARGURA_LUT_TRANSMITANCIA * ALTURA_LUT_TRANSMITANCIA);
+    executarEmParalelo(0, ALTURA_LUT_TRANSMITANCIA, 1, [&](int j) {
+        float r = RAIO_PLANETA_KM + (RAIO_ATMOSFERA_KM - RAIO_PLANETA_KM) * j / (ALTURA_LUT_TRANSMITANCIA - 1);
+        for (int i = 0; i < LARGURA_LUT_TRANSMITANCIA; i++) {
+            float mu = -1.0f + 2.0f * i / (LARGURA_LUT_TRANSMITANCIA - 1);
+            Vetor3 &saida = ceu.transmitancia[j * LARGURA_LUT_TRANSMITANCIA + i];
+            float chao = distanciaEsfera(r, mu, RAIO_PLANETA_KM - 1e-3f);
+            if (chao > 0.0f) {
+                saida = vetor3(0.0f, 0.0f, 0.0f);      // O planeta bloqueia
+                continue;
+            }
+            float comprimentoRaio = std::max(distanciaEsfera(r, mu, RAIO_ATMOSFERA_KM), 0.0f);
+            float passo = comprimentoRaio / PASSOS_TRANSMITANCIA;
+            Vetor3 profundidade = vetor3(0.0f, 0.0f, 0.0f);
+            for (int k = 0; k < PASSOS_TRANSMITANCIA; k++) {
+                float t = (k + 0.5f) * passo;
+                float altura = sqrtf(r * r + t * t + 2.0f * r * mu * t) - RAIO_PLANETA_KM;
+                Vetor3 espRayleigh;
+                float espMie;
+                profundidade = profundidade + coeficientesAtmosfera(altura, espRayleigh, espMie) * passo;
+            }
+            saida = exponencialNegativa(profundidade);
+        }
+    });
+}
+
+// Transmitância do ponto de raio r até o topo, na direção de cosseno zenital mu (bilinear)
+Vetor3 amostrarTransmitancia(float r, float mu) {
+    float x = (mu + 1.0f) * 0.5f * (LARGURA_LUT_TRANSMITANCIA - 1);
+    float y = (r - RAIO_PLANETA_KM) / (RAIO_ATMOSFERA_KM - RAIO_PLANETA_KM) * (ALTURA_LUT_TRANSMITANCIA - 1);
+    x = std::max(0.0f, std::min(x, LARGURA_LUT_TRANSMITANCIA - 1.001f));
+    y = std::max(0.0f, std::min(y, ALTURA_LUT_TRANSMITANCIA - 1.001f));
+    int i = (int)x, j = (int)y;
+    float fx = x - i, fy = y - j;
+    const Vetor3 *linha0 = &ceu.transmitancia[j * LARGURA_LUT_TRANSMITANCIA + i];
+    const Vetor3 *linha1 = linha0 + LARGURA_LUT_TRANSMITANCIA;
+    return interpolar(interpolar(linha0[0], linha0[1], fx), interpolar(linha1[0], linha1[1], fx), fy);
 }
 
-void desenharParedeExterna(float cx, float cy,
-                           float rx_base, float ry_base, float rx_topo, float ry_topo,
-                           float z_baixo, float z_alto,
-                           float angulo_inicial_graus, float angulo_final_graus,
-                           int num_segmentos_curva) {
-    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
-    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
-    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
-    float intervalo_rad = rad_final - rad_inicial;
+// Elevação da linha da tabela da vista: mais resolução perto do horizonte.
+// Só o hemisfério de cima: abaixo do horizonte (além do chão da cena) fica a
+// cor do horizonte.
+float elevacaoLinhaCeu(float v) {
+    return v * v * (float)(PI * 0.5);
+}
 
-    // --- Face da Parede ---
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad);
-        float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao * 10.0f; // Repetição de textura (talvez maior para paredes)
-        glTexCoord2f(s_coord, 1.0f); // Coord T = 1 (topo da parede)
-        glVertex3f(cx + rx_topo * cos_a, cy + ry_topo * sin_a, z_alto);
-        glTexCoord2f(s_coord, 0.0f); // Coord T = 0 (base da parede)
-        glVertex3f(cx + rx_base * cos_a, cy + ry_base * sin_a, z_baixo);
-    }
-    glEnd();
+float coordenadaElevacaoCeu(float elevacao) {
+    return sqrtf(std::max(0.0f, std::min(elevacao / (float)(PI * 0.5), 1.0f)));
 }
 
-void desenharTampaLateral(float cx, float cy, float angulo_graus,
-                          float rx_int_base, float ry_int_base, float z_int_base,
-                          float rx_ext_base, float ry_ext_base, float z_ext_base,
-                          float rx_ext_topo, float ry_ext_topo, float z_ext_topo,
-                          float rx_int_topo, float ry_int_topo, float z_int_topo) {
-    float angulo_rad = GRAUS_PARA_RAD(angulo_graus);
-    float cos_a = cosf(angulo_rad);
-    float sin_a = sinf(angulo_rad);
+// Espalhamento simples ao longo da direção 'dir' (Z para cima) saindo do
+// observador, com o sol em 'sol'; radiância para um sol de iluminância 1
+Vetor3 radianciaAtmosfera(const Vetor3 &dir, const Vetor3 &sol) {
+    float r = RAIO_PLANETA_KM + ALTURA_OBSERVADOR_KM;
+    float comprimentoRaio = distanciaEsfera(r, dir.z, RAIO_PLANETA_KM);
+    if (comprimentoRaio < 0.0f) comprimentoRaio = distanciaEsfera(r, dir.z, RAIO_ATMOSFERA_KM);
+    float passo = std::max(comprimentoRaio, 0.0f) / PASSOS_VISTA_CEU;
+    float cosTeta = produtoEscalar(dir, sol);
+    float faseRayleigh = 3.0f / (16.0f * PI) * (1.0f + cosTeta * cosTeta);
+    float g = ASSIMETRIA_MIE;
+    float faseMie = 3.0f / (8.0f * PI) * (1.0f - g * g) * (1.0f + cosTeta * cosTeta)
+                  / ((2.0f + g * g) * powf(1.0f + g * g - 2.0f * g * cosTeta, 1.5f));
+    Vetor3 radiancia = vetor3(0.0f, 0.0f, 0.0f);
+    Vetor3 transmitanciaVista = vetor3(1.0f, 1.0f, 1.0f);
+    for (int k = 0; k < PASSOS_VISTA_CEU; k++) {
+        float t = (k + 0.5f) * passo;
+        Vetor3 p = vetor3(0.0f, 0.0f, r) + dir * t;
+        float raio = comprimento(p);
+        Vetor3 espRayleigh;
+        float espMie;
+        Vetor3 extincao = coeficientesAtmosfera(raio - RAIO_PLANETA_KM, espRayleigh, espMie);
+        Vetor3 transmitanciaPasso = exponencialNegativa(extincao * passo);
+        Vetor3 espalhado = espRayleigh * faseRayleigh + vetor3(espMie, espMie, espMie) * faseMie;
+        Vetor3 luzSol = amostrarTransmitancia(raio, produtoEscalar(p, sol) / raio);
+        // Integral analítica do passo (extinção constante dentro dele)
+        Vetor3 fonte = produtoComponentes(espalhado, luzSol);
+        Vetor3 integral = vetor3(extincao.x > 0.0f ? fonte.x * (1.0f - transmitanciaPasso.x) / extincao.x : 0.0f,
+                                 extincao.y > 0.0f ? fonte.y * (1.0f - transmitanciaPasso.y) / extincao.y : 0.0f,
+                                 extincao.z > 0.0f ? fonte.z * (1.0f - transmitanciaPasso.z) / extincao.z : 0.0f);
+        radiancia = radiancia + produtoComponentes(transmitanciaVista, integral);
+        transmitanciaVista = produtoComponentes(transmitanciaVista, transmitanciaPasso);
+    }
+    return radiancia;
+}
 
-    // Vértices do quadrilátero da tampa
-    float v1[3] = {cx + rx_int_base * cos_a, cy + ry_int_base * sin_a, z_int_base}; // Interno, Base
-    float v2[3] = {cx + rx_ext_base * cos_a, cy + ry_ext_base * sin_a, z_ext_base}; // Externo, Base
-    float v3[3] = {cx + rx_ext_topo * cos_a, cy + ry_ext_topo * sin_a, z_ext_topo}; // Externo, Topo
-    float v4[3] = {cx + rx_int_topo * cos_a, cy + ry_int_topo * sin_a, z_int_topo}; // Interno, Topo
+// Tabela da vista para o sol na elevação dada; devolve a iluminância no chão
+// (sol direto + céu integrado sobre o hemisfério de cima)
+Vetor3 calcularTabelaVistaCeu(float elevacaoSol) {
+    Vetor3 sol = vetor3(cosf(elevacaoSol), 0.0f, sinf(elevacaoSol));
+    ceu.vista.resize(LARGURA_LUT_CEU * ALTURA_LUT_CEU);
+    std::vector<Vetor3> irradianciaLinha(ALTURA_LUT_CEU);
+    executarEmParalelo(0, ALTURA_LUT_CEU, 1, [&](int j) {
+        float v = (j + 0.5f) / ALTURA_LUT_CEU;
+        float elevacao = elevacaoLinhaCeu(v);
+        // Ângulo sólido de um texel vezes o cosseno (as duas metades do azimute, por simetria)
+        float dElevacao = (float)PI * v / ALTURA_LUT_CEU;
+        float pesoIrradiancia = 2.0f * sinf(elevacao) * cosf(elevacao) * dElevacao * (float)(PI / LARGURA_LUT_CEU);
+        Vetor3 soma = vetor3(0.0f, 0.0f, 0.0f);
+        for (int i = 0; i < LARGURA_LUT_CEU; i++) {
+            float azimute = (i + 0.5f) / LARGURA_LUT_CEU * PI;
+            Vetor3 dir = vetor3(cosf(elevacao) * cosf(azimute), cosf(elevacao) * sinf(azimute), sinf(elevacao));
+            Vetor3 l = radianciaAtmosfera(dir, sol) + RADIANCIA_CEU_ESTRELADO;
+            ceu.vista[j * LARGURA_LUT_CEU + i] = l;
+            soma = soma + l * pesoIrradiancia;
+        }
+        irradianciaLinha[j] = soma;
+    });
+    Vetor3 iluminancia = amostrarTransmitancia(RAIO_PLANETA_KM + ALTURA_OBSERVADOR_KM, sol.z)
+                       * std::max(sol.z, 0.0f);
+    for (int j = 0; j < ALTURA_LUT_CEU; j++) iluminancia = iluminancia + irradianciaLinha[j];
+    return iluminancia;
+}
 
-    // --- Tampa (Quadrilátero) ---
-    glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 0.0f); glVertex3fv(v1); // Canto inf-int
-        glTexCoord2f(1.0f, 0.0f); glVertex3fv(v2); // Canto inf-ext
-        glTexCoord2f(1.0f, 1.0f); glVertex3fv(v3); // Canto sup-ext
-        glTexCoord2f(0.0f, 1.0f); glVertex3fv(v4); // Canto sup-int
-    glEnd();
+// Hora do céu: a das sombras de dia, levada até HORA_NOITE_CEU pelo ciclo dia/noite
+float horaCeuCena(const EstadoCena &cena) {
+    float hora = horaSolCena.load();
+    float alvo = hora < 12.0f ? HORA_MADRUGADA_CEU : HORA_NOITE_CEU;
+    return hora + (alvo - hora) * std::min(cena.alphaFiltro, 1.0f);
 }
 
-void desenharMarquiseCobertura(float cx, float cy,
-    float rx_base, float ry_base, float z_base, // Ponto de trás/base
-    float rx_frente, float ry_frente, float z_frente, float espessura,
-    float angulo_inicial_graus, float angulo_final_graus,
-    int num_segmentos_curva) {
-    if (num_segmentos_curva <= 1) num_segmentos_curva = 2;
-    float z_base_inf = z_base - espessura;
-    float z_frente_inf = z_frente - espessura;
+// Calcula e revela a tabela da vista para a hora e o fator da cena (sem GL)
+void calcularVistaCeu(float hora) {
+    RASTREAR_FUNCAO();
+    Vetor3 sol = direcaoSol(diaDoAnoSol, hora);
+    Vetor3 iluminancia = calcularTabelaVistaCeu(asinf(std::max(-1.0f, std::min(sol.z, 1.0f))));
+    ceu.texels.resize(ceu.vista.size() * 3);
+    for (size_t i = 0; i < ceu.vista.size(); i++) {
+        const Vetor3 &l = ceu.vista[i];
+        ceu.texels[i * 3 + 0] = (unsigned char)(linearParaSrgb(cinzaAces(l.x * EXPOSICAO_CEU)) * 255.0f + 0.5f);
+        ceu.texels[i * 3 + 1] = (unsigned char)(linearParaSrgb(cinzaAces(l.y * EXPOSICAO_CEU)) * 255.0f + 0.5f);
+        ceu.texels[i * 3 + 2] = (unsigned char)(linearParaSrgb(cinzaAces(l.z * EXPOSICAO_CEU)) * 255.0f + 0.5f);
+    }
 
-    float rad_inicial = GRAUS_PARA_RAD(angulo_inicial_graus);
-    float rad_final = GRAUS_PARA_RAD(angulo_final_graus);
-    float intervalo_rad = rad_final - rad_inicial;
+    // Fator da cena: iluminância relativa à de referência (com a cor do pôr do
+    // sol); com o sol mais alto que a referência, a cena fica como está
+    Vetor3 f = vetor3(iluminancia.x / ceu.iluminanciaReferencia.x, iluminancia.y / ceu.iluminanciaReferencia.y,
+                      iluminancia.z / ceu.iluminanciaReferencia.z);
+    float brilho = 0.2126f * f.x + 0.7152f * f.y + 0.0722f * f.z;
+    if (brilho >= 1.0f) f = vetor3(1.0f, 1.0f, 1.0f);
+    float maximo = std::max(f.x, std::max(f.y, f.z));
+    if (maximo > 1.0f) f = f * (1.0f / maximo);
+    ceu.luzCalculo = vetor3(std::max(f.x, LUZ_MINIMA_CENA), std::max(f.y, LUZ_MINIMA_CENA), std::max(f.z, LUZ_MINIMA_CENA));
+    ceu.horaCalculo = hora;
+}
 
-    // --- 1. Superfície SUPERIOR ---
-    glColor3f(0.7f, 0.7f, 0.75f); // Cor da superfície superior
-    // glBindTexture(GL_TEXTURE_2D, idTexturaMarquiseTopo); // Textura Topo
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao;
-        // Vértice Trás/Base (Superior)
-        glTexCoord2f(s_coord, 1.0f); glVertex3f(cx + rx_base * cos_a, cy + ry_base * sin_a, z_base);
-        // Vértice Frente (Superior)
-        glTexCoord2f(s_coord, 0.0f); glVertex3f(cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente);
-    }
-    glEnd();
+// Envia a tabela calculada e passa a usar o seu fator da cena
+void enviarVistaCeu() {
+    glBindTexture(GL_TEXTURE_2D, ceu.textura);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LARGURA_LUT_CEU, ALTURA_LUT_CEU, GL_RGB, GL_UNSIGNED_BYTE, &ceu.texels[0]);
+    glBindTexture(GL_TEXTURE_2D, texturaVinculadaAtual);
+    estatisticasQuadro.bytesEnviados += ceu.texels.size();
+    estatisticasQuadro.tabelasCeu++;
+    ceu.luzCena = ceu.luzCalculo;
+    ceu.horaTabela = ceu.horaCalculo;
+}
 
-    // --- 2. Superfície INFERIOR ---
-    glColor3f(0.6f, 0.6f, 0.65f); // Cor um pouco mais escura para baixo
-    // glBindTexture(GL_TEXTURE_2D, idTexturaMarquiseFundo); // Textura Fundo
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao;
-        // Vértice Trás/Base (Inferior) - Ordem invertida para face apontar para baixo? Testar.
-        // Ou manter ordem e usar glFrontFace(GL_CW) / glCullFace(GL_FRONT) se culling estiver ativo.
-        // Vamos manter a ordem por enquanto:
-        glTexCoord2f(s_coord, 1.0f); glVertex3f(cx + rx_base * cos_a, cy + ry_base * sin_a, z_base_inf);
-        // Vértice Frente (Inferior)
-        glTexCoord2f(s_coord, 0.0f); glVertex3f(cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente_inf);
-    }
-    glEnd();
+void lacoCalculoCeu(float hora) {
+    nomearThreadRastreio("ceu");
+    calcularVistaCeu(hora);
+    calculoCeuPronto.store(true, std::memory_order_release);
+}
 
-    // --- 3. Borda FRONTAL (Espessura) ---
-    glColor3f(0.65f, 0.65f, 0.7f); // Cor da borda
-    // glBindTexture(GL_TEXTURE_2D, idTexturaMarquiseBorda); // Textura Borda
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao;
-        // Vértice Frente (Superior)
-        glTexCoord2f(s_coord, 1.0f); glVertex3f(cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente);
-        // Vértice Frente (Inferior)
-        glTexCoord2f(s_coord, 0.0f); glVertex3f(cx + rx_frente * cos_a, cy + ry_frente * sin_a, z_frente_inf);
-    
+// Registrada com atexit(): espera a thread do cálculo em andamento
+void encerrarCalculoCeu() {
+    if (!ceu.calculo) return;
+    ceu.calculo->join();
+    delete ceu.calculo;
+    ceu.calculo = NULL;
+}
 
-    // --- 4. Borda TRASEIRA (Espessura - Opcional, pode não ser visível) ---
-    // Se precisar desenhar:
-    
-    glColor3f(0.65f, 0.65f, 0.7f);
-    glBegin(GL_TRIANGLE_STRIP);
-    for (int i = 0; i <= num_segmentos_curva; i++) {
-        float fracao = (float)i / (float)num_segmentos_curva;
-        float angulo_atual_rad = rad_inicial + fracao * intervalo_rad;
-        float cos_a = cosf(angulo_atual_rad); float sin_a = sinf(angulo_atual_rad);
-        float s_coord = fracao;
-        // Vértice Trás/Base (Superior)
-        glTexCoord2f(s_coord, 1.0f); glVertex3f(cx + rx_base * cos_a, cy + ry_base * sin_a, z_base);
-        // Vértice Trás/Base (Inferior)
-        glTexCoord2f(s_coord, 0.0f); glVertex3f(cx + rx_base * cos_a, cy + ry_base * sin_a, z_base_inf);
-    }
-    glEnd();
+// Com a hora além do limiar, calcula a nova tabela numa thread em segundo
+// plano (em paralelo pelo sistema de tarefas) enquanto a anterior continua
+// sendo desenhada; o envio acontece no primeiro quadro depois que ela termina.
+// Nunca há mais de um cálculo em andamento.
+void atualizarCeu(float hora) {
+    if (ceu.calculo) {
+        if (!calculoCeuPronto.load(std::memory_order_acquire)) return;
+        encerrarCalculoCeu();
+        enviarVistaCeu();
     }
+    if (fabsf(hora - ceu.horaTabela) < LIMIAR_HORA_CEU) return;
+    calculoCeuPronto.store(false);
+    ceu.calculo = new std::thread(lacoCalculoCeu, hora);
+}
 
-    // --- 5. Tampas Laterais da Marquise ---
-    // Tampa no ângulo inicial
-    float cos_ini = cosf(rad_inicial); float sin_ini = sinf(rad_inicial);
-    float v1_ini[3] = {cx + rx_frente * cos_ini, cy + ry_frente * sin_ini, z_frente_inf}; // Frente Inf
-    float v2_ini[3] = {cx + rx_base * cos_ini, cy + ry_base * sin_ini, z_base_inf};     // Trás Inf
-    float v3_ini[3] = {cx + rx_base * cos_ini, cy + ry_base * sin_ini, z_base};         // Trás Sup
-    float v4_ini[3] = {cx + rx_frente * cos_ini, cy + ry_frente * sin_ini, z_frente};     // Frente Sup
-    glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 0.0f); glVertex3fv(v1_ini);
-        glTexCoord2f(1.0f, 0.0f); glVertex3fv(v2_ini);
-        glTexCoord2f(1.0f, 1.0f); glVertex3fv(v3_ini);
-        glTexCoord2f(0.0f, 1.0f); glVertex3fv(v4_ini);
-    glEnd();
+// Tabela de transmitância e textura da vista, na inicialização
+void iniciarCeu() {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
+    calcularTabelaTransmitancia();
+    ceu.iluminanciaReferencia = calcularTabelaVistaCeu(GRAUS_PARA_RAD(ELEVACAO_REFERENCIA_CEU_GRAUS));
+    glGenTextures(1, &ceu.textura);
+    glBindTexture(GL_TEXTURE_2D, ceu.textura);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, LARGURA_LUT_CEU, ALTURA_LUT_CEU, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, texturaVinculadaAtual);
+    // A primeira tabela (hora inicial, de dia) sai aqui; as seguintes, em segundo plano
+    calcularVistaCeu(horaSolCena.load());
+    enviarVistaCeu();
+    atexit(encerrarCalculoCeu);
+    ceu.iniciado = true;
+    printf("Céu atmosférico: tabelas %dx%d e %dx%d em %.1f ms (%d threads)\n",
+           LARGURA_LUT_TRANSMITANCIA, ALTURA_LUT_TRANSMITANCIA, LARGURA_LUT_CEU, ALTURA_LUT_CEU,
+           tempoAtualMs() - inicio, numTrabalhadores + 1);
+}
 
-    // Tampa no ângulo final
-    float cos_fim = cosf(rad_final); float sin_fim = sinf(rad_final);
-    float v1_fim[3] = {cx + rx_frente * cos_fim, cy + ry_frente * sin_fim, z_frente_inf}; // Frente Inf
-    float v2_fim[3] = {cx + rx_base * cos_fim, cy + ry_base * sin_fim, z_base_inf};     // Trás Inf
-    float v3_fim[3] = {cx + rx_base * cos_fim, cy + ry_base * sin_fim, z_base};         // Trás Sup
-    float v4_fim[3] = {cx + rx_frente * cos_fim, cy + ry_frente * sin_fim, z_frente};     // Frente Sup
-    glBegin(GL_QUADS);
-        // Ordem dos vértices para o Quad apontar para fora no fim do arco
-        glTexCoord2f(0.0f, 0.0f); glVertex3fv(v1_fim); // Frente Inf
-        glTexCoord2f(0.0f, 1.0f); glVertex3fv(v4_fim); // Frente Sup
-        glTexCoord2f(1.0f, 1.0f); glVertex3fv(v3_fim); // Trás Sup
-        glTexCoord2f(1.0f, 0.0f); glVertex3fv(v2_fim); // Trás Inf
-    glEnd();
+// Multiplica a cena já desenhada pelo fator de luz da hora (substitui o filtro preto)
+void escurecerCenaCeu() {
+    if (ceu.luzCena.x >= 1.0f && ceu.luzCena.y >= 1.0f && ceu.luzCena.z >= 1.0f) return;
+    alterarEstadoGL(GL_DEPTH_TEST, false);
+    alterarEstadoGL(GL_TEXTURE_2D, false);
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, 1, 0, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glColor4f(ceu.luzCena.x, ceu.luzCena.y, ceu.luzCena.z, 1.0f);
+    iniciarPrimitiva(GL_QUADS);
+        enviarVertice2f(0.0f, 0.0f);
+        enviarVertice2f(1.0f, 0.0f);
+        enviarVertice2f(1.0f, 1.0f);
+        enviarVertice2f(0.0f, 1.0f);
+    finalizarPrimitiva();
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    alterarEstadoGL(GL_TEXTURE_2D, true);
+    alterarEstadoGL(GL_DEPTH_TEST, true);
 }
 
+// Passada de tela cheia no plano distante: só os pixels sem geometria passam
+// no teste de profundidade. 'm' é a modelview da câmera.
+void desenharCeu(const float m[16], const Vetor3 &sol, float proporcao) {
+    float tangenteY = tanf(GRAUS_PARA_RAD(CAMPO_VISAO_GRAUS) * 0.5f);
+    float tangenteX = tangenteY * proporcao;
+    float azimuteSol = atan2f(sol.y, sol.x);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, 1, 0, 1, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    vincularTextura(ceu.textura);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    std::vector<float> s((COLUNAS_GRADE_CEU + 1) * 2), t((COLUNAS_GRADE_CEU + 1) * 2);
+    for (int j = 0; j < LINHAS_GRADE_CEU; j++) {
+        iniciarPrimitiva(GL_TRIANGLE_STRIP);
+        for (int i = 0; i <= COLUNAS_GRADE_CEU; i++) {
+            for (int k = 1; k >= 0; k--) {
+                float x = (float)i / COLUNAS_GRADE_CEU, y = (float)(j + k) / LINHAS_GRADE_CEU;
+                // Direção do olho levada ao estádio pela transposta da rotação da câmera
+                float ox = (2.0f * x - 1.0f) * tangenteX, oy = (2.0f * y - 1.0f) * tangenteY, oz = -1.0f;
+                Vetor3 dir = normalizar(vetor3(m[0] * ox + m[1] * oy + m[2] * oz,
+                                               m[4] * ox + m[5] * oy + m[6] * oz,
+                                               m[8] * ox + m[9] * oy + m[10] * oz));
+                float relativo = fabsf(atan2f(dir.y, dir.x) - azimuteSol);
+                if (relativo > PI) relativo = 2.0f * PI - relativo;
+                enviarCoordTextura2f(relativo / PI,
+                                     coordenadaElevacaoCeu(asinf(std::max(-1.0f, std::min(dir.z, 1.0f)))));
+                enviarVertice3f(x, y, -1.0f);
+            }
+        }
+        finalizarPrimitiva();
+    }
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
 
 // --- Função de callback: Desenho ---
-void display() {
+// Desenha um quadro a partir de um instantâneo do estado da cena
+void renderizarCena(const EstadoCena &cena) {
+    RASTREAR_FUNCAO();
+    if (pedidoReconstruirMalha.exchange(false)) {
+        float marquiseAnterior = anguloInicialMarquiseMalha;
+        construirMalhaEstadio(fatorDetalheMalha.load());
+        if (anguloInicialMarquiseMalha != marquiseAnterior) atualizarAnalisesMarquise(marquiseAnterior);
+    }
+    if (pedidoAtualizarAssentos.exchange(false)) aplicarLayoutAssentos(layoutAssentosAtual.load());
+    iniciarQuadroPerfil();
+
     // Limpa os buffers de cor e profundidade
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -383,11 +7741,18 @@ void display() {
     glMatrixMode(GL_MODELVIEW); // Define a matriz de ModelView como a matriz atual
     glLoadIdentity();           // Carrega a matriz identidade (reseta transformações)
 
+   const float *camera_position = cena.posicaoCamera;
+   if (cena.vooAtivo) {
+       // Câmera no trilho, em coordenadas do estádio (Z para cima)
+       gluLookAt(cena.olhoVoo.x, cena.olhoVoo.y, cena.olhoVoo.z,
+                 ALVO_VOO.x, ALVO_VOO.y, ALVO_VOO.z,
+                 0.0f, 0.0f, 1.0f);
+   } else {
    // Configuração da câmera
    glTranslatef(-camera_position[0], -camera_position[1], -camera_position[2]);
     
    // Cálculo do ângulo de rotação da câmera
-   float rad = cameraAngle * M_PI / 180.0f;
+   float rad = cena.anguloCamera * M_PI / 180.0f;
    float lookX = camera_position[0] + sin(rad);
    float lookZ = camera_position[2] - cos(rad);
 
@@ -401,279 +7766,95 @@ void display() {
     glRotatef(anguloRotacaoX, 1.0f, 0.0f, 0.0f); // Rotação em torno do eixo X global
     glRotatef(anguloRotacaoY, 0.0f, 1.0f, 0.0f); // Rotação em torno do eixo Y global
     glRotatef(anguloRotacaoZ, 0.0f, 0.0f, 1.0f); // Rotação em torno do eixo Z global
+   }
 
-   // --- 1. Desenhar o Chão ---
-   glColor3f(0.8f, 0.8f, 0.8f);
-   glBindTexture(GL_TEXTURE_2D, idTexturaTerra);
-   float tamChao = 20.0f;
-   float repTexturaChao = 15.0f;
-   glBegin(GL_QUADS);
-       glTexCoord2f(0.0f, 0.0f);                   glVertex3f(-tamChao, -tamChao, Z_CHAO);
-       glTexCoord2f(repTexturaChao, 0.0f);         glVertex3f( tamChao, -tamChao, Z_CHAO);
-       glTexCoord2f(repTexturaChao, repTexturaChao); glVertex3f( tamChao,  tamChao, Z_CHAO);
-       glTexCoord2f(0.0f, repTexturaChao);         glVertex3f(-tamChao,  tamChao, Z_CHAO);
-   glEnd();
-
-   
-
-   // --- Parâmetros Comuns & Seção Especial ---
-   float centro_x = 0.0f;
-   float centro_y = 0.0f;
-   int segmentos_curva_degrau = 40;
-   int segmentos_curva_parede = 60;
-   // Raios e altura padrões
-   const float raio_x_geral_int = 0.5f;
-   const float raio_y_geral_int = 0.7f;
-   const float raio_x_geral_ext = 0.8f;
-   const float raio_y_geral_ext = 0.95f;
-   const float largura_radial_x_padrao = raio_x_geral_ext - raio_x_geral_int;
-   const float largura_radial_y_padrao = raio_y_geral_ext - raio_y_geral_int;
-   const float altura_max_parede_padrao = ALTURA_MAX_ESC; // Altura padrão explícita
-   const float rx_topo_parede_padrao = raio_x_geral_ext + INCLINACAO_PAREDE_OFFSET; // Topo padrão explícito
-   const float ry_topo_parede_padrao = raio_y_geral_ext + INCLINACAO_PAREDE_OFFSET;
-   const float altura_arco_conexao = ALTURA_MIN_ESC * 7; 
-
-   // Arcos
-   float arcos_principais[][2] = {
-       {  0.0f,  60.0f}, {120.0f, 140.0f}, {140.0f, 220.0f}, {220.0f, 240.0f}, {300.0f, 360.0f}
-   };
-   int num_arcos_principais = sizeof(arcos_principais) / sizeof(arcos_principais[0]);
-   float arcos_conexao[][2] = {
-       { 60.0f, 120.0f}, {240.0f, 300.0f}
-   };
-   int num_arcos_conexao = sizeof(arcos_conexao) / sizeof(arcos_conexao[0]);
-
-   // Parâmetros Seção Especial (Arquibancada 140-220)
-   const int DEGRAUS_ADICIONAIS_SECAO_ESPECIAL = 8;
-   const float FATOR_ALTURA_SECAO_ESPECIAL = 1.35f;
-   const float FATOR_RAIO_EXTERNO_SECAO_ESPECIAL = 1.15f;
-   const int num_degraus_secao_especial = NUM_DEGRAUS + DEGRAUS_ADICIONAIS_SECAO_ESPECIAL;
-   const float altura_max_secao_especial = altura_max_parede_padrao * FATOR_ALTURA_SECAO_ESPECIAL;
-   const float raio_x_ext_especial_seating = raio_x_geral_ext * FATOR_RAIO_EXTERNO_SECAO_ESPECIAL;
-   const float raio_y_ext_especial_seating = raio_y_geral_ext * FATOR_RAIO_EXTERNO_SECAO_ESPECIAL;
-   const float largura_radial_x_especial = raio_x_ext_especial_seating - raio_x_geral_int;
-   const float largura_radial_y_especial = raio_y_ext_especial_seating - raio_y_geral_int;
-
-   const float INCLINACAO_PAREDE_SUPERIOR_EXTRA = 0.15f;
-   const float FATOR_ALTURA_PAREDE_SUPERIOR = 1.6f; 
-   const float rx_base_parede_superior = rx_topo_parede_padrao;
-   const float ry_base_parede_superior = ry_topo_parede_padrao;
-   const float z_base_parede_superior = altura_max_parede_padrao;
-   const float rx_topo_parede_superior = rx_base_parede_superior + INCLINACAO_PAREDE_SUPERIOR_EXTRA;
-   const float ry_topo_parede_superior = ry_base_parede_superior + INCLINACAO_PAREDE_SUPERIOR_EXTRA;
-   const float z_topo_parede_superior = altura_max_parede_padrao * FATOR_ALTURA_PAREDE_SUPERIOR;
-
-   const float MARQUISE_ESPESSURA = 0.03f;
-   const float MARQUISE_PROJECAO_RADIAL = -0.3f; 
-   const float MARQUISE_INCLINACAO_Z_OFFSET = 0.08f;
-   const float rx_base_marquise = rx_topo_parede_superior; // Base (atrás) no topo da parede superior
-   const float ry_base_marquise = ry_topo_parede_superior;
-   const float z_base_marquise = z_topo_parede_superior + 0.03f;
-   const float rx_frente_marquise = rx_base_marquise + MARQUISE_PROJECAO_RADIAL; // Frente (projetada) com raio menor
-   const float ry_frente_marquise = ry_base_marquise + MARQUISE_PROJECAO_RADIAL;
-   const float z_frente_marquise = z_base_marquise + MARQUISE_INCLINACAO_Z_OFFSET; // Frente com Z menor 
-
-   //Desenhando Grama
-
-   glColor3f(0.7f, 0.7f, 0.7f); // Cor base branca para não tingir a textura
-   glBindTexture(GL_TEXTURE_2D, idTexturaGrama); // Usa a textura da grama
-
-   // Define Z ligeiramente acima do chão para evitar Z-fighting
-   glColor3f(1.0f, 1.0f, 1.0f);
-    glBindTexture(GL_TEXTURE_2D, idTexturaGrama);
-
-    const float Z_GRAMA = Z_CHAO + 0.001f;
-    const int segmentos_curva_grama = 60;
-    const float repTexturaGrama = 8.0f;
-
-    glBegin(GL_TRIANGLE_FAN);
-        glNormal3f(0.0f, 0.0f, 1.0f);
-        glTexCoord2f(0.5f * repTexturaGrama, 0.5f * repTexturaGrama);
-        glVertex3f(centro_x, centro_y, Z_GRAMA);
-
-        for (int i = 0; i <= segmentos_curva_grama; i++) {
-            float fracao = (float)i / (float)segmentos_curva_grama;
-            float angulo_rad = fracao * 2.0f * PI;
-            float cos_a = cosf(angulo_rad);
-            float sin_a = sinf(angulo_rad);
-
-            // *** ALTERAÇÃO AQUI: Usar os raios calculados do gramado ***
-            float vx = centro_x + 0.4 * cos_a; // <-- Usa raio_x_gramado
-            float vy = centro_y + 0.6 * sin_a; // <-- Usa raio_y_gramado
-
-            float s_tex = (cos_a + 1.0f) * 0.5f * repTexturaGrama;
-            float t_tex = (sin_a + 1.0f) * 0.5f * repTexturaGrama;
+   // Objetos fora da câmera não são desenhados (testados por setor)
+   float planosFrustum[6][4];
+   extrairPlanosFrustum(planosFrustum);
 
-            glNormal3f(0.0f, 0.0f, 1.0f);
-            glTexCoord2f(s_tex, t_tex);
-            glVertex3f(vx, vy, Z_GRAMA);
-        }
-    glEnd();
+   // Clique pendente: raio com as matrizes deste quadro
+   int pedido = pedidoSelecao.exchange(-1);
+   if (pedido >= 0) selecionarNaTela(pedido >> 16, pedido & 0xFFFF);
 
-   // --- 2. Desenhar Arquibancadas (Degraus) ---
-   glColor3f(1.0f, 1.0f, 1.0f);
-   glBindTexture(GL_TEXTURE_2D, idTexturaConcreto);
-   for (int i = 0; i < num_arcos_principais; ++i) {
-       float ang_inicio_arco = arcos_principais[i][0];
-       float ang_fim_arco = arcos_principais[i][1];
-       float z_topo_anterior = Z_BASE_INICIAL;
-       bool secao_especial = (fabs(ang_inicio_arco - 140.0f) < FLOAT_COMPARISON_TOLERANCE);
-
-       // Define parâmetros para este arco (padrão ou especial)
-       int num_degraus_atual = secao_especial ? num_degraus_secao_especial : NUM_DEGRAUS;
-       // A altura máxima aqui refere-se à arquibancada
-       float altura_max_atual_seating = secao_especial ? altura_max_secao_especial : altura_max_parede_padrao;
-       float largura_radial_x_atual = secao_especial ? largura_radial_x_especial : largura_radial_x_padrao;
-       float largura_radial_y_atual = secao_especial ? largura_radial_y_especial : largura_radial_y_padrao;
-
-       // Desenha os degraus
-       for (int k = 0; k < num_degraus_atual; ++k) {
-           float z_topo_atual = Z_BASE_INICIAL + (altura_max_atual_seating - Z_BASE_INICIAL) * ((float)(k + 1) / num_degraus_atual);
-           float z_base_atual = z_topo_anterior;
-
-           float fracao_raio_int = (float)k / num_degraus_atual;
-           float fracao_raio_ext = (float)(k + 1) / num_degraus_atual;
-           float rx_int_k = raio_x_geral_int + largura_radial_x_atual * fracao_raio_int;
-           float ry_int_k = raio_y_geral_int + largura_radial_y_atual * fracao_raio_int;
-           float rx_ext_k = raio_x_geral_int + largura_radial_x_atual * fracao_raio_ext;
-           float ry_ext_k = raio_y_geral_int + largura_radial_y_atual * fracao_raio_ext;
-
-           desenharDegrauArquibancada(
-               centro_x, centro_y,
-               rx_int_k, ry_int_k, rx_ext_k, ry_ext_k,
-               z_base_atual, z_topo_atual,
-               ang_inicio_arco, ang_fim_arco,
-               segmentos_curva_degrau
-           );
-           z_topo_anterior = z_topo_atual;
+   // --- 1. Chão, Grama, Arquibancadas (Degraus), Paredes, Marquise e Tampas ---
+   const PassoRender passosMalha[] = {
+       PASSO_CHAO, PASSO_GRAMA, PASSO_ARQUIBANCADA, PASSO_PAREDES, PASSO_MARQUISE, PASSO_TAMPAS
+   };
+   bool iluminar = iluminacaoLigada.load();
+   bool shaders = usarShaders();
+   if (shaders) {
+       atualizarUniformesShaders(cena, iluminar);
+   } else if (iluminar) {
+       ligarIluminacao(cena);
+   }
+   for (size_t i = 0; i < sizeof(passosMalha) / sizeof(passosMalha[0]); i++) {
+       iniciarPasso(passosMalha[i]);
+       if (shaders) {
+           desenharLoteMalhaShader(passosMalha[i], planosFrustum);
+       } else {
+           desenharLoteMalha(lotesMalha[passosMalha[i]], planosFrustum);
        }
+       finalizarPasso(passosMalha[i]);
    }
+   if (iluminar && !shaders) desligarIluminacao();
 
+   // Sombras da marquise e da parede superior sobre o que já foi desenhado
+   iniciarPasso(PASSO_SOMBRAS);
+   desenharSombras(cena);
+   finalizarPasso(PASSO_SOMBRAS);
 
-   // --- 3. Desenhar Paredes Externas e Tampas ---
-   glColor3f(0.9f, 0.9f, 0.9f);
-   glBindTexture(GL_TEXTURE_2D, idTexturaConcretoExterno);
-
-    const float INCLINACAO_MARQUISE_EXTRA = 0.10f; // Inclinação *adicional* à base da marquise
-    const float ALTURA_INICIO_MARQUISE_FATOR = 1.05f; // Começa 5% acima da parede superior
-    const float ALTURA_FIM_MARQUISE_FATOR = 1.4f;
- 
-   // Desenha as Paredes Principais (PADRÃO - até altura_max_parede_padrao)
-   for (int i = 0; i < num_arcos_principais; ++i) {
-       float ang_inicio_arco = arcos_principais[i][0];
-       float ang_fim_arco = arcos_principais[i][1];
-       desenharParedeExterna(
-           centro_x, centro_y,
-           raio_x_geral_ext, raio_y_geral_ext,           // Base padrão
-           rx_topo_parede_padrao, ry_topo_parede_padrao, // Topo padrão
-           Z_BASE_INICIAL, altura_max_parede_padrao,     // Altura padrão
-           ang_inicio_arco, ang_fim_arco, segmentos_curva_parede
-       );
+   // Mapa de análise sobre os tampos dos degraus
+   int modoAnalise = modoAnaliseAtual.load();
+   iniciarPasso(PASSO_ANALISE);
+   if (modoAnalise != ANALISE_DESLIGADA) {
+       prepararAnalise(modoAnalise);
+       desenharLoteMalha(mantoAnalise, planosFrustum);
+   }
+   finalizarPasso(PASSO_ANALISE);
+
+   // --- 2. Assentos e Torcida (nível de detalhe pelo tamanho na tela) ---
+   Vetor3 olho = posicaoOlhoModelview();
+   float focoPixels = cena.alturaJanela / (2.0f * tanf(GRAUS_PARA_RAD(CAMPO_VISAO_GRAUS) * 0.5f));
+   iniciarPasso(PASSO_ASSENTOS);
+   if (layoutAssentosAtual.load() != LAYOUT_OCULTO) {
+       if (shaders) {
+           desenharAssentosShader(planosFrustum, olho, focoPixels);
+       } else {
+           desenharAssentos(planosFrustum, olho, focoPixels);
+       }
    }
+   finalizarPasso(PASSO_ASSENTOS);
 
-   // Desenha as Paredes de Conexão
-   for (int i = 0; i < num_arcos_conexao; ++i) {
-       float ang_inicio_arco = arcos_conexao[i][0];
-       float ang_fim_arco = arcos_conexao[i][1];
-       desenharParedeExterna(
-           centro_x, centro_y,
-           raio_x_geral_ext, raio_y_geral_ext,           // Base padrão
-           rx_topo_parede_padrao, ry_topo_parede_padrao, // Topo padrão
-           Z_BASE_INICIAL, altura_arco_conexao,          // Altura de conexão (usando seu valor *7)
-           ang_inicio_arco, ang_fim_arco, segmentos_curva_parede
-       );
+   iniciarPasso(PASSO_TORCIDA);
+   if (torcidaVisivel.load() && shaders) {
+       desenharTorcidaShader(planosFrustum, olho, direitaCameraModelview(), focoPixels,
+                             cena.tempoCena, cena.alturasOla);
+   } else if (torcidaVisivel.load()) {
+       desenharTorcida(planosFrustum, olho, direitaCameraModelview(), focoPixels,
+                       cena.tempoCena, cena.alturasOla);
    }
+   finalizarPasso(PASSO_TORCIDA);
 
-   // Desenha a PAREDE SUPERIOR ADICIONAL (140-220) 
-   desenharParedeExterna(
-       centro_x, centro_y,
-       rx_base_parede_superior, ry_base_parede_superior, // Base = Topo da parede padrão
-       rx_topo_parede_superior, ry_topo_parede_superior, // Topo = Mais inclinado
-       z_base_parede_superior, z_topo_parede_superior,   // Altura = Acima da parede padrão
-       140.0f, 220.0f,                                   // Apenas neste ângulo da Elipse
-       segmentos_curva_parede 
-   );
-
-   //Desenha Marquise
-   desenharMarquiseCobertura(
-    centro_x, centro_y,
-    rx_base_marquise, ry_base_marquise, z_base_marquise,     // Base (Superior)
-    rx_frente_marquise, ry_frente_marquise, z_frente_marquise, // Frente (Superior)
-    MARQUISE_ESPESSURA,                                      // Espessura
-    180.0f, 220.0f,                                          // Ângulo da Elipse
-    segmentos_curva_parede / 2
-    );
-    // Restaurar cor/textura da parede se necessário
-    glColor3f(0.9f, 0.9f, 0.9f);
-    glBindTexture(GL_TEXTURE_2D, idTexturaConcretoExterno);
-
-
-   // Desenha as Tampas Laterais (pulando 0, 140, 220, 360)
-   float altura_interna_tampa = altura_arco_conexao; // Altura interna da tampa é sempre a de conexão
-   for (int i = 0; i < num_arcos_principais; ++i) {
-       float ang_inicio_arco = arcos_principais[i][0];
-       float ang_fim_arco = arcos_principais[i][1];
-
-       // *** ALTERADO/CONFIRMADO: Lógica para pular tampas e ajustar adjacentes ***
-       // Verifica se a tampa INICIAL deve ser desenhada
-       bool desenhar_tampa_inicial =
-              fabs(ang_inicio_arco -   0.0f) > FLOAT_COMPARISON_TOLERANCE
-           && fabs(ang_inicio_arco - 140.0f) > FLOAT_COMPARISON_TOLERANCE
-           && fabs(ang_inicio_arco - 220.0f) > FLOAT_COMPARISON_TOLERANCE;
-
-       if (desenhar_tampa_inicial) {
-            // Determina parâmetros do TOPO EXTERNO para a tampa INICIAL
-            float rx_final_topo_ext = rx_topo_parede_padrao;      // Default
-            float ry_final_topo_ext = ry_topo_parede_padrao;
-            float z_final_topo_ext = altura_max_parede_padrao;
-
-            // Se a tampa inicial for em 240 graus, ela encontra a parede superior que termina em 220
-            if (fabs(ang_inicio_arco - 240.0f) < FLOAT_COMPARISON_TOLERANCE) {
-                rx_final_topo_ext = rx_topo_parede_superior; // Usa topo da parede superior
-                ry_final_topo_ext = ry_topo_parede_superior;
-                z_final_topo_ext = z_topo_parede_superior;
-            }
-
-            desenharTampaLateral(
-               centro_x, centro_y, ang_inicio_arco,
-               raio_x_geral_int, raio_y_geral_int, Z_BASE_INICIAL,      // Base interna
-               raio_x_geral_ext, raio_y_geral_ext, Z_BASE_INICIAL,      // Base externa
-               rx_final_topo_ext, ry_final_topo_ext, z_final_topo_ext, // Topo externo (Calculado)
-               raio_x_geral_int, raio_y_geral_int, altura_interna_tampa // Topo interno
-            );
-       }
+   iniciarPasso(PASSO_SELECAO);
+   desenharSelecao();
+   finalizarPasso(PASSO_SELECAO);
 
+   // A cor corrente fica indefinida depois do array de cores
+   glColor3f(0.9f, 0.9f, 0.9f);
 
-       // Verifica se a tampa FINAL deve ser desenhada
-       bool desenhar_tampa_final =
-              fabs(ang_fim_arco - 360.0f) > FLOAT_COMPARISON_TOLERANCE
-           && fabs(ang_fim_arco - 140.0f) > FLOAT_COMPARISON_TOLERANCE
-           && fabs(ang_fim_arco - 220.0f) > FLOAT_COMPARISON_TOLERANCE;
-
-       if (desenhar_tampa_final) {
-            // Determina parâmetros do TOPO EXTERNO para a tampa FINAL
-            float rx_final_topo_ext = rx_topo_parede_padrao;      // Default
-            float ry_final_topo_ext = ry_topo_parede_padrao;
-            float z_final_topo_ext = altura_max_parede_padrao;
-
-            // Se a tampa final for em 120 graus, ela encontra a parede superior que começa em 140
-            if (fabs(ang_fim_arco - 120.0f) < FLOAT_COMPARISON_TOLERANCE) {
-                rx_final_topo_ext = rx_topo_parede_superior; // Usa topo da parede superior
-                ry_final_topo_ext = ry_topo_parede_superior;
-                z_final_topo_ext = z_topo_parede_superior;
-            }
-
-            desenharTampaLateral(
-               centro_x, centro_y, ang_fim_arco,
-               raio_x_geral_int, raio_y_geral_int, Z_BASE_INICIAL,      // Base interna
-               raio_x_geral_ext, raio_y_geral_ext, Z_BASE_INICIAL,      // Base externa
-               rx_final_topo_ext, ry_final_topo_ext, z_final_topo_ext, // Topo externo (Calculado)
-               raio_x_geral_int, raio_y_geral_int, altura_interna_tampa // Topo interno
-            );
-       }
-   } // Fim loop for (para tampas)
-   if (alphaFiltro > 0.0f) {
-    glDisable(GL_DEPTH_TEST); 
+   // O céu atmosférico escurece a cena pela luz da hora; sem ele, o filtro preto
+   bool ceuLigado = ceuAtmosfericoLigado.load();
+   Vetor3 solCeu = vetor3(0.0f, 0.0f, 1.0f);
+   if (ceuLigado) {
+       float horaCeu = horaCeuCena(cena);
+       atualizarCeu(horaCeu);
+       solCeu = direcaoSol(diaDoAnoSol, horaCeu);
+   }
+   iniciarPasso(PASSO_FILTRO_NOITE);
+   if (ceuLigado) {
+       escurecerCenaCeu();
+   } else if (cena.alphaFiltro > 0.0f) {
+    alterarEstadoGL(GL_DEPTH_TEST, false); 
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
@@ -684,63 +7865,189 @@ void display() {
     glLoadIdentity();
 
     for (int i = 0; i < 4; i++) {  
-        glColor4f(0.0f, 0.0f, 0.0f, alphaFiltro);
-        glBegin(GL_QUADS);
-            glVertex2f(0.0f, 0.0f);
-            glVertex2f(1.0f, 0.0f);
-            glVertex2f(1.0f, 1.0f);
-            glVertex2f(0.0f, 1.0f);
-        glEnd();
+        glColor4f(0.0f, 0.0f, 0.0f, cena.alphaFiltro);
+        iniciarPrimitiva(GL_QUADS);
+            enviarVertice2f(0.0f, 0.0f);
+            enviarVertice2f(1.0f, 0.0f);
+            enviarVertice2f(1.0f, 1.0f);
+            enviarVertice2f(0.0f, 1.0f);
+        finalizarPrimitiva();
     }
 
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_DEPTH_TEST);
+    alterarEstadoGL(GL_DEPTH_TEST, true);
+    }
+    finalizarPasso(PASSO_FILTRO_NOITE);
+
+    // Céu no fundo, depois de toda a geometria (só onde a profundidade ficou vazia)
+    iniciarPasso(PASSO_CEU);
+    if (ceuLigado) {
+        float camera[16];
+        glGetFloatv(GL_MODELVIEW_MATRIX, camera);
+        desenharCeu(camera, solCeu, (float)cena.larguraJanela / std::max(cena.alturaJanela, 1));
     }
+    finalizarPasso(PASSO_CEU);
     // Desenho dos refletores
     // glDisable(GL_TEXTURE_2D); // Desabilita texturas para os refletores
 
-    const int NUM_REFLETORES = 105;
-    float ang_inicio_refletores = 180.0f;
-    float ang_fim_refletores = 220.0f;
+    float ang_inicio_refletores = anguloInicialMarquiseMalha;
+    float ang_fim_refletores = MARQUISE_ANGULO_FINAL;
     float intervalo_angular_refletores = ang_fim_refletores - ang_inicio_refletores;
 
-    for (int i = 0; i < NUM_REFLETORES; ++i) {
-        float fracao = (NUM_REFLETORES > 1) ? (float)i / (float)(NUM_REFLETORES - 1) : 0.5f;
+    for (int i = 0; i < NUM_REFLETORES_MARQUISE; ++i) {
+        float fracao = (NUM_REFLETORES_MARQUISE > 1) ? (float)i / (float)(NUM_REFLETORES_MARQUISE - 1) : 0.5f;
         float angulo_graus_atual = ang_inicio_refletores + fracao * intervalo_angular_refletores;
         float angulo_rad_atual = GRAUS_PARA_RAD(angulo_graus_atual);
         float cos_a = cosf(angulo_rad_atual);
         float sin_a = sinf(angulo_rad_atual);
 
         // Calcula a posição na BORDA FRONTAL da marquise (inalterado)
-        float refletoe_x = centro_x + rx_frente_marquise * cos_a;
-        float refletoe_y = centro_y + ry_frente_marquise * sin_a;
-        float refletoe_z = z_frente_marquise;
+        float refletoe_x = estadio.centro_x + estadio.rx_frente_marquise * cos_a;
+        float refletoe_y = estadio.centro_y + estadio.ry_frente_marquise * sin_a;
+        float refletoe_z = estadio.z_frente_marquise;
 
         // *** ALTERADO: Passa o estado 'luzesRefletoresLigadas' para a função ***
     }
-    glEnable(GL_TEXTURE_2D);
+    alterarEstadoGL(GL_TEXTURE_2D, true);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glutSwapBuffers();
+    vincularTextura(0);
+
+    if (cena.painelPerfilVisivel) {
+        desenharPainelPerfil(cena.larguraJanela, cena.alturaJanela);
+    }
+    finalizarQuadroPerfil();
+    finalizarQuadroEstatisticas();
+    atenderPedidosRender();
+}
+
+// Projeção em perspectiva para o tamanho de janela dado
+void aplicarProjecao(int largura, int altura) {
+    // Previne divisão por zero se a janela for minimizada
+    if (altura == 0) {
+        altura = 1;
+    }
+    // Calcula a proporção largura/altura da janela
+    float proporcao = (float)largura / (float)altura;
+
+    // Define a área de desenho (viewport) para ocupar toda a janela
+    glViewport(0, 0, largura, altura);
+
+    // Define a matriz de Projeção como a matriz atual
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity(); // Reseta a matriz de projeção
+
+    // Configura a projeção em perspectiva
+    // Parâmetros: ângulo de visão Y, proporção, plano de corte próximo (near), plano de corte distante (far)
+    gluPerspective(CAMPO_VISAO_GRAUS, proporcao, PLANO_PROXIMO, PLANO_DISTANTE);
+
+    // Retorna para a matriz de ModelView para as operações de desenho e câmera
+    glMatrixMode(GL_MODELVIEW);
+}
+
+// --- Thread de Renderização ---
+// Com --thread-render, o contexto GL sai da thread do GLUT (que passa a só
+// tratar entrada e simulação) e fica com uma thread dedicada que desenha
+// continuamente o instantâneo mais recente da cena.
+std::atomic<bool> encerrarThreadRender(false);
+std::thread *threadRender = NULL;
+
+#ifdef RENDER_THREAD_GLX
+Display *displayX = NULL;
+GLXDrawable drawableGlx = 0;
+GLXContext contextoGlx = NULL;
+
+void lacoThreadRender() {
+    nomearThreadRastreio("render");
+    glXMakeCurrent(displayX, drawableGlx, contextoGlx);
+    int larguraAplicada = -1, alturaAplicada = -1;
+    while (!encerrarThreadRender.load()) {
+        const EstadoCena &cena = consumirEstadoCena();
+        if (cena.larguraJanela != larguraAplicada || cena.alturaJanela != alturaAplicada) {
+            larguraAplicada = cena.larguraJanela;
+            alturaAplicada = cena.alturaJanela;
+            aplicarProjecao(larguraAplicada, alturaAplicada);
+        }
+        renderizarCena(cena);
+        RASTREAR_ESCOPO("glXSwapBuffers");
+        glXSwapBuffers(displayX, drawableGlx);
+    }
+    glXMakeCurrent(displayX, None, NULL);
+}
+#endif
+
+// Registrada com atexit(): a thread precisa soltar o contexto antes do fim do processo
+void encerrarRenderizacaoEmThread() {
+    if (!threadRender) return;
+    encerrarThreadRender.store(true);
+    threadRender->join();
+    delete threadRender;
+    threadRender = NULL;
+}
+
+bool iniciarRenderizacaoEmThread() {
+#ifdef RENDER_THREAD_GLX
+    displayX = glXGetCurrentDisplay();
+    drawableGlx = glXGetCurrentDrawable();
+    contextoGlx = glXGetCurrentContext();
+    if (!displayX || !contextoGlx) {
+        fprintf(stderr, "Aviso: contexto GLX indisponível, renderização na thread principal.\n");
+        return false;
+    }
+    publicarEstadoCena();
+    glXMakeCurrent(displayX, None, NULL); // Libera o contexto para a thread de renderização
+    threadRender = new std::thread(lacoThreadRender);
+    atexit(encerrarRenderizacaoEmThread);
+    return true;
+#else
+    fprintf(stderr, "Aviso: --thread-render não suportado nesta plataforma.\n");
+    return false;
+#endif
+}
+
+void display() {
+    RASTREAR_FUNCAO();
+    if (renderEmThreadSeparada) return; // Os quadros são desenhados pela thread de renderização
+    avancarSimulacao();
+    aplicarAmostraReproducao();
+    aplicarVooCamera();
+    publicarEstadoCena();
+    const EstadoCena &cena = consumirEstadoCena();
+    renderizarCena(cena);
+    if (arquivoCapturaGl) {
+        capturarQuadroGl(arquivoCapturaGl, cena.larguraJanela, cena.alturaJanela);
+        exit(0);
+    }
+    registrarQuadroReproducao();
+    avancarVooCamera();
+    {
+        RASTREAR_ESCOPO("glutSwapBuffers");
+        glutSwapBuffers();
+    }
 }
 
 void idle() {
-    static int contador = 0;
-    contador++;
-    if (contador > 5000) {  // muda a cada x frames (~alguns segundos)
-        modoNoite = !modoNoite;
-        contador = 0;
+    RASTREAR_FUNCAO();
+    amostrarGravacaoCamera();
+    if (renderEmThreadSeparada) {
+        // Lado da simulação: avança os passos fixos e publica o estado.
+        // A pausa curta evita girar em vazio sem atrasar a entrada.
+        avancarSimulacao();
+        publicarEstadoCena();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return;
     }
     glutPostRedisplay();
 }
 
 // --- Função de callback: Inicialização ---
 void init() {
+    RASTREAR_FUNCAO();
+    double inicio = tempoAtualMs();
     // Define a cor de fundo da janela (RGBA) - um azul céu claro
-    glClearColor(0.529f, 0.808f, 0.922f, 1.0f);
+    glClearColor(COR_CEU[0], COR_CEU[1], COR_CEU[2], 1.0f);
 
     // Habilita o uso de texturas 2D
     glEnable(GL_TEXTURE_2D);
@@ -751,6 +8058,9 @@ void init() {
     // Habilita o teste de profundidade (Z-buffer) para que objetos mais próximos ocultem os mais distantes
     glEnable(GL_DEPTH_TEST);
 
+    // Consultas de tempo da GPU para o painel de perfil
+    inicializarPerfil();
+
     // Carrega as texturas necessárias
     idTexturaConcreto = carregarTextura("concreto.jpg");
     if (idTexturaConcreto == 0) { // Verifica se o carregamento falhou
@@ -772,71 +8082,139 @@ void init() {
        fprintf(stderr, "ERRO FATAL: Textura 'concreto_externo.jpg' não carregada!\n");
        exit(1);
    }
+
+    construirMalhaEstadio(fatorDetalheMalha.load());
+    if (arquivoMapaLuz) carregarMapaLuz(arquivoMapaLuz);
+    construirAssentos(layoutAssentosAtual.load());
+    construirGradeOla();
+    construirTorcida();
+    iniciarShaders();
+    iniciarCeu();
+    registrarSistemaSimulacao(avancarOla);
+    if (msEconomizadosCacheShaders > 0.0) {
+        printf("Inicialização em %.1f ms (%.1f ms economizados pelo cache de shaders)\n",
+               tempoAtualMs() - inicio, msEconomizadosCacheShaders);
+    } else {
+        printf("Inicialização em %.1f ms\n", tempoAtualMs() - inicio);
+    }
 }
 
 // --- Função de callback: Redimensionamento da Janela ---
 void reshape(int largura, int altura) {
-    // Previne divisão por zero se a janela for minimizada
-    if (altura == 0) {
-        altura = 1;
+    larguraJanela = largura;
+    alturaJanela = altura;
+    if (renderEmThreadSeparada) {
+        publicarEstadoCena(); // A thread de renderização aplica a nova projeção
+        return;
     }
-    // Calcula a proporção largura/altura da janela
-    float proporcao = (float)largura / (float)altura;
-
-    // Define a área de desenho (viewport) para ocupar toda a janela
-    glViewport(0, 0, largura, altura);
-
-    // Define a matriz de Projeção como a matriz atual
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity(); // Reseta a matriz de projeção
-
-    // Configura a projeção em perspectiva
-    // Parâmetros: ângulo de visão Y, proporção, plano de corte próximo (near), plano de corte distante (far)
-    gluPerspective(60.0, proporcao, 0.1, 100.0);
-
-    // Retorna para a matriz de ModelView para as operações de desenho e câmera
-    glMatrixMode(GL_MODELVIEW);
+    aplicarProjecao(largura, altura);
 }
 
+// Teclado - apenas enfileira; o efeito é aplicado uma vez por quadro
 void keyboard(unsigned char key, int x, int y) {
-    printf("Tecla: %c\n", key);
-
-    float cameraSpeed = 0.5f; // Velocidade de movimento
-    float rad = cameraAngle * M_PI / 180.0f;
-    float dirX = sin(rad);
-    float dirZ = -cos(rad);
-
-    switch (key) {
-        case 'a': // Rotacionar à esquerda
-            cameraAngle -= 5.0f;
-            break;
-        case 'd': // Rotacionar à direita
-            cameraAngle += 5.0f;
-            break;
-        case 'w': // Subir (eixo Y)
-            camera_position[1] += cameraSpeed;
-            break;
-        case 's': // Descer (eixo Y)
-            camera_position[1] -= cameraSpeed;
-            break;
-        case 'j': // Aproximar (zoom in)
-            camera_position[0] += dirX * cameraSpeed;
-            camera_position[2] += dirZ * cameraSpeed;
-            break;
-        case 'k': // Afastar (zoom out)
-            camera_position[0] -= dirX * cameraSpeed;
-            camera_position[2] -= dirZ * cameraSpeed;
-            break;
-        case 27: // ESC
-            exit(0);
-            break;
-    }
+    empilharEventoEntrada(EVENTO_TECLA_PRESSIONADA, (unsigned char)tolower(key), 0, 0);
+}
 
-    glutPostRedisplay();
+void keyboardUp(unsigned char key, int x, int y) {
+    empilharEventoEntrada(EVENTO_TECLA_SOLTA, (unsigned char)tolower(key), 0, 0);
 }
 
 // --- Função Principal ---
 int main(int numArgumentos, char** argumentos) {
+    caminhoExecutavel = argumentos[0];
+    // --thread-render precisa ser conhecido antes do GLUT abrir a conexão com o X
+    bool pedidoThreadRender = false;
+    for (int i = 1; i < numArgumentos; i++) {
+        if (strcmp(argumentos[i], "--thread-render") == 0) pedidoThreadRender = true;
+        // Benchmark sem janela: roda e sai
+        if (strcmp(argumentos[i], "--benchmark-ola") == 0) {
+            executarBenchmarkOla(i + 1 < numArgumentos ? atoi(argumentos[i + 1]) : 100000);
+            return 0;
+        }
+        if (strcmp(argumentos[i], "--benchmark-visibilidade") == 0) {
+            executarBenchmarkVisibilidade(i + 1 < numArgumentos ? atoi(argumentos[i + 1]) : 0);
+            return 0;
+        }
+    }
+
+    // Opções de linha de comando, lidas antes do GLUT para que --render-cpu
+    // --render-still e --bake-luz rodem sem servidor gráfico (as opções do GLUT são ignoradas aqui)
+    int numThreadsTarefas = 0; // 0: todos os núcleos
+    const char *arquivoRenderCpu = NULL, *arquivoReferenciaCpu = NULL;
+    const char *arquivoRenderStill = NULL, *arquivoBakeLuz = NULL;
+    int amostrasStill = 64;
+    float horaSol = 15.0f;     // --render-still, --bake-luz e sol das sombras
+    for (int i = 1; i < numArgumentos; i++) {
+        if (strcmp(argumentos[i], "--trace") == 0 && i + 1 < numArgumentos) {
+            arquivoRastreio = argumentos[++i];
+            rastreioAtivo = true;
+            nomearThreadRastreio("principal");
+            atexit(gravarRastreioChrome);
+        } else if (strcmp(argumentos[i], "--replay") == 0 && i + 1 < numArgumentos) {
+            if (!carregarSessaoCamera(argumentos[++i])) exit(1);
+            sairAoFimDaReproducao = true;
+        } else if (strcmp(argumentos[i], "--voo") == 0 && i + 1 < numArgumentos) {
+            voltasBenchmarkVoo = atoi(argumentos[++i]);
+            if (voltasBenchmarkVoo < 1) voltasBenchmarkVoo = 1;
+        } else if (strcmp(argumentos[i], "--threads") == 0 && i + 1 < numArgumentos) {
+            numThreadsTarefas = atoi(argumentos[++i]);
+        } else if (strcmp(argumentos[i], "--dia-sol") == 0 && i + 1 < numArgumentos) {
+            diaDoAnoSol = std::max(1, std::min(atoi(argumentos[++i]), 365));
+        } else if (strcmp(argumentos[i], "--detalhe") == 0 && i + 1 < numArgumentos) {
+            int detalhe = atoi(argumentos[++i]);
+            if (detalhe < 1) detalhe = 1;
+            if (detalhe > FATOR_DETALHE_MAXIMO) detalhe = FATOR_DETALHE_MAXIMO;
+            fatorDetalheMalha.store(detalhe);
+        } else if (strcmp(argumentos[i], "--tamanho") == 0 && i + 1 < numArgumentos) {
+            int largura, altura;
+            if (sscanf(argumentos[++i], "%dx%d", &largura, &altura) == 2 && largura > 0 && altura > 0) {
+                larguraJanela = largura;
+                alturaJanela = altura;
+            }
+        } else if (strcmp(argumentos[i], "--camera") == 0 && i + 1 < numArgumentos) {
+            float c[5];
+            if (sscanf(argumentos[++i], "%f,%f,%f,%f,%f", &c[0], &c[1], &c[2], &c[3], &c[4]) == 5) {
+                for (int k = 0; k < 3; k++) camera_position[k] = c[k];
+                anguloRotacaoX = c[3];
+                anguloRotacaoZ = c[4];
+            }
+        } else if (strcmp(argumentos[i], "--filtro-noite") == 0 && i + 1 < numArgumentos) {
+            alphaFiltro = std::max(0.0f, std::min((float)atof(argumentos[++i]), 1.0f));
+        } else if (strcmp(argumentos[i], "--render-cpu") == 0 && i + 1 < numArgumentos) {
+            arquivoRenderCpu = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--referencia") == 0 && i + 1 < numArgumentos) {
+            arquivoReferenciaCpu = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--capturar-gl") == 0 && i + 1 < numArgumentos) {
+            arquivoCapturaGl = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--render-still") == 0 && i + 1 < numArgumentos) {
+            arquivoRenderStill = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--amostras") == 0 && i + 1 < numArgumentos) {
+            amostrasStill = std::max(1, atoi(argumentos[++i]));
+        } else if (strcmp(argumentos[i], "--hora") == 0 && i + 1 < numArgumentos) {
+            horaSol = std::max(0.0f, std::min((float)atof(argumentos[++i]), 24.0f));
+        } else if (strcmp(argumentos[i], "--bake-luz") == 0 && i + 1 < numArgumentos) {
+            arquivoBakeLuz = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--mapa-luz") == 0 && i + 1 < numArgumentos) {
+            arquivoMapaLuz = argumentos[++i];
+        } else if (strcmp(argumentos[i], "--pipeline-fixo") == 0) {
+            shadersLigados.store(false);
+        }
+    }
+    horaSolCena.store(horaSol);
+    // A captura serve de referência para a CPU, que não desenha as sombras nem o céu
+    if (arquivoCapturaGl) {
+        sombrasLigadas.store(false);
+        ceuAtmosfericoLigado.store(false);
+    }
+    iniciarSistemaTarefas(numThreadsTarefas);
+    if (arquivoRenderCpu) return executarRenderCpu(arquivoRenderCpu, arquivoReferenciaCpu);
+    if (arquivoRenderStill) return executarRenderStill(arquivoRenderStill, amostrasStill, horaSol);
+    if (arquivoBakeLuz) return executarBakeLuz(arquivoBakeLuz, horaSol);
+
+#ifdef RENDER_THREAD_GLX
+    if (pedidoThreadRender) XInitThreads();
+#endif
+
     // Inicializa a biblioteca GLUT
     glutInit(&numArgumentos, argumentos);
 
@@ -847,7 +8225,7 @@ int main(int numArgumentos, char** argumentos) {
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
 
     // Define o tamanho inicial da janela (largura, altura)
-    glutInitWindowSize(1200, 800);
+    glutInitWindowSize(larguraJanela, alturaJanela);
 
     // Define a posição inicial da janela na tela (canto superior esquerdo)
     glutInitWindowPosition(100, 100);
@@ -857,7 +8235,6 @@ int main(int numArgumentos, char** argumentos) {
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glutTimerFunc(0, atualizarTransicao, 0);
 
     // Chama nossa função de inicialização (configura OpenGL, carrega texturas)
     init();
@@ -867,11 +8244,27 @@ int main(int numArgumentos, char** argumentos) {
     glutDisplayFunc(display);   // Função a ser chamada para desenhar a cena
     glutReshapeFunc(reshape);   // Função a ser chamada quando a janela é redimensionada
     glutKeyboardFunc(keyboard); // Função a ser chamada quando uma tecla é pressionada
+    glutKeyboardUpFunc(keyboardUp); // ... e quando é solta (movimento enquanto mantida)
+    glutIgnoreKeyRepeat(1);     // A repetição automática do sistema é substituída pela tecla mantida
 
     glutIdleFunc(idle);
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
 
+    if (sairAoFimDaReproducao) {
+        iniciarReproducaoCamera();
+    } else if (voltasBenchmarkVoo > 0) {
+        iniciarVooCamera();
+    }
+
+    if (pedidoThreadRender) {
+        if (sairAoFimDaReproducao || voltasBenchmarkVoo > 0) {
+            fprintf(stderr, "Aviso: benchmarks medem quadro a quadro; ignorando --thread-render.\n");
+        } else {
+            renderEmThreadSeparada = iniciarRenderizacaoEmThread();
+        }
+    }
+
 
     // Exibe as instruções de controle no console
     printf("Controles do Simulador:\n");
@@ -879,6 +8272,25 @@ int main(int numArgumentos, char** argumentos) {
     printf("  A/D: Rotacionar Esquerda/Direita (Eixo Z)\n");
     printf("  X/Z: Rotacionar Inclinação Lateral (Eixo X)\n");
     printf("  K/J: Zoom Out / Zoom In\n"); // Corrigido K/J
+    printf("  Clique: Selecionar setor/degrau/assento\n");
+    printf("  P: Painel de perfil (tempo de CPU/GPU por passo)\n");
+    printf("  C: Exportar perfil para perfil_passos.csv\n");
+    printf("  G: Iniciar/encerrar gravação da câmera (sessao_camera.bin)\n");
+    printf("  R: Reproduzir/interromper a sessão gravada\n");
+    printf("  V: Voo automático ao redor do estádio\n");
+    printf("  E: Imprimir estatísticas de renderização do último quadro\n");
+    printf("  +/-: Mais/menos detalhe na malha do estádio\n");
+    printf("  L: Layout dos assentos (setores / reservas / oculto)\n");
+    printf("  T: Mostrar/ocultar a torcida\n");
+    printf("  O: Iniciar uma ola\n");
+    printf("  H: Mapa de análise (visibilidade / sombra ao longo do dia)\n");
+    printf("  M: Ligar/desligar o mapa de luz (--mapa-luz)\n");
+    printf("  I: Ligar/desligar o modo iluminado (sol e refletores)\n");
+    printf("  U: Ligar/desligar o céu atmosférico\n");
+    printf("  B: Ligar/desligar as sombras da marquise\n");
+    printf("  , / .: Atrasar / adiantar o sol das sombras\n");
+    printf("  F: Alternar entre o pipeline de shaders e o fixo\n");
+    printf("  [ / ]: Encurtar / estender a marquise\n");
     printf("  ESC: Sair\n");
 
     // Inicia o loop principal do GLUT. A partir daqui, GLUT gerencia os eventos.